@@ -143,6 +143,20 @@ namespace graphene { namespace app {
        return res;
     }
 
+    vector<optional<vector<char>>> block_api::get_raw_blocks(uint32_t block_num_from, uint32_t block_num_to)const
+    {
+       FC_ASSERT( block_num_to >= block_num_from );
+       vector<optional<vector<char>>> res;
+       for(uint32_t block_num=block_num_from; block_num<=block_num_to; block_num++) {
+          auto raw_block = _db.fetch_raw_block_by_number(block_num);
+          if( raw_block )
+             res.emplace_back( *raw_block );
+          else
+             res.emplace_back();
+       }
+       return res;
+    }
+
     network_broadcast_api::network_broadcast_api(application& a):_app(a)
     {
        _applied_block_connection = _app.chain_database()->applied_block.connect([this](const signed_block& b){ on_applied_block(b); });
@@ -548,9 +562,25 @@ namespace graphene { namespace app {
           _app(app),
           _db( *app.chain_database()),
           database_api( std::ref(*app.chain_database()), &(app.get_options())
-          ) { }
+          )
+    {
+       if( _app.get_options().has_api_helper_indexes_plugin )
+          _asset_holders_index = &_db.get_index_type< primary_index< account_balance_index > >()
+                                 .get_secondary_index<graphene::api_helper_indexes::asset_holders_index>();
+    }
     asset_api::~asset_api() { }
 
+    static account_asset_balance make_account_asset_balance( const database& db, const account_balance_object& bal )
+    {
+       const auto& account = bal.owner(db);
+
+       account_asset_balance aab;
+       aab.name       = account.name;
+       aab.account_id = account.id;
+       aab.amount     = bal.balance.value;
+       return aab;
+    }
+
     vector<account_asset_balance> asset_api::get_asset_holders( std::string asset, uint32_t start, uint32_t limit ) const
     {
        const auto configured_limit = _app.get_options().api_limit_get_asset_holders;
@@ -567,56 +597,79 @@ namespace graphene { namespace app {
        uint32_t index = 0;
        for( const account_balance_object& bal : boost::make_iterator_range( range.first, range.second ) )
        {
-          if( result.size() >= limit )
+          // Balances are in descending order, so the zero balances are all at the end
+          if( result.size() >= limit || bal.balance.value == 0 )
              break;
 
-          if( bal.balance.value == 0 )
-             continue;
-
           if( index++ < start )
              continue;
 
-          const auto account = _db.find(bal.owner);
+          result.push_back( make_account_asset_balance( _db, bal ) );
+       }
+
+       return result;
+    }
+
+    vector<account_asset_balance> asset_api::list_asset_holders( std::string asset,
+                                                                 optional<share_type> start_balance,
+                                                                 optional<account_id_type> start_account,
+                                                                 uint32_t limit )const
+    {
+       const auto configured_limit = _app.get_options().api_limit_get_asset_holders;
+       FC_ASSERT( limit <= configured_limit,
+                  "limit can not be greater than ${configured_limit}",
+                  ("configured_limit", configured_limit) );
 
-          account_asset_balance aab;
-          aab.name       = account->name;
-          aab.account_id = account->id;
-          aab.amount     = bal.balance.value;
+       FC_ASSERT( start_balance.valid() || !start_account.valid(),
+                  "start_account can only be used together with start_balance" );
 
-          result.push_back(aab);
+       asset_id_type asset_id = database_api.get_asset_id_from_string( asset );
+       const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
+
+       auto itr = bal_idx.lower_bound( boost::make_tuple( asset_id ) );
+       if( start_balance.valid() && start_account.valid() )
+          itr = bal_idx.lower_bound( boost::make_tuple( asset_id, *start_balance, *start_account ) );
+       else if( start_balance.valid() )
+          itr = bal_idx.lower_bound( boost::make_tuple( asset_id, *start_balance ) );
+
+       vector<account_asset_balance> result;
+       result.reserve( limit );
+       for( ; itr != bal_idx.end() && result.size() < limit; ++itr )
+       {
+          if( itr->asset_type != asset_id || itr->balance.value == 0 )
+             break;
+          result.push_back( make_account_asset_balance( _db, *itr ) );
        }
 
        return result;
     }
-    // get number of asset holders.
-    int asset_api::get_asset_holders_count( std::string asset ) const {
-       const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
-       asset_id_type asset_id = database_api.get_asset_id_from_string( asset );
-       auto range = bal_idx.equal_range( boost::make_tuple( asset_id ) );
 
-       int count = boost::distance(range) - 1;
+    uint64_t asset_api::count_holders( asset_id_type asset_id )const
+    {
+       if( _asset_holders_index )
+          return _asset_holders_index->get_holders_count( asset_id );
 
+       const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
+       uint64_t count = 0;
+       for( auto itr = bal_idx.lower_bound( boost::make_tuple( asset_id ) );
+            itr != bal_idx.end() && itr->asset_type == asset_id && itr->balance.value != 0; ++itr )
+          ++count;
        return count;
     }
+
+    // get number of asset holders.
+    int asset_api::get_asset_holders_count( std::string asset ) const {
+       asset_id_type asset_id = database_api.get_asset_id_from_string( asset );
+       return static_cast<int>( count_holders( asset_id ) );
+    }
     // function to get vector of system assets with holders count.
     vector<asset_holders> asset_api::get_all_asset_holders() const {
        vector<asset_holders> result;
-       vector<asset_id_type> total_assets;
        for( const asset_object& asset_obj : _db.get_index_type<asset_index>().indices() )
        {
-          const auto& dasset_obj = asset_obj.dynamic_asset_data_id(_db);
-
-          asset_id_type asset_id;
-          asset_id = dasset_obj.id;
-
-          const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
-          auto range = bal_idx.equal_range( boost::make_tuple( asset_id ) );
-
-          int count = boost::distance(range) - 1;
-
           asset_holders ah;
-          ah.asset_id       = asset_id;
-          ah.count     = count;
+          ah.asset_id = asset_obj.get_id();
+          ah.count    = static_cast<int>( count_holders( ah.asset_id ) );
 
           result.push_back(ah);
        }
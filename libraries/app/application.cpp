@@ -9,7 +9,9 @@
 
 #include <graphene/chain/db_with.hpp>
 #include <graphene/chain/genesis_state.hpp>
+#include <graphene/chain/snapshot.hpp>
 #include <graphene/protocol/fee_schedule.hpp>
+#include <graphene/protocol/signature_cache.hpp>
 #include <graphene/protocol/types.hpp>
 
 #include <graphene/egenesis/egenesis.hpp>
@@ -24,6 +26,7 @@
 #include <fc/io/fstream.hpp>
 #include <fc/rpc/api_connection.hpp>
 #include <fc/rpc/websocket_api.hpp>
+#include <fc/thread/parallel.hpp>
 #include <fc/crypto/base64.hpp>
 
 #include <boost/filesystem/path.hpp>
@@ -397,6 +400,10 @@ void application_impl::set_api_limit() {
       _app_options.api_limit_get_tickets =
             _options->at("api-limit-get-tickets").as<uint64_t>();
    }
+   if(_options->count("api-limit-get-tanks") > 0) {
+      _app_options.api_limit_get_tanks =
+            _options->at("api-limit-get-tanks").as<uint64_t>();
+   }
 }
 
 graphene::chain::genesis_state_type application_impl::initialize_genesis_state() const
@@ -459,6 +466,19 @@ void application_impl::open_chain_database() const
    if( _options->count("resync-blockchain") > 0 )
       _chain_db->wipe(_data_dir / "blockchain", true);
 
+   if( _options->count("restore-from-snapshot") > 0 )
+   {
+      const fc::path snapshot_dir = _options->at("restore-from-snapshot").as<boost::filesystem::path>();
+      ilog( "Restoring chain state from snapshot ${s}", ("s",snapshot_dir) );
+      // Check the snapshot before wiping the current chain state
+      const chain_id_type chain_id = initialize_genesis_state().compute_chain_id();
+      graphene::chain::binary_snapshot::read_manifest( snapshot_dir, chain_id );
+      _chain_db->wipe( _data_dir / "blockchain", true );
+      const auto manifest = graphene::chain::binary_snapshot::restore( snapshot_dir, _data_dir / "blockchain",
+                                                                       chain_id );
+      ilog( "Restored snapshot at block ${n} ${id}", ("n",manifest.head_block_num)("id",manifest.head_block_id) );
+   }
+
    flat_map<uint32_t,block_id_type> loaded_checkpoints;
    if( _options->count("checkpoint") > 0 )
    {
@@ -477,6 +497,25 @@ void application_impl::open_chain_database() const
       _chain_db->enable_standby_votes_tracking( _options->at("enable-standby-votes-tracking").as<bool>() );
    }
 
+   if( _options->count("replay-pipeline-depth") > 0 )
+      _chain_db->set_reindex_pipeline_depth( _options->at("replay-pipeline-depth").as<uint32_t>() );
+
+   if( _options->count("undo-packed-values") > 0 )
+      _chain_db->enable_packed_undo_values( _options->at("undo-packed-values").as<bool>() );
+
+   if( _options->count("block-cache-size") > 0 )
+      _chain_db->set_block_cache_size( _options->at("block-cache-size").as<uint32_t>() );
+
+   if( _options->count("block-sync-interval") > 0 )
+      _chain_db->set_block_sync_interval( _options->at("block-sync-interval").as<uint32_t>() );
+
+   if( _options->count("api-reader-threads") > 0 )
+      _chain_db->set_reader_threads( _options->at("api-reader-threads").as<uint16_t>() );
+
+   if( _options->count("signature-cache-size") > 0 )
+      graphene::protocol::signature_cache::instance().set_capacity(
+            _options->at("signature-cache-size").as<uint32_t>() );
+
    if( _options->count("replay-blockchain") > 0 || _options->count("revalidate-blockchain") > 0 )
       _chain_db->wipe( _data_dir / "blockchain", false );
 
@@ -653,6 +692,17 @@ bool application_impl::handle_block(const graphene::net::block_message& blk_msg,
    }
 } FC_CAPTURE_AND_RETHROW( (blk_msg)(sync_mode) ) return false; }
 
+fc::future<void> application_impl::precompute_block(
+      const std::shared_ptr<const graphene::net::block_message>& blk_msg )
+{
+   // same as in handle_block()
+   const uint32_t skip = (_is_block_producer || _force_validate) ?
+                            database::skip_nothing : database::skip_transaction_signatures;
+   return fc::do_parallel( [this,blk_msg,skip] () {
+      _chain_db->precompute_sequential( blk_msg->block, skip );
+   });
+}
+
 void application_impl::handle_transaction(const graphene::net::trx_message& transaction_message)
 { try {
    static fc::time_point last_call;
@@ -678,8 +728,8 @@ void application_impl::handle_message(const message& message_to_process)
 bool application_impl::is_included_block(const block_id_type& block_id)
 {
   uint32_t block_num = block_header::num_from_id(block_id);
-  block_id_type block_id_in_preferred_chain = _chain_db->get_block_id_for_num(block_num);
-  return block_id == block_id_in_preferred_chain;
+  optional<block_id_type> block_id_in_preferred_chain = _chain_db->find_block_id_for_num(block_num);
+  return block_id_in_preferred_chain.valid() && block_id == *block_id_in_preferred_chain;
 }
 
 /**
@@ -727,6 +777,11 @@ std::vector<item_hash_t> application_impl::get_block_ids(const std::vector<item_
        FC_THROW_EXCEPTION( graphene::net::peer_is_on_an_unreachable_fork,
                            "Unable to provide a list of blocks starting at any of the blocks in peer's synopsis" );
    }
+   // A node restored from a snapshot has no blocks before it, peers behind it have to sync from other nodes
+   const uint32_t first_block_num = std::max<uint32_t>( 1, block_header::num_from_id(last_known_block_id) );
+   if( first_block_num <= _chain_db->head_block_num() && !_chain_db->find_block_id_for_num(first_block_num).valid() )
+     FC_THROW_EXCEPTION( graphene::net::peer_is_on_an_unreachable_fork,
+                         "Block ${n} is older than the snapshot this node was restored from", ("n",first_block_num) );
    for( uint32_t num = block_header::num_from_id(last_known_block_id);
         num <= _chain_db->head_block_num() && result.size() < limit;
         ++num )
@@ -747,13 +802,21 @@ message application_impl::get_item(const item_id& id)
   // ilog("Request for item ${id}", ("id", id));
    if( id.item_type == graphene::net::block_message_type )
    {
-      auto opt_block = _chain_db->fetch_block_by_id(id.item_hash);
-      if( !opt_block )
+      auto raw_block = _chain_db->fetch_raw_block_by_id(id.item_hash);
+      if( !raw_block )
          elog("Couldn't find block ${id} -- corresponding ID in our chain is ${id2}",
               ("id", id.item_hash)("id2", _chain_db->get_block_id_for_num(block_header::num_from_id(id.item_hash))));
-      FC_ASSERT( opt_block.valid() );
-      // ilog("Serving up block #${num}", ("num", opt_block->block_num()));
-      return block_message(std::move(*opt_block));
+      FC_ASSERT( raw_block );
+      // ilog("Serving up block #${num}", ("num", block_header::num_from_id(id.item_hash)));
+      // A packed block_message is the packed block followed by its ID, no need to unpack the block for that
+      message msg;
+      msg.msg_type = graphene::net::block_message_type;
+      msg.data.reserve( raw_block->size() + sizeof(block_id_type) );
+      msg.data.insert( msg.data.end(), raw_block->begin(), raw_block->end() );
+      const auto packed_id = fc::raw::pack( id.item_hash );
+      msg.data.insert( msg.data.end(), packed_id.begin(), packed_id.end() );
+      msg.size = (uint32_t)msg.data.size();
+      return msg;
    }
    return trx_message( _chain_db->get_recent_transaction( id.item_hash ) );
 } FC_CAPTURE_AND_RETHROW( (id) ) }
@@ -1130,6 +1193,24 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("enable-standby-votes-tracking", bpo::value<bool>()->implicit_value(true),
           "Whether to enable tracking of votes of standby witnesses and committee members. "
           "Set it to true to provide accurate data to API clients, set to false for slightly better performance.")
+         ("replay-pipeline-depth", bpo::value<uint32_t>()->default_value(0),
+          "Number of blocks to load and precompute in parallel ahead of the one being applied during a replay, "
+          "default to 0 for auto-configuration")
+         ("block-cache-size", bpo::value<uint32_t>()->default_value(1000),
+          "Number of recent blocks kept packed in memory for serving them to peers and API clients without "
+          "reading and converting them again, 0 to disable")
+         ("block-sync-interval", bpo::value<uint32_t>()->default_value(100),
+          "Number of stored blocks after which the block log is synced to disk. Blocks stored since the last sync "
+          "may be lost on a power failure and are then fetched again from peers. 0 to sync only on shutdown")
+         ("api-reader-threads", bpo::value<uint16_t>()->default_value(0),
+          "Number of threads serving expensive database API queries (full accounts, markets, asset lists) "
+          "concurrently with block processing, default to 0 for serving them on the API thread")
+         ("signature-cache-size", bpo::value<uint32_t>()->default_value(100000),
+          "Number of public keys recovered from transaction signatures kept in memory, so that transactions "
+          "seen again in blocks or API calls are not recovered again, 0 to disable")
+         ("undo-packed-values", bpo::value<bool>()->implicit_value(true),
+          "Whether to keep the old values of modified objects packed in the undo history. "
+          "Set it to true to reduce memory usage when the undo history is long, at the cost of slower undo.")
          ("api-limit-get-account-history-operations",
           bpo::value<uint64_t>()->default_value(default_opts.api_limit_get_account_history_operations),
           "For history_api::get_account_history_operations to set max limit value")
@@ -1217,12 +1298,17 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("api-limit-get-tickets",
           bpo::value<uint64_t>()->default_value(default_opts.api_limit_get_tickets),
           "Set maximum limit value for database APIs which query for tickets")
+         ("api-limit-get-tanks",
+          bpo::value<uint64_t>()->default_value(default_opts.api_limit_get_tanks),
+          "Set maximum limit value for database APIs which query for tanks")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
          ("replay-blockchain", "Rebuild object graph by replaying all blocks without validation")
          ("revalidate-blockchain", "Rebuild object graph by replaying all blocks with full validation")
          ("resync-blockchain", "Delete all blocks and re-sync with network from scratch")
+         ("restore-from-snapshot", bpo::value<boost::filesystem::path>(),
+          "Delete all blocks and chain state, then start from the binary snapshot in the given directory")
          ("force-validate", "Force validation of all transactions during normal operation")
          ("genesis-timestamp", bpo::value<uint32_t>(),
           "Replace timestamp from genesis.json with current time plus this many seconds (experts only!)")
@@ -65,6 +65,10 @@ class application_impl : public net::node_delegate, public std::enable_shared_fr
       bool handle_block(const graphene::net::block_message& blk_msg, bool sync_mode,
                         std::vector<graphene::net::message_hash_type>& contained_transaction_msg_ids) override;
 
+      /// Precomputes the block on one thread of the pool, blocks during sync are spread over all of them
+      fc::future<void> precompute_block(
+            const std::shared_ptr<const graphene::net::block_message>& blk_msg ) override;
+
       void handle_transaction(const graphene::net::trx_message& transaction_message) override;
 
       void handle_message(const graphene::net::message& message_to_process) override;
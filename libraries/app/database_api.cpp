@@ -9,6 +9,7 @@
 #include <graphene/chain/get_config.hpp>
 #include <graphene/chain/hardfork.hpp>
 #include <graphene/protocol/pts_address.hpp>
+#include <graphene/protocol/tnt/lookups.hpp>
 #include <graphene/protocol/restriction_predicate.hpp>
 
 #include <fc/crypto/hex.hpp>
@@ -361,21 +362,12 @@ vector<flat_set<account_id_type>> database_api_impl::get_key_references( vector<
       {
           auto itr = refs.account_to_address_memberships.find(a);
           if( itr != refs.account_to_address_memberships.end() )
-          {
-             result.reserve( result.size() + itr->second.size() );
-             for( auto item : itr->second )
-             {
-                result.insert(item);
-             }
-          }
+             result.insert( boost::container::ordered_unique_range, itr->second.begin(), itr->second.end() );
       }
 
       auto itr = refs.account_to_key_memberships.find(key);
       if( itr != refs.account_to_key_memberships.end() )
-      {
-         result.reserve( result.size() + itr->second.size() );
-         for( auto item : itr->second ) result.insert(item);
-      }
+         result.insert( boost::container::ordered_unique_range, itr->second.begin(), itr->second.end() );
       final_result.emplace_back( std::move(result) );
    }
 
@@ -454,7 +446,8 @@ vector<optional<account_object>> database_api_impl::get_accounts( const vector<s
 std::map<string,full_account> database_api::get_full_accounts( const vector<string>& names_or_ids,
                                                                optional<bool> subscribe )
 {
-   return my->get_full_accounts( names_or_ids, subscribe );
+   return my->read( [&] () { return my->get_full_accounts( names_or_ids, subscribe ); },
+                    my->get_whether_to_subscribe( subscribe ) );
 }
 
 std::map<std::string, full_account> database_api_impl::get_full_accounts( const vector<std::string>& names_or_ids,
@@ -670,8 +663,7 @@ vector<account_id_type> database_api_impl::get_account_references( const std::st
 
    if( itr != refs.account_to_account_memberships.end() )
    {
-      result.reserve( itr->second.size() );
-      for( auto item : itr->second ) result.push_back(item);
+      result.assign( itr->second.begin(), itr->second.end() );
    }
    return result;
 }
@@ -690,7 +682,8 @@ map<string,account_id_type> database_api::lookup_accounts( const string& lower_b
                                                            uint32_t limit,
                                                            optional<bool> subscribe )const
 {
-   return my->lookup_accounts( lower_bound_name, limit, subscribe );
+   return my->read( [&] () { return my->lookup_accounts( lower_bound_name, limit, subscribe ); },
+                    limit == 1 && my->get_whether_to_subscribe( subscribe ) );
 }
 
 map<string,account_id_type> database_api_impl::lookup_accounts( const string& lower_bound_name,
@@ -911,7 +904,7 @@ vector<optional<extended_asset_object>> database_api_impl::get_assets(
 
 vector<extended_asset_object> database_api::list_assets(const string& lower_bound_symbol, uint32_t limit)const
 {
-   return my->list_assets( lower_bound_symbol, limit );
+   return my->read( [&] () { return my->list_assets( lower_bound_symbol, limit ); } );
 }
 
 vector<extended_asset_object> database_api_impl::list_assets(const string& lower_bound_symbol, uint32_t limit)const
@@ -1317,7 +1310,7 @@ void database_api_impl::unsubscribe_from_market(const std::string& a, const std:
 
 market_ticker database_api::get_ticker( const string& base, const string& quote )const
 {
-    return my->get_ticker( base, quote );
+    return my->read( [&] () { return my->get_ticker( base, quote ); } );
 }
 
 market_ticker database_api_impl::get_ticker( const string& base, const string& quote, bool skip_order_book )const
@@ -1351,7 +1344,7 @@ market_ticker database_api_impl::get_ticker( const string& base, const string& q
 
 market_volume database_api::get_24_volume( const string& base, const string& quote )const
 {
-    return my->get_24_volume( base, quote );
+    return my->read( [&] () { return my->get_24_volume( base, quote ); } );
 }
 
 market_volume database_api_impl::get_24_volume( const string& base, const string& quote )const
@@ -1370,7 +1363,7 @@ market_volume database_api_impl::get_24_volume( const string& base, const string
 
 order_book database_api::get_order_book( const string& base, const string& quote, unsigned limit )const
 {
-   return my->get_order_book( base, quote, limit);
+   return my->read( [&] () { return my->get_order_book( base, quote, limit ); } );
 }
 
 order_book database_api_impl::get_order_book( const string& base, const string& quote, unsigned limit )const
@@ -1422,7 +1415,7 @@ order_book database_api_impl::get_order_book( const string& base, const string&
 
 vector<market_ticker> database_api::get_top_markets(uint32_t limit)const
 {
-   return my->get_top_markets(limit);
+   return my->read( [&] () { return my->get_top_markets( limit ); } );
 }
 
 vector<market_ticker> database_api_impl::get_top_markets(uint32_t limit)const
@@ -1459,7 +1452,7 @@ vector<market_trade> database_api::get_trade_history( const string& base,
                                                       fc::time_point_sec stop,
                                                       unsigned limit )const
 {
-   return my->get_trade_history( base, quote, start, stop, limit );
+   return my->read( [&] () { return my->get_trade_history( base, quote, start, stop, limit ); } );
 }
 
 vector<market_trade> database_api_impl::get_trade_history( const string& base,
@@ -1561,7 +1554,7 @@ vector<market_trade> database_api::get_trade_history_by_sequence(
                                                       fc::time_point_sec stop,
                                                       unsigned limit )const
 {
-   return my->get_trade_history_by_sequence( base, quote, start, stop, limit );
+   return my->read( [&] () { return my->get_trade_history_by_sequence( base, quote, start, stop, limit ); } );
 }
 
 vector<market_trade> database_api_impl::get_trade_history_by_sequence(
@@ -2159,6 +2152,16 @@ bool database_api_impl::verify_account_authority( const string& account_name_or_
    return true;
 }
 
+signature_cache_stats database_api::get_signature_cache_stats()const
+{
+   return my->get_signature_cache_stats();
+}
+
+signature_cache_stats database_api_impl::get_signature_cache_stats()const
+{
+   return signature_cache::instance().get_stats();
+}
+
 processed_transaction database_api::validate_transaction( const signed_transaction& trx )const
 {
    return my->validate_transaction( trx );
@@ -2496,6 +2499,157 @@ vector<htlc_object> database_api_impl::list_htlcs(const htlc_id_type start, uint
    return result;
 }
 
+//////////////////////////////////////////////////////////////////////
+//                                                                  //
+//  Tanks and Taps                                                  //
+//                                                                  //
+//////////////////////////////////////////////////////////////////////
+
+vector<tank_object> database_api::get_tanks_by_asset( const std::string asset_symbol_or_id,
+                                                      tank_id_type start, uint32_t limit )const
+{
+   return my->get_tanks_by_asset( asset_symbol_or_id, start, limit );
+}
+
+vector<tank_object> database_api_impl::get_tanks_by_asset( const std::string asset_symbol_or_id,
+                                                           tank_id_type start, uint32_t limit )const
+{
+   FC_ASSERT( _app_options, "Internal error" );
+   const auto configured_limit = _app_options->api_limit_get_tanks;
+   FC_ASSERT( limit <= configured_limit,
+              "limit can not be greater than ${configured_limit}",
+              ("configured_limit", configured_limit) );
+
+   vector<tank_object> result;
+
+   const auto& tank_idx = _db.get_index_type< tank_index >().indices().get< by_asset_type >();
+   const asset_id_type asset = get_asset_from_string( asset_symbol_or_id )->id;
+   auto tank_itr = tank_idx.lower_bound( boost::make_tuple( asset, start ) );
+
+   while( tank_itr != tank_idx.end() && tank_itr->schematic.asset_type == asset && result.size() < limit )
+   {
+      result.push_back( *tank_itr );
+      ++tank_itr;
+   }
+   return result;
+}
+
+vector<tank_object> database_api::get_tanks_by_connection( const protocol::tnt::remote_connection& destination,
+                                                           tank_id_type start, uint32_t limit )const
+{
+   return my->get_tanks_by_connection( destination, start, limit );
+}
+
+vector<tank_object> database_api_impl::get_tanks_by_connection( const protocol::tnt::remote_connection& destination,
+                                                                tank_id_type start, uint32_t limit )const
+{
+   return get_tanks( get_tank_connection_index().get_tanks_releasing_to( destination ), start, limit );
+}
+
+vector<tank_object> database_api::get_tanks_by_source( const protocol::tnt::remote_connection& source,
+                                                       tank_id_type start, uint32_t limit )const
+{
+   return my->get_tanks_by_source( source, start, limit );
+}
+
+vector<tank_object> database_api_impl::get_tanks_by_source( const protocol::tnt::remote_connection& source,
+                                                            tank_id_type start, uint32_t limit )const
+{
+   return get_tanks( get_tank_connection_index().get_tanks_receiving_from( source ), start, limit );
+}
+
+vector<tank_object> database_api::get_tanks_by_tap_opener( const std::string account_id_or_name,
+                                                           tank_id_type start, uint32_t limit )const
+{
+   return my->get_tanks_by_tap_opener( account_id_or_name, start, limit );
+}
+
+vector<tank_object> database_api_impl::get_tanks_by_tap_opener( const std::string account_id_or_name,
+                                                                tank_id_type start, uint32_t limit )const
+{
+   const auto& tank_connections = get_tank_connection_index();
+   const account_id_type account = get_account_from_string( account_id_or_name )->id;
+   return get_tanks( tank_connections.get_tanks_openable_by( account ), start, limit );
+}
+
+const tank_connection_index& database_api_impl::get_tank_connection_index()const
+{
+   // api_helper_indexes plugin is required for accessing the secondary index
+   FC_ASSERT( _app_options && _app_options->has_api_helper_indexes_plugin,
+              "api_helper_indexes plugin is not enabled on this server." );
+
+   const auto& idx = _db.get_index_type<tank_index>();
+   const auto& tidx = dynamic_cast<const base_primary_index&>(idx);
+   return tidx.get_secondary_index<tank_connection_index>();
+}
+
+vector<tank_object> database_api_impl::get_tanks( const flat_set<tank_id_type>& tank_ids,
+                                                  tank_id_type start, uint32_t limit )const
+{
+   FC_ASSERT( _app_options, "Internal error" );
+   const auto configured_limit = _app_options->api_limit_get_tanks;
+   FC_ASSERT( limit <= configured_limit,
+              "limit can not be greater than ${configured_limit}",
+              ("configured_limit", configured_limit) );
+
+   vector<tank_object> result;
+   for( auto itr = tank_ids.lower_bound( start ); itr != tank_ids.end() && result.size() < limit; ++itr )
+      result.push_back( (*itr)(_db) );
+   return result;
+}
+
+vector<protocol::tnt::connection> database_api::get_tank_flow_path( const protocol::tnt::tap_id_type& tap )const
+{
+   return my->get_tank_flow_path( tap );
+}
+
+vector<protocol::tnt::connection> database_api_impl::get_tank_flow_path( const protocol::tnt::tap_id_type& tap )const
+{
+   namespace ptnt = protocol::tnt;
+
+   FC_ASSERT( tap.tank_id.valid(), "The tank of the tap must be specified" );
+   const tank_object* tank = _db.find( *tap.tank_id );
+   FC_ASSERT( tank != nullptr, "No tank with ID ${id}", ("id", *tap.tank_id) );
+   auto tap_itr = tank->schematic.taps.find( tap.tap_id );
+   FC_ASSERT( tap_itr != tank->schematic.taps.end(), "No tap with ID ${id}", ("id", tap) );
+   FC_ASSERT( tap_itr->second.connected_connection.valid(), "The tap is not connected" );
+   const auto& tnt_parameters = _db.get_global_properties().parameters.extensions.value.updatable_tnt_options;
+   FC_ASSERT( tnt_parameters.valid(), "Tanks and Taps is not yet configured on this blockchain" );
+
+   const ptnt::tank_lookup_function lookup = [this]( tank_id_type id ) -> const ptnt::tank_schematic* {
+      const tank_object* t = _db.find( id );
+      return t == nullptr ? nullptr : &t->schematic;
+   };
+   ptnt::lookup_utilities utilities( tank->schematic, lookup );
+   auto chain_result = utilities.get_connection_chain( *tap_itr->second.connected_connection,
+                                                       tnt_parameters->max_connection_chain_length );
+   FC_ASSERT( chain_result.is_type<ptnt::connection_chain>(), "The connection chain of the tap is broken: ${r}",
+              ("r", chain_result) );
+
+   // Connections in the chain are relative to the tank of the attachment before them, resolve them to absolute
+   // references so the path can be read without the schematics
+   vector<ptnt::connection> result;
+   const auto& chain = chain_result.get<ptnt::connection_chain>();
+   result.reserve( chain.connections.size() );
+   tank_id_type current_tank = *tap.tank_id;
+   for( const auto& connection_ref : chain.connections )
+   {
+      ptnt::connection step = connection_ref.get();
+      if( step.is_type<ptnt::same_tank>() )
+         step = current_tank;
+      else if( step.is_type<ptnt::attachment_id_type>() )
+      {
+         auto& attachment = step.get<ptnt::attachment_id_type>();
+         if( attachment.tank_id.valid() )
+            current_tank = *attachment.tank_id;
+         else
+            attachment.tank_id = current_tank;
+      }
+      result.push_back( std::move(step) );
+   }
+   return result;
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 //  AcloudBank                                                       //
@@ -153,6 +153,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       bool verify_authority( const signed_transaction& trx )const;
       bool verify_account_authority( const string& account_name_or_id,
                                      const flat_set<public_key_type>& signers )const;
+      signature_cache_stats get_signature_cache_stats()const;
       processed_transaction validate_transaction( const signed_transaction& trx )const;
       vector< fc::variant > get_required_fees( const vector<operation>& ops,
                                                const std::string& asset_id_or_symbol )const;
@@ -177,6 +178,17 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
                                           htlc_id_type start, uint32_t limit) const;
       vector<htlc_object> list_htlcs(const htlc_id_type lower_bound_id, uint32_t limit) const;
 
+      // Tanks and Taps
+      vector<tank_object> get_tanks_by_asset( const std::string asset_symbol_or_id,
+                                              tank_id_type start, uint32_t limit ) const;
+      vector<tank_object> get_tanks_by_connection( const protocol::tnt::remote_connection& destination,
+                                                   tank_id_type start, uint32_t limit ) const;
+      vector<tank_object> get_tanks_by_source( const protocol::tnt::remote_connection& source,
+                                               tank_id_type start, uint32_t limit ) const;
+      vector<tank_object> get_tanks_by_tap_opener( const std::string account_id_or_name,
+                                                   tank_id_type start, uint32_t limit ) const;
+      vector<protocol::tnt::connection> get_tank_flow_path( const protocol::tnt::tap_id_type& tap ) const;
+
       // AcloudBank personal data
       vector<personal_data_object> get_personal_data( const account_id_type subject_account,
                                                       const account_id_type operator_account ) const;
@@ -228,6 +240,25 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       vector<limit_order_object> get_limit_orders( const asset_id_type a, const asset_id_type b,
                                                    const uint32_t limit )const;
 
+      ////////////////////////////////////////////////
+      // Tanks and Taps
+      ////////////////////////////////////////////////
+
+      const tank_connection_index& get_tank_connection_index()const;
+      // helper function
+      vector<tank_object> get_tanks( const flat_set<tank_id_type>& tank_ids, tank_id_type start,
+                                     uint32_t limit )const;
+
+      // Runs a query in a read view of the chain state, on a reader thread if the node has any. Queries which
+      // subscribe change the subscription state of this session and therefore stay on the calling thread.
+      template<typename Query>
+      auto read( Query&& query, bool subscribes = false )const -> decltype( query() )
+      {
+         if( subscribes )
+            return query();
+         return _db.read_view( std::forward<Query>( query ) );
+      }
+
       ////////////////////////////////////////////////
       // Subscription
       ////////////////////////////////////////////////
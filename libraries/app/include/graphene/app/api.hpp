@@ -28,6 +28,7 @@
 
 #include <graphene/protocol/types.hpp>
 
+#include <graphene/api_helper_indexes/api_helper_indexes.hpp>
 #include <graphene/market_history/market_history_plugin.hpp>
 #include <graphene/grouped_orders/grouped_orders_plugin.hpp>
 #include <graphene/custom_operations/custom_operations_plugin.hpp>
@@ -243,6 +244,15 @@ namespace graphene { namespace app {
           */
       vector<optional<signed_block>> get_blocks(uint32_t block_num_from, uint32_t block_num_to)const;
 
+      /**
+          * @brief Get packed signed blocks, as stored and relayed by the node
+          * @param block_num_from The lowest block number
+          * @param block_num_to The highest block number
+          * @return A list of binary serialized signed blocks from block_num_from till block_num_to,
+          *         encoded as hex strings, null for blocks which are not known
+          */
+      vector<optional<vector<char>>> get_raw_blocks(uint32_t block_num_from, uint32_t block_num_to)const;
+
    private:
       graphene::chain::database& _db;
    };
@@ -375,10 +385,26 @@ namespace graphene { namespace app {
           */
          vector<account_asset_balance> get_asset_holders( std::string asset, uint32_t start, uint32_t limit  )const;
 
+         /**
+          * @brief Get asset holders for a specific asset, from the given position in the list
+          * @param asset The specific asset id or symbol
+          * @param start_balance Balance of the first holder to return, omit to start from the largest holder
+          * @param start_account Account of the first holder to return among those with @p start_balance, omit to
+          *                      start from the first one; requires @p start_balance
+          * @param limit Maximum number of holders to return, must not exceed the configured limit
+          * @return A list of asset holders for the specified asset, in the same order as @ref get_asset_holders
+          *
+          * Holders are ordered by descending balance and then by account ID. To get the next page, pass the
+          * balance and account of the last holder returned, and skip it in the result.
+          */
+         vector<account_asset_balance> list_asset_holders( std::string asset, optional<share_type> start_balance,
+                                                           optional<account_id_type> start_account,
+                                                           uint32_t limit )const;
+
          /**
           * @brief Get asset holders count for a specific asset
           * @param asset The specific asset id or symbol
-          * @return Holders count for the specified asset
+          * @return Number of accounts with a non-zero balance of the specified asset
           */
          int get_asset_holders_count( std::string asset )const;
 
@@ -389,9 +415,13 @@ namespace graphene { namespace app {
          vector<asset_holders> get_all_asset_holders() const;
 
       private:
+         /// Uses the counts of the api_helper_indexes plugin if it is enabled, otherwise counts the balances
+         uint64_t count_holders( asset_id_type asset )const;
+
          graphene::app::application& _app;
          graphene::chain::database& _db;
          graphene::app::database_api database_api;
+         const graphene::api_helper_indexes::asset_holders_index* _asset_holders_index = nullptr;
    };
 
    /**
@@ -554,6 +584,7 @@ FC_API(graphene::app::history_api,
      )
 FC_API(graphene::app::block_api,
        (get_blocks)
+       (get_raw_blocks)
      )
 FC_API(graphene::app::network_broadcast_api,
        (broadcast_transaction)
@@ -571,6 +602,7 @@ FC_API(graphene::app::network_node_api,
      )
 FC_API(graphene::app::asset_api,
        (get_asset_holders)
+       (list_asset_holders)
 	   (get_asset_holders_count)
        (get_all_asset_holders)
      )
@@ -6,6 +6,7 @@
 
 #include <graphene/app/api_objects.hpp>
 
+#include <graphene/protocol/signature_cache.hpp>
 #include <graphene/protocol/types.hpp>
 
 #include <graphene/chain/database.hpp>
@@ -22,6 +23,7 @@
 #include <graphene/chain/permission_object.hpp>
 #include <graphene/chain/commit_reveal_object.hpp>
 #include <graphene/chain/witness_schedule_object.hpp>
+#include <graphene/chain/tnt/object.hpp>
 
 #include <fc/api.hpp>
 #include <fc/variant_object.hpp>
@@ -782,6 +784,13 @@ class database_api
       bool verify_account_authority( const string& account_name_or_id,
                                      const flat_set<public_key_type>& signers )const;
 
+      /**
+       * @brief Get the statistics of the cache of public keys recovered from signatures
+       * @return the number of hits, misses, cached keys and the capacity of the cache
+       * @note The cache is shared by all transaction checks of this node, so the statistics are node-wide
+       */
+      signature_cache_stats get_signature_cache_stats()const;
+
       /**
        * @brief Validates a transaction against the current state without broadcasting it on the network
        * @param trx a transaction to be validated
@@ -944,6 +953,69 @@ class database_api
       */
       vector<htlc_object> list_htlcs(const htlc_id_type start, uint32_t limit) const;
 
+      ////////////////////
+      // Tanks and Taps //
+      ////////////////////
+
+      /**
+       *  @brief Get tanks holding an asset
+       *  @param asset_symbol_or_id Symbol or ID of the asset
+       *  @param start Tanks before this ID will be skipped in results. Pagination purposes.
+       *  @param limit Maximum number of objects to retrieve
+       *  @return Tanks of the asset, ordered by ID
+       */
+      vector<tank_object> get_tanks_by_asset( const std::string asset_symbol_or_id,
+                                              tank_id_type start,
+                                              uint32_t limit ) const;
+
+      /**
+       *  @brief Get tanks which release asset to a destination
+       *  @param destination Account, tank or attachment which receives the asset
+       *  @param start Tanks before this ID will be skipped in results. Pagination purposes.
+       *  @param limit Maximum number of objects to retrieve
+       *  @return Tanks with a tap or an attachment connected directly to the destination, ordered by ID
+       *
+       *  @note This API requires the api_helper_indexes plugin to be enabled.
+       */
+      vector<tank_object> get_tanks_by_connection( const protocol::tnt::remote_connection& destination,
+                                                   tank_id_type start,
+                                                   uint32_t limit ) const;
+
+      /**
+       *  @brief Get tanks which accept deposits from a source
+       *  @param source Account, tank or attachment which deposits the asset
+       *  @param start Tanks before this ID will be skipped in results. Pagination purposes.
+       *  @param limit Maximum number of objects to retrieve
+       *  @return Tanks whose own or attachment source lists name the source, ordered by ID; tanks accepting
+       *          deposits from all sources are not included
+       *
+       *  @note This API requires the api_helper_indexes plugin to be enabled.
+       */
+      vector<tank_object> get_tanks_by_source( const protocol::tnt::remote_connection& source,
+                                               tank_id_type start,
+                                               uint32_t limit ) const;
+
+      /**
+       *  @brief Get tanks with taps an account can open
+       *  @param account_name_or_id Name or ID of the account
+       *  @param start Tanks before this ID will be skipped in results. Pagination purposes.
+       *  @param limit Maximum number of objects to retrieve
+       *  @return Tanks with a tap whose open authority names the account directly, ordered by ID
+       *
+       *  @note This API requires the api_helper_indexes plugin to be enabled.
+       */
+      vector<tank_object> get_tanks_by_tap_opener( const std::string account_name_or_id,
+                                                   tank_id_type start,
+                                                   uint32_t limit ) const;
+
+      /**
+       *  @brief Get the path asset released from a tap takes
+       *  @param tap The tap, its tank must be specified
+       *  @return The connections the asset passes through, the last one being its final destination. Connections
+       *          are absolute: references to the current tank are replaced by the ID of the tank they refer to.
+       */
+      vector<protocol::tnt::connection> get_tank_flow_path( const protocol::tnt::tap_id_type& tap ) const;
+
 private:
       std::shared_ptr< database_api_impl > my;
 };
@@ -1054,6 +1126,7 @@ FC_API(graphene::app::database_api,
    (get_potential_address_signatures)
    (verify_authority)
    (verify_account_authority)
+   (get_signature_cache_stats)
    (validate_transaction)
    (get_required_fees)
 
@@ -1078,4 +1151,11 @@ FC_API(graphene::app::database_api,
    (get_htlc_by_from)
    (get_htlc_by_to)
    (list_htlcs)
+
+   // Tanks and Taps
+   (get_tanks_by_asset)
+   (get_tanks_by_connection)
+   (get_tanks_by_source)
+   (get_tanks_by_tap_opener)
+   (get_tank_flow_path)
 )
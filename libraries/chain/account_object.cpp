@@ -28,6 +28,8 @@
 #include <fc/io/raw.hpp>
 #include <fc/uint128.hpp>
 
+#include <algorithm>
+
 namespace graphene { namespace chain {
 
 share_type cut_fee(share_type a, uint16_t p)
@@ -106,81 +108,129 @@ void account_statistics_object::pay_fee( share_type core_fee, share_type cashbac
       pending_vested_fees += core_fee;
 }
 
-set<account_id_type> account_member_index::get_account_members(const account_object& a)const
+namespace {
+
+template<typename T, typename Compare = std::less<T>>
+void sort_unique( vector<T>& v, Compare comp = Compare() )
 {
-   set<account_id_type> result;
-   for( auto auth : a.owner.account_auths )
-      result.insert(auth.first);
-   for( auto auth : a.active.account_auths )
-      result.insert(auth.first);
-   return result;
+   std::sort( v.begin(), v.end(), comp );
+   v.erase( std::unique( v.begin(), v.end(), [&comp]( const T& x, const T& y ) {
+               return !comp( x, y ) && !comp( y, x );
+            } ), v.end() );
 }
-set<public_key_type, pubkey_comparator> account_member_index::get_key_members(const account_object& a)const
+
+/// Walks both sorted member lists once, adding the account to the members which were added and removing it from the
+/// members which were removed
+template<typename Map, typename Member, typename Compare = std::less<Member>>
+void update_memberships( Map& memberships, const vector<Member>& before, const vector<Member>& after,
+                         account_id_type account, Compare comp = Compare() )
 {
-   set<public_key_type, pubkey_comparator> result;
-   for( auto auth : a.owner.key_auths )
-      result.insert(auth.first);
-   for( auto auth : a.active.key_auths )
-      result.insert(auth.first);
-   result.insert( a.options.memo_key );
-   return result;
+   auto b = before.begin();
+   auto a = after.begin();
+   while( b != before.end() || a != after.end() )
+   {
+      if( a == after.end() || ( b != before.end() && comp( *b, *a ) ) )
+      {
+         auto itr = memberships.find( *b );
+         if( itr != memberships.end() )
+            itr->second.erase( account );
+         ++b;
+      }
+      else if( b == before.end() || comp( *a, *b ) )
+      {
+         memberships[*a].insert( account );
+         ++a;
+      }
+      else
+      {
+         ++a;
+         ++b;
+      }
+   }
 }
-set<address> account_member_index::get_address_members(const account_object& a)const
+
+template<typename Map, typename Member>
+void add_memberships( Map& memberships, const vector<Member>& members, account_id_type account )
 {
-   set<address> result;
-   for( auto auth : a.owner.address_auths )
-      result.insert(auth.first);
-   for( auto auth : a.active.address_auths )
-      result.insert(auth.first);
-   result.insert( a.options.memo_key );
-   return result;
+   for( const auto& item : members )
+      memberships[item].insert( account );
 }
 
-void account_member_index::object_inserted(const object& obj)
+template<typename Map, typename Member>
+void remove_memberships( Map& memberships, const vector<Member>& members, account_id_type account )
 {
-    assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
-    const account_object& a = static_cast<const account_object&>(obj);
+   for( const auto& item : members )
+   {
+      auto itr = memberships.find( item );
+      if( itr != memberships.end() )
+         itr->second.erase( account );
+   }
+}
 
-    auto account_members = get_account_members(a);
-    for( auto item : account_members )
-       account_to_account_memberships[item].insert(obj.id);
+} // anonymous namespace
 
-    auto key_members = get_key_members(a);
-    for( auto item : key_members )
-       account_to_key_memberships[item].insert(obj.id);
+void account_member_index::get_members( const authority& owner, const authority& active,
+                                        const public_key_type& memo_key, members_type& members )
+{
+   members.accounts.clear();
+   for( const auto& auth : owner.account_auths )
+      members.accounts.push_back( auth.first );
+   for( const auto& auth : active.account_auths )
+      members.accounts.push_back( auth.first );
+   sort_unique( members.accounts );
+
+   members.keys.clear();
+   for( const auto& auth : owner.key_auths )
+      members.keys.push_back( auth.first );
+   for( const auto& auth : active.key_auths )
+      members.keys.push_back( auth.first );
+   members.keys.push_back( memo_key );
+   sort_unique( members.keys, pubkey_comparator() );
+
+   members.addresses.clear();
+   for( const auto& auth : owner.address_auths )
+      members.addresses.push_back( auth.first );
+   for( const auto& auth : active.address_auths )
+      members.addresses.push_back( auth.first );
+   members.addresses.push_back( address( memo_key ) );
+   sort_unique( members.addresses );
+}
 
-    auto address_members = get_address_members(a);
-    for( auto item : address_members )
-       account_to_address_memberships[item].insert(obj.id);
+void account_member_index::get_members( const account_object& a, members_type& members )
+{
+   get_members( a.owner, a.active, a.options.memo_key, members );
 }
 
-void account_member_index::object_removed(const object& obj)
+void account_member_index::object_inserted(const object& obj)
 {
     assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
     const account_object& a = static_cast<const account_object&>(obj);
 
-    auto key_members = get_key_members(a);
-    for( auto item : key_members )
-       account_to_key_memberships[item].erase( obj.id );
+    get_members( a, current_members );
+    add_memberships( account_to_account_memberships, current_members.accounts, a.get_id() );
+    add_memberships( account_to_key_memberships, current_members.keys, a.get_id() );
+    add_memberships( account_to_address_memberships, current_members.addresses, a.get_id() );
+}
 
-    auto address_members = get_address_members(a);
-    for( auto item : address_members )
-       account_to_address_memberships[item].erase( obj.id );
+void account_member_index::object_removed(const object& obj)
+{
+    assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
+    const account_object& a = static_cast<const account_object&>(obj);
 
-    auto account_members = get_account_members(a);
-    for( auto item : account_members )
-       account_to_account_memberships[item].erase( obj.id );
+    get_members( a, current_members );
+    remove_memberships( account_to_key_memberships, current_members.keys, a.get_id() );
+    remove_memberships( account_to_address_memberships, current_members.addresses, a.get_id() );
+    remove_memberships( account_to_account_memberships, current_members.accounts, a.get_id() );
 }
 
 void account_member_index::about_to_modify(const object& before)
 {
-   before_key_members.clear();
-   before_account_members.clear();
    assert( dynamic_cast<const account_object*>(&before) ); // for debug only
    const account_object& a = static_cast<const account_object&>(before);
-   before_key_members     = get_key_members(a);
-   before_address_members = get_address_members(a);
-   before_account_members = get_account_members(a);
+   // Assigning reuses the memory of the previous copies
+   before_owner = a.owner;
+   before_active = a.active;
+   before_memo_key = a.options.memo_key;
 }
 
 void account_member_index::object_modified(const object& after)
@@ -188,66 +238,18 @@ void account_member_index::object_modified(const object& after)
     assert( dynamic_cast<const account_object*>(&after) ); // for debug only
     const account_object& a = static_cast<const account_object&>(after);
 
-    {
-       set<account_id_type> after_account_members = get_account_members(a);
-       vector<account_id_type> removed; removed.reserve(before_account_members.size());
-       std::set_difference(before_account_members.begin(), before_account_members.end(),
-                           after_account_members.begin(), after_account_members.end(),
-                           std::inserter(removed, removed.end()));
-
-       for( auto itr = removed.begin(); itr != removed.end(); ++itr )
-          account_to_account_memberships[*itr].erase(after.id);
-
-       vector<object_id_type> added; added.reserve(after_account_members.size());
-       std::set_difference(after_account_members.begin(), after_account_members.end(),
-                           before_account_members.begin(), before_account_members.end(),
-                           std::inserter(added, added.end()));
-
-       for( auto itr = added.begin(); itr != added.end(); ++itr )
-          account_to_account_memberships[*itr].insert(after.id);
-    }
-
-
-    {
-       set<public_key_type, pubkey_comparator> after_key_members = get_key_members(a);
-
-       vector<public_key_type> removed; removed.reserve(before_key_members.size());
-       std::set_difference(before_key_members.begin(), before_key_members.end(),
-                           after_key_members.begin(), after_key_members.end(),
-                           std::inserter(removed, removed.end()));
-
-       for( auto itr = removed.begin(); itr != removed.end(); ++itr )
-          account_to_key_memberships[*itr].erase(after.id);
-
-       vector<public_key_type> added; added.reserve(after_key_members.size());
-       std::set_difference(after_key_members.begin(), after_key_members.end(),
-                           before_key_members.begin(), before_key_members.end(),
-                           std::inserter(added, added.end()));
-
-       for( auto itr = added.begin(); itr != added.end(); ++itr )
-          account_to_key_memberships[*itr].insert(after.id);
-    }
-
-    {
-       set<address> after_address_members = get_address_members(a);
-
-       vector<address> removed; removed.reserve(before_address_members.size());
-       std::set_difference(before_address_members.begin(), before_address_members.end(),
-                           after_address_members.begin(), after_address_members.end(),
-                           std::inserter(removed, removed.end()));
-
-       for( auto itr = removed.begin(); itr != removed.end(); ++itr )
-          account_to_address_memberships[*itr].erase(after.id);
-
-       vector<address> added; added.reserve(after_address_members.size());
-       std::set_difference(after_address_members.begin(), after_address_members.end(),
-                           before_address_members.begin(), before_address_members.end(),
-                           std::inserter(added, added.end()));
-
-       for( auto itr = added.begin(); itr != added.end(); ++itr )
-          account_to_address_memberships[*itr].insert(after.id);
-    }
-
+    // Most modifications (votes, statistics, membership) leave the authorities alone
+    if( a.owner == before_owner && a.active == before_active && a.options.memo_key == before_memo_key )
+       return;
+
+    get_members( before_owner, before_active, before_memo_key, before_members );
+    get_members( a, current_members );
+    update_memberships( account_to_account_memberships, before_members.accounts, current_members.accounts,
+                        a.get_id() );
+    update_memberships( account_to_key_memberships, before_members.keys, current_members.keys, a.get_id(),
+                        pubkey_comparator() );
+    update_memberships( account_to_address_memberships, before_members.addresses, current_members.addresses,
+                        a.get_id() );
 }
 
 const uint8_t  balances_by_account_index::bits = 20;
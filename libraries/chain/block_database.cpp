@@ -26,6 +26,19 @@
 #include <fc/io/raw.hpp>
 #include <boost/endian/buffers.hpp>
 
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace graphene { namespace chain {
 
 struct index_entry
@@ -43,23 +56,251 @@ FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
 
 namespace graphene { namespace chain {
 
-void block_database::open( const fc::path& dbdir )
-{ try {
-   fc::create_directories(dbdir);
-   _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
-   _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
+namespace detail {
 
-   _index_filename = dbdir / "index";
-   if( !fc::exists( _index_filename ) )
+random_access_file::~random_access_file()
+{
+   close();
+}
+
+#ifdef _WIN32
+
+void random_access_file::open( const fc::path& p, bool truncate )
+{
+   FC_ASSERT( !is_open(), "File ${p} is already open", ("p",p) );
+   HANDLE h = CreateFileW( p.generic_wstring().c_str(), GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                           truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr );
+   FC_ASSERT( h != INVALID_HANDLE_VALUE, "Unable to open ${p}, error ${e}", ("p",p)("e",uint64_t(GetLastError())) );
+   _handle = h;
+}
+
+bool random_access_file::is_open()const
+{
+   return _handle != nullptr;
+}
+
+void random_access_file::close()
+{
+   if( _handle != nullptr )
+   {
+      CloseHandle( (HANDLE)_handle );
+      _handle = nullptr;
+   }
+}
+
+uint64_t random_access_file::size()const
+{
+   LARGE_INTEGER result;
+   FC_ASSERT( GetFileSizeEx( (HANDLE)_handle, &result ), "Unable to get file size, error ${e}",
+              ("e",uint64_t(GetLastError())) );
+   return uint64_t(result.QuadPart);
+}
+
+size_t random_access_file::read_at( uint64_t pos, char* data, size_t len )const
+{
+   size_t total = 0;
+   while( total < len )
+   {
+      OVERLAPPED ov = {};
+      ov.Offset     = DWORD( (pos + total) & 0xffffffff );
+      ov.OffsetHigh = DWORD( (pos + total) >> 32 );
+      DWORD got = 0;
+      if( !ReadFile( (HANDLE)_handle, data + total, DWORD( len - total ), &got, &ov ) )
+      {
+         const DWORD err = GetLastError();
+         if( err == ERROR_HANDLE_EOF )
+            break;
+         FC_THROW( "Unable to read file at ${pos}, error ${e}", ("pos",pos+total)("e",uint64_t(err)) );
+      }
+      if( got == 0 )
+         break;
+      total += got;
+   }
+   return total;
+}
+
+void random_access_file::write_at( uint64_t pos, const char* data, size_t len )
+{
+   size_t total = 0;
+   while( total < len )
+   {
+      OVERLAPPED ov = {};
+      ov.Offset     = DWORD( (pos + total) & 0xffffffff );
+      ov.OffsetHigh = DWORD( (pos + total) >> 32 );
+      DWORD written = 0;
+      FC_ASSERT( WriteFile( (HANDLE)_handle, data + total, DWORD( len - total ), &written, &ov ),
+                 "Unable to write file at ${pos}, error ${e}", ("pos",pos+total)("e",uint64_t(GetLastError())) );
+      total += written;
+   }
+}
+
+void random_access_file::sync()
+{
+   FC_ASSERT( FlushFileBuffers( (HANDLE)_handle ), "Unable to sync file, error ${e}", ("e",uint64_t(GetLastError())) );
+}
+
+void random_access_file::truncate( uint64_t new_size )
+{
+   FILE_END_OF_FILE_INFO info;
+   info.EndOfFile.QuadPart = int64_t(new_size);
+   FC_ASSERT( SetFileInformationByHandle( (HANDLE)_handle, FileEndOfFileInfo, &info, sizeof(info) ),
+              "Unable to resize file to ${s}, error ${e}", ("s",new_size)("e",uint64_t(GetLastError())) );
+}
+
+#else // _WIN32
+
+void random_access_file::open( const fc::path& p, bool truncate )
+{
+   FC_ASSERT( !is_open(), "File ${p} is already open", ("p",p) );
+   int flags = O_RDWR | O_CREAT;
+   if( truncate )
+      flags |= O_TRUNC;
+   _fd = ::open( p.generic_string().c_str(), flags, 0644 );
+   FC_ASSERT( _fd >= 0, "Unable to open ${p}: ${e}", ("p",p)("e",strerror(errno)) );
+}
+
+bool random_access_file::is_open()const
+{
+   return _fd >= 0;
+}
+
+void random_access_file::close()
+{
+   if( _fd >= 0 )
+   {
+      ::close( _fd );
+      _fd = -1;
+   }
+}
+
+uint64_t random_access_file::size()const
+{
+   struct stat st;
+   FC_ASSERT( fstat( _fd, &st ) == 0, "Unable to get file size: ${e}", ("e",strerror(errno)) );
+   return uint64_t(st.st_size);
+}
+
+size_t random_access_file::read_at( uint64_t pos, char* data, size_t len )const
+{
+   size_t total = 0;
+   while( total < len )
+   {
+      const ssize_t got = pread( _fd, data + total, len - total, off_t(pos + total) );
+      if( got < 0 && errno == EINTR )
+         continue;
+      FC_ASSERT( got >= 0, "Unable to read file at ${pos}: ${e}", ("pos",pos+total)("e",strerror(errno)) );
+      if( got == 0 )
+         break;
+      total += size_t(got);
+   }
+   return total;
+}
+
+void random_access_file::write_at( uint64_t pos, const char* data, size_t len )
+{
+   size_t total = 0;
+   while( total < len )
+   {
+      const ssize_t written = pwrite( _fd, data + total, len - total, off_t(pos + total) );
+      if( written < 0 && errno == EINTR )
+         continue;
+      FC_ASSERT( written >= 0, "Unable to write file at ${pos}: ${e}", ("pos",pos+total)("e",strerror(errno)) );
+      total += size_t(written);
+   }
+}
+
+void random_access_file::sync()
+{
+#ifdef __APPLE__
+   FC_ASSERT( fcntl( _fd, F_FULLFSYNC ) == 0 || fsync( _fd ) == 0, "Unable to sync file: ${e}", ("e",strerror(errno)) );
+#else
+   FC_ASSERT( fdatasync( _fd ) == 0, "Unable to sync file: ${e}", ("e",strerror(errno)) );
+#endif
+}
+
+void random_access_file::truncate( uint64_t new_size )
+{
+   FC_ASSERT( ftruncate( _fd, off_t(new_size) ) == 0, "Unable to resize file to ${s}: ${e}",
+              ("s",new_size)("e",strerror(errno)) );
+}
+
+#endif // _WIN32
+
+void raw_block_cache::set_capacity( size_t blocks )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _capacity = blocks;
+   while( _entries.size() > _capacity )
+   {
+      _by_id.erase( _entries.back().first );
+      _entries.pop_back();
+   }
+}
+
+raw_block_ptr raw_block_cache::get( const block_id_type& id )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto itr = _by_id.find( id );
+   if( itr == _by_id.end() )
+      return raw_block_ptr();
+   _entries.splice( _entries.begin(), _entries, itr->second );
+   return itr->second->second;
+}
+
+void raw_block_cache::put( const block_id_type& id, const raw_block_ptr& data )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   if( _capacity == 0 )
+      return;
+   auto itr = _by_id.find( id );
+   if( itr != _by_id.end() )
    {
-     _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+      _entries.splice( _entries.begin(), _entries, itr->second );
+      return;
    }
-   else
+   _entries.emplace_front( id, data );
+   _by_id[id] = _entries.begin();
+   if( _entries.size() > _capacity )
    {
-     _block_num_to_pos.open( _index_filename.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+      _by_id.erase( _entries.back().first );
+      _entries.pop_back();
    }
+}
+
+void raw_block_cache::erase( const block_id_type& id )
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   auto itr = _by_id.find( id );
+   if( itr == _by_id.end() )
+      return;
+   _entries.erase( itr->second );
+   _by_id.erase( itr );
+}
+
+void raw_block_cache::clear()
+{
+   std::lock_guard<std::mutex> guard( _mutex );
+   _by_id.clear();
+   _entries.clear();
+}
+
+} // detail
+
+void block_database::open( const fc::path& dbdir )
+{ try {
+   fc::create_directories(dbdir);
+
+   std::lock_guard<std::mutex> guard( _write_mutex );
+   _index_filename = dbdir / "index";
+   const bool create = !fc::exists( _index_filename );
+   _block_num_to_pos.open( _index_filename, create );
+   _blocks.open( dbdir / "blocks", create );
+
+   _index_size      = _block_num_to_pos.size();
+   _blocks_size     = _blocks.size();
+   _blocks_read_pos = 0;
+   _unsynced_blocks = 0;
 } FC_CAPTURE_AND_RETHROW( (dbdir) ) }
 
 bool block_database::is_open()const
@@ -69,14 +310,25 @@ bool block_database::is_open()const
 
 void block_database::close()
 {
-  _blocks.close();
-  _block_num_to_pos.close();
+   std::lock_guard<std::mutex> guard( _write_mutex );
+   if( _blocks.is_open() )
+   {
+      _blocks.sync();
+      _block_num_to_pos.sync();
+   }
+   _blocks.close();
+   _block_num_to_pos.close();
+   _index_size  = 0;
+   _blocks_size = 0;
+   _cache.clear();
 }
 
 void block_database::flush()
 {
-  _blocks.flush();
-  _block_num_to_pos.flush();
+   std::lock_guard<std::mutex> guard( _write_mutex );
+   _blocks.sync();
+   _block_num_to_pos.sync();
+   _unsynced_blocks = 0;
 }
 
 void block_database::store( const block_id_type& _id, const signed_block& b )
@@ -87,48 +339,112 @@ void block_database::store( const block_id_type& _id, const signed_block& b )
       id = b.id();
       elog( "id argument of block_database::store() was not initialized for block ${id}", ("id", id) );
    }
-   _block_num_to_pos.seekp( sizeof( index_entry ) * int64_t(block_header::num_from_id(id)) );
+   const auto data = std::make_shared<const vector<char>>( fc::raw::pack( b ) );
+   const vector<char>& vec = *data;
+
+   std::lock_guard<std::mutex> guard( _write_mutex );
+   // A block of another fork stored under the same number is not served any longer
+   index_entry replaced;
+   if( read_index_entry( block_header::num_from_id(id), replaced ) && replaced.block_id != id )
+      _cache.erase( replaced.block_id );
+
    index_entry e;
-   _blocks.seekp( 0, _blocks.end );
-   auto vec = fc::raw::pack( b );
-   e.block_pos  = _blocks.tellp();
+   e.block_pos  = _blocks_size.load();
    e.block_size = vec.size();
    e.block_id   = id;
-   _blocks.write( vec.data(), vec.size() );
-   _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   // The block data must be in place before the index entry pointing at it becomes visible
+   _blocks.write_at( e.block_pos.value(), vec.data(), vec.size() );
+   _blocks_size = e.block_pos.value() + vec.size();
+   // Peers ask for the newest blocks most often
+   _cache.put( id, data );
+
+   const uint64_t index_pos = sizeof( index_entry ) * uint64_t(block_header::num_from_id(id));
+   _block_num_to_pos.write_at( index_pos, (const char*)&e, sizeof(e) );
+   if( index_pos + sizeof(e) > _index_size.load() )
+      _index_size = index_pos + sizeof(e);
+
+   if( _sync_interval > 0 && ++_unsynced_blocks >= _sync_interval )
+   {
+      _blocks.sync();
+      _block_num_to_pos.sync();
+      _unsynced_blocks = 0;
+   }
 }
 
 void block_database::remove( const block_id_type& id )
 { try {
+   std::lock_guard<std::mutex> guard( _write_mutex );
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !read_index_entry( block_header::num_from_id(id), e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    if( e.block_id == id )
    {
+      _cache.erase( id );
       e.block_size = 0;
-      _block_num_to_pos.seekp( sizeof(e) * int64_t(block_header::num_from_id(id)) );
-      _block_num_to_pos.write( (char*)&e, sizeof(e) );
+      _block_num_to_pos.write_at( sizeof(e) * uint64_t(block_header::num_from_id(id)), (const char*)&e, sizeof(e) );
    }
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
+bool block_database::read_index_entry( uint32_t block_num, index_entry& e )const
+{
+   const uint64_t index_pos = sizeof(e) * uint64_t(block_num);
+   if( index_pos + sizeof(e) > _index_size.load() )
+      return false;
+   return _block_num_to_pos.read_at( index_pos, (char*)&e, sizeof(e) ) == sizeof(e);
+}
+
+raw_block_ptr block_database::read_raw( const index_entry& e, bool cache_it, optional<signed_block>* block )const
+{
+   if( e.block_size.value() == 0 )
+      return raw_block_ptr();
+
+   raw_block_ptr cached = _cache.get( e.block_id );
+   if( cached )
+      return cached;
+
+   auto data = std::make_shared<vector<char>>( e.block_size.value() );
+   if( _blocks.read_at( e.block_pos.value(), data->data(), data->size() ) != data->size() )
+      return raw_block_ptr();
+   _blocks_read_pos = e.block_pos.value() + e.block_size.value();
+
+   // The ID only covers the header, the merkle root in it covers the transactions. Both are checked before the
+   // data is cached or passed on, so that a corrupted log is never served to peers.
+   auto result = fc::raw::unpack<signed_block>( *data );
+   FC_ASSERT( result.id() == e.block_id, "Block ${id} is corrupted in the block database", ("id",e.block_id) );
+   FC_ASSERT( result.transaction_merkle_root == result.calculate_merkle_root(),
+              "Transactions of block ${id} are corrupted in the block database", ("id",e.block_id) );
+
+   if( cache_it )
+      _cache.put( e.block_id, data );
+   if( block != nullptr )
+      *block = std::move( result );
+   return data;
+}
+
+optional<signed_block> block_database::read_block( const index_entry& e )const
+{
+   optional<signed_block> result;
+   raw_block_ptr data = read_raw( e, false, &result );
+   if( !data )
+      return optional<signed_block>();
+   if( result.valid() )
+      return result;
+
+   // Served from the cache, i.e. stored or checked before
+   result = fc::raw::unpack<signed_block>( *data );
+   FC_ASSERT( result->id() == e.block_id );
+   return result;
+}
+
 bool block_database::contains( const block_id_type& id )const
 {
    if( id == block_id_type() )
       return false;
 
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() < int64_t(index_pos + sizeof(e)) )
+   if( !read_index_entry( block_header::num_from_id(id), e ) )
       return false;
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
 
    return e.block_id == id && e.block_size.value() > 0;
 }
@@ -137,40 +453,32 @@ block_id_type block_database::fetch_block_id( uint32_t block_num )const
 {
    assert( block_num != 0 );
    index_entry e;
-   int64_t index_pos = sizeof(e) * int64_t(block_num);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !read_index_entry( block_num, e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
    return e.block_id;
 }
 
+optional<block_id_type> block_database::find_block_id( uint32_t block_num )const
+{
+   index_entry e;
+   if( block_num == 0 || !read_index_entry( block_num, e ) || e.block_id == block_id_type() )
+      return optional<block_id_type>();
+   return e.block_id;
+}
+
 optional<signed_block> block_database::fetch_optional( const block_id_type& id )const
 {
    try
    {
       index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_header::num_from_id(id));
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_index_entry( block_header::num_from_id(id), e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
       if( e.block_id != id ) return optional<signed_block>();
 
-      vector<char> data( e.block_size.value() );
-      _blocks.seekg( e.block_pos.value() );
-      if (e.block_size.value())
-         _blocks.read( data.data(), e.block_size.value() );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      return read_block( e );
    }
    catch (const fc::exception&)
    {
@@ -186,20 +494,10 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    try
    {
       index_entry e;
-      int64_t index_pos = sizeof(e) * int64_t(block_num);
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      if( !read_index_entry( block_num, e ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-      vector<char> data( e.block_size.value() );
-      _blocks.seekg( e.block_pos.value() );
-      _blocks.read( data.data(), e.block_size.value() );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      return read_block( e );
    }
    catch (const fc::exception&)
    {
@@ -210,38 +508,68 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    return optional<signed_block>();
 }
 
-optional<index_entry> block_database::last_index_entry()const {
+raw_block_ptr block_database::fetch_raw( const block_id_type& id )const
+{
+   try
+   {
+      // The index decides, the cache may still hold a block of another fork under the same number
+      index_entry e;
+      if( !read_index_entry( block_header::num_from_id(id), e ) || e.block_id != id )
+         return raw_block_ptr();
+
+      return read_raw( e, true );
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return raw_block_ptr();
+}
+
+raw_block_ptr block_database::fetch_raw_by_number( uint32_t block_num )const
+{
    try
    {
       index_entry e;
+      if( !read_index_entry( block_num, e ) )
+         return raw_block_ptr();
+
+      return read_raw( e, true );
+   }
+   catch (const fc::exception&)
+   {
+   }
+   catch (const std::exception&)
+   {
+   }
+   return raw_block_ptr();
+}
+
+optional<index_entry> block_database::last_index_entry()const {
+   try
+   {
+      // May truncate trailing garbage from the index, so it must not race with writers
+      std::lock_guard<std::mutex> guard( _write_mutex );
 
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      std::streampos pos = _block_num_to_pos.tellg();
-      if( pos < long(sizeof(index_entry)) )
+      uint64_t pos = _index_size.load();
+      if( pos < sizeof(index_entry) )
          return optional<index_entry>();
 
       pos -= pos % sizeof(index_entry);
 
-      _blocks.seekg( 0, _block_num_to_pos.end );
-      const std::streampos blocks_size = _blocks.tellg();
+      const uint64_t blocks_size = _blocks_size.load();
       while( pos > 0 )
       {
          pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-         if( _block_num_to_pos.gcount() == sizeof(e) && e.block_size.value() > 0
-                && int64_t(e.block_pos.value() + e.block_size.value()) <= blocks_size )
+         index_entry e;
+         if( _block_num_to_pos.read_at( pos, (char*)&e, sizeof(e) ) == sizeof(e) && e.block_size.value() > 0
+                && e.block_pos.value() + e.block_size.value() <= blocks_size )
             try
             {
-               vector<char> data( e.block_size.value() );
-               _blocks.seekg( e.block_pos.value() );
-               _blocks.read( data.data(), e.block_size.value() );
-               if( _blocks.gcount() == long(e.block_size.value()) )
-               {
-                  const signed_block block = fc::raw::unpack<signed_block>(data);
-                  if( block.id() == e.block_id )
-                     return e;
-               }
+               if( read_block( e ).valid() )
+                  return e;
             }
             catch (const fc::exception&)
             {
@@ -249,7 +577,8 @@ optional<index_entry> block_database::last_index_entry()const {
             catch (const std::exception&)
             {
             }
-         fc::resize_file( _index_filename, pos );
+         _index_size = pos;
+         _block_num_to_pos.truncate( pos );
       }
    }
    catch (const fc::exception&)
@@ -277,13 +606,12 @@ optional<block_id_type> block_database::last_id()const
 
 size_t block_database::blocks_current_position()const
 {
-   return (size_t)_blocks.tellg();
+   return (size_t)_blocks_read_pos.load();
 }
 
 size_t block_database::total_block_size()const
 {
-   _blocks.seekg( 0, _blocks.end );
-   return (size_t)_blocks.tellg();
+   return (size_t)_blocks_size.load();
 }
 
 } }
@@ -28,8 +28,10 @@
 #include <graphene/chain/hardfork.hpp>
 
 #include <graphene/chain/block_summary_object.hpp>
+#include <graphene/chain/custom_authority_object.hpp>
 #include <graphene/chain/global_property_object.hpp>
 #include <graphene/chain/operation_history_object.hpp>
+#include <graphene/chain/parallel_tasks.hpp>
 
 #include <graphene/chain/proposal_object.hpp>
 #include <graphene/chain/transaction_history_object.hpp>
@@ -65,6 +67,11 @@ block_id_type  database::get_block_id_for_num( uint32_t block_num )const
    return _block_id_to_block.fetch_block_id( block_num );
 } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
+optional<block_id_type> database::find_block_id_for_num( uint32_t block_num )const
+{
+   return _block_id_to_block.find_block_id( block_num );
+}
+
 optional<signed_block> database::fetch_block_by_id( const block_id_type& id )const
 {
    auto b = _fork_db.fetch_block( id );
@@ -82,6 +89,26 @@ optional<signed_block> database::fetch_block_by_number( uint32_t num )const
       return _block_id_to_block.fetch_by_number(num);
 }
 
+raw_block_ptr database::fetch_raw_block_by_id( const block_id_type& id )const
+{
+   raw_block_ptr raw = _block_id_to_block.fetch_raw( id );
+   if( raw )
+      return raw;
+   // not applied (yet), only known to the fork database
+   auto b = _fork_db.fetch_block( id );
+   if( !b )
+      return raw_block_ptr();
+   return std::make_shared<const vector<char>>( fc::raw::pack( b->data ) );
+}
+
+raw_block_ptr database::fetch_raw_block_by_number( uint32_t num )const
+{
+   auto results = _fork_db.fetch_block_by_number(num);
+   if( results.size() == 1 )
+      return fetch_raw_block_by_id( results[0]->id );
+   return _block_id_to_block.fetch_raw_by_number(num);
+}
+
 const signed_transaction& database::get_recent_transaction(const transaction_id_type& trx_id) const
 {
    auto& index = get_index_type<transaction_index>().indices().get<by_trx_id>();
@@ -117,6 +144,7 @@ std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of
 bool database::push_block(const signed_block& new_block, uint32_t skip)
 {
 //   idump((new_block.block_num())(new_block.id())(new_block.timestamp)(new_block.previous));
+   state_lock::write_guard guard( _state_lock );
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -218,6 +246,7 @@ bool database::_push_block(const signed_block& new_block)
          update_witnesses( *new_head );
       _block_id_to_block.store(new_block.id(), new_block);
       session.commit();
+      dlog( "Undo state of block ${n}: ${s}", ("n", new_block.block_num())("s", _undo_db.head_stats()) );
    } catch ( const fc::exception& e ) {
       elog("Failed to push new block:\n${e}", ("e", e.to_detail_string()));
       _fork_db.remove( new_block.id() );
@@ -269,6 +298,7 @@ processed_transaction database::push_transaction( const precomputable_transactio
 { try {
    // see https://github.com/bitshares/bitshares-core/issues/1573
    FC_ASSERT( fc::raw::pack_size( trx ) < (1024 * 1024), "Transaction exceeds maximum transaction size." );
+   state_lock::write_guard guard( _state_lock );
    processed_transaction result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -304,6 +334,8 @@ processed_transaction database::_push_transaction( const precomputable_transacti
 
 processed_transaction database::validate_transaction( const signed_transaction& trx )
 {
+   // The transaction is applied and undone, API reader threads must not see it in between
+   state_lock::write_guard guard( _state_lock );
    auto session = _undo_db.start_undo_session();
    return _apply_transaction( trx );
 }
@@ -362,6 +394,7 @@ signed_block database::generate_block(
    uint32_t skip /* = 0 */
    )
 { try {
+   state_lock::write_guard guard( _state_lock );
    signed_block result;
    detail::with_skip_flags( *this, skip, [&]()
    {
@@ -421,9 +454,17 @@ signed_block database::_generate_block(
 
    _pending_tx_session = _undo_db.start_undo_session();
 
+   // Signatures and authorities of the pending transactions are checked in parallel up front, the serial loop
+   // below only verifies those whose check failed or was invalidated by the transactions applied before them
+   authority_precheck checks;
+   if( !(skip & skip_transaction_signatures) && _pending_tx.size() > 1 )
+      checks = precheck_authorities( _pending_tx );
+
    uint64_t postponed_tx_count = 0;
+   size_t tx_index = 0;
    for( const processed_transaction& tx : _pending_tx )
    {
+      const bool verified = checks.still_valid( tx_index++ );
       size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
 
       // postpone transaction if it would make block too big
@@ -436,7 +477,14 @@ signed_block database::_generate_block(
       try
       {
          auto temp_session = _undo_db.start_undo_session();
-         processed_transaction ptx = _apply_transaction( tx );
+         processed_transaction ptx;
+         if( verified )
+            detail::with_skip_flags( *this, skip | skip_transaction_signatures, [&]()
+            {
+               ptx = _apply_transaction( tx );
+            } );
+         else
+            ptx = _apply_transaction( tx );
 
          // We have to recompute pack_size(ptx) because it may be different
          // than pack_size(tx) (i.e. if one or more results increased
@@ -450,6 +498,7 @@ signed_block database::_generate_block(
          }
 
          temp_session.merge();
+         checks.applied( tx );
 
          total_block_size = new_total_size;
          pending_block.transactions.push_back( ptx );
@@ -493,6 +542,7 @@ signed_block database::_generate_block(
  */
 void database::pop_block()
 { try {
+   state_lock::write_guard guard( _state_lock );
    _pending_tx_session.reset();
    auto fork_db_head = _fork_db.head();
    FC_ASSERT( fork_db_head, "Trying to pop() from empty fork database!?" );
@@ -509,6 +559,7 @@ void database::pop_block()
 
 void database::clear_pending()
 { try {
+   state_lock::write_guard guard( _state_lock );
    assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
    _pending_tx.clear();
    _pending_tx_session.reset();
@@ -544,6 +595,7 @@ const vector<optional< operation_history_object > >& database::get_applied_opera
 
 void database::apply_block( const signed_block& next_block, uint32_t skip )
 {
+   state_lock::write_guard guard( _state_lock );
    auto block_num = next_block.block_num();
    if( _checkpoints.size() && _checkpoints.rbegin()->second != block_id_type() )
    {
@@ -625,6 +677,7 @@ void database::_apply_block( const signed_block& next_block )
    clear_expired_proposals();
    clear_expired_orders();
    clear_expired_htlcs();
+   process_tank_accessory_states();
    update_expired_feeds();       // this will update expired feeds and some core exchange rates
    update_core_exchange_rates(); // this will update remaining core exchange rates
    update_withdraw_permissions();
@@ -724,7 +777,9 @@ processed_transaction database::_apply_transaction(const signed_transaction& trx
    eval_state.operation_results.reserve(trx.operations.size());
 
    //Finally process the operations
-   processed_transaction ptrx(trx);
+   // Pending transactions are applied again for every new block, keep what they have cached so far
+   const auto* precomputed = dynamic_cast<const precomputable_transaction*>( &trx );
+   processed_transaction ptrx = precomputed ? processed_transaction( *precomputed ) : processed_transaction( trx );
    _current_op_in_trx = 0;
    for( const auto& op : ptrx.operations )
    {
@@ -849,6 +904,17 @@ fc::future<void> database::precompute_parallel( const signed_block& block, const
    return *first;
 } FC_LOG_AND_RETHROW() }
 
+void database::precompute_sequential( const signed_block& block, const uint32_t skip )const
+{ try {
+   if( !block.transactions.empty() )
+      _precompute_parallel( &block.transactions[0], block.transactions.size(), skip );
+   if( !(skip&skip_witness_signature) )
+      block.signee();
+   if( !(skip&skip_merkle_check) )
+      block.calculate_merkle_root();
+   block.id();
+} FC_LOG_AND_RETHROW() }
+
 fc::future<void> database::precompute_parallel( const precomputable_transaction& trx )const
 {
    return fc::do_parallel([this,&trx] () {
@@ -856,4 +922,71 @@ fc::future<void> database::precompute_parallel( const precomputable_transaction&
    });
 }
 
+namespace {
+   /// Thrown out of the authority lookups of a precheck for transactions which need a regular verification
+   struct precheck_fallback {};
+}
+
+void database::_precheck_authorities( const processed_transaction* trx, authority_precheck::result* res,
+                                      const size_t count )const
+{
+   const chain_id_type& chain_id = get_chain_id();
+   const uint32_t max_depth = get_global_properties().parameters.max_authority_depth;
+   const auto& custom_idx = get_index_type<custom_authority_index>().indices().get<by_account_custom>();
+   for( size_t i = 0; i < count; ++i, ++trx, ++res )
+   {
+      flat_set<account_id_type>& accounts = res->accounts;
+      auto get_active = [this,&accounts]( account_id_type id ) {
+         accounts.insert( id );
+         return &id(*this).active;
+      };
+      auto get_owner = [this,&accounts]( account_id_type id ) {
+         accounts.insert( id );
+         return &id(*this).owner;
+      };
+      // custom authorities cache their predicates lazily, which is not safe to do here
+      auto get_custom = [&custom_idx]( account_id_type id, const operation& op, rejected_predicate_map* ) {
+         auto range = custom_idx.equal_range( boost::make_tuple( id, unsigned_int(op.which()), true ) );
+         if( range.first != range.second )
+            throw precheck_fallback();
+         return vector<authority>();
+      };
+      try {
+         trx->validate();
+         trx->verify_authority( chain_id, get_active, get_owner, get_custom, true, false, max_depth );
+         res->passed = true;
+      } catch( ... ) {
+         // not cached, the transaction is verified again when it is applied
+      }
+   }
+}
+
+authority_precheck database::precheck_authorities( const vector<processed_transaction>& trxs )const
+{
+   authority_precheck result( trxs.size() );
+   if( trxs.empty() )
+      return result;
+
+   const size_t chunks = std::min<size_t>( fc::asio::default_io_service_scope::get_num_threads(), trxs.size() );
+   if( chunks <= 1 )
+   {
+      _precheck_authorities( &trxs[0], &result.results[0], trxs.size() );
+      return result;
+   }
+
+   // The workers read the state, so unlike precompute_parallel() this must not wait on fc futures: that would
+   // let other fibers of this thread run, and they may change the state meanwhile.
+   const size_t chunk_size = ( trxs.size() + chunks - 1 ) / chunks;
+   run_parallel_tasks( ( trxs.size() + chunk_size - 1 ) / chunk_size,
+                       [this,&trxs,&result,chunk_size] ( size_t chunk ) {
+      const size_t base = chunk * chunk_size;
+      try {
+         _precheck_authorities( &trxs[base], &result.results[base], std::min( chunk_size, trxs.size() - base ) );
+      } catch( ... ) {
+         // results stay unpassed
+      }
+   });
+   return result;
+}
+
 } }
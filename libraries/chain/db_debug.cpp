@@ -45,7 +45,7 @@ void database::debug_dump()
    const asset_dynamic_data_object& core_asset_data = db.get_core_asset().dynamic_asset_data_id(db);
 
    const auto& balance_index = db.get_index_type<account_balance_index>().indices();
-   const auto& statistics_index = db.get_index_type<account_stats_index>().indices();
+   const auto& statistics_index = db.get_index_type<account_stats_index>();
    const auto& settle_index = db.get_index_type<force_settlement_index>().indices();
    const auto& htlcs = db.get_index_type<htlc_index>().indices();
    map<asset_id_type,share_type> total_balances;
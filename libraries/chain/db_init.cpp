@@ -171,9 +171,9 @@ void database::initialize_indexes()
    add_index< primary_index<asset_bitasset_data_index,                 13 > >(); // 8192
    add_index< primary_index<simple_index<global_property_object          >> >();
    add_index< primary_index<simple_index<dynamic_global_property_object  >> >();
-   add_index< primary_index<account_stats_index,                       20 > >(); // 1 Mi
-   add_index< primary_index<simple_index<asset_dynamic_data_object       >> >();
-   add_index< primary_index<simple_index<block_summary_object            >> >();
+   add_index< primary_index<account_stats_index                           > >();
+   add_index< primary_index<flat_index<asset_dynamic_data_object, 13   >> >(); // 8192 per chunk
+   add_index< primary_index<flat_index<block_summary_object, 16        >> >(); // a full TaPoS window
    add_index< primary_index<simple_index<chain_property_object          > > >();
    add_index< primary_index<simple_index<witness_schedule_object        > > >();
    add_index< primary_index<simple_index<budget_record_object           > > >();
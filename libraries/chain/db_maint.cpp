@@ -3,7 +3,9 @@
  *
  */
 
+#include <fc/asio.hpp>
 #include <fc/uint128.hpp>
+#include <fc/variant_object.hpp>
 
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/fba_accumulator_id.hpp>
@@ -25,6 +27,7 @@
 #include <graphene/chain/witness_object.hpp>
 #include <graphene/chain/worker_object.hpp>
 #include <graphene/chain/custom_authority_object.hpp>
+#include <graphene/chain/parallel_tasks.hpp>
 
 namespace graphene { namespace chain {
 
@@ -41,8 +44,8 @@ vector<std::reference_wrapper<const typename Index::object_type>> database::sort
                   [](const ObjectType& o) { return std::cref(o); });
    std::partial_sort(refs.begin(), refs.begin() + count, refs.end(),
                    [this](const ObjectType& a, const ObjectType& b)->bool {
-      share_type oa_vote = _vote_tally_buffer[a.vote_id];
-      share_type ob_vote = _vote_tally_buffer[b.vote_id];
+      share_type oa_vote = _vote_tally.vote_tally[a.vote_id];
+      share_type ob_vote = _vote_tally.vote_tally[b.vote_id];
       if( oa_vote != ob_vote )
          return oa_vote > ob_vote;
       return a.vote_id < b.vote_id;
@@ -53,7 +56,7 @@ vector<std::reference_wrapper<const typename Index::object_type>> database::sort
 }
 
 template<class Type>
-void database::perform_account_maintenance(Type tally_helper)
+void database::perform_account_maintenance(Type& tally_helper)
 {
    const auto& bal_idx = get_index_type< account_balance_index >().indices().get< by_maintenance_flag >();
    if( bal_idx.begin() != bal_idx.end() )
@@ -80,7 +83,7 @@ void database::perform_account_maintenance(Type tally_helper)
 
    while( stats_itr != stats_idx.end() )
    {
-      const account_statistics_object& acc_stat = *stats_itr;
+      const account_statistics_object& acc_stat = **stats_itr;
       const account_object& acc_obj = acc_stat.owner( *this );
       ++stats_itr;
 
@@ -121,9 +124,9 @@ void database::update_worker_votes()
    {
       modify( *itr, [this]( worker_object& obj )
       {
-         obj.total_votes_for = _vote_tally_buffer[obj.vote_for];
-         obj.total_cm_votes_for = _cm_vote_for_worker_buffer[obj.vote_for];
-         obj.cm_support.swap(_cm_support_worker_buffer[obj.vote_for]);
+         obj.total_votes_for = _vote_tally.vote_tally[obj.vote_for];
+         obj.total_cm_votes_for = _vote_tally.cm_vote_for_worker[obj.vote_for];
+         obj.cm_support.swap(_vote_tally.cm_support_worker[obj.vote_for]);
       });
       ++itr;
    }
@@ -206,8 +209,8 @@ fc::uint128_t database::calculate_workers_budget()
 
 void database::update_active_witnesses()
 { try {
-   assert( _witness_count_histogram_buffer.size() > 0 );
-   share_type stake_target = (_total_voting_stake[1]-_witness_count_histogram_buffer[0]) / 2;
+   assert( _vote_tally.witness_count_histogram.size() > 0 );
+   share_type stake_target = (_vote_tally.total_voting_stake[1]-_vote_tally.witness_count_histogram[0]) / 2;
 
    /// accounts that vote for 0 or 1 witness do not get to express an opinion on
    /// the number of witnesses to have (they abstain and are non-voting accounts)
@@ -217,10 +220,10 @@ void database::update_active_witnesses()
    size_t witness_count = 0;
    if( stake_target > 0 )
    {
-      while( (witness_count < _witness_count_histogram_buffer.size() - 1)
+      while( (witness_count < _vote_tally.witness_count_histogram.size() - 1)
              && (stake_tally <= stake_target) )
       {
-         stake_tally += _witness_count_histogram_buffer[++witness_count];
+         stake_tally += _vote_tally.witness_count_histogram[++witness_count];
       }
    }
 
@@ -285,7 +288,7 @@ void database::update_active_witnesses()
    // Sort all
    std::sort(wits.begin(), wits.end(),
          [&](const witness_object& a, const witness_object& b){
-            return _vote_tally_buffer[a.vote_id] > _vote_tally_buffer[b.vote_id];
+            return _vote_tally.vote_tally[a.vote_id] > _vote_tally.vote_tally[b.vote_id];
          });
 
    // the first round
@@ -328,13 +331,13 @@ void database::update_active_witnesses()
 
    std::sort(wits.begin(), wits.end(),
              [&](const witness_object& a, const witness_object& b){
-                return _vote_tally_buffer[a.vote_id] > _vote_tally_buffer[b.vote_id];
+                return _vote_tally.vote_tally[a.vote_id] > _vote_tally.vote_tally[b.vote_id];
              });
 
    auto update_witness_total_votes = [this]( const witness_object& wit ) {
       modify( wit, [this]( witness_object& obj )
       {
-         obj.total_votes = _vote_tally_buffer[obj.vote_id];
+         obj.total_votes = _vote_tally.vote_tally[obj.vote_id];
       });
    };
 
@@ -359,7 +362,7 @@ void database::update_active_witnesses()
    {
       vote_counter vc;
       for( const witness_object& wit : wits )
-         vc.add( wit.witness_account, _vote_tally_buffer[wit.vote_id] );
+         vc.add( wit.witness_account, _vote_tally.vote_tally[wit.vote_id] );
       vc.finish( a.active );
    } );
 
@@ -378,8 +381,8 @@ void database::update_active_witnesses()
 
 void database::update_active_committee_members()
 { try {
-   assert( _committee_count_histogram_buffer.size() > 0 );
-   share_type stake_target = (_total_voting_stake[0]-_committee_count_histogram_buffer[0]) / 2;
+   assert( _vote_tally.committee_count_histogram.size() > 0 );
+   share_type stake_target = (_vote_tally.total_voting_stake[0]-_vote_tally.committee_count_histogram[0]) / 2;
 
    /// accounts that vote for 0 or 1 committee member do not get to express an opinion on
    /// the number of committee members to have (they abstain and are non-voting accounts)
@@ -387,10 +390,10 @@ void database::update_active_committee_members()
    size_t committee_member_count = 0;
    if( stake_target > 0 )
    {
-      while( (committee_member_count < _committee_count_histogram_buffer.size() - 1)
+      while( (committee_member_count < _vote_tally.committee_count_histogram.size() - 1)
              && (stake_tally <= stake_target.value) )
       {
-         stake_tally += _committee_count_histogram_buffer[++committee_member_count];
+         stake_tally += _vote_tally.committee_count_histogram[++committee_member_count];
       }
    }
 
@@ -402,7 +405,7 @@ void database::update_active_committee_members()
    auto update_committee_member_total_votes = [this]( const committee_member_object& cm ) {
       modify( cm, [this]( committee_member_object& obj )
       {
-         obj.total_votes = _vote_tally_buffer[obj.vote_id];
+         obj.total_votes = _vote_tally.vote_tally[obj.vote_id];
       });
    };
 
@@ -430,7 +433,7 @@ void database::update_active_committee_members()
       {
          vote_counter vc;
          for( const committee_member_object& cm : committee_members )
-            vc.add( cm.committee_member_account, _vote_tally_buffer[cm.vote_id] );
+            vc.add( cm.committee_member_account, _vote_tally.vote_tally[cm.vote_id] );
          vc.finish( a.active );
       });
       modify( get(GRAPHENE_RELAXED_COMMITTEE_ACCOUNT), [&committee_account](account_object& a)
@@ -983,9 +986,26 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
    const auto& gpo = get_global_properties();
    const auto& dgpo = get_dynamic_global_properties();
 
+   fc::time_point phase_start = fc::time_point::now();
+   const fc::time_point maintenance_start = phase_start;
+   fc::mutable_variant_object phase_times;
+   auto end_phase = [&phase_start,&phase_times]( const char* phase ) {
+      const fc::time_point now = fc::time_point::now();
+      phase_times.set( phase, ( now - phase_start ).count() );
+      phase_start = now;
+   };
+
    distribute_fba_balances(*this);
    create_buyback_orders(*this);
-
+   end_phase( "fba_and_buyback" );
+
+   /**
+    * Votes are tallied in two passes. perform_account_maintenance() visits the accounts one by one and records
+    * the voters, because it also pays out pending fees, and the cashback it deposits changes the stake of the
+    * accounts visited later. Nothing else read by the tally is changed by account maintenance, so the voting
+    * stakes are then computed and summed up in parallel, each thread over its own range of voters and into its
+    * own buffers. The buffers are merged in the order of the ranges, which gives the same result as a serial tally.
+    */
    struct vote_tally_helper {
       database& d;
       const global_property_object& props;
@@ -1000,18 +1020,19 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
 
       vector<account_id_type> committee_members;
 
+      struct voter {
+         const account_object*            stake_account;
+         const account_statistics_object* stats;
+         uint64_t                         cashback; ///< balance of the cashback vesting balance when visited
+      };
+      vector<voter> voters;
+
       vote_tally_helper( database& db )
          : d(db), props( d.get_global_properties() ), dprops( d.get_dynamic_global_properties() ),
            now( d.head_block_time() ),
            pob_activated( dprops.total_pob > 0 || dprops.total_inactive > 0 )
       {
-         d._vote_tally_buffer.resize( props.next_available_vote_id, 0 );
-         d._cm_vote_for_worker_buffer.resize( props.next_available_vote_id, 0 );
-         d._cm_support_worker_buffer.resize( props.next_available_vote_id, {} );
-         d._witness_count_histogram_buffer.resize( props.parameters.maximum_witness_count / 2 + 1, 0 );
-         d._committee_count_histogram_buffer.resize( props.parameters.maximum_committee_count / 2 + 1, 0 );
-         d._total_voting_stake[0] = 0;
-         d._total_voting_stake[1] = 0;
+         init_buffers( d._vote_tally );
          witness_recalc_times   = detail::vote_recalc_options::witness().get_vote_recalc_times( now );
          committee_recalc_times = detail::vote_recalc_options::committee().get_vote_recalc_times( now );
          worker_recalc_times    = detail::vote_recalc_options::worker().get_vote_recalc_times( now );
@@ -1032,6 +1053,17 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
          */
       }
 
+      void init_buffers( vote_tally_buffers& buffers )const
+      {
+         buffers.vote_tally.resize( props.next_available_vote_id, 0 );
+         buffers.cm_vote_for_worker.resize( props.next_available_vote_id, 0 );
+         buffers.cm_support_worker.resize( props.next_available_vote_id, {} );
+         buffers.witness_count_histogram.resize( props.parameters.maximum_witness_count / 2 + 1, 0 );
+         buffers.committee_count_histogram.resize( props.parameters.maximum_committee_count / 2 + 1, 0 );
+         buffers.total_voting_stake[0] = 0;
+         buffers.total_voting_stake[1] = 0;
+      }
+
       void operator()( const account_object& stake_account, const account_statistics_object& stats )
       {
          // PoB activation
@@ -1040,132 +1072,192 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
 
          if( props.parameters.count_non_member_votes || stake_account.is_member( now ) )
          {
-            // There may be a difference between the account whose stake is voting and the one specifying opinions.
-            // Usually they're the same, but if the stake account has specified a voting_account, that account is the
-            // one specifying the opinions.
-            bool directly_voting = ( stake_account.options.voting_account == GRAPHENE_PROXY_TO_SELF_ACCOUNT );
-            const account_object& opinion_account = ( directly_voting ? stake_account
-                                                      : d.get(stake_account.options.voting_account) );
-
-            uint64_t voting_stake[3]; // 0=committee, 1=witness, 2=worker, as in vote_id_type::vote_type
-            uint64_t num_committee_voting_stake; // number of committee members
-            voting_stake[2] = ( pob_activated ? 0 : stats.total_core_in_orders.value )
-                  + (stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(d).balance.amount.value: 0)
-                  + stats.core_in_balance.value;
-
-            //PoB
-            const uint64_t pol_amount = stats.total_core_pol.value;
-            const uint64_t pol_value = stats.total_pol_value.value;
-            const uint64_t pob_amount = stats.total_core_pob.value;
-            const uint64_t pob_value = stats.total_pob_value.value;
-            if( pob_amount == 0 )
+            voters.push_back( { &stake_account, &stats,
+                  stake_account.cashback_vb.valid() ? (*stake_account.cashback_vb)(d).balance.amount.value : 0 } );
+         }
+      }
+
+      void tally( const voter& v, vote_tally_buffers& buffers )const
+      {
+         const account_object& stake_account = *v.stake_account;
+         const account_statistics_object& stats = *v.stats;
+
+         // There may be a difference between the account whose stake is voting and the one specifying opinions.
+         // Usually they're the same, but if the stake account has specified a voting_account, that account is the
+         // one specifying the opinions.
+         bool directly_voting = ( stake_account.options.voting_account == GRAPHENE_PROXY_TO_SELF_ACCOUNT );
+         const account_object& opinion_account = ( directly_voting ? stake_account
+                                                   : d.get(stake_account.options.voting_account) );
+
+         uint64_t voting_stake[3]; // 0=committee, 1=witness, 2=worker, as in vote_id_type::vote_type
+         uint64_t num_committee_voting_stake; // number of committee members
+         voting_stake[2] = ( pob_activated ? 0 : stats.total_core_in_orders.value )
+               + v.cashback
+               + stats.core_in_balance.value;
+
+         //PoB
+         const uint64_t pol_amount = stats.total_core_pol.value;
+         const uint64_t pol_value = stats.total_pol_value.value;
+         const uint64_t pob_amount = stats.total_core_pob.value;
+         const uint64_t pob_value = stats.total_pob_value.value;
+         if( pob_amount == 0 )
+         {
+            voting_stake[2] += pol_value;
+         }
+         else if( pol_amount == 0 ) // and pob_amount > 0
+         {
+            if( pob_amount <= voting_stake[2] )
             {
-               voting_stake[2] += pol_value;
+               voting_stake[2] += ( pob_value - pob_amount );
             }
-            else if( pol_amount == 0 ) // and pob_amount > 0
+            else
             {
-               if( pob_amount <= voting_stake[2] )
-               {
-                  voting_stake[2] += ( pob_value - pob_amount );
-               }
-               else
-               {
-                  auto base_value = static_cast<fc::uint128_t>( voting_stake[2] ) * pob_value / pob_amount;
-                  voting_stake[2] = static_cast<uint64_t>( base_value );
-               }
+               auto base_value = static_cast<fc::uint128_t>( voting_stake[2] ) * pob_value / pob_amount;
+               voting_stake[2] = static_cast<uint64_t>( base_value );
             }
-            else if( pob_amount <= pol_amount ) // pob_amount > 0 && pol_amount > 0
+         }
+         else if( pob_amount <= pol_amount ) // pob_amount > 0 && pol_amount > 0
+         {
+            auto base_value = static_cast<fc::uint128_t>( pob_value ) * pol_value / pol_amount;
+            auto diff_value = static_cast<fc::uint128_t>( pob_amount ) * pol_value / pol_amount;
+            base_value += ( pol_value - diff_value );
+            voting_stake[2] += static_cast<uint64_t>( base_value );
+         }
+         else // pob_amount > pol_amount > 0
+         {
+            auto base_value = static_cast<fc::uint128_t>( pol_value ) * pob_value / pob_amount;
+            fc::uint128_t diff_amount = pob_amount - pol_amount;
+            if( diff_amount <= voting_stake[2] )
             {
-               auto base_value = static_cast<fc::uint128_t>( pob_value ) * pol_value / pol_amount;
-               auto diff_value = static_cast<fc::uint128_t>( pob_amount ) * pol_value / pol_amount;
-               base_value += ( pol_value - diff_value );
-               voting_stake[2] += static_cast<uint64_t>( base_value );
+               auto diff_value = static_cast<fc::uint128_t>( pol_amount ) * pob_value / pob_amount;
+               base_value += ( pob_value - diff_value );
+               voting_stake[2] += static_cast<uint64_t>( base_value - diff_amount );
             }
-            else // pob_amount > pol_amount > 0
+            else // diff_amount > voting_stake[2]
             {
-               auto base_value = static_cast<fc::uint128_t>( pol_value ) * pob_value / pob_amount;
-               fc::uint128_t diff_amount = pob_amount - pol_amount;
-               if( diff_amount <= voting_stake[2] )
-               {
-                  auto diff_value = static_cast<fc::uint128_t>( pol_amount ) * pob_value / pob_amount;
-                  base_value += ( pob_value - diff_value );
-                  voting_stake[2] += static_cast<uint64_t>( base_value - diff_amount );
-               }
-               else // diff_amount > voting_stake[2]
-               {
-                  base_value += static_cast<fc::uint128_t>( voting_stake[2] ) * pob_value / pob_amount;
-                  voting_stake[2] = static_cast<uint64_t>( base_value );
-               }
+               base_value += static_cast<fc::uint128_t>( voting_stake[2] ) * pob_value / pob_amount;
+               voting_stake[2] = static_cast<uint64_t>( base_value );
             }
+         }
 
-            // Shortcut
-            if( voting_stake[2] == 0 )
-               return;
+         // Shortcut
+         if( voting_stake[2] == 0 )
+            return;
 
-            // Recalculate votes
-            if( !directly_voting )
-            {
-               voting_stake[2] = detail::vote_recalc_options::delegator().get_recalced_voting_stake(
-                                       voting_stake[2], stats.last_vote_time, *delegator_recalc_times );
-            }
-            const account_statistics_object& opinion_account_stats = ( directly_voting ? stats
-                                       : opinion_account.statistics( d ) );
-            voting_stake[1] = detail::vote_recalc_options::witness().get_recalced_voting_stake(
-                                 voting_stake[2], opinion_account_stats.last_vote_time, *witness_recalc_times );
-            voting_stake[0] = detail::vote_recalc_options::committee().get_recalced_voting_stake(
-                                 voting_stake[2], opinion_account_stats.last_vote_time, *committee_recalc_times );
-            num_committee_voting_stake = voting_stake[0];
-            if( opinion_account.num_committee_voted > 1 )
-               voting_stake[0] /= opinion_account.num_committee_voted;
-            voting_stake[2] = detail::vote_recalc_options::worker().get_recalced_voting_stake(
-                                 voting_stake[2], opinion_account_stats.last_vote_time, *worker_recalc_times );
-
-            bool is_committee_members = false;
-            const account_id_type account = stake_account.id;
-            auto itr = std::lower_bound(committee_members.begin(), committee_members.end(), account);
-            if( itr != committee_members.end() && *itr == account ) is_committee_members = true;
-            for( vote_id_type id : opinion_account.options.votes )
-            {
-               uint32_t offset = id.instance();
-               uint32_t type = std::min( id.type(), vote_id_type::vote_type::worker ); // cap the data
-               // if they somehow managed to specify an illegal offset, ignore it.
-               if( offset >= d._vote_tally_buffer.size()
-                  || offset >= d._cm_vote_for_worker_buffer.size()
-                  || offset >= d._cm_support_worker_buffer.size() )
-                  continue;
-
-               if (is_committee_members && type == vote_id_type::vote_type::worker)
-               {
-                  // Add up only the committee members votes
-                  d._cm_vote_for_worker_buffer[offset] += voting_stake[type];
-                  d._cm_support_worker_buffer[offset].push_back(account);
-               }
-
-               d._vote_tally_buffer[offset] += voting_stake[type];
-            }
+         // Recalculate votes
+         if( !directly_voting )
+         {
+            voting_stake[2] = detail::vote_recalc_options::delegator().get_recalced_voting_stake(
+                                    voting_stake[2], stats.last_vote_time, *delegator_recalc_times );
+         }
+         const account_statistics_object& opinion_account_stats = ( directly_voting ? stats
+                                    : opinion_account.statistics( d ) );
+         voting_stake[1] = detail::vote_recalc_options::witness().get_recalced_voting_stake(
+                              voting_stake[2], opinion_account_stats.last_vote_time, *witness_recalc_times );
+         voting_stake[0] = detail::vote_recalc_options::committee().get_recalced_voting_stake(
+                              voting_stake[2], opinion_account_stats.last_vote_time, *committee_recalc_times );
+         num_committee_voting_stake = voting_stake[0];
+         if( opinion_account.num_committee_voted > 1 )
+            voting_stake[0] /= opinion_account.num_committee_voted;
+         voting_stake[2] = detail::vote_recalc_options::worker().get_recalced_voting_stake(
+                              voting_stake[2], opinion_account_stats.last_vote_time, *worker_recalc_times );
+
+         bool is_committee_members = false;
+         const account_id_type account = stake_account.id;
+         auto itr = std::lower_bound(committee_members.begin(), committee_members.end(), account);
+         if( itr != committee_members.end() && *itr == account ) is_committee_members = true;
+         for( vote_id_type id : opinion_account.options.votes )
+         {
+            uint32_t offset = id.instance();
+            uint32_t type = std::min( id.type(), vote_id_type::vote_type::worker ); // cap the data
+            // if they somehow managed to specify an illegal offset, ignore it.
+            if( offset >= buffers.vote_tally.size() )
+               continue;
 
-            // votes for a number greater than maximum_witness_count are skipped here
-            if( voting_stake[1] > 0
-                  && opinion_account.options.num_witness <= props.parameters.maximum_witness_count )
+            if (is_committee_members && type == vote_id_type::vote_type::worker)
             {
-               uint16_t offset = opinion_account.options.num_witness / 2;
-               d._witness_count_histogram_buffer[offset] += voting_stake[1];
+               // Add up only the committee members votes
+               buffers.cm_vote_for_worker[offset] += voting_stake[type];
+               buffers.cm_support_worker[offset].push_back(account);
             }
-            // votes for a number greater than maximum_committee_count are skipped here
-            if( num_committee_voting_stake > 0
-                  && opinion_account.options.num_committee <= props.parameters.maximum_committee_count )
+
+            buffers.vote_tally[offset] += voting_stake[type];
+         }
+
+         // votes for a number greater than maximum_witness_count are skipped here
+         if( voting_stake[1] > 0
+               && opinion_account.options.num_witness <= props.parameters.maximum_witness_count )
+         {
+            uint16_t offset = opinion_account.options.num_witness / 2;
+            buffers.witness_count_histogram[offset] += voting_stake[1];
+         }
+         // votes for a number greater than maximum_committee_count are skipped here
+         if( num_committee_voting_stake > 0
+               && opinion_account.options.num_committee <= props.parameters.maximum_committee_count )
+         {
+            uint16_t offset = opinion_account.options.num_committee / 2;
+            buffers.committee_count_histogram[offset] += num_committee_voting_stake;
+         }
+
+         buffers.total_voting_stake[0] += num_committee_voting_stake;
+         buffers.total_voting_stake[1] += voting_stake[1];
+      }
+
+      void tally_range( size_t begin, size_t end, vote_tally_buffers& buffers )const
+      {
+         for( size_t i = begin; i < end; ++i )
+            tally( voters[i], buffers );
+      }
+
+      void tally_votes()
+      {
+         // Small sets of voters are not worth the threads
+         const size_t chunks = std::max<size_t>( 1, std::min<size_t>(
+                                     fc::asio::default_io_service_scope::get_num_threads(),
+                                     voters.size() / std::max<size_t>( d._vote_tally_chunk_size, 1 ) ) );
+         if( chunks == 1 )
+         {
+            tally_range( 0, voters.size(), d._vote_tally );
+            return;
+         }
+
+         const size_t chunk_size = ( voters.size() + chunks - 1 ) / chunks;
+         vector<vote_tally_buffers> results( ( voters.size() + chunk_size - 1 ) / chunk_size );
+         // The workers read the state, so as in database::precheck_authorities() this must not let fibers run
+         run_parallel_tasks( results.size(), [this,&results,chunk_size] ( size_t chunk ) {
+            const size_t base = chunk * chunk_size;
+            init_buffers( results[chunk] );
+            tally_range( base, std::min( base + chunk_size, voters.size() ), results[chunk] );
+         });
+
+         // Merge in the order of the ranges, so the committee members supporting a worker keep the serial order
+         vote_tally_buffers& total = d._vote_tally;
+         for( const vote_tally_buffers& buffers : results )
+         {
+            for( size_t i = 0; i < buffers.vote_tally.size(); ++i )
             {
-               uint16_t offset = opinion_account.options.num_committee / 2;
-               d._committee_count_histogram_buffer[offset] += num_committee_voting_stake;
+               total.vote_tally[i] += buffers.vote_tally[i];
+               total.cm_vote_for_worker[i] += buffers.cm_vote_for_worker[i];
+               total.cm_support_worker[i].insert( total.cm_support_worker[i].end(),
+                                                  buffers.cm_support_worker[i].begin(),
+                                                  buffers.cm_support_worker[i].end() );
             }
-
-            d._total_voting_stake[0] += num_committee_voting_stake;
-            d._total_voting_stake[1] += voting_stake[1];
+            for( size_t i = 0; i < buffers.witness_count_histogram.size(); ++i )
+               total.witness_count_histogram[i] += buffers.witness_count_histogram[i];
+            for( size_t i = 0; i < buffers.committee_count_histogram.size(); ++i )
+               total.committee_count_histogram[i] += buffers.committee_count_histogram[i];
+            total.total_voting_stake[0] += buffers.total_voting_stake[0];
+            total.total_voting_stake[1] += buffers.total_voting_stake[1];
          }
       }
    } tally_helper(*this);
 
    perform_account_maintenance( tally_helper );
+   end_phase( "account_maintenance" );
+
+   tally_helper.tally_votes();
+   end_phase( "vote_tally" );
+   votes_tallied( _vote_tally );
 
    struct clear_canary {
       clear_canary(vector<uint64_t>& target): target(target){}
@@ -1173,15 +1265,19 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
    private:
       vector<uint64_t>& target;
    };
-   clear_canary a(_witness_count_histogram_buffer),
-                b(_committee_count_histogram_buffer),
-                c(_vote_tally_buffer),
-                d(_cm_vote_for_worker_buffer);
+   clear_canary a(_vote_tally.witness_count_histogram),
+                b(_vote_tally.committee_count_histogram),
+                c(_vote_tally.vote_tally),
+                d(_vote_tally.cm_vote_for_worker);
 
    update_top_n_authorities(*this);
+   end_phase( "top_n_authorities" );
    update_active_witnesses();
+   end_phase( "active_witnesses" );
    update_active_committee_members();
+   end_phase( "active_committee_members" );
    update_worker_votes();
+   end_phase( "worker_votes" );
 
    modify(gpo, [&dgpo](global_property_object& p) {
       // Remove scaling of account registration fee
@@ -1230,18 +1326,26 @@ void database::perform_chain_maintenance(const signed_block& next_block, const g
       d.accounts_registered_this_interval = 0;
    });
 
+   end_phase( "global_properties" );
+
    process_bitassets();
+   end_phase( "bitassets" );
    delete_expired_custom_authorities(*this);
+   end_phase( "custom_authorities" );
 
    // process_budget needs to run at the bottom because
    //   it needs to know the next_maintenance_time
    process_budget();
+   end_phase( "budget" );
 
-   for (vector<account_id_type>& at: _cm_support_worker_buffer)
+   for (vector<account_id_type>& at: _vote_tally.cm_support_worker)
    {
       at.clear();
    }
-   _cm_support_worker_buffer.clear();
+   _vote_tally.cm_support_worker.clear();
+
+   ilog( "Chain maintenance at block ${b} took ${t} us, by phase: ${p}",
+         ("b", next_block.block_num())("t", ( fc::time_point::now() - maintenance_start ).count())("p", phase_times) );
 }
 
 void database::maintenance_prng::seed(uint64_t seed)
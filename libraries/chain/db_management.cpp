@@ -33,12 +33,14 @@
 #include <graphene/protocol/fee_schedule.hpp>
 
 #include <fc/io/fstream.hpp>
+#include <fc/asio.hpp>
+#include <fc/thread/parallel.hpp>
 
+#include <atomic>
+#include <deque>
 #include <fstream>
 #include <functional>
 #include <iostream>
-#include <queue>
-#include <tuple>
 
 namespace graphene { namespace chain {
 
@@ -50,9 +52,86 @@ database::database()
 
 database::~database()
 {
+   _reader_threads.clear();
    clear_pending();
 }
 
+void database::set_reader_threads( uint16_t count )
+{
+   _reader_threads.clear();
+   _reader_threads.reserve( count );
+   for( uint16_t i = 0; i < count; ++i )
+      _reader_threads.push_back( std::make_unique<fc::thread>( "reader_" + fc::to_string(i) ) );
+}
+
+namespace {
+
+/// One block in flight through the replay pipeline
+struct replay_slot
+{
+   uint32_t               block_num = 0;
+   size_t                 processed_block_size = 0;
+   signed_block           block;
+   bool                   found = false;
+   /// Whether the block is recent enough that transaction dupe checks must be enabled from here on
+   bool                   dupe_check = false;
+   fc::future<void>       done;
+};
+
+/// Per-stage counters of the replay pipeline, stage times are in microseconds
+struct replay_stats
+{
+   std::atomic<int64_t>   load_time{0};
+   std::atomic<int64_t>   precompute_time{0};
+   int64_t                apply_time = 0;
+   uint64_t               applied = 0;
+   uint64_t               apply_stalls = 0;
+   uint64_t               ready_sum = 0;
+
+   void report( const fc::time_point& since, size_t depth )const
+   {
+      if( applied == 0 )
+         return;
+      const double elapsed = double( (fc::time_point::now() - since).count() ) / 1000000.0;
+      const auto per_sec = [this]( int64_t usecs ) {
+         return usecs > 0 ? double(applied) * 1000000.0 / double(usecs) : 0.0;
+      };
+      ilog( "   replay pipeline: ${bps} blocks/s overall; stage capacity (blocks/s per thread): "
+            "load ${l}, precompute ${p}, apply ${a}; ready queue ${q}/${d}, apply stalls ${s}",
+            ("bps", uint64_t( double(applied) / std::max( elapsed, 0.001 ) ))
+            ("l", uint64_t( per_sec( load_time.load() ) ))
+            ("p", uint64_t( per_sec( precompute_time.load() ) ))
+            ("a", uint64_t( per_sec( apply_time ) ))
+            ("q", uint64_t( ready_sum / applied ))("d", depth)
+            ("s", apply_stalls) );
+   }
+};
+
+/// Owns the in-flight blocks, and makes sure no worker outlives them
+class replay_queue : public std::deque<replay_slot>
+{
+   public:
+      ~replay_queue() { drain(); }
+
+      void drain()
+      {
+         for( auto& slot : *this )
+         {
+            try
+            {
+               if( slot.done.valid() )
+                  slot.done.wait();
+            }
+            catch( const fc::exception& )
+            {
+            }
+         }
+         clear();
+      }
+};
+
+} // anonymous namespace
+
 void database::reindex( fc::path data_dir )
 { try {
    auto last_block = _block_id_to_block.last();
@@ -81,85 +160,124 @@ void database::reindex( fc::path data_dir )
 
    size_t total_block_size = _block_id_to_block.total_block_size();
    const auto& gpo = get_global_properties();
-   std::queue< std::tuple< size_t, signed_block, fc::future< void > > > blocks;
+   const fc::time_point_sec dupe_check_start = last_block->timestamp - gpo.parameters.maximum_time_until_expiration;
+
+   // Blocks are read, unpacked and precomputed by the thread pool, each block on its own worker, while
+   // this thread only applies them in order.
+   const size_t depth = _reindex_pipeline_depth > 0 ? _reindex_pipeline_depth
+                        : std::max<size_t>( 20, 4 * fc::asio::default_io_service_scope::get_num_threads() );
+   ilog( "Replay pipeline depth is ${d} blocks", ("d",depth) );
+
+   replay_stats stats;
+   replay_queue blocks;
    uint32_t next_block_num = head_block_num() + 1;
    uint32_t i = next_block_num;
    while( next_block_num <= last_block_num || !blocks.empty() )
    {
-      if( next_block_num <= last_block_num && blocks.size() < 20 )
+      while( next_block_num <= last_block_num && blocks.size() < depth )
       {
-         const size_t processed_block_size = _block_id_to_block.blocks_current_position();
-         fc::optional< signed_block > block = _block_id_to_block.fetch_by_number( next_block_num++ );
-         if( block.valid() )
-         {
-            if( block->timestamp >= last_block->timestamp - gpo.parameters.maximum_time_until_expiration )
-               skip &= ~skip_transaction_dupe_check;
-            blocks.emplace( processed_block_size, std::move(*block), fc::future<void>() );
-            std::get<2>(blocks.back()) = precompute_parallel( std::get<1>(blocks.back()), skip );
-         }
-         else
-         {
-            wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
-            uint32_t dropped_count = 0;
-            while( true )
+         blocks.emplace_back();
+         replay_slot& slot = blocks.back();
+         slot.block_num = next_block_num++;
+         slot.done = fc::do_parallel( [this,&slot,&stats,skip,dupe_check_start] () {
+            const auto load_start = fc::time_point::now();
+            slot.processed_block_size = _block_id_to_block.blocks_current_position();
+            fc::optional< signed_block > block = _block_id_to_block.fetch_by_number( slot.block_num );
+            const auto load_end = fc::time_point::now();
+            stats.load_time += ( load_end - load_start ).count();
+            if( !block.valid() )
+               return;
+            slot.found = true;
+            slot.block = std::move( *block );
+
+            uint32_t block_skip = skip;
+            if( slot.block.timestamp >= dupe_check_start )
             {
-               fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
-               // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
-               if( !last_id.valid() )
-                  break;
-               // we've caught up to the gap
-               if( block_header::num_from_id( *last_id ) <= i )
-                  break;
-               _block_id_to_block.remove( *last_id );
-               dropped_count++;
+               slot.dupe_check = true;
+               block_skip &= ~skip_transaction_dupe_check;
             }
-            wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
-            next_block_num = last_block_num + 1; // don't load more blocks
-         }
+            precompute_sequential( slot.block, block_skip );
+            stats.precompute_time += ( fc::time_point::now() - load_end ).count();
+         } );
       }
-      else
-      {
-         std::get<2>(blocks.front()).wait();
-         const signed_block& block = std::get<1>(blocks.front());
 
-         if( i % 10000 == 0 )
-         {
-            std::stringstream bysize;
-            std::stringstream bynum;
-            size_t current_pos = std::get<0>(blocks.front());
-            if( current_pos > total_block_size )
-               total_block_size = current_pos;
-            bysize << std::fixed << std::setprecision(5) << double(current_pos) / total_block_size * 100;
-            bynum << std::fixed << std::setprecision(5) << double(i)*100/last_block_num;
-            ilog(
-               "   [by size: ${size}%   ${processed} of ${total}]   [by num: ${num}%   ${i} of ${last}]",
-               ("size", bysize.str())
-               ("processed", current_pos)
-               ("total", total_block_size)
-               ("num", bynum.str())
-               ("i", i)
-               ("last", last_block_num)
-            );
-         }
-         if( i == undo_point )
-         {
-            ilog( "Writing database to disk at block ${i}", ("i",i) );
-            flush();
-            ilog( "Done" );
-         }
-         if( i < undo_point )
-            apply_block( block, skip );
-         else
+      replay_slot& slot = blocks.front();
+      if( !slot.done.ready() )
+         ++stats.apply_stalls;
+      for( const auto& s : blocks )
+         if( s.done.ready() )
+            ++stats.ready_sum;
+      slot.done.wait();
+
+      if( !slot.found )
+      {
+         wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", slot.block_num) );
+         // let the workers for the blocks behind the gap finish before touching the block log
+         blocks.drain();
+         uint32_t dropped_count = 0;
+         while( true )
          {
-            _undo_db.enable();
-            push_block( block, skip );
+            fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
+            // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
+            if( !last_id.valid() )
+               break;
+            // we've caught up to the gap
+            if( block_header::num_from_id( *last_id ) <= i )
+               break;
+            _block_id_to_block.remove( *last_id );
+            dropped_count++;
          }
-         blocks.pop();
-         i++;
+         wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
+         next_block_num = last_block_num + 1; // don't load more blocks
+         continue;
       }
+
+      if( slot.dupe_check )
+         skip &= ~skip_transaction_dupe_check;
+      const signed_block& block = slot.block;
+
+      if( i % 10000 == 0 )
+      {
+         std::stringstream bysize;
+         std::stringstream bynum;
+         size_t current_pos = slot.processed_block_size;
+         if( current_pos > total_block_size )
+            total_block_size = current_pos;
+         bysize << std::fixed << std::setprecision(5) << double(current_pos) / total_block_size * 100;
+         bynum << std::fixed << std::setprecision(5) << double(i)*100/last_block_num;
+         ilog(
+            "   [by size: ${size}%   ${processed} of ${total}]   [by num: ${num}%   ${i} of ${last}]",
+            ("size", bysize.str())
+            ("processed", current_pos)
+            ("total", total_block_size)
+            ("num", bynum.str())
+            ("i", i)
+            ("last", last_block_num)
+         );
+         stats.report( start, depth );
+      }
+      if( i == undo_point )
+      {
+         ilog( "Writing database to disk at block ${i}", ("i",i) );
+         flush();
+         ilog( "Done" );
+      }
+      const auto apply_start = fc::time_point::now();
+      if( i < undo_point )
+         apply_block( block, skip );
+      else
+      {
+         _undo_db.enable();
+         push_block( block, skip );
+      }
+      stats.apply_time += ( fc::time_point::now() - apply_start ).count();
+      ++stats.applied;
+      blocks.pop_front();
+      i++;
    }
    _undo_db.enable();
    auto end = fc::time_point::now();
+   stats.report( start, depth );
    ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
@@ -223,6 +341,14 @@ void database::open(
                     ("last_block->id", last_block)("head_block_id",head_block_num()) );
          reindex( data_dir );
       }
+      // Blocks pushed next must link to the head block also if nothing was replayed, e.g. right after restoring a
+      // snapshot, which leaves only the head block in the block log
+      if( !_fork_db.head() && head_block_num() > 0 )
+      {
+         auto head_block = _block_id_to_block.fetch_optional( head_block_id() );
+         if( head_block.valid() )
+            _fork_db.start_block( *head_block );
+      }
       _opened = true;
    }
    FC_CAPTURE_LOG_AND_RETHROW( (data_dir) )
@@ -232,7 +358,9 @@ void database::close(bool rewind)
 {
    if (!_opened)
       return;
-      
+
+   state_lock::write_guard guard( _state_lock );
+
    // TODO:  Save pending tx's on close()
    clear_pending();
 
@@ -626,7 +626,10 @@ void database::notify_changed_objects()
         for( const auto& item : head_undo.old_values )
         {
           changed_ids.push_back(item.first);
-          get_relevant_accounts(item.second.get(), changed_accounts_impacted, false);
+          // a packed old value is not an object, the current one references the same accounts
+          const object* obj = item.second.copy ? item.second.copy.get() : find_object(item.first);
+          if( obj != nullptr )
+             get_relevant_accounts(obj, changed_accounts_impacted, false);
         }
 
         if( changed_ids.size() )
@@ -33,6 +33,7 @@
 #include <graphene/chain/market_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 #include <graphene/chain/ticket_object.hpp>
+#include <graphene/chain/tnt/object.hpp>
 #include <graphene/chain/transaction_history_object.hpp>
 #include <graphene/chain/withdraw_permission_object.hpp>
 #include <graphene/chain/witness_object.hpp>
@@ -535,6 +536,17 @@ void database::clear_expired_htlcs()
    }
 }
 
+void database::process_tank_accessory_states()
+{
+   const auto& idx = get_index_type<tank_index>().indices().get<by_next_state_update>();
+   while( !idx.empty() && idx.begin()->next_state_update <= head_block_time() )
+   {
+      modify( *idx.begin(), [now=head_block_time()]( tank_object& tank ) {
+         tank.process_accessory_states( now );
+      });
+   }
+}
+
 generic_operation_result database::process_tickets()
 {
    generic_operation_result result;
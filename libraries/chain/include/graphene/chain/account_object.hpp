@@ -24,6 +24,7 @@
 #pragma once
 
 #include <graphene/chain/types.hpp>
+#include <graphene/db/flat_index.hpp>
 #include <graphene/db/generic_index.hpp>
 #include <graphene/protocol/account.hpp>
 
@@ -327,20 +328,34 @@ namespace graphene { namespace chain {
 
 
          /** given an account or key, map it to the set of accounts that reference it in an active or owner authority */
-         map< account_id_type, set<account_id_type> >                    account_to_account_memberships;
-         map< public_key_type, set<account_id_type>, pubkey_comparator > account_to_key_memberships;
+         map< account_id_type, flat_set<account_id_type> >                    account_to_account_memberships;
+         map< public_key_type, flat_set<account_id_type>, pubkey_comparator > account_to_key_memberships;
          /** some accounts use address authorities in the genesis block */
-         map< address, set<account_id_type> >                            account_to_address_memberships;
+         map< address, flat_set<account_id_type> >                            account_to_address_memberships;
 
 
       protected:
-         set<account_id_type>                    get_account_members( const account_object& a )const;
-         set<public_key_type, pubkey_comparator> get_key_members( const account_object& a )const;
-         set<address>                            get_address_members( const account_object& a )const;
-
-         set<account_id_type>                    before_account_members;
-         set<public_key_type, pubkey_comparator> before_key_members;
-         set<address>                            before_address_members;
+         /** The members of the authorities and the memo key of an account, each sorted and unique */
+         struct members_type
+         {
+            vector<account_id_type> accounts;
+            vector<public_key_type> keys;
+            vector<address>         addresses;
+         };
+
+         /** Fills @p members, reusing the memory of the vectors */
+         static void get_members( const authority& owner, const authority& active, const public_key_type& memo_key,
+                                  members_type& members );
+         static void get_members( const account_object& a, members_type& members );
+
+         /** The authorities and the memo key of the account being modified, as they were before */
+         authority       before_owner;
+         authority       before_active;
+         public_key_type before_memo_key;
+         /** Only collected if the authorities or the memo key changed */
+         members_type    before_members;
+         /** Used for the account being inserted, removed or modified, kept to reuse its memory */
+         members_type current_members;
    };
 
 
@@ -424,9 +439,8 @@ namespace graphene { namespace chain {
     * @ingroup object_index
     */
    typedef multi_index_container<
-      account_statistics_object,
+      const account_statistics_object*,
       indexed_by<
-         ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
          ordered_unique< tag<by_maintenance_seq>,
             composite_key<
                account_statistics_object,
@@ -439,8 +453,11 @@ namespace graphene { namespace chain {
 
    /**
     * @ingroup object_index
+    *
+    * Every account has exactly one statistics object and they are never removed, so they are stored flat.
+    * The multi index holds pointers to the objects.
     */
-   typedef generic_index<account_statistics_object, account_stats_multi_index_type> account_stats_index;
+   typedef flat_index<account_statistics_object, 10, account_stats_multi_index_type> account_stats_index;
 
 }}
 
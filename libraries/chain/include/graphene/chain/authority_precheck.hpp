@@ -0,0 +1,101 @@
+/*
+ * Copyright (c) 2020-2023 Revolution Populi Limited, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/protocol/transaction.hpp>
+
+namespace graphene { namespace chain {
+
+   /**
+    * @brief Results of checking the authorities of a batch of transactions ahead of applying them
+    *
+    * The checks are done in parallel against the state before any of the transactions is applied, see
+    * database::precheck_authorities(). Each result records the accounts whose owner or active authority was
+    * consulted. While the transactions are then applied one by one, applied() tracks which authorities they
+    * changed, and a passed check remains usable as long as none of its accounts was touched.
+    *
+    * Only passed checks are reused: a transaction which failed may become valid through the ones applied
+    * before it (e. g. when they create an account it refers to), so it is always verified again.
+    */
+   class authority_precheck
+   {
+      public:
+         struct result
+         {
+            bool                      passed = false;
+            flat_set<account_id_type> accounts;
+         };
+
+         explicit authority_precheck( size_t count = 0 ) : results( count ) {}
+
+         /// @return true if the check of transaction @p i passed and is still valid in the current state
+         bool still_valid( size_t i )const
+         {
+            if( i >= results.size() || !results[i].passed || _barrier )
+               return false;
+            for( const auto& account : results[i].accounts )
+               if( _changed.find( account ) != _changed.end() )
+                  return false;
+            return true;
+         }
+
+         /// Notes the authority changes of a transaction which was applied after the checks
+         void applied( const transaction& trx )
+         {
+            for( const auto& op : trx.operations )
+            {
+               switch( op.which() )
+               {
+                  case operation::tag<account_update_operation>::value:
+                     _changed.insert( op.get<account_update_operation>().account );
+                     break;
+                  // custom authorities are not consulted by the checks, but they change which signatures are
+                  // used and therefore may make others irrelevant
+                  case operation::tag<custom_authority_create_operation>::value:
+                     _changed.insert( op.get<custom_authority_create_operation>().account );
+                     break;
+                  case operation::tag<custom_authority_update_operation>::value:
+                     _changed.insert( op.get<custom_authority_update_operation>().account );
+                     break;
+                  case operation::tag<custom_authority_delete_operation>::value:
+                     _changed.insert( op.get<custom_authority_delete_operation>().account );
+                     break;
+                  // an approved proposal executes arbitrary operations
+                  case operation::tag<proposal_update_operation>::value:
+                     _barrier = true;
+                     break;
+                  default:
+                     break;
+               }
+            }
+         }
+
+         vector<result> results;
+
+      private:
+         flat_set<account_id_type> _changed;
+         bool                      _barrier = false;
+   };
+
+} } // graphene::chain
@@ -22,16 +22,96 @@
  * THE SOFTWARE.
  */
 #pragma once
-#include <fstream>
 #include <graphene/protocol/block.hpp>
 
 #include <fc/filesystem.hpp>
 
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
 namespace graphene { namespace chain {
    struct index_entry;
    using namespace graphene::protocol;
 
-   class block_database 
+   namespace detail {
+      /**
+       * @brief A file accessed only through positioned reads and writes
+       *
+       * Positioned I/O does not share a file offset between callers, so any number of threads may read
+       * concurrently (and concurrently with a single writer) without locking.
+       */
+      class random_access_file
+      {
+         public:
+            random_access_file() = default;
+            random_access_file( const random_access_file& ) = delete;
+            random_access_file& operator=( const random_access_file& ) = delete;
+            ~random_access_file();
+
+            void     open( const fc::path& p, bool truncate );
+            bool     is_open()const;
+            void     close();
+
+            uint64_t size()const;
+            /** @return the number of bytes actually read, which is less than len only at end of file */
+            size_t   read_at( uint64_t pos, char* data, size_t len )const;
+            void     write_at( uint64_t pos, const char* data, size_t len );
+            /** Blocks until all written data has reached the storage device */
+            void     sync();
+            void     truncate( uint64_t new_size );
+         private:
+#ifdef _WIN32
+            void*    _handle = nullptr;
+#else
+            int      _fd = -1;
+#endif
+      };
+   }
+
+   /// Packed signed_block exactly as stored in the block log, shared between all readers
+   typedef std::shared_ptr<const vector<char>> raw_block_ptr;
+
+   namespace detail {
+      /**
+       * @brief Least recently used packed blocks, keyed by block ID
+       *
+       * The contents of a block never change for a given ID. The block database still erases the blocks it no longer
+       * indexes, and checks its index before the cache.
+       */
+      class raw_block_cache
+      {
+         public:
+            void          set_capacity( size_t blocks );
+            raw_block_ptr get( const block_id_type& id );
+            void          put( const block_id_type& id, const raw_block_ptr& data );
+            void          erase( const block_id_type& id );
+            void          clear();
+         private:
+            typedef std::list< std::pair<block_id_type, raw_block_ptr> > lru_list;
+            struct id_hash { size_t operator()( const block_id_type& id )const { return id._hash[1].value(); } };
+
+            std::mutex                                                    _mutex;
+            size_t                                                        _capacity = 1000;
+            lru_list                                                      _entries; // most recent first
+            std::unordered_map<block_id_type, lru_list::iterator, id_hash> _by_id;
+      };
+   }
+
+   /**
+    * @brief Append-only on-disk log of blocks, indexed by block number
+    *
+    * All fetch methods are safe to call from any thread at any time, they only briefly lock the cache of
+    * recent blocks. Methods which modify the log must only be called from one thread at a time. Stored blocks
+    * are visible to readers immediately, but they are only guaranteed to be durable after the next sync point,
+    * i.e. a call to flush() or close(), or automatically every @ref set_sync_interval blocks.
+    *
+    * Recently stored blocks and blocks fetched raw are kept packed in a cache, see @ref set_cache_size. The raw
+    * fetch methods serve them without unpacking, e.g. to pass them on to peers as they are.
+    */
+   class block_database
    {
       public:
          void open( const fc::path& dbdir );
@@ -39,21 +119,51 @@ namespace graphene { namespace chain {
          void flush();
          void close();
 
+         /** Set the number of stored blocks after which the log is synced to disk, 0 to sync only on flush */
+         void set_sync_interval( uint32_t blocks ) { _sync_interval = blocks; }
+         /** Set the number of packed blocks kept in memory, 0 to disable the cache */
+         void set_cache_size( size_t blocks ) { _cache.set_capacity( blocks ); }
+
          void store( const block_id_type& id, const signed_block& b );
          void remove( const block_id_type& id );
 
          bool                   contains( const block_id_type& id )const;
          block_id_type          fetch_block_id( uint32_t block_num )const;
+         /** @return the ID stored for block_num, empty if there is none, e.g. before a restored snapshot */
+         optional<block_id_type> find_block_id( uint32_t block_num )const;
          optional<signed_block> fetch_optional( const block_id_type& id )const;
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
+         /** @return the packed block, or an empty pointer if it is not stored */
+         raw_block_ptr          fetch_raw( const block_id_type& id )const;
+         raw_block_ptr          fetch_raw_by_number( uint32_t block_num )const;
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
          size_t                 blocks_current_position()const;
          size_t                 total_block_size()const;
       private:
+         bool read_index_entry( uint32_t block_num, index_entry& e )const;
+         optional<signed_block> read_block( const index_entry& e )const;
+         /// Reads the block data of an entry from the cache or the log, @p cache_it decides whether a block read
+         /// from the log is added to the cache. A block read from the log is checked against its ID and merkle root,
+         /// and moved to @p block if that is given.
+         raw_block_ptr read_raw( const index_entry& e, bool cache_it, optional<signed_block>* block = nullptr )const;
          optional<index_entry> last_index_entry()const;
+
          fc::path _index_filename;
-         mutable std::fstream _blocks;
-         mutable std::fstream _block_num_to_pos;
+         mutable detail::random_access_file _blocks;
+         mutable detail::random_access_file _block_num_to_pos;
+
+         /// Logical sizes of the two files, published after the data they cover has been written
+         std::atomic<uint64_t>         _blocks_size{0};
+         mutable std::atomic<uint64_t> _index_size{0};
+         /// End position of the most recently read block, for progress reporting
+         mutable std::atomic<uint64_t> _blocks_read_pos{0};
+
+         /// Serializes writers only, readers never take it
+         mutable std::mutex _write_mutex;
+         uint32_t           _sync_interval = 0;
+         uint32_t           _unsynced_blocks = 0;
+
+         mutable detail::raw_block_cache _cache;
    };
 } }
@@ -35,14 +35,19 @@
 #include <graphene/chain/block_database.hpp>
 #include <graphene/chain/genesis_state.hpp>
 #include <graphene/chain/evaluator.hpp>
+#include <graphene/chain/authority_precheck.hpp>
+#include <graphene/chain/state_lock.hpp>
 
 #include <graphene/db/object_database.hpp>
 #include <graphene/db/object.hpp>
+#include <graphene/db/flat_index.hpp>
 #include <graphene/db/simple_index.hpp>
 #include <fc/signals.hpp>
 
 #include <fc/log/logger.hpp>
+#include <fc/thread/thread.hpp>
 
+#include <atomic>
 #include <map>
 
 namespace graphene { namespace protocol { struct predicate_result; } }
@@ -64,6 +69,21 @@ namespace graphene { namespace chain {
    struct budget_record;
    enum class vesting_balance_type;
 
+   /// Votes summed up in chain maintenance, see @ref database::votes_tallied
+   struct vote_tally_buffers
+   {
+      /// Votes by vote_id_type::instance()
+      vector<uint64_t>                  vote_tally;
+      /// Votes of committee members by worker vote_id_type::instance(); flat_map saves memory, but vector is faster
+      vector<uint64_t>                  cm_vote_for_worker;
+      /// Committee members voting for workers, by worker vote_id_type::instance()
+      vector<vector<account_id_type>>   cm_support_worker;
+      vector<uint64_t>                  witness_count_histogram;
+      vector<uint64_t>                  committee_count_histogram;
+      /// 0=committee, 1=witness, as in vote_id_type::vote_type
+      uint64_t                          total_voting_stake[2] = { 0, 0 };
+   };
+
    /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -136,8 +156,13 @@ namespace graphene { namespace chain {
          bool                       is_known_block( const block_id_type& id )const;
          bool                       is_known_transaction( const transaction_id_type& id )const;
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
+         /// Same as the above, but empty if no block is stored for block_num, e.g. before a restored snapshot
+         optional<block_id_type>    find_block_id_for_num( uint32_t block_num )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
+         /// Same as the above, but the block stays packed, as it is stored. Empty if the block is not known.
+         raw_block_ptr              fetch_raw_block_by_id( const block_id_type& id )const;
+         raw_block_ptr              fetch_raw_block_by_number( uint32_t num )const;
          const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
@@ -222,6 +247,12 @@ namespace graphene { namespace chain {
           */
          fc::signal<void(const vector<object_id_type>&, const vector<const object*>&, const flat_set<account_id_type>&)>  removed_objects;
 
+         /**
+          *  Emitted in chain maintenance once the votes are tallied, before they are applied to witnesses,
+          *  committee members and workers. The callback must not yield.
+          */
+         fc::signal<void(const vote_tally_buffers&)>     votes_tallied;
+
          //////////////////// db_witness_schedule.cpp ////////////////////
 
          /**
@@ -525,6 +556,46 @@ namespace graphene { namespace chain {
          /// Enable or disable tracking of votes of standby witnesses and committee members
          inline void enable_standby_votes_tracking(bool enable)  { _track_standby_votes = enable; }
 
+         /// Set the minimum number of voters tallied by each thread in chain maintenance; the votes of fewer voters
+         /// are tallied on the calling thread
+         inline void set_vote_tally_chunk_size(size_t voters)  { _vote_tally_chunk_size = voters; }
+
+         /// Set the number of blocks loaded and precomputed ahead of the one being applied during a replay,
+         /// 0 to derive it from the number of threads
+         inline void set_reindex_pipeline_depth(uint32_t depth)  { _reindex_pipeline_depth = depth; }
+
+         /// Keep the old values of modified objects packed in the undo history instead of as full copies
+         inline void enable_packed_undo_values(bool enable)  { _undo_db.set_packed_values( enable ); }
+
+         /// Set the number of recent blocks kept packed in memory for serving them to peers and API clients
+         inline void set_block_cache_size(size_t blocks)  { _block_id_to_block.set_cache_size( blocks ); }
+
+         /// Set the number of stored blocks after which the block log is synced to disk, 0 to sync only on close
+         inline void set_block_sync_interval(uint32_t blocks)  { _block_id_to_block.set_sync_interval( blocks ); }
+
+         /// Set the number of threads reserved for @ref read_view, 0 to run readers on the calling thread
+         void set_reader_threads( uint16_t count );
+
+         /**
+          * Runs reader against the chain state, on one of the reader threads if there are any. The state does not
+          * change while reader runs, and the calling fiber yields until the result is there, so the chain thread
+          * keeps applying blocks meanwhile. Readers must not change the state.
+          */
+         template<typename Reader>
+         auto read_view( Reader&& reader )const -> decltype( reader() )
+         {
+            if( _reader_threads.empty() )
+               return reader();
+            fc::thread& worker = *_reader_threads[ _next_reader_thread++ % _reader_threads.size() ];
+            return worker.async( [this,&reader] () {
+               state_lock::read_guard guard( _state_lock );
+               return reader();
+            }, "read_view" ).wait();
+         }
+
+         /// Held for writing while the chain state changes
+         state_lock& get_state_lock()const { return _state_lock; }
+
          /** Precomputes digests, signatures and operation validations depending
           *  on skip flags. "Expensive" computations may be done in a parallel
           *  thread.
@@ -544,9 +615,29 @@ namespace graphene { namespace chain {
           *         precomputations applied
           */
          fc::future<void> precompute_parallel( const precomputable_transaction& trx )const;
+
+         /** Does the same precomputations as @ref precompute_parallel, but all of them in the calling
+          *  thread. Useful for callers which already process several blocks in parallel.
+          *
+          * @param block the block to preprocess
+          * @param skip indicates which computations can be skipped
+          */
+         void precompute_sequential( const signed_block& block, const uint32_t skip = skip_nothing )const;
+
+         /** Checks the signatures and authorities of the given transactions against the current state, in
+          *  parallel. The calling thread blocks until all checks are done, the state must not change meanwhile.
+          *
+          *  Transactions depending on custom authorities are left to the regular verification.
+          *
+          * @param trxs the transactions to check, usually the pending ones about to be applied again
+          * @return the results, to be consulted while applying @p trxs in order
+          */
+         authority_precheck precheck_authorities( const vector<processed_transaction>& trxs )const;
    private:
          template<typename Trx>
          void _precompute_parallel( const Trx* trx, const size_t count, const uint32_t skip )const;
+         void _precheck_authorities( const processed_transaction* trx, authority_precheck::result* res,
+                                     const size_t count )const;
 
    protected:
          //Mark pop_undo() as protected -- we do not want outside calling pop_undo(); it should call pop_block() instead
@@ -605,6 +696,7 @@ namespace graphene { namespace chain {
          bool check_for_blackswan( const asset_object& mia, bool enable_black_swan = true,
                                    const asset_bitasset_data_object* bitasset_ptr = nullptr );
          void clear_expired_htlcs();
+         void process_tank_accessory_states();
 
          ///Steps performed only at maintenance intervals
          ///@{
@@ -623,7 +715,7 @@ namespace graphene { namespace chain {
          void process_bitassets();
 
          template<class Type>
-         void perform_account_maintenance( Type tally_helper );
+         void perform_account_maintenance( Type& tally_helper );
          ///@}
          ///@}
 
@@ -654,13 +746,8 @@ namespace graphene { namespace chain {
          uint16_t                          _current_op_in_trx    = 0;
          uint32_t                          _current_virtual_op   = 0;
 
-         vector<uint64_t>                  _vote_tally_buffer;
-         vector<uint64_t>                  _cm_vote_for_worker_buffer; // flat_map saves memory, but vector is still faster
-         vector<vector<account_id_type>>   _cm_support_worker_buffer;
-         vector<uint64_t>                  _witness_count_histogram_buffer;
-         vector<uint64_t>                  _committee_count_histogram_buffer;
-         uint64_t                          _total_voting_stake[2]; // 0=committee, 1=witness,
-                                                                   // as in vote_id_type::vote_type
+         vote_tally_buffers                _vote_tally;
+         size_t                            _vote_tally_chunk_size = 1000;
 
          flat_map<uint32_t,block_id_type>  _checkpoints;
 
@@ -670,6 +757,14 @@ namespace graphene { namespace chain {
          /// Set it to true to provide accurate data to API clients, set to false to have better performance.
          bool                              _track_standby_votes = true;
 
+         /// Number of blocks in flight in the replay pipeline, 0 for automatic
+         uint32_t                          _reindex_pipeline_depth = 0;
+
+         mutable state_lock                _state_lock;
+         /// Threads running read_view() calls, stopped first on destruction
+         vector< std::unique_ptr<fc::thread> > _reader_threads;
+         mutable std::atomic<uint32_t>     _next_reader_thread{ 0 };
+
          /**
           * Whether database is successfully opened or not.
           *
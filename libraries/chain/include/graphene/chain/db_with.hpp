@@ -76,22 +76,45 @@ struct pending_transactions_restorer
 
    ~pending_transactions_restorer()
    {
+      // Check the authorities of the pending transactions in parallel against the new head state before
+      // anything is pushed, the popped transactions go first and may invalidate some of the checks
+      const uint32_t skip = _db.get_node_properties().skip_flags;
+      authority_precheck checks;
+      if( !(skip & database::skip_transaction_signatures) && _pending_transactions.size() > 1 )
+      {
+         try {
+            checks = _db.precheck_authorities( _pending_transactions );
+         } catch ( const fc::exception& ) { // verify all of them when pushing
+         }
+      }
+
       for( const auto& tx : _db._popped_tx )
       {
          try {
             if( !_db.is_known_transaction( tx.id() ) ) {
                _db._push_transaction( tx );
+               checks.applied( tx );
             }
          } catch ( const fc::exception& ) { // ignore invalid transactions
          }
       }
       _db._popped_tx.clear();
+      size_t tx_index = 0;
       for( const processed_transaction& tx : _pending_transactions )
       {
+         const bool verified = checks.still_valid( tx_index++ );
          try
          {
             if( !_db.is_known_transaction( tx.id() ) ) {
-               _db._push_transaction( tx );
+               if( verified )
+               {
+                  skip_flags_restorer restorer( _db.node_properties(), skip );
+                  _db.node_properties().skip_flags = skip | database::skip_transaction_signatures;
+                  _db._push_transaction( tx );
+               }
+               else
+                  _db._push_transaction( tx );
+               checks.applied( tx );
             }
          }
          catch( const fc::exception& )
@@ -0,0 +1,111 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/protocol/block.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <string>
+#include <vector>
+
+namespace graphene { namespace chain {
+   class database;
+   using namespace graphene::protocol;
+
+   /// Describes one chunk of a binary snapshot, which holds one index in checkpoint format
+   struct snapshot_chunk_info
+   {
+      uint8_t      space_id = 0;
+      uint8_t      type_id = 0;
+      std::string  file;
+      uint64_t     size = 0; ///< uncompressed size
+   };
+
+   /// Describes a binary snapshot, it is written last so that a snapshot without it is known to be incomplete
+   struct snapshot_manifest
+   {
+      uint32_t                          format_version = 0;
+      std::string                       db_version;
+      chain_id_type                     chain_id;
+      uint32_t                          head_block_num = 0;
+      block_id_type                     head_block_id;
+      fc::time_point_sec                head_block_time;
+      std::vector<snapshot_chunk_info>  chunks;
+   };
+
+   /**
+    * @brief A binary, chunked and compressed copy of the complete object database
+    *
+    * A snapshot is a directory with one zlib-compressed chunk per index, the head block and a manifest. Each
+    * chunk holds the index in the same format as the object database checkpoints, so restoring a snapshot
+    * only decompresses the chunks into place and the database loads them on open.
+    *
+    * Capturing a snapshot serializes the indexes into memory in parallel, which is fast enough to do on the
+    * thread applying blocks. Compressing and writing the chunks, the expensive part, can then be done from any
+    * thread while the chain moves on.
+    */
+   class binary_snapshot
+   {
+      public:
+         static const uint32_t current_format_version = 1;
+
+         /**
+          * Serializes every index of db. Must be called when head_block has just been applied, and while db
+          * is not being modified.
+          */
+         static binary_snapshot capture( const database& db, const signed_block& head_block );
+
+         /** Writes the snapshot into directory dest, compressing the chunks in parallel */
+         void write( const fc::path& dest )const;
+
+         /**
+          * Reads the manifest of the snapshot in directory src, and checks that the snapshot is complete, can be
+          * restored by this node and belongs to the chain identified by chain_id.
+          */
+         static snapshot_manifest read_manifest( const fc::path& src, const chain_id_type& chain_id );
+
+         /**
+          * Restores the snapshot in directory src into the data directory of a chain database which is not open
+          * and has no blocks. A subsequent database::open() on data_dir continues from the snapshot's head block.
+          * The snapshot must belong to the chain identified by chain_id.
+          *
+          * Only the head block is put into the block log. The restored node syncs on from it, but can not serve
+          * older blocks to peers, see database::find_block_id_for_num().
+          */
+         static snapshot_manifest restore( const fc::path& src, const fc::path& data_dir,
+                                           const chain_id_type& chain_id );
+
+         const snapshot_manifest& manifest()const { return _manifest; }
+
+      private:
+         snapshot_manifest          _manifest;
+         signed_block               _head_block;
+         std::vector<std::string>   _chunks;
+   };
+
+} }
+
+FC_REFLECT( graphene::chain::snapshot_chunk_info, (space_id)(type_id)(file)(size) )
+FC_REFLECT( graphene::chain::snapshot_manifest,
+            (format_version)(db_version)(chain_id)(head_block_num)(head_block_id)(head_block_time)(chunks) )
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2020-2023 Revolution Populi Limited, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace graphene { namespace chain {
+
+   /**
+    * @brief Separates changes of the chain state from readers running on other threads
+    *
+    * Every public entry point which changes the state (pushing and popping blocks and transactions, generating
+    * blocks) holds the write side for its whole duration, so readers on other threads only ever see the state
+    * between two such changes. Readers do not exclude each other.
+    *
+    * Writers are preferred: once a writer waits, new readers wait behind it, so a steady stream of readers can not
+    * hold off block application. A writer waits at most for the readers already inside, i. e. for the longest single
+    * read section, which is one API query bounded by the API limits.
+    *
+    * The write side is reentrant on the writing thread, and reads on the writing thread do not lock at all:
+    * fibers of the chain thread are already serialized with its writes by cooperative scheduling, as before.
+    */
+   class state_lock
+   {
+      public:
+         void lock_write()
+         {
+            const std::thread::id self = std::this_thread::get_id();
+            if( _writer.load() == self )
+            {
+               ++_write_depth;
+               return;
+            }
+            std::unique_lock<std::mutex> lock( _mutex );
+            ++_waiting_writers;
+            _writer_turn.wait( lock, [this] { return !_writing && _readers == 0; } );
+            --_waiting_writers;
+            _writing = true;
+            _writer.store( self );
+            _write_depth = 1;
+         }
+
+         void unlock_write()
+         {
+            if( --_write_depth > 0 )
+               return;
+            ++_version;
+            _writer.store( std::thread::id() );
+            {
+               std::lock_guard<std::mutex> lock( _mutex );
+               _writing = false;
+            }
+            _writer_turn.notify_one();
+            _readers_turn.notify_all();
+         }
+
+         /// @return false if nothing was locked because the calling thread is the writer
+         bool lock_read()
+         {
+            if( _writer.load() == std::this_thread::get_id() )
+               return false;
+            std::unique_lock<std::mutex> lock( _mutex );
+            _readers_turn.wait( lock, [this] { return !_writing && _waiting_writers == 0; } );
+            ++_readers;
+            return true;
+         }
+
+         void unlock_read()
+         {
+            bool last;
+            {
+               std::lock_guard<std::mutex> lock( _mutex );
+               last = ( --_readers == 0 );
+            }
+            if( last )
+               _writer_turn.notify_one();
+         }
+
+         /// Number of completed write sections, i. e. an identifier of the state a reader sees
+         uint64_t version()const { return _version.load(); }
+
+         class write_guard
+         {
+            public:
+               explicit write_guard( state_lock& l ):_lock(l) { _lock.lock_write(); }
+               ~write_guard() { _lock.unlock_write(); }
+               write_guard( const write_guard& ) = delete;
+               write_guard& operator=( const write_guard& ) = delete;
+            private:
+               state_lock& _lock;
+         };
+
+         class read_guard
+         {
+            public:
+               explicit read_guard( state_lock& l ):_lock(l),_locked(l.lock_read()) {}
+               ~read_guard() { if( _locked ) _lock.unlock_read(); }
+               read_guard( const read_guard& ) = delete;
+               read_guard& operator=( const read_guard& ) = delete;
+            private:
+               state_lock& _lock;
+               const bool  _locked;
+         };
+
+      private:
+         std::mutex                     _mutex;
+         std::condition_variable        _writer_turn;
+         std::condition_variable        _readers_turn;
+         uint32_t                       _readers = 0;
+         uint32_t                       _waiting_writers = 0;
+         bool                           _writing = false;
+         std::atomic<std::thread::id>   _writer{ std::thread::id() };
+         uint32_t                       _write_depth = 0;
+         std::atomic<uint64_t>          _version{ 0 };
+   };
+
+} } // graphene::chain
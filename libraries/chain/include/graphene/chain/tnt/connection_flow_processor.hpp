@@ -38,6 +38,21 @@ using TapOpenCallback = std::function<void(ptnt::tap_id_type, ptnt::asset_flow_l
 /// Account will have already been checked for authorization to hold the asset when the callback is invoked.
 using FundAccountCallback = std::function<void(account_id_type, asset, vector<ptnt::connection>)>;
 
+/// A connection flow which was resolved and checked once, and can then be released into any number of times
+struct resolved_connection_flow {
+   /// Terminal connection describing the source the asset flows from
+   ptnt::connection origin;
+   /// The type of the asset flowing
+   asset_id_type asset_type;
+   /// The connections the asset flows through, beginning with the connection released into and ending with the
+   /// terminal connection. Tank attachments in the path have their tank IDs set.
+   vector<ptnt::connection> path;
+   /// The path reported to the caller; the same as path since HARDFORK_TNT_FLOW_FIX_TIME
+   vector<ptnt::connection> reported_path;
+   /// The path given to the FundAccountCallback, including the origin
+   vector<ptnt::connection> deposit_path;
+};
+
 /**
  * @brief Processes release of asset into a connection, including the movement of asset along the connection chain
  * and deposit into a terminal connection
@@ -60,7 +75,8 @@ public:
     * @param origin Terminal connection describing the source the asset is flowing from
     * @param connection The connection to release asset into
     * @param amount The amount to release into the connection
-    * @return The full path of connections the asset flowed through, beginning with the connection argument
+    * @return The full path of connections the asset flowed through, beginning with the connection argument (see
+    * @ref resolved_connection_flow::reported_path)
     *
     * Release asset into the provided connection and process its flow through any intermediate connections to the
     * terminal connection, performing any processing and state updates required by intermediate connections or the
@@ -68,8 +84,29 @@ public:
     *
     * This includes handling all asset flows through tank attachments, as well as deposit into tanks and accounts,
     * with relevant deposit source and asset ownership checks applied.
+    *
+    * This is the same as @ref resolve_connection followed by @ref release_to_resolved_connection.
     */
    vector<ptnt::connection> release_to_connection(ptnt::connection origin, ptnt::connection connection, asset amount);
+
+   /**
+    * @brief Follow the path of asset released into a connection, checking that the asset can flow along it
+    * @param origin Terminal connection describing the source the asset is flowing from
+    * @param connection The connection to release asset into
+    * @param asset_type The type of asset to release
+    * @return The resolved flow, which can be released into repeatedly as long as the schematics along the path do
+    * not change
+    *
+    * This applies all deposit source and asset ownership checks, but does not change any state.
+    */
+   resolved_connection_flow resolve_connection(ptnt::connection origin, ptnt::connection connection,
+                                               asset_id_type asset_type);
+   /**
+    * @brief Release asset into a resolved connection, performing the state updates along its path
+    * @param flow The flow to release into, as returned by @ref resolve_connection
+    * @param amount The amount to release
+    */
+   void release_to_resolved_connection(const resolved_connection_flow& flow, share_type amount);
 };
 
 } } } // namespace graphene::chain::tnt
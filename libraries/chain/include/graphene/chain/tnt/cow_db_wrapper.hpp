@@ -31,19 +31,46 @@ namespace impl {
 template<typename...> using make_void = void;
 namespace TL = fc::typelist;
 
+/// A copy of a top-level field of an object, which was written through a copy-on-write reflection
+struct cow_written_field {
+   /// The copy of the field's value
+   std::shared_ptr<void> value;
+   /// Moves the value into the field of the supplied object
+   void (*store)(object& dest, void* value);
+   /// Copies the value into the field of the supplied object
+   void (*copy)(object& dest, const void* value);
+};
+
 struct cow_refletion_data {
    const database& db;
    object_id_type object_id;
+   /// The object in the database
+   const object* original;
+   /// A copy of the whole object, made only if the object itself is accessed mutably
    std::unique_ptr<object> written;
+   /// Copies of the top-level fields which were written, keyed by the address of the field in the original object
+   flat_map<const void*, cow_written_field> written_fields;
+   /// A copy of the whole object with the written fields copied into it, made only if the whole object is read
+   /// after fields were written
+   std::unique_ptr<object> view;
    std::function<void(cow_refletion_data&, database&)> update;
 
    template<typename T>
    static cow_refletion_data create(const database& db, object_id_type object_id) {
-      cow_refletion_data data(db, object_id);
+      cow_refletion_data data(db, object_id, db.get<T>(object_id));
       data.update = [](cow_refletion_data& data, database& mutable_db) {
-         if (data.written == nullptr)
+         if (!data.has_writes())
             return;
          const T& dest = mutable_db.get<T>(data.object_id);
+         if (data.written == nullptr) {
+            mutable_db.modify(dest, [&data](T& dest) {
+               for (auto& field : data.written_fields)
+                  field.second.store(dest, field.second.value.get());
+            });
+            data.written_fields.clear();
+            data.view.reset();
+            return;
+         }
          T* src = dynamic_cast<T*>(data.written.get());
          FC_ASSERT(src != nullptr, "LOGIC ERROR: Tried to update object with incorrect source type. "
                                    "Please report this error.");
@@ -52,6 +79,11 @@ struct cow_refletion_data {
       };
       return data;
    }
+
+   bool has_writes() const { return written != nullptr || !written_fields.empty(); }
+
+   template<typename T>
+   const T& get_original() const { return static_cast<const T&>(*original); }
    template<typename T>
    T& get_written() {
       FC_ASSERT(written, "LOGIC ERROR: Tried to fetch written object when none exists. Please report this error.");
@@ -60,9 +92,67 @@ struct cow_refletion_data {
                                 "Please report this error.");
       return *ptr;
    }
+   /// Get the whole object mutably, copying it and moving the written fields into the copy if necessary. This
+   /// invalidates references to written fields.
+   template<typename T>
+   T& write_object() {
+      if (!written) {
+         written = view? std::move(view) : original->clone();
+         for (auto& field : written_fields)
+            field.second.store(*written, field.second.value.get());
+         written_fields.clear();
+      }
+      return get_written<T>();
+   }
+   /// Get the whole object for reading. If only fields were written, this copies them into a copy of the object, which
+   /// shows the writes made so far; references to written fields stay valid.
+   template<typename T>
+   const T& view_object() {
+      if (written)
+         return get_written<T>();
+      if (written_fields.empty())
+         return get_original<T>();
+      if (!view)
+         view = original->clone();
+      for (const auto& field : written_fields)
+         field.second.copy(*view, field.second.value.get());
+      const T* ptr = dynamic_cast<const T*>(&*view);
+      FC_ASSERT(ptr != nullptr, "LOGIC ERROR: Tried to fetch object view with incorrect type. "
+                                "Please report this error.");
+      return *ptr;
+   }
+
+   /// Get the written copy of a top-level field, or null if it was not written
+   template<typename Reflector, typename Field = typename Reflector::type>
+   Field* find_written_field() const {
+      auto itr = written_fields.find(&Reflector::get(get_original<typename Reflector::container>()));
+      if (itr == written_fields.end())
+         return nullptr;
+      return static_cast<Field*>(itr->second.value.get());
+   }
+   /// Get the written copy of a top-level field, copying the field from the original object if necessary
+   template<typename Reflector, typename Field = typename Reflector::type>
+   Field& write_field() {
+      using Container = typename Reflector::container;
+      const Field& original_field = Reflector::get(get_original<Container>());
+      auto itr = written_fields.find(&original_field);
+      if (itr == written_fields.end()) {
+         cow_written_field field;
+         field.value = std::make_shared<Field>(original_field);
+         field.store = [](object& dest, void* value) {
+            Reflector::get(static_cast<Container&>(dest)) = std::move(*static_cast<Field*>(value));
+         };
+         field.copy = [](object& dest, const void* value) {
+            Reflector::get(static_cast<Container&>(dest)) = *static_cast<const Field*>(value);
+         };
+         itr = written_fields.emplace(&original_field, std::move(field)).first;
+      }
+      return *static_cast<Field*>(itr->second.value.get());
+   }
 
 private:
-   cow_refletion_data(const database& db, object_id_type object_id) : db(db), object_id(object_id) {}
+   cow_refletion_data(const database& db, object_id_type object_id, const object& original)
+      : db(db), object_id(object_id), original(&original) {}
 };
 struct cow_data_lt {
    using is_transparent=void;
@@ -73,23 +163,14 @@ struct cow_data_lt {
    bool operator()(const object_id_type& a, const cow_refletion_data& b) const { return a < b.object_id; }
 };
 
-// Flatten a list of reflectors into a single getter
-// Base case: list of 1; return its getter
-template<typename Reflectors, typename Root = typename TL::first<Reflectors>::container,
-         typename Field = typename TL::last<Reflectors>::type,
-         std::enable_if_t<TL::length<Reflectors>() == 1, bool> = true>
-auto make_getter() {
-   return [](Root& o) -> Field& { return TL::first<Reflectors>::get(o); };
-}
-// Recursive case: compute the getter for the list except the first reflector, and wrap it in the getter from the
-// first reflector
-template<typename Reflectors, typename Root = typename TL::first<Reflectors>::container,
-         typename Field = typename TL::last<Reflectors>::type,
-         std::enable_if_t<TL::length<Reflectors>() != 1, bool> = true>
-auto make_getter() {
-   return [inner = make_getter<TL::slice<Reflectors, 1>>()](Root& root) -> Field& {
-      return inner(TL::first<Reflectors>::get(root));
-   };
+// Follow a list of reflectors from a container to the field they reflect
+// Base case: empty list; the container is the field
+template<typename Reflectors, typename Container, std::enable_if_t<TL::length<Reflectors>() == 0, bool> = true>
+Container& follow_reflectors(Container& c) { return c; }
+// Recursive case: get the field of the first reflector, and follow the rest of the list from there
+template<typename Reflectors, typename Container, std::enable_if_t<TL::length<Reflectors>() != 0, bool> = true>
+decltype(auto) follow_reflectors(Container& c) {
+   return follow_reflectors<TL::slice<Reflectors, 1>>(TL::first<Reflectors>::get(c));
 }
 
 template<typename Reflectors, typename Data, bool is_const>
@@ -97,6 +178,10 @@ struct cow_field_reflection {
    static_assert(std::is_same<Data, cow_refletion_data>::value, "Unexpected type for reflection data");
    static_assert(is_const, "COW reflections are for const types only");
    using RootObject = typename TL::first<Reflectors>::container;
+   /// Reflector of the top-level field of the object which contains this field; this is what gets copied on write
+   using TopReflector = TL::first<Reflectors>;
+   /// Reflectors from the top-level field to this field
+   using FieldPath = TL::slice<Reflectors, 1>;
    using Field = typename TL::last<Reflectors>::type;
    const Field& field;
    cow_refletion_data* data;
@@ -105,23 +190,21 @@ struct cow_field_reflection {
    template<typename T>
    using cow_object = fc::object_reflection<const T, cow_refletion_data, cow_field_reflection, Reflectors>;
 
-   std::function<Field&(RootObject&)> make_getter() const {
-      static std::function<Field&(RootObject&)> cache;
-      if (cache) return cache;
-      return cache = impl::make_getter<Reflectors>();
-   }
-
    /// Get a const reference to the field
    const Field& get() const {
+      if (!data->has_writes())
+         return field;
       if (data->written)
-         return make_getter()(data->get_written<RootObject>());
+         return follow_reflectors<Reflectors>(data->get_written<RootObject>());
+      if (auto* top = data->find_written_field<TopReflector>())
+         return follow_reflectors<FieldPath>(*top);
       return field;
    }
-   /// Get a mutable reference to the field (triggers a copy)
+   /// Get a mutable reference to the field (triggers a copy of the top-level field containing it)
    Field& set() {
-      if (!data->written)
-         data->written = data->db.get_object(data->object_id).clone();
-      return make_getter()(data->get_written<RootObject>());
+      if (data->written)
+         return follow_reflectors<Reflectors>(data->get_written<RootObject>());
+      return follow_reflectors<FieldPath>(data->write_field<TopReflector>());
    }
 
    /// Function call operator, returns a Field (for types without reflections only)
@@ -152,16 +235,11 @@ struct cow_object : fc::object_reflection<const T, impl::cow_refletion_data, imp
    cow_object(const T& ref, impl::cow_refletion_data* data)
       : fc::object_reflection<const T, impl::cow_refletion_data, impl::cow_field_reflection>(ref, data) {}
 
-   operator T&() {
-      if (!this->_data_->written)
-         this->_data_->written = this->_data_->db.get_object(this->_data_->object_id).clone();
-      return this->_data_->template get_written<T>();
-   }
-   operator const T&() const {
-      if (!this->_data_->written)
-         return this->_data_->template get_written<T>();
-      return this->_ref_;
-   }
+   /// Mutable access to the whole object (triggers a copy of the whole object)
+   operator T&() { return this->_data_->template write_object<T>(); }
+   /// Const access to the whole object (triggers a copy of the whole object if any of its fields were written, but
+   /// does not invalidate references to the written fields)
+   operator const T&() const { return this->_data_->template view_object<T>(); }
 };
 
 /**
@@ -174,7 +252,10 @@ struct cow_object : fc::object_reflection<const T, impl::cow_refletion_data, imp
  * outside the xyz_object.cpp files.
  *
  * The copy-on-write database wrapper returns @ref fc::object_reflection types using @ref cow_field_reflection for
- * field reflections. Client code can interact with these objects in the following ways:
+ * field reflections. Copies are made per top-level field: writing a field of an object copies only the top-level
+ * field containing it, and reading a field which was not written reads the object in the database directly. Only
+ * mutable access to the whole object copies the whole object. Client code can interact with these objects in the
+ * following ways:
  *
  * \code{.cpp}
  * cow_db_wrapper wrapper(db);
@@ -197,15 +278,27 @@ struct cow_object : fc::object_reflection<const T, impl::cow_refletion_data, imp
  * // If the field provides a subscript operator, this can also be used, but this always triggers a copy
  * my_object.map_field["key"] = value;
  *
+ * // Access to the whole object (a mutable reference copies the whole object, so prefer field access; convert a
+ * // const cow object for const access, which keeps references to written fields valid)
+ * const auto& const_object = my_object;
+ * const my_object_type& whole_object = const_object;
+ *
  * // To write all changes to the database, call @ref commit
  * wrapper.commit(mutable_db);
  * \endcode
  */
 class cow_db_wrapper {
    const database& db;
-   mutable std::map<object_id_type, object*> db_cache;
    mutable std::set<impl::cow_refletion_data, impl::cow_data_lt> pensive_cattle;
 
+   template<typename T>
+   impl::cow_refletion_data& get_data(object_id_type id) const {
+      auto itr = pensive_cattle.find(id);
+      if (itr == pensive_cattle.end())
+         itr = pensive_cattle.insert(impl::cow_refletion_data::create<T>(db, id)).first;
+      return const_cast<impl::cow_refletion_data&>(*itr);
+   }
+
 public:
    cow_db_wrapper(const database& wrapped_db) : db(wrapped_db) {}
 
@@ -213,28 +306,18 @@ public:
 
    template<typename T>
    cow_object<T> get(object_id_type id) const {
-      decltype(pensive_cattle)::iterator itr = pensive_cattle.find(id);
-      if (itr == pensive_cattle.end())
-         itr = pensive_cattle.insert(impl::cow_refletion_data::create<T>(db, id)).first;
-      auto cache_itr = db_cache.lower_bound(id);
-      if (cache_itr == db_cache.end() || cache_itr->first != id)
-         cache_itr = db_cache.insert(cache_itr, std::make_pair(id, (object*)&db.get<T>(id)));
-      const T* ptr = dynamic_cast<const T*>(cache_itr->second);
+      auto& data = get_data<T>(id);
+      const T* ptr = dynamic_cast<const T*>(data.original);
       FC_ASSERT(ptr != nullptr, "INTERNAL ERROR: Failed to downcast object. Please report this error.");
-      return cow_object<T>(*ptr, const_cast<impl::cow_refletion_data*>(&*itr));
+      return cow_object<T>(*ptr, &data);
    }
    template<uint8_t SpaceID, uint8_t TypeID>
    auto get(object_id<SpaceID, TypeID> id) const {
       using Object = object_downcast_t<decltype(id)>;
-      auto itr = pensive_cattle.find(id);
-      if (itr == pensive_cattle.end())
-         itr = pensive_cattle.insert(impl::cow_refletion_data::create<Object>(db, id)).first;
-      auto cache_itr = db_cache.lower_bound(id);
-      if (cache_itr == db_cache.end() || cache_itr->first != id)
-         cache_itr = db_cache.insert(cache_itr, std::make_pair(object_id_type(id), (object*)&db.get(id)));
-      const Object* ptr = dynamic_cast<const Object*>(cache_itr->second);
+      auto& data = get_data<Object>(id);
+      const Object* ptr = dynamic_cast<const Object*>(data.original);
       FC_ASSERT(ptr != nullptr, "INTERNAL ERROR: Failed to downcast object. Please report this error.");
-      return cow_object<Object>(*ptr, const_cast<impl::cow_refletion_data*>(&*itr));
+      return cow_object<Object>(*ptr, &data);
    }
 
    /// Write all changes to the database
@@ -243,7 +326,7 @@ public:
       for (auto& const_cow : pensive_cattle) {
          // I do not understand why cow is const... compiler bug? Fix it.
          auto& cow = const_cast<impl::cow_refletion_data&>(const_cow);
-         if (cow.written == nullptr) continue;
+         if (!cow.has_writes()) continue;
          FC_ASSERT(cow.update, "LOGIC ERROR: Update method not set on copy-on-write data. Please report this error.");
          cow.update(cow, mutable_db);
       }
@@ -30,6 +30,9 @@
 
 #include <graphene/db/generic_index.hpp>
 
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/mem_fun.hpp>
+
 namespace graphene { namespace chain {
 namespace ptnt = protocol::tnt;
 
@@ -64,22 +67,18 @@ public:
 
    /// Storage of tank accessories' states
    accessory_state_map accessory_states;
+   /// The next time some accessory state expires and must be updated by @ref process_accessory_states; this may be
+   /// earlier than necessary, but never later
+   time_point_sec next_state_update = time_point_sec::maximum();
 
    /// Get state by address (const, generic types)
    const ptnt::tank_accessory_state* get_state(const stateful_accessory_address& address) const {
-      auto itr = accessory_states.find(address);
-      if (itr == accessory_states.end())
-         return nullptr;
-      return &itr->second;
+      return find_state(accessory_states, address);
    }
    /// Get state by address (const, specific types)
    template<typename Accessory, typename State = typename Accessory::state_type>
    const State* get_state(const ptnt::tank_accessory_address<Accessory>& address) const {
-      auto itr = accessory_states.find(address);
-      if (itr == accessory_states.end())
-         return nullptr;
-      FC_ASSERT(itr->second.template is_type<State>(), "Accessory state has unexpected type");
-      return &itr->second.template get<State>();
+      return find_state(accessory_states, address);
    }
    /// Get state by address (mutable, generic types)
    ptnt::tank_accessory_state* get_state(const stateful_accessory_address& address) {
@@ -92,41 +91,126 @@ public:
    }
    /// Get state by address, creating a default one if none yet exists (generic types)
    ptnt::tank_accessory_state& get_or_create_state(const stateful_accessory_address& address) {
-      auto itr = accessory_states.find(address);
-      if (itr == accessory_states.end()) {
-         itr = accessory_states.insert(std::make_pair(address, ptnt::tank_accessory_state())).first;
+      return get_or_create_state(accessory_states, address);
+   }
+   /// Get state by address, creating a default one if none yet exists (specific types)
+   template<typename Accessory, typename State = typename Accessory::state_type>
+   State& get_or_create_state(const ptnt::tank_accessory_address<Accessory>& address) {
+      return get_or_create_state(accessory_states, address);
+   }
+
+   /// @name State map helpers
+   /// The same lookups as above, on a state map which need not be in a tank_object (such as the copy-on-write copy
+   /// of a tank's states)
+   /// @{
+   static const ptnt::tank_accessory_state* find_state(const accessory_state_map& states,
+                                                       const stateful_accessory_address& address) {
+      auto itr = states.find(address);
+      if (itr == states.end())
+         return nullptr;
+      return &itr->second;
+   }
+   template<typename Accessory, typename State = typename Accessory::state_type>
+   static const State* find_state(const accessory_state_map& states,
+                                  const ptnt::tank_accessory_address<Accessory>& address) {
+      auto itr = states.find(address);
+      if (itr == states.end())
+         return nullptr;
+      FC_ASSERT(itr->second.template is_type<State>(), "Accessory state has unexpected type");
+      return &itr->second.template get<State>();
+   }
+   static ptnt::tank_accessory_state& get_or_create_state(accessory_state_map& states,
+                                                          const stateful_accessory_address& address) {
+      auto itr = states.find(address);
+      if (itr == states.end()) {
+         itr = states.insert(std::make_pair(address, ptnt::tank_accessory_state())).first;
          itr->second.set_which(address.which());
       }
       return itr->second;
    }
-   /// Get state by address, creating a default one if none yet exists (specific types)
    template<typename Accessory, typename State = typename Accessory::state_type>
-   State& get_or_create_state(const ptnt::tank_accessory_address<Accessory>& address) {
-      auto itr = accessory_states.find(address);
-      if (itr == accessory_states.end()) {
+   static State& get_or_create_state(accessory_state_map& states,
+                                     const ptnt::tank_accessory_address<Accessory>& address) {
+      auto itr = states.find(address);
+      if (itr == states.end()) {
          auto state = std::make_pair(stateful_accessory_address(address), ptnt::tank_accessory_state(State()));
-         itr = accessory_states.insert(std::move(state)).first;
+         itr = states.insert(std::move(state)).first;
       }
       return itr->second.template get<State>();
    }
+   /// @}
 
    /// Delete state for any/all requirements on the specified tap
    void clear_tap_state(ptnt::index_type tap_ID);
    /// Delete state for the supplied attachment ID
    void clear_attachment_state(ptnt::index_type attachment_ID);
+   /// Delete the accessory states which expired by the supplied time, and schedule the next update
+   void process_accessory_states(time_point_sec now);
 
    /// Get the specifically typed ID
    tank_id_type get_id() const { return id; }
+   /// Get the type of asset the tank stores
+   asset_id_type get_asset_type() const { return schematic.asset_type; }
 };
 
+struct by_asset_type;
+struct by_next_state_update;
 using tank_object_index_type = multi_index_container<
    tank_object,
    indexed_by<
-      ordered_unique<tag<by_id>, member<object, object_id_type, &object::id>>
+      ordered_unique<tag<by_id>, member<object, object_id_type, &object::id>>,
+      ordered_unique<tag<by_asset_type>,
+         composite_key<tank_object,
+            const_mem_fun<tank_object, asset_id_type, &tank_object::get_asset_type>,
+            member<object, object_id_type, &object::id>
+         >
+      >,
+      ordered_unique<tag<by_next_state_update>,
+         composite_key<tank_object,
+            member<tank_object, time_point_sec, &tank_object::next_state_update>,
+            member<object, object_id_type, &object::id>
+         >
+      >
    >
 >;
 using tank_index = generic_index<tank_object, tank_object_index_type>;
 
+/// @brief A secondary index for reverse lookups of the tanks which refer to an account, tank, or attachment
+/// @ingroup TNT
+///
+/// Tanks are found by the remote connections their taps and attachments release asset to, by the remote sources
+/// they or their attachments authorize deposits from, and by the accounts in the open authorities of their taps.
+class tank_connection_index : public secondary_index {
+public:
+   void object_inserted(const object& obj) override;
+   void object_removed(const object& obj) override;
+   void about_to_modify(const object& before) override;
+   void object_modified(const object& after) override;
+
+   /// Tanks with a tap or attachment releasing asset to the connection
+   const flat_set<tank_id_type>& get_tanks_releasing_to(const ptnt::remote_connection& destination) const;
+   /// Tanks which, or whose attachments, explicitly authorize deposits from the connection
+   const flat_set<tank_id_type>& get_tanks_receiving_from(const ptnt::remote_connection& source) const;
+   /// Tanks with a tap the account is in the open authority of
+   const flat_set<tank_id_type>& get_tanks_openable_by(account_id_type account) const;
+
+private:
+   struct tank_references {
+      flat_set<ptnt::remote_connection> destinations;
+      flat_set<ptnt::remote_connection> sources;
+      flat_set<account_id_type> tap_openers;
+   };
+   static tank_references get_references(const tank_object& tank);
+   void add_references(tank_id_type tank, const tank_references& references);
+   void remove_references(tank_id_type tank, const tank_references& references);
+
+   map<ptnt::remote_connection, flat_set<tank_id_type>> tanks_by_destination;
+   map<ptnt::remote_connection, flat_set<tank_id_type>> tanks_by_source;
+   map<account_id_type, flat_set<tank_id_type>> tanks_by_tap_opener;
+
+   tank_references before_references;
+};
+
 } } // namespace graphene::chain
 
 MAP_OBJECT_ID_TO_TYPE(graphene::chain::tank_object)
@@ -136,4 +220,4 @@ GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION(graphene::chain::tank_object)
 // This reflection information cannot be moved to the .cpp file as with the other objects, because it must be visible
 // to the evaluation code.
 FC_REFLECT(graphene::chain::tank_object,
-           (schematic)(balance)(deposit)(creation_date)(accessory_states))
+           (schematic)(balance)(deposit)(creation_date)(accessory_states)(next_state_update))
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/parallel_tasks.hpp>
+
+#include <fc/thread/parallel.hpp>
+
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <vector>
+
+namespace graphene { namespace chain {
+
+void run_parallel_tasks( size_t count, const std::function<void(size_t)>& task )
+{
+   if( count == 0 )
+      return;
+   if( count == 1 )
+   {
+      task( 0 );
+      return;
+   }
+
+   std::vector<std::exception_ptr> errors( count );
+   std::mutex mtx;
+   std::condition_variable finished;
+   size_t running = count;
+   for( size_t i = 0; i < count; ++i )
+   {
+      fc::do_parallel( [&task,&errors,&mtx,&finished,&running,i] () {
+         try {
+            task( i );
+         } catch( ... ) {
+            errors[i] = std::current_exception();
+         }
+         std::lock_guard<std::mutex> lock( mtx );
+         if( --running == 0 )
+            finished.notify_one();
+      });
+   }
+   {
+      std::unique_lock<std::mutex> lock( mtx );
+      finished.wait( lock, [&running] () { return running == 0; } );
+   }
+   for( const std::exception_ptr& e : errors )
+      if( e )
+         std::rethrow_exception( e );
+}
+
+} }
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/chain/snapshot.hpp>
+#include <graphene/chain/block_database.hpp>
+#include <graphene/chain/config.hpp>
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/parallel_tasks.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/thread/parallel.hpp>
+
+#include <boost/iostreams/copy.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <fstream>
+#include <sstream>
+
+namespace graphene { namespace chain {
+
+namespace {
+
+const char* const manifest_file   = "manifest.json";
+const char* const head_block_file = "head_block";
+
+void write_compressed( const fc::path& file, const std::string& data )
+{
+   std::ofstream out( file.generic_string(), std::ios::binary | std::ios::out | std::ios::trunc );
+   FC_ASSERT( out, "Unable to create ${f}", ("f",file) );
+   {
+      boost::iostreams::filtering_ostream zout;
+      zout.push( boost::iostreams::zlib_compressor( boost::iostreams::zlib::best_speed ) );
+      zout.push( out );
+      zout.write( data.data(), data.size() );
+      boost::iostreams::close( zout );
+   }
+   out.flush();
+   FC_ASSERT( out, "Error writing ${f}", ("f",file) );
+}
+
+uint64_t read_compressed( const fc::path& file, std::ostream& out )
+{
+   std::ifstream in( file.generic_string(), std::ios::binary | std::ios::in );
+   FC_ASSERT( in, "Unable to open ${f}", ("f",file) );
+   boost::iostreams::filtering_istream zin;
+   zin.push( boost::iostreams::zlib_decompressor() );
+   zin.push( in );
+   const auto size = boost::iostreams::copy( zin, out );
+   FC_ASSERT( out, "Error extracting ${f}", ("f",file) );
+   return uint64_t(size);
+}
+
+} // anonymous namespace
+
+binary_snapshot binary_snapshot::capture( const database& db, const signed_block& head_block )
+{ try {
+   FC_ASSERT( head_block.id() == db.head_block_id(), "Can only capture a snapshot at the head block" );
+
+   binary_snapshot result;
+   result._manifest.format_version  = current_format_version;
+   result._manifest.db_version      = GRAPHENE_CURRENT_DB_VERSION;
+   result._manifest.chain_id        = db.get_chain_id();
+   result._manifest.head_block_num  = head_block.block_num();
+   result._manifest.head_block_id   = head_block.id();
+   result._manifest.head_block_time = head_block.timestamp;
+   result._head_block = head_block;
+
+   std::vector<const graphene::db::index*> indexes;
+   db.inspect_all_indexes( [&indexes]( const graphene::db::index& idx ) {
+      indexes.push_back( &idx );
+   });
+
+   result._chunks.resize( indexes.size() );
+   result._manifest.chunks.resize( indexes.size() );
+   for( size_t i = 0; i < indexes.size(); ++i )
+   {
+      auto& info = result._manifest.chunks[i];
+      info.space_id = indexes[i]->object_space_id();
+      info.type_id  = indexes[i]->object_type_id();
+      info.file     = fc::to_string( info.space_id ) + "." + fc::to_string( info.type_id );
+   }
+   // Waiting on fc futures would let other fibers of the chain thread modify the database while it is serialized
+   run_parallel_tasks( indexes.size(), [&result,&indexes] ( size_t i ) {
+      std::ostringstream out( std::ios::binary | std::ios::out );
+      indexes[i]->save( out );
+      result._chunks[i] = out.str();
+   });
+   for( size_t i = 0; i < indexes.size(); ++i )
+      result._manifest.chunks[i].size = result._chunks[i].size();
+
+   return result;
+} FC_CAPTURE_AND_RETHROW() }
+
+void binary_snapshot::write( const fc::path& dest )const
+{ try {
+   fc::create_directories( dest );
+   // a manifest left over from an earlier snapshot would make a half written one look complete
+   fc::remove( dest / manifest_file );
+
+   std::vector<fc::future<void>> tasks;
+   tasks.reserve( _chunks.size() + 1 );
+   for( size_t i = 0; i < _chunks.size(); ++i )
+      tasks.push_back( fc::do_parallel( [this,&dest,i] () {
+         write_compressed( dest / _manifest.chunks[i].file, _chunks[i] );
+      } ) );
+   tasks.push_back( fc::do_parallel( [this,&dest] () {
+      const auto packed = fc::raw::pack( _head_block );
+      write_compressed( dest / head_block_file, std::string( packed.begin(), packed.end() ) );
+   } ) );
+   for( auto& task : tasks )
+      task.wait();
+
+   fc::json::save_to_file( _manifest, dest / manifest_file );
+} FC_CAPTURE_AND_RETHROW( (dest) ) }
+
+snapshot_manifest binary_snapshot::read_manifest( const fc::path& src, const chain_id_type& chain_id )
+{ try {
+   FC_ASSERT( fc::exists( src / manifest_file ), "No complete snapshot found in ${src}", ("src",src) );
+   const auto manifest = fc::json::from_file( src / manifest_file )
+                                  .as<snapshot_manifest>( GRAPHENE_MAX_NESTED_OBJECTS );
+   FC_ASSERT( manifest.format_version == current_format_version, "Unsupported snapshot format ${f}",
+              ("f",manifest.format_version) );
+   FC_ASSERT( manifest.db_version == GRAPHENE_CURRENT_DB_VERSION,
+              "Snapshot was taken with object database version ${s}, this node uses ${n}",
+              ("s",manifest.db_version)("n",GRAPHENE_CURRENT_DB_VERSION) );
+   FC_ASSERT( manifest.chain_id == chain_id, "Snapshot is of chain ${s}, this node is on chain ${n}",
+              ("s",manifest.chain_id)("n",chain_id) );
+   return manifest;
+} FC_CAPTURE_AND_RETHROW( (src)(chain_id) ) }
+
+snapshot_manifest binary_snapshot::restore( const fc::path& src, const fc::path& data_dir,
+                                            const chain_id_type& chain_id )
+{ try {
+   const auto manifest = read_manifest( src, chain_id );
+
+   // Same layout as created by database::open() and object_database::flush()
+   const fc::path objects_dir = data_dir / "object_database";
+   const fc::path blocks_dir  = data_dir / "database" / "block_num_to_block";
+   FC_ASSERT( !fc::exists( blocks_dir / "index" ), "Can only restore a snapshot into a database without blocks" );
+   fc::remove_all( objects_dir );
+   for( const auto& chunk : manifest.chunks )
+      fc::create_directories( objects_dir / fc::to_string( chunk.space_id ) );
+
+   std::vector<fc::future<void>> tasks;
+   tasks.reserve( manifest.chunks.size() );
+   for( const auto& chunk : manifest.chunks )
+      tasks.push_back( fc::do_parallel( [&src,&objects_dir,&chunk] () {
+         const fc::path file = objects_dir / fc::to_string( chunk.space_id ) / fc::to_string( chunk.type_id );
+         std::ofstream out( file.generic_string(), std::ios::binary | std::ios::out | std::ios::trunc );
+         FC_ASSERT( out, "Unable to create ${f}", ("f",file) );
+         const uint64_t size = read_compressed( src / chunk.file, out );
+         FC_ASSERT( size == chunk.size, "Chunk ${c} is ${s} bytes, expected ${e}",
+                    ("c",chunk.file)("s",size)("e",chunk.size) );
+      } ) );
+   for( auto& task : tasks )
+      task.wait();
+
+   std::ostringstream packed_block( std::ios::binary | std::ios::out );
+   read_compressed( src / head_block_file, packed_block );
+   const std::string packed = packed_block.str();
+   const auto head_block = fc::raw::unpack<signed_block>( std::vector<char>( packed.begin(), packed.end() ) );
+   FC_ASSERT( head_block.id() == manifest.head_block_id, "Head block does not match the snapshot manifest" );
+
+   // The head block is needed to build blockchain synopses for syncing peers
+   block_database blocks;
+   blocks.open( blocks_dir );
+   blocks.store( head_block.id(), head_block );
+   blocks.close();
+
+   std::ofstream version_file( (data_dir / "db_version").generic_string().c_str(),
+                               std::ios::out | std::ios::binary | std::ios::trunc );
+   version_file.write( manifest.db_version.c_str(), manifest.db_version.size() );
+   version_file.close();
+
+   return manifest;
+} FC_CAPTURE_AND_RETHROW( (src)(data_dir)(chain_id) ) }
+
+} }
@@ -24,6 +24,7 @@
 
 #include <graphene/chain/tnt/connection_flow_processor.hpp>
 #include <graphene/chain/is_authorized_asset.hpp>
+#include <graphene/chain/hardfork.hpp>
 
 namespace graphene { namespace chain { namespace tnt {
 
@@ -52,14 +53,13 @@ optional<tank_id_type> get_connection_tank(const ptnt::remote_connection& c) {
    return {};
 }
 
-class attachment_receive_inspector {
-   tank_object& tank;
-   const asset& amount;
+// Checks that an attachment can receive the flowed asset from the source, and returns where it releases it to
+class attachment_resolve_inspector {
+   tank_id_type tank_id;
+   asset_id_type asset_type;
    const ptnt::connection& source;
-   const connection_flow_processor_impl& data;
-   attachment_receive_inspector(tank_object& tank, const asset& amount, const ptnt::connection& source,
-                                const connection_flow_processor_impl& data)
-      : tank(tank), amount(amount), source(source), data(data) {}
+   attachment_resolve_inspector(tank_id_type tank_id, asset_id_type asset_type, const ptnt::connection& source)
+      : tank_id(tank_id), asset_type(asset_type), source(source) {}
 
    using NonReceivingAttachments = ptnt::TL::list<ptnt::attachment_connect_authority>;
    template<typename Attachment,
@@ -77,7 +77,7 @@ class attachment_receive_inspector {
       auto remote_source = ptnt::remote_connection::import_from(source);
       auto remote_tank = get_connection_tank(remote_source);
       // If the destination is on the same tank as the source, there's nothing to check
-      if (remote_tank.valid() && *remote_tank == tank.get_id())
+      if (remote_tank.valid() && *remote_tank == tank_id)
          return;
       FC_ASSERT(authorized.count(remote_source) > 0,
                 "Cannot process connection flow ${S} -> ${D}: destination does not allow deposits from source",
@@ -87,30 +87,28 @@ class attachment_receive_inspector {
    ptnt::connection operator()(const ptnt::asset_flow_meter& meter,
                                ptnt::tank_accessory_address<ptnt::asset_flow_meter> address) {
       check_source_restriction(meter.authorized_sources(),
-                               ptnt::attachment_id_type{tank.get_id(), address.attachment_ID});
-      FC_ASSERT(meter.asset_type == amount.asset_id,
+                               ptnt::attachment_id_type{tank_id, address.attachment_ID});
+      FC_ASSERT(meter.asset_type == asset_type,
                 "Flowed wrong type of asset to flow meter. Meter expects ${O} but received ${A}",
-                ("O", meter.asset_type)("A", amount.asset_id));
-      auto& state = tank.get_or_create_state(address);
-      state.metered_amount += amount.amount;
+                ("O", meter.asset_type)("A", asset_type));
       return meter.destination;
    }
    ptnt::connection operator()(const ptnt::tap_opener& opener,
                                ptnt::tank_accessory_address<ptnt::tap_opener> address) {
       check_source_restriction(opener.authorized_sources(),
-                               ptnt::attachment_id_type{tank.get_id(), address.attachment_ID});
-      FC_ASSERT(opener.asset_type == amount.asset_id,
+                               ptnt::attachment_id_type{tank_id, address.attachment_ID});
+      FC_ASSERT(opener.asset_type == asset_type,
                 "Flowed wrong type of asset to tap opener. Opener expects ${O} but received ${A}",
-                ("O", opener.asset_type)("A", amount.asset_id));
-      data.cbOpenTap(ptnt::tap_id_type{tank.id, opener.tap_index}, opener.release_amount);
+                ("O", opener.asset_type)("A", asset_type));
       return opener.destination;
    }
 
 public:
-   static ptnt::connection inspect(tank_object& tank, ptnt::index_type attachment_ID, const asset& amount,
-                             const ptnt::connection& source, const connection_flow_processor_impl& data) {
-      attachment_receive_inspector inspector(tank, amount, source, data);
-      const auto& attachment = tank.schematic.attachments.at(attachment_ID);
+   static ptnt::connection inspect(const ptnt::tank_schematic& schematic, tank_id_type tank_id,
+                                   ptnt::index_type attachment_ID, asset_id_type asset_type,
+                                   const ptnt::connection& source) {
+      attachment_resolve_inspector inspector(tank_id, asset_type, source);
+      const auto& attachment = schematic.attachments.at(attachment_ID);
       return ptnt::TL::runtime::dispatch(ptnt::tank_attachment::list(), attachment.which(),
                                   [&attachment, attachment_ID, &inspector](auto t) {
          return inspector(attachment.get<typename decltype(t)::type>(), {attachment_ID});
@@ -118,18 +116,63 @@ public:
    }
 };
 
-vector<ptnt::connection> connection_flow_processor::release_to_connection(ptnt::connection origin,
-                                                                          ptnt::connection connection, asset amount) {
+// Performs the processing of an attachment receiving asset, after it was checked by the attachment_resolve_inspector
+class attachment_receive_inspector {
+   cow_object<tank_object>& tank;
+   tank_id_type tank_id;
+   share_type amount;
+   const connection_flow_processor_impl& data;
+   attachment_receive_inspector(cow_object<tank_object>& tank, tank_id_type tank_id, share_type amount,
+                                const connection_flow_processor_impl& data)
+      : tank(tank), tank_id(tank_id), amount(amount), data(data) {}
+
+   template<typename Attachment,
+            std::enable_if_t<!ptnt::TL::contains<ptnt::TL::list<ptnt::asset_flow_meter, ptnt::tap_opener>,
+                                                 Attachment>(), bool> = true>
+   [[noreturn]] void operator()(const Attachment&, ptnt::tank_accessory_address<Attachment>) {
+      FC_THROW_EXCEPTION(fc::assert_exception, "INTERNAL ERROR: Tried to flow asset to an attachment which cannot "
+                                               "receive asset. Please report this error.");
+   }
+   void operator()(const ptnt::asset_flow_meter&, ptnt::tank_accessory_address<ptnt::asset_flow_meter> address) {
+      // Copies only the tank's accessory states, not the whole tank
+      auto& state = tank_object::get_or_create_state(tank.accessory_states.set(), address);
+      state.metered_amount += amount;
+   }
+   void operator()(const ptnt::tap_opener& opener, ptnt::tank_accessory_address<ptnt::tap_opener>) {
+      data.cbOpenTap(ptnt::tap_id_type{tank_id, opener.tap_index}, opener.release_amount);
+   }
+
+public:
+   static void inspect(cow_object<tank_object> tank, tank_id_type tank_id, ptnt::index_type attachment_ID,
+                       share_type amount, const connection_flow_processor_impl& data) {
+      attachment_receive_inspector inspector(tank, tank_id, amount, data);
+      const auto& attachment = tank.schematic.get().attachments.at(attachment_ID);
+      ptnt::TL::runtime::dispatch(ptnt::tank_attachment::list(), attachment.which(),
+                                  [&attachment, attachment_ID, &inspector](auto t) {
+         inspector(attachment.get<typename decltype(t)::type>(), {attachment_ID});
+      });
+   }
+};
+
+resolved_connection_flow connection_flow_processor::resolve_connection(ptnt::connection origin,
+                                                                       ptnt::connection connection,
+                                                                       asset_id_type asset_type) {
    FC_ASSERT(!origin.is_type<ptnt::same_tank>(), "Cannot process connection flow from origin of 'same_tank'");
-   vector<ptnt::connection> connection_path;
+   const auto& d = my->db.get_db();
+   // Before the hardfork, the reported path listed where each attachment released to instead of the attachment,
+   // and sources were checked against that path
+   const bool flow_fix = HARDFORK_TNT_FLOW_FIX_PASSED(d.head_block_time());
+   resolved_connection_flow flow{origin, asset_type, {}, {}, {}};
+   vector<ptnt::connection>& connection_path = flow.path;
+   vector<ptnt::connection>& source_path = flow_fix? flow.path : flow.reported_path;
    optional<tank_id_type> current_tank;
    if (origin.is_type<tank_id_type>())
       current_tank = origin.get<tank_id_type>();
+   const auto max_connections = d.get_global_properties()
+                                .parameters.extensions.value.updatable_tnt_options->max_connection_chain_length;
 
    try {
    while (!ptnt::is_terminal_connection(connection)) {
-      auto max_connections = my->db.get_db().get_global_properties()
-                       .parameters.extensions.value.updatable_tnt_options->max_connection_chain_length;
       FC_ASSERT(connection_path.size() < max_connections,
                 "Tap flow has exceeded the maximm connection chain length.");
 
@@ -144,10 +187,19 @@ vector<ptnt::connection> connection_flow_processor::release_to_connection(ptnt::
                             "Could not process connection flow: connection specifies a tank attachment with implied "
                             "tank ID outside the context of any \"current tank\"");
 
-      connection =
-            attachment_receive_inspector::inspect(my->db.get(*current_tank), att_id.attachment_id, amount,
-                                                  (connection_path.empty()? origin : connection_path.back()), *my);
-      connection_path.emplace_back(std::move(connection));
+      // Schematics are read through the wrapper, as queries may have changed them
+      const ptnt::tank_schematic& schematic = my->db.get(*current_tank).schematic.get();
+      auto next = attachment_resolve_inspector::inspect(schematic, *current_tank, att_id.attachment_id, asset_type,
+                                                        (source_path.empty()? origin : source_path.back()));
+      if (flow_fix) {
+         connection_path.emplace_back(std::move(connection));
+         connection = std::move(next);
+      } else {
+         connection_path.emplace_back(connection);
+         // The flow continues with what is left of the connection after moving it into the reported path
+         connection = std::move(next);
+         flow.reported_path.emplace_back(std::move(connection));
+      }
    }
 
    if (connection.is_type<ptnt::same_tank>()) {
@@ -157,47 +209,83 @@ vector<ptnt::connection> connection_flow_processor::release_to_connection(ptnt::
    }
    // Save the next to last connection so we can check the deposit source
    auto penultimate_connection =
-         ptnt::remote_connection::import_from(connection_path.empty()? origin : connection_path.back());
-   // Complete the connection_path
-   connection_path.emplace_back(connection);
+         ptnt::remote_connection::import_from(source_path.empty()? origin : source_path.back());
 
-   // Process deposit to the terminal connection
+   // Check the deposit to the terminal connection
    if (connection.is_type<tank_id_type>()) {
       // Terminal connection is a tank
-      auto dest_tank = connection.get<tank_id_type>()(my->db);
-      const tank_object& tank_ref = dest_tank;
+      auto dest_tank_id = connection.get<tank_id_type>();
+      const ptnt::tank_schematic& dest_schematic = my->db.get(dest_tank_id).schematic.get();
       // Check tank's asset type
-      FC_ASSERT(tank_ref.schematic.asset_type == amount.asset_id,
+      FC_ASSERT(dest_schematic.asset_type == asset_type,
                 "Destination tank of tap flow stores asset ID ${D}, but tap flow asset ID was ${F}",
-                ("D", tank_ref.schematic.asset_type)("F", amount.asset_id));
+                ("D", dest_schematic.asset_type)("F", asset_type));
       // Check the tank's deposit source restrictions
       auto source_tank = get_connection_tank(penultimate_connection);
       // If the source tank is the same as the dest tank, or the dest allows all sources, we can skip the check
-      if (!(source_tank.valid() && *source_tank == tank_ref.get_id()) &&
-          tank_ref.schematic.remote_sources.is_type<flat_set<ptnt::remote_connection>>()) {
-         const auto& authorized = tank_ref.schematic.remote_sources.get<flat_set<ptnt::remote_connection>>();
+      if (!(source_tank.valid() && *source_tank == dest_tank_id) &&
+          dest_schematic.remote_sources.is_type<flat_set<ptnt::remote_connection>>()) {
+         const auto& authorized = dest_schematic.remote_sources.get<flat_set<ptnt::remote_connection>>();
          FC_ASSERT(authorized.count(penultimate_connection),
                    "Cannot process connection flow: terminal tank does not allow deposits from source: ${S} -> ${D}",
-                   ("S", penultimate_connection)("D", tank_ref.get_id()));
+                   ("S", penultimate_connection)("D", dest_tank_id));
       }
-      // Update tank's balance
-      dest_tank.balance = dest_tank.balance() + amount.amount;
    } else if (connection.is_type<account_id_type>()) {
       // Terminal connection is an account
       auto account = connection.get<account_id_type>();
       // Check account is authorized to hold the asset
-      FC_ASSERT(is_authorized_asset(my->db.get_db(), account(my->db.get_db()), amount.asset_id(my->db.get_db())),
+      FC_ASSERT(is_authorized_asset(d, account(d), asset_type(d)),
                 "Could not process connection flow: terminal connection is an account which is unauthorized to hold "
                 "the asset");
-      // Use callback to pay the account
-      vector<ptnt::connection> fullPath(connection_path.size() + 1);
-      fullPath.emplace_back(origin);
-      fullPath.insert(fullPath.end(), connection_path.begin(), connection_path.end());
-      my->cbFundAccount(account, amount, std::move(fullPath));
    }
+   // Complete the connection_path
+   connection_path.emplace_back(std::move(connection));
    } FC_CAPTURE_AND_RETHROW( (connection_path) )
 
-   return connection_path;
+   if (flow_fix) {
+      flow.reported_path = flow.path;
+      flow.deposit_path.reserve(flow.path.size() + 1);
+   } else {
+      flow.reported_path.emplace_back(flow.path.back());
+      // Before the hardfork, the path of account deposits began with a default connection per reported connection,
+      // plus one
+      flow.deposit_path.resize(flow.reported_path.size() + 1);
+   }
+   flow.deposit_path.emplace_back(flow.origin);
+   flow.deposit_path.insert(flow.deposit_path.end(), flow.reported_path.begin(), flow.reported_path.end());
+
+   return flow;
+}
+
+void connection_flow_processor::release_to_resolved_connection(const resolved_connection_flow& flow,
+                                                                share_type amount) {
+   FC_ASSERT(!flow.path.empty(), "INTERNAL ERROR: Released into an unresolved connection. Please report this error.");
+   try {
+   // Process the flow through the attachments along the path
+   for (auto itr = flow.path.begin(); itr + 1 != flow.path.end(); ++itr) {
+      const auto& att_id = itr->get<ptnt::attachment_id_type>();
+      attachment_receive_inspector::inspect(my->db.get(*att_id.tank_id), *att_id.tank_id, att_id.attachment_id,
+                                            amount, *my);
+   }
+
+   // Process deposit to the terminal connection
+   const ptnt::connection& terminal = flow.path.back();
+   if (terminal.is_type<tank_id_type>()) {
+      // Update tank's balance; only the balance gets copied
+      auto dest_tank = my->db.get(terminal.get<tank_id_type>());
+      dest_tank.balance = dest_tank.balance() + amount;
+   } else if (terminal.is_type<account_id_type>()) {
+      // Use callback to pay the account
+      my->cbFundAccount(terminal.get<account_id_type>(), asset(amount, flow.asset_type), flow.deposit_path);
+   }
+   } FC_CAPTURE_AND_RETHROW( (flow.path) )
+}
+
+vector<ptnt::connection> connection_flow_processor::release_to_connection(ptnt::connection origin,
+                                                                          ptnt::connection connection, asset amount) {
+   auto flow = resolve_connection(std::move(origin), std::move(connection), amount.asset_id);
+   release_to_resolved_connection(flow, amount.amount);
+   return std::move(flow.reported_path);
 }
 
 } } } // graphene::chain::tnt
@@ -98,7 +98,7 @@ void_result tank_update_evaluator::do_apply(const tank_update_evaluator::operati
    auto& d = db();
    if (o.deposit_delta != 0)
       d.adjust_balance(o.payer, o.deposit_delta);
-   d.modify(*old_tank, [&schema = updated_tank, &o](tank_object& tank) {
+   d.modify(*old_tank, [&schema = updated_tank, &o, now = d.head_block_time()](tank_object& tank) {
       tank.schematic = std::move(schema);
       tank.deposit += o.deposit_delta;
 
@@ -110,6 +110,8 @@ void_result tank_update_evaluator::do_apply(const tank_update_evaluator::operati
          tank.clear_tap_state(id);
       for (auto id_tap_pair : o.taps_to_replace)
          tank.clear_tap_state(id_tap_pair.first);
+      // The schedule of state updates was computed for the old schematic, so compute it for the new one
+      tank.process_accessory_states(now);
    });
 
    return {};
@@ -236,7 +238,9 @@ void_result tap_open_evaluator::do_evaluate(const tap_open_evaluator::operation_
       auto required_auths = query_evaluator.evaluate_query(query, d);
       auth_checker.require_auths(std::move(required_auths));
    } FC_CAPTURE_AND_RETHROW((query)) }
-   query_evaluator.apply_queries(db_wrapper->get<tank_object>(tank->id));
+   // Applying queries needs the whole tank mutably, which copies it, so skip that when there are none
+   if (!o.queries.empty())
+      query_evaluator.apply_queries(db_wrapper->get<tank_object>(tank->id));
 
    // Create the callback for tap flow evaluation
    tnt::FundAccountCallback cb_pay = [this](account_id_type account, asset amount, vector<ptnt::connection> path) {
@@ -53,6 +53,166 @@ void tank_object::clear_attachment_state(tnt::index_type attachment_ID) {
    accessory_states.erase(tnt::tank_accessory_address<tnt::asset_flow_meter>{attachment_ID});
 }
 
+void tank_object::process_accessory_states(time_point_sec now) {
+   using periodic_address = tnt::tank_accessory_address<tnt::periodic_flow_limit>;
+   next_state_update = time_point_sec::maximum();
+
+   // Only periodic flow limits have state which expires: a state from a past period is the same as no state at all.
+   // Requests of delay requirements do not expire, and their request counters must be kept to keep request IDs unique.
+   auto itr = accessory_states.begin();
+   while (itr != accessory_states.end()) {
+      if (!itr->first.is_type<periodic_address>()) {
+         ++itr;
+         continue;
+      }
+      const auto& address = itr->first.get<periodic_address>();
+      auto tap_itr = schematic.taps.find(address.tap_ID);
+      if (tap_itr == schematic.taps.end() || tap_itr->second.requirements.size() <= address.requirement_index ||
+          !tap_itr->second.requirements[address.requirement_index].is_type<tnt::periodic_flow_limit>()) {
+         itr = accessory_states.erase(itr);
+         continue;
+      }
+      const auto& limit = tap_itr->second.requirements[address.requirement_index].get<tnt::periodic_flow_limit>();
+      const auto& state = itr->second.get<tnt::periodic_flow_limit::state_type>();
+      if (state.period_num != limit.period_num_at_time(creation_date, now)) {
+         itr = accessory_states.erase(itr);
+         continue;
+      }
+      next_state_update = std::min(next_state_update, limit.period_end_time(creation_date, state.period_num));
+      ++itr;
+   }
+}
+
+namespace {
+using tank_id_set = flat_set<tank_id_type>;
+const tank_id_set no_tanks;
+
+/// Connections to the current tank or its own attachments are not remote and are skipped
+void add_remote_connection(flat_set<ptnt::remote_connection>& set, const ptnt::connection& c) {
+   if (c.is_type<account_id_type>())
+      set.insert(c.get<account_id_type>());
+   else if (c.is_type<tank_id_type>())
+      set.insert(c.get<tank_id_type>());
+   else if (c.is_type<ptnt::attachment_id_type>() && c.get<ptnt::attachment_id_type>().tank_id.valid())
+      set.insert(c.get<ptnt::attachment_id_type>());
+}
+
+void add_authorized_sources(flat_set<ptnt::remote_connection>& set, const ptnt::authorized_connections_type& sources) {
+   if (sources.is_type<flat_set<ptnt::remote_connection>>()) {
+      const auto& source_set = sources.get<flat_set<ptnt::remote_connection>>();
+      set.insert(source_set.begin(), source_set.end());
+   }
+}
+
+struct attachment_reference_collector {
+   using result_type = void;
+   flat_set<ptnt::remote_connection>& destinations;
+   flat_set<ptnt::remote_connection>& sources;
+
+   template<typename Attachment, std::enable_if_t<Attachment::can_receive_asset, bool> = true>
+   void operator()(const Attachment& attachment) const {
+      add_remote_connection(destinations, attachment.output_connection());
+      add_authorized_sources(sources, attachment.authorized_sources());
+   }
+   template<typename Attachment, std::enable_if_t<!Attachment::can_receive_asset, bool> = true>
+   void operator()(const Attachment&) const {}
+};
+
+template<typename Key, typename Map>
+const tank_id_set& find_tanks(const Map& map, const Key& key) {
+   auto itr = map.find(key);
+   if (itr == map.end())
+      return no_tanks;
+   return itr->second;
+}
+}
+
+tank_connection_index::tank_references tank_connection_index::get_references(const tank_object& tank) {
+   tank_references references;
+   add_authorized_sources(references.sources, tank.schematic.remote_sources);
+   for (const auto& index_tap : tank.schematic.taps) {
+      const ptnt::tap& tap = index_tap.second;
+      if (tap.connected_connection.valid())
+         add_remote_connection(references.destinations, *tap.connected_connection);
+      if (tap.open_authority.valid())
+         for (const auto& account_weight : tap.open_authority->account_auths)
+            references.tap_openers.insert(account_weight.first);
+   }
+   attachment_reference_collector collector{references.destinations, references.sources};
+   for (const auto& index_attachment : tank.schematic.attachments)
+      index_attachment.second.visit(collector);
+   return references;
+}
+
+void tank_connection_index::add_references(tank_id_type tank, const tank_references& references) {
+   for (const auto& destination : references.destinations)
+      tanks_by_destination[destination].insert(tank);
+   for (const auto& source : references.sources)
+      tanks_by_source[source].insert(tank);
+   for (const auto& account : references.tap_openers)
+      tanks_by_tap_opener[account].insert(tank);
+}
+
+void tank_connection_index::remove_references(tank_id_type tank, const tank_references& references) {
+   auto remove = [tank](auto& map, const auto& key) {
+      auto itr = map.find(key);
+      if (itr == map.end())
+         return;
+      itr->second.erase(tank);
+      if (itr->second.empty())
+         map.erase(itr);
+   };
+   for (const auto& destination : references.destinations)
+      remove(tanks_by_destination, destination);
+   for (const auto& source : references.sources)
+      remove(tanks_by_source, source);
+   for (const auto& account : references.tap_openers)
+      remove(tanks_by_tap_opener, account);
+}
+
+void tank_connection_index::object_inserted(const object& obj) {
+   assert(dynamic_cast<const tank_object*>(&obj)); // for debug only
+   const tank_object& tank = static_cast<const tank_object&>(obj);
+   add_references(tank.get_id(), get_references(tank));
+}
+
+void tank_connection_index::object_removed(const object& obj) {
+   assert(dynamic_cast<const tank_object*>(&obj)); // for debug only
+   const tank_object& tank = static_cast<const tank_object&>(obj);
+   remove_references(tank.get_id(), get_references(tank));
+}
+
+void tank_connection_index::about_to_modify(const object& before) {
+   assert(dynamic_cast<const tank_object*>(&before)); // for debug only
+   before_references = get_references(static_cast<const tank_object&>(before));
+}
+
+void tank_connection_index::object_modified(const object& after) {
+   assert(dynamic_cast<const tank_object*>(&after)); // for debug only
+   const tank_object& tank = static_cast<const tank_object&>(after);
+   // Most modifications only change balances and accessory states, so compare before touching the maps
+   tank_references after_references = get_references(tank);
+   if (after_references.destinations == before_references.destinations &&
+       after_references.sources == before_references.sources &&
+       after_references.tap_openers == before_references.tap_openers)
+      return;
+   remove_references(tank.get_id(), before_references);
+   add_references(tank.get_id(), after_references);
+}
+
+const flat_set<tank_id_type>& tank_connection_index::get_tanks_releasing_to(
+      const ptnt::remote_connection& destination) const {
+   return find_tanks(tanks_by_destination, destination);
+}
+
+const flat_set<tank_id_type>& tank_connection_index::get_tanks_receiving_from(
+      const ptnt::remote_connection& source) const {
+   return find_tanks(tanks_by_source, source);
+}
+
+const flat_set<tank_id_type>& tank_connection_index::get_tanks_openable_by(account_id_type account) const {
+   return find_tanks(tanks_by_tap_opener, account);
+}
 
 } } // namespace graphene::chain
 
@@ -25,6 +25,7 @@
 #include <graphene/chain/tnt/tap_requirement_utility.hpp>
 #include <graphene/chain/tnt/connection_flow_processor.hpp>
 #include <graphene/chain/is_authorized_asset.hpp>
+#include <graphene/chain/hardfork.hpp>
 
 #include <queue>
 
@@ -34,13 +35,20 @@ vector<tap_flow> evaluate_tap_flow(cow_db_wrapper& db, const query_evaluator& qu
                                    ptnt::tap_id_type tap_to_open, ptnt::asset_flow_limit flow_amount,
                                    int max_taps_to_open, FundAccountCallback fund_account_cb) {
    const account_object& responsible_account = account(db.get_db());
+   // Before the hardfork, taps released the core asset whatever their tank held, and flows were reported as
+   // released from the tap opened by the operation
+   const bool flow_fix = HARDFORK_TNT_FLOW_FIX_PASSED(db.get_db().head_block_time());
    std::queue<std::pair<ptnt::tap_id_type, ptnt::asset_flow_limit>> pending_taps;
    vector<tap_flow> tap_flows;
    std::map<ptnt::tap_id_type, tap_requirement_utility> tap_utilities;
+   // A tap may be opened many times in one operation, and the checks of its asset and of the path its asset takes
+   // do not change in between, so they are only done on its first opening
+   flat_set<asset_id_type> authorized_assets;
+   std::map<ptnt::tap_id_type, resolved_connection_flow> resolved_flows;
 
    auto getTapUtil = [&tap_utilities, &db, &queries](ptnt::tap_id_type id) -> tap_requirement_utility& {
      auto itr = tap_utilities.lower_bound(id);
-     if (itr->first != id)
+     if (itr == tap_utilities.end() || itr->first != id)
         itr = tap_utilities.emplace_hint(itr, std::make_pair(id, tap_requirement_utility(db, id, queries)));
      return itr->second;
    };
@@ -66,10 +74,14 @@ vector<tap_flow> evaluate_tap_flow(cow_db_wrapper& db, const query_evaluator& qu
       FC_ASSERT(tap.connected_connection.valid(), "Cannot open tap ${ID}: tap is not connected to a connection",
                 ("ID", current_tap));
       // Check the responsible account is authorized to transact the tank's asset
-      const asset_object& tank_asset = tank.schematic().asset_type()(db);
-      FC_ASSERT(is_authorized_asset(db.get_db(), responsible_account, tank_asset),
-                "Cannot open tap: responsible account ${R} is not authorized to transact the tank's asset ${A}",
-                ("R", account)("A", tank_asset.symbol));
+      const asset_id_type tank_asset_id = tank.schematic.get().asset_type;
+      if (authorized_assets.count(tank_asset_id) == 0) {
+         const asset_object& tank_asset = tank_asset_id(db.get_db());
+         FC_ASSERT(is_authorized_asset(db.get_db(), responsible_account, tank_asset),
+                   "Cannot open tap: responsible account ${R} is not authorized to transact the tank's asset ${A}",
+                   ("R", account)("A", tank_asset.symbol));
+         authorized_assets.insert(tank_asset_id);
+      }
       // Check tank balance (it's checked later too, but we can skip a lot of work if it's obviously wrong)
       if (current_amount.is_type<share_type>())
          FC_ASSERT(tank.balance() >= current_amount.get<share_type>(),
@@ -103,10 +115,18 @@ vector<tap_flow> evaluate_tap_flow(cow_db_wrapper& db, const query_evaluator& qu
       // By now, release_limit is the exact amount we will be releasing. Remove it from the tank balance
       tank.balance = tank.balance() - release_limit;
       // Flow the released asset until it stops
-      auto connection_path = connection_processor.release_to_connection(*current_tap.tank_id,
-                                                                        *tap.connected_connection, release_limit);
+      auto flow_itr = resolved_flows.find(current_tap);
+      if (flow_itr == resolved_flows.end())
+         flow_itr = resolved_flows.emplace(current_tap,
+                                           connection_processor.resolve_connection(*current_tap.tank_id,
+                                                                                   *tap.connected_connection,
+                                                                                   flow_fix? tank_asset_id
+                                                                                           : asset_id_type())).first;
+      const resolved_connection_flow& flow = flow_itr->second;
+      connection_processor.release_to_resolved_connection(flow, release_limit);
       // Add flow to report
-      tap_flows.emplace_back(release_limit, tap_to_open, std::move(connection_path));
+      tap_flows.emplace_back(asset(release_limit, flow.asset_type), flow_fix? current_tap : tap_to_open,
+                             flow.reported_path);
       // Remove the tap from the queue to open
       pending_taps.pop();
    }
@@ -45,6 +45,8 @@ struct tap_requirement_utility_impl {
       }
    }
    map<ptnt::index_type, bool> adjusted_states;
+   // Limits of requirements which cannot change during an operation, saved from the first opening of the tap
+   map<ptnt::index_type, ptnt::asset_flow_limit> invariant_limits;
 
    tap_requirement_utility_impl(cow_db_wrapper& db, const query_evaluator& queries, ptnt::tap_id_type&& id)
       : db(db), queries(queries), tap_ID(std::move(id)) {}
@@ -64,10 +66,15 @@ tap_requirement_utility::~tap_requirement_utility() = default;
 // Get the maximum amount a particular tap_requirement will allow to be released
 class max_release_inspector {
    tap_requirement_utility_impl& data;
-   const tank_object& tank;
-   max_release_inspector(tap_requirement_utility_impl& data, const tank_object& t)
+   const cow_object<tank_object>& tank;
+   max_release_inspector(tap_requirement_utility_impl& data, const cow_object<tank_object>& t)
       : data(data), tank(t) {}
 
+   template<typename Accessory>
+   auto get_state(const ptnt::tank_accessory_address<Accessory>& address) const {
+      return tank_object::find_state(tank.accessory_states.get(), address);
+   }
+
    template<typename Requirement>
    struct Req {
       const Requirement& req;
@@ -76,16 +83,16 @@ class max_release_inspector {
 
    ptnt::asset_flow_limit operator()(const Req<ptnt::immediate_flow_limit>& req) const { return req.req.limit; }
    ptnt::asset_flow_limit operator()(const Req<ptnt::cumulative_flow_limit>& req) const {
-      const auto* state = tank.get_state(req.address);
+      const auto* state = get_state(req.address);
       if (state == nullptr)
          return req.req.limit;
       return req.req.limit - state->amount_released;
    }
    ptnt::asset_flow_limit operator()(const Req<ptnt::periodic_flow_limit>& req) const {
-      const auto* state = tank.get_state(req.address);
+      const auto* state = get_state(req.address);
       if (state == nullptr)
          return req.req.limit;
-      auto period_num = req.req.period_num_at_time(tank.creation_date, data.db.get_db().head_block_time());
+      auto period_num = req.req.period_num_at_time(tank.creation_date.get(), data.db.get_db().head_block_time());
       if (state->period_num == period_num)
          return req.req.limit - state->amount_released;
       return req.req.limit;
@@ -97,9 +104,10 @@ class max_release_inspector {
       return share_type(0);
    }
    ptnt::asset_flow_limit operator()(const Req<ptnt::minimum_tank_level>& req) const {
-      if (tank.balance <= req.req.minimum_level)
+      const share_type& balance = tank.balance.get();
+      if (balance <= req.req.minimum_level)
          return share_type(0);
-      return tank.balance - req.req.minimum_level;
+      return balance - req.req.minimum_level;
    }
    ptnt::asset_flow_limit operator()(const Req<ptnt::documentation_requirement>&) const {
       auto tank_queries = data.queries.get_tank_queries();
@@ -124,7 +132,7 @@ class max_release_inspector {
          return data.remaining_limits[req.address.requirement_index];
 
       // This is the first opening in this operation. Count up how much is allowed to release by consuming requests
-      const auto* state = tank.get_state(req.address);
+      const auto* state = get_state(req.address);
       if (state == nullptr) {
          data.remaining_limits[req.address.requirement_index] = share_type(0);
          return share_type(0);
@@ -174,39 +182,51 @@ class max_release_inspector {
       return share_type(0);
    }
    ptnt::asset_flow_limit operator()(const Req<ptnt::exchange_requirement>& req) const {
-      const auto* state = tank.get_state(req.address);
+      const auto* state = get_state(req.address);
       const auto& meter_id = req.req.meter_id;
-      tank_id_type meter_tank_id = tank.id;
+      tank_id_type meter_tank_id = *data.tap_ID.tank_id;
       if (meter_id.tank_id.valid())
          meter_tank_id = *meter_id.tank_id;
-      const tank_object& meter_tank = meter_tank_id(data.db);
-      const auto* meter_state =
-            meter_tank.get_state(ptnt::tank_accessory_address<ptnt::asset_flow_meter>{meter_id.attachment_id});
+      auto meter_tank = data.db.get(meter_tank_id);
+      const auto* meter_state = tank_object::find_state(meter_tank.accessory_states.get(),
+            ptnt::tank_accessory_address<ptnt::asset_flow_meter>{meter_id.attachment_id});
       if (meter_state == nullptr)
          return share_type(0);
 
       return req.req.max_release_amount((state == nullptr? share_type(0) : state->amount_released), *meter_state);
    }
 
+   // The limits of these requirements depend only on the requirement, the head block time and the queries, none of
+   // which change during an operation
+   using InvariantRequirements = ptnt::TL::list<ptnt::immediate_flow_limit, ptnt::time_lock,
+                                                ptnt::documentation_requirement, ptnt::hash_preimage_requirement>;
+
 public:
-   static ptnt::asset_flow_limit inspect(tap_requirement_utility_impl& data, const tank_object& tank,
+   static ptnt::asset_flow_limit inspect(tap_requirement_utility_impl& data, const cow_object<tank_object>& tank,
                                          ptnt::index_type requirement_index) {
+      auto invariant_itr = data.invariant_limits.find(requirement_index);
+      if (invariant_itr != data.invariant_limits.end())
+         return invariant_itr->second;
+
       max_release_inspector inspector(data, tank);
-      const auto& requirement = tank.schematic.taps.at(data.tap_ID.tap_id).requirements[requirement_index];
+      const auto& requirement = tank.schematic.get().taps.at(data.tap_ID.tap_id).requirements[requirement_index];
       return ptnt::TL::runtime::dispatch(ptnt::tap_requirement::list(), requirement.which(),
                                          [&inspector, &requirement, &data, requirement_index](auto t) {
          using Requirement = typename decltype(t)::type;
          ptnt::tank_accessory_address<Requirement> address{data.tap_ID.tap_id, requirement_index};
          Req<Requirement> req{requirement.get<Requirement>(), address};
-         return inspector(req);
+         ptnt::asset_flow_limit limit = inspector(req);
+         if (ptnt::TL::contains<InvariantRequirements, Requirement>())
+            data.invariant_limits[requirement_index] = limit;
+         return limit;
       });
    }
 };
 
 share_type tap_requirement_utility::max_tap_release() {
-   const tank_object& tank = my->db.get(*my->tap_ID.tank_id);
-   ptnt::asset_flow_limit tap_limit = tank.balance;
-   const auto& tap = tank.schematic.taps.at(my->tap_ID.tap_id);
+   auto tank = my->db.get(*my->tap_ID.tank_id);
+   ptnt::asset_flow_limit tap_limit = tank.balance.get();
+   const auto& tap = tank.schematic.get().taps.at(my->tap_ID.tap_id);
 
    for (ptnt::index_type i = 0; i < tap.requirements.size(); ++i) {
       auto req_limit = max_release_inspector::inspect(*my, tank, i);
@@ -233,11 +253,17 @@ optional<protocol::tnt::index_type> tap_requirement_utility::most_restrictive_re
 
 class prepare_release_inspector {
    tap_requirement_utility_impl& data;
-   tank_object& tank;
+   cow_object<tank_object> tank;
    share_type amount;
    prepare_release_inspector(tap_requirement_utility_impl& data, share_type amount)
       : data(data), tank(data.db.get(*data.tap_ID.tank_id)), amount(amount) {}
 
+   // Copies only the tank's accessory states, not the whole tank
+   template<typename Accessory>
+   auto& get_or_create_state(const ptnt::tank_accessory_address<Accessory>& address) {
+      return tank_object::get_or_create_state(tank.accessory_states.set(), address);
+   }
+
    template<typename Requirement>
    struct Req {
       const Requirement& req;
@@ -252,17 +278,21 @@ class prepare_release_inspector {
    void operator()(const Req<R>&) {}
 
    void operator()(const Req<ptnt::cumulative_flow_limit>& req) {
-      auto& state = tank.get_or_create_state(req.address);
+      auto& state = get_or_create_state(req.address);
       state.amount_released += amount;
    }
    void operator()(const Req<ptnt::periodic_flow_limit>& req) {
-      auto& state = tank.get_or_create_state(req.address);
-      auto period_num = req.req.period_num_at_time(tank.creation_date, data.db.get_db().head_block_time());
+      auto& state = get_or_create_state(req.address);
+      auto period_num = req.req.period_num_at_time(tank.creation_date.get(), data.db.get_db().head_block_time());
       if (state.period_num != period_num) {
          state.period_num = period_num;
          state.amount_released = 0;
       }
       state.amount_released += amount;
+      // Schedule the state to be deleted when the period ends
+      auto period_end = req.req.period_end_time(tank.creation_date.get(), period_num);
+      if (period_end < tank.next_state_update.get())
+         tank.next_state_update = period_end;
    }
    // Delay requirement and review requirement (collectively, the "Request Requirements") have exactly identical
    // implementations, just different types, so unify them into a single function
@@ -280,7 +310,7 @@ class prepare_release_inspector {
       // Delete the consumed requests, if it hasn't been done already
       if (data.adjusted_states[index])
          return;
-      auto& state = tank.get_or_create_state(req.address);
+      auto& state = get_or_create_state(req.address);
       auto my_queries = data.queries.get_target_queries(req.address);
       for (const ptnt::tank_query_type& query : my_queries)
          if (query.is_type<consume_query>()) {
@@ -296,21 +326,22 @@ class prepare_release_inspector {
       // Update the consumed ticket number, if it hasn't been done already
       if (data.adjusted_states[req.address.requirement_index])
          return;
-      auto& state = tank.get_or_create_state(req.address);
+      auto& state = get_or_create_state(req.address);
       auto my_queries = data.queries.get_target_queries(req.address);
       for (const ptnt::tank_query_type& query : my_queries)
          if (query.is_type<query_type>())
             state.tickets_consumed = query.get<query_type>().query_content.ticket.ticket_number + 1;
    }
    void operator()(const Req<ptnt::exchange_requirement>& req) {
-      auto& state = tank.get_or_create_state(req.address);
+      auto& state = get_or_create_state(req.address);
       state.amount_released += amount;
    }
 
 public:
    static void inspect(tap_requirement_utility_impl& data, share_type amount, ptnt::index_type requirement_index) {
       prepare_release_inspector inspector(data, amount);
-      const auto& requirement = inspector.tank.schematic.taps.at(data.tap_ID.tap_id).requirements[requirement_index];
+      const auto& requirement =
+            inspector.tank.schematic.get().taps.at(data.tap_ID.tap_id).requirements[requirement_index];
       return ptnt::TL::runtime::dispatch(ptnt::tap_requirement::list(), requirement.which(),
                                          [&inspector, &requirement, &data, requirement_index](auto t) {
          using Requirement = typename decltype(t)::type;
@@ -322,9 +353,8 @@ public:
 };
 
 void tap_requirement_utility::prepare_tap_release(share_type release_amount) {
-   const tank_object& tank = my->db.get(*my->tap_ID.tank_id);
-   ptnt::asset_flow_limit tap_limit = tank.balance;
-   const auto& tap = tank.schematic.taps.at(my->tap_ID.tap_id);
+   auto tank = my->db.get(*my->tap_ID.tank_id);
+   const auto& tap = tank.schematic.get().taps.at(my->tap_ID.tap_id);
 
    for (ptnt::index_type i = 0; i < tap.requirements.size(); ++i)
       prepare_release_inspector::inspect(*my, release_amount, i);
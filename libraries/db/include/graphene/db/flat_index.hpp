@@ -0,0 +1,305 @@
+/*
+ * Copyright (c) 2020-2023 Revolution Populi Limited, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+#include <graphene/db/index.hpp>
+#include <boost/multi_index_container.hpp>
+
+#include <type_traits>
+
+namespace graphene { namespace db {
+
+   namespace detail {
+
+      /**
+       * Keeps the optional ordered index of a flat_index up to date. OrderedIndexType is a
+       * boost::multi_index_container of const ObjectType*, its key extractors are applied through the
+       * pointer (boost::multi_index supports chained pointers in all of its key extractors).
+       */
+      template<typename ObjectType, typename OrderedIndexType>
+      struct flat_ordered_index
+      {
+         typedef typename OrderedIndexType::iterator handle_type;
+
+         OrderedIndexType _indices;
+
+         handle_type insert( const ObjectType* obj )
+         {
+            auto insert_result = _indices.insert( obj );
+            FC_ASSERT( insert_result.second, "Could not insert object, most likely a uniqueness constraint was violated" );
+            return insert_result.first;
+         }
+
+         /** Moves the entry to its new place after the object was modified, returns false (and drops the entry)
+          *  if a uniqueness constraint is violated */
+         bool update( handle_type handle )
+         {
+            return _indices.modify( handle, []( const ObjectType*& ){} );
+         }
+
+         void erase( handle_type handle ) { _indices.erase( handle ); }
+      };
+
+      template<typename ObjectType>
+      struct flat_ordered_index<ObjectType, void>
+      {
+         struct handle_type {};
+
+         handle_type insert( const ObjectType* )    { return handle_type(); }
+         bool        update( handle_type )          { return true; }
+         void        erase( handle_type )           {}
+      };
+
+   } // detail
+
+   /**
+    *  @class flat_index
+    *  @brief An index that stores objects in place, in fixed size chunks addressed by instance
+    *
+    *  Lookups by ID are a shift and a mask, and objects of neighbouring IDs share cache lines instead of being
+    *  spread over separately allocated tree nodes. Chunks are never moved or shrunk, so object addresses are
+    *  stable, but a chunk is allocated as a whole as soon as one of its instances is used. This index is
+    *  therefore meant for densely numbered objects which are rarely or never removed.
+    *
+    *  OrderedIndexType optionally adds a boost::multi_index_container of const ObjectType* for lookups by
+    *  other keys, it is available through indices().
+    */
+   template<typename ObjectType, uint8_t ChunkBits = 10, typename OrderedIndexType = void>
+   class flat_index : public index
+   {
+      static_assert( ChunkBits > 0 && ChunkBits < 24, "Chunks must hold between 2 and 2^23 objects" );
+
+      typedef detail::flat_ordered_index<ObjectType, OrderedIndexType> ordered_type;
+
+      struct slot
+      {
+         typename std::aligned_storage<sizeof(ObjectType), alignof(ObjectType)>::type storage;
+         typename ordered_type::handle_type handle;
+         bool live = false;
+
+         ObjectType&       get()       { return *reinterpret_cast<ObjectType*>( &storage );       }
+         const ObjectType& get()const  { return *reinterpret_cast<const ObjectType*>( &storage ); }
+      };
+
+      static const uint64_t chunk_size = uint64_t(1) << ChunkBits;
+      static const uint64_t mask = chunk_size - 1;
+
+      public:
+         typedef ObjectType object_type;
+
+         flat_index() = default;
+         flat_index( const flat_index& ) = delete;
+         flat_index& operator=( const flat_index& ) = delete;
+
+         virtual ~flat_index()
+         {
+            for( auto& chunk : _chunks )
+               if( chunk )
+                  for( uint64_t i = 0; i < chunk_size; ++i )
+                     if( chunk[i].live )
+                        chunk[i].get().~ObjectType();
+         }
+
+         virtual const object& insert( object&& obj )override
+         {
+            assert( nullptr != dynamic_cast<ObjectType*>(&obj) );
+            slot& s = make_slot( obj.id );
+            FC_ASSERT( !s.live, "Could not insert object, an object with id ${id} already exists", ("id",obj.id) );
+            new (&s.storage) ObjectType( std::move( static_cast<ObjectType&>(obj) ) );
+            publish( s );
+            return s.get();
+         }
+
+         virtual const object& create( const std::function<void(object&)>& constructor )override
+         {
+            ObjectType item;
+            item.id = get_next_id();
+            constructor( item );
+            item.id = get_next_id(); // just in case it changed
+            const object& result = insert( std::move(item) );
+            use_next_id();
+            return result;
+         }
+
+         virtual void modify( const object& obj, const std::function<void(object&)>& m )override
+         {
+            modify_with( obj, m );
+         }
+
+         template<typename Modifier>
+         void modify_with( const object& obj, const Modifier& m )
+         {
+            assert( nullptr != dynamic_cast<const ObjectType*>(&obj) );
+            slot* s = find_slot( obj.id );
+            FC_ASSERT( s != nullptr && &s->get() == &obj, "Could not modify object, it is not in the index" );
+            std::exception_ptr exc;
+            try {
+               m( s->get() );
+            } catch (fc::exception& e) {
+               exc = std::current_exception();
+               elog("Exception while modifying object: ${e} -- object may be corrupted", ("e", e));
+            } catch (...) {
+               exc = std::current_exception();
+               elog("Unknown exception while modifying object");
+            }
+            bool ok = _ordered.update( s->handle );
+            if( !ok )
+               destroy( *s, false ); // the ordered index dropped it already, same as generic_index would
+            if (exc)
+                std::rethrow_exception(exc);
+            FC_ASSERT(ok, "Could not modify object, most likely an index constraint was violated");
+         }
+
+         virtual void remove( const object& obj )override
+         {
+            assert( nullptr != dynamic_cast<const ObjectType*>(&obj) );
+            slot* s = find_slot( obj.id );
+            FC_ASSERT( s != nullptr, "Could not remove object, it is not in the index" );
+            destroy( *s, true );
+         }
+
+         virtual const object* find( object_id_type id )const override
+         {
+            assert( id.space() == ObjectType::space_id );
+            assert( id.type() == ObjectType::type_id );
+            const uint64_t instance = id.instance();
+            const uint64_t chunk = instance >> ChunkBits;
+            if( chunk >= _chunks.size() || !_chunks[chunk] ) return nullptr;
+            const slot& s = _chunks[chunk][instance & mask];
+            return s.live ? &s.get() : nullptr;
+         }
+
+         virtual void inspect_all_objects(std::function<void (const object&)> inspector)const override
+         {
+            try {
+               for( const auto& obj : *this )
+                  inspector( obj );
+            } FC_CAPTURE_AND_RETHROW()
+         }
+
+         class const_iterator
+         {
+            public:
+               typedef std::forward_iterator_tag iterator_category;
+               typedef ObjectType                value_type;
+               typedef std::ptrdiff_t            difference_type;
+               typedef const ObjectType*         pointer;
+               typedef const ObjectType&         reference;
+
+               const_iterator( const flat_index& idx, uint64_t pos ):_idx(&idx),_pos(pos) { skip_dead(); }
+
+               friend bool operator==( const const_iterator& a, const const_iterator& b ) { return a._pos == b._pos; }
+               friend bool operator!=( const const_iterator& a, const const_iterator& b ) { return a._pos != b._pos; }
+               const ObjectType& operator*()const  { return _idx->_chunks[_pos >> ChunkBits][_pos & mask].get(); }
+               const ObjectType* operator->()const { return &**this; }
+               const_iterator operator++(int)     // postfix
+               {
+                  const_iterator result( *this );
+                  ++(*this);
+                  return result;
+               }
+               const_iterator& operator++()       // prefix
+               {
+                  ++_pos;
+                  skip_dead();
+                  return *this;
+               }
+
+            private:
+               void skip_dead()
+               {
+                  const uint64_t end = _idx->_chunks.size() << ChunkBits;
+                  while( _pos < end )
+                  {
+                     const auto& chunk = _idx->_chunks[_pos >> ChunkBits];
+                     if( !chunk )
+                        _pos = ( (_pos >> ChunkBits) + 1 ) << ChunkBits;
+                     else if( !chunk[_pos & mask].live )
+                        ++_pos;
+                     else
+                        return;
+                  }
+                  _pos = end;
+               }
+
+               const flat_index* _idx;
+               uint64_t          _pos;
+         };
+         const_iterator begin()const { return const_iterator( *this, 0 ); }
+         const_iterator end()const   { return const_iterator( *this, _chunks.size() << ChunkBits ); }
+
+         /// number of objects in the index
+         size_t size()const { return _size; }
+
+         /// the ordered index, only available if OrderedIndexType is given
+         template<typename O = OrderedIndexType>
+         const O& indices()const { return _ordered._indices; }
+
+      private:
+         slot* find_slot( object_id_type id )
+         {
+            const uint64_t instance = id.instance();
+            const uint64_t chunk = instance >> ChunkBits;
+            if( chunk >= _chunks.size() || !_chunks[chunk] ) return nullptr;
+            slot& s = _chunks[chunk][instance & mask];
+            return s.live ? &s : nullptr;
+         }
+
+         slot& make_slot( object_id_type id )
+         {
+            const uint64_t instance = id.instance();
+            const uint64_t chunk = instance >> ChunkBits;
+            if( chunk >= _chunks.size() )
+               _chunks.resize( chunk + 1 );
+            if( !_chunks[chunk] )
+               _chunks[chunk].reset( new slot[chunk_size] );
+            return _chunks[chunk][instance & mask];
+         }
+
+         void publish( slot& s )
+         {
+            try {
+               s.handle = _ordered.insert( &s.get() );
+            } catch( ... ) {
+               s.get().~ObjectType();
+               throw;
+            }
+            s.live = true;
+            ++_size;
+         }
+
+         void destroy( slot& s, bool erase_ordered )
+         {
+            if( erase_ordered )
+               _ordered.erase( s.handle );
+            s.get().~ObjectType();
+            s.live = false;
+            --_size;
+         }
+
+         vector< unique_ptr<slot[]> > _chunks;
+         ordered_type                 _ordered;
+         size_t                       _size = 0;
+   };
+
+} } // graphene::db
@@ -66,6 +66,13 @@ namespace graphene { namespace db {
          }
 
          virtual void modify( const object& obj, const std::function<void(object&)>& m )override
+         {
+            modify_with( obj, m );
+         }
+
+         /// Same as modify(), with the modifier called directly instead of through a std::function
+         template<typename Modifier>
+         void modify_with( const object& obj, const Modifier& m )
          {
             assert(nullptr != dynamic_cast<const ObjectType*>(&obj));
             std::exception_ptr exc;
@@ -36,6 +36,49 @@ namespace graphene { namespace db {
    class object_database;
    using fc::path;
 
+   namespace detail {
+      /// Identifies an index file in checkpoint format, as opposed to the legacy format which starts with the next id
+      const uint64_t checkpoint_magic          = 0x54504b4348505247ULL; // "GRPHCKPT"
+      const uint32_t checkpoint_format_version = 1;
+
+      /** Computes the checksum stored at the end of a checkpoint, on data of any size */
+      inline fc::sha256 checkpoint_checksum( const char* data, size_t size )
+      {
+         fc::sha256::encoder enc;
+         const size_t max_chunk = 1 << 30;
+         while( size > 0 )
+         {
+            const size_t chunk = std::min( size, max_chunk );
+            enc.write( data, uint32_t(chunk) );
+            data += chunk;
+            size -= chunk;
+         }
+         return enc.result();
+      }
+
+      /** Stream for fc::raw::pack which writes through to a std::ostream while hashing everything written */
+      class checksum_ostream
+      {
+         public:
+            explicit checksum_ostream( std::ostream& out ) : _out(out) {}
+
+            void write( const char* data, size_t size )
+            {
+               _out.write( data, size );
+               _enc.write( data, uint32_t(size) );
+            }
+            void put( char c )
+            {
+               _out.put( c );
+               _enc.put( c );
+            }
+            fc::sha256 checksum() { return _enc.result(); }
+         private:
+            std::ostream&       _out;
+            fc::sha256::encoder _enc;
+      };
+   }
+
    /**
     * @class index_observer
     * @brief used to get callbacks when objects change
@@ -98,6 +141,13 @@ namespace graphene { namespace db {
           */
          virtual void open( const fc::path& db ) = 0;
          virtual void save( const fc::path& db ) = 0;
+         /** Writes the same data as save() to a stream, the result can later be passed to open() as a file */
+         virtual void save( std::ostream& out )const = 0;
+
+         /** @return whether the index may have changed since it was last opened or saved */
+         virtual bool is_dirty()const { return true; }
+         /** Marks the index as identical to its saved state, until the next change */
+         virtual void clear_dirty() {}
 
 
 
@@ -136,6 +186,45 @@ namespace graphene { namespace db {
          virtual void               object_default( object& obj )const = 0;
    };
 
+   /**
+    *  A non-owning reference to a callable which modifies an ObjectType. Unlike std::function it neither allocates
+    *  nor copies the callable, the referenced callable must outlive the modifier.
+    */
+   template<typename ObjectType>
+   class object_modifier
+   {
+      public:
+         template<typename Lambda>
+         object_modifier( const Lambda& l ):_callable(&l),_call(&call<Lambda>){}
+
+         void operator()( ObjectType& obj )const { _call( _callable, obj ); }
+
+      private:
+         template<typename Lambda>
+         static void call( const void* l, ObjectType& obj ) { (*static_cast<const Lambda*>(l))( obj ); }
+
+         const void* _callable;
+         void (*_call)( const void*, ObjectType& );
+   };
+
+   /** Common base of all typed_index instances, lets object_database keep them in one table */
+   class typed_index_base
+   {
+      public:
+         virtual ~typed_index_base(){}
+   };
+
+   /**
+    *  Modification entry point of an index which knows the type of its objects. object_database::modify uses it
+    *  to hand the modifier over without wrapping it in a std::function.
+    */
+   template<typename ObjectType>
+   class typed_index : public typed_index_base
+   {
+      public:
+         virtual void modify_object( const ObjectType& obj, object_modifier<ObjectType> m ) = 0;
+   };
+
    class secondary_index
    {
       public:
@@ -187,6 +276,8 @@ namespace graphene { namespace db {
       protected:
          vector< shared_ptr<index_observer> >   _observers;
          vector< unique_ptr<secondary_index> >  _sindex;
+         /// Set by every change which goes through the undo hooks, cleared when the index is saved
+         bool                                   _dirty = false;
 
       private:
          object_database& _db;
@@ -306,7 +397,8 @@ namespace graphene { namespace db {
     *  @see http://en.wikipedia.org/wiki/Curiously_recurring_template_pattern
     */
    template<typename DerivedIndex, uint8_t DirectBits = 0>
-   class primary_index  : public DerivedIndex, public base_primary_index
+   class primary_index  : public DerivedIndex, public base_primary_index,
+                          public typed_index<typename DerivedIndex::object_type>
    {
       public:
          typedef typename DerivedIndex::object_type object_type;
@@ -325,8 +417,11 @@ namespace graphene { namespace db {
          { return object_type::type_id; }
 
          virtual object_id_type get_next_id()const override              { return _next_id;    }
-         virtual void           use_next_id()override                    { ++_next_id.number;  }
-         virtual void           set_next_id( object_id_type id )override { _next_id = id;      }
+         virtual void           use_next_id()override                    { ++_next_id.number; _dirty = true; }
+         virtual void           set_next_id( object_id_type id )override { _next_id = id; _dirty = true;     }
+
+         virtual bool           is_dirty()const override                 { return _dirty;      }
+         virtual void           clear_dirty()override                    { _dirty = false;     }
 
          /** @return the object with id or nullptr if not found */
          virtual const object*  find( object_id_type id )const override
@@ -347,18 +442,16 @@ namespace graphene { namespace db {
             if( !fc::exists( db ) ) return;
             fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
             fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(db) );
-            fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
-            fc::sha256 open_ver;
-
-            fc::raw::unpack(ds, _next_id);
-            fc::raw::unpack(ds, open_ver);
-            FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
-            vector<char> tmp;
-            while( ds.remaining() > 0 )
-            {
-               fc::raw::unpack( ds, tmp );
-               load( tmp );
-            }
+            const char* data = (const char*)mr.get_address();
+            const size_t size = mr.get_size();
+
+            uint64_t magic = 0;
+            if( size >= sizeof(magic) )
+               memcpy( &magic, data, sizeof(magic) );
+            if( magic == detail::checkpoint_magic )
+               open_checkpoint( db, data, size );
+            else
+               open_legacy( data, size );
          }
 
          virtual void save( const path& db ) override 
@@ -366,25 +459,39 @@ namespace graphene { namespace db {
             std::ofstream out( db.generic_string(), 
                                std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
             FC_ASSERT( out );
+            save( out );
+            out.flush();
+            FC_ASSERT( out, "Error writing ${db}", ("db",db) );
+         }
+
+         /**
+          * Writes the index in checkpoint format: a header, every object packed back to back, and a checksum of
+          * the packed objects.
+          */
+         virtual void save( std::ostream& out )const override
+         {
+            uint64_t count = 0;
+            this->inspect_all_objects( [&count]( const object& ) { ++count; } );
+
             auto ver  = get_object_version();
+            fc::raw::pack( out, detail::checkpoint_magic );
+            fc::raw::pack( out, detail::checkpoint_format_version );
             fc::raw::pack( out, _next_id );
             fc::raw::pack( out, ver );
-            this->inspect_all_objects( [&]( const object& o ) {
-                auto vec = fc::raw::pack( static_cast<const object_type&>(o) );
-                auto packed_vec = fc::raw::pack( vec );
-                out.write( packed_vec.data(), packed_vec.size() );
+            fc::raw::pack( out, count );
+
+            detail::checksum_ostream payload( out );
+            this->inspect_all_objects( [&payload]( const object& o ) {
+                fc::raw::pack( payload, static_cast<const object_type&>(o) );
             });
+            fc::raw::pack( out, payload.checksum() );
          }
 
          virtual const object&  load( const std::vector<char>& data )override
          {
-            const auto& result = DerivedIndex::insert( fc::raw::unpack<object_type>( data ) );
-            for( const auto& item : _sindex )
-               item->object_inserted( result );
-            return result;
+            return load_object( fc::raw::unpack<object_type>( data ) );
          }
 
-
          virtual const object&  create(const std::function<void(object&)>& constructor )override
          {
             const auto& result = DerivedIndex::create( constructor );
@@ -413,13 +520,12 @@ namespace graphene { namespace db {
 
          virtual void modify( const object& obj, const std::function<void(object&)>& m )override
          {
-            save_undo( obj );
-            for( const auto& item : _sindex )
-               item->about_to_modify( obj );
-            DerivedIndex::modify( obj, m );
-            for( const auto& item : _sindex )
-               item->object_modified( obj );
-            on_modify( obj );
+            modify_with( obj, m );
+         }
+
+         virtual void modify_object( const object_type& obj, object_modifier<object_type> m )override
+         {
+            modify_with( obj, m );
          }
 
          virtual void add_observer( const shared_ptr<index_observer>& o ) override
@@ -446,8 +552,89 @@ namespace graphene { namespace db {
          }
 
       private:
+         /**
+          * The direct index, if any, is the first secondary index. It is notified through a non-virtual call, the
+          * others are only known at runtime.
+          */
+         template<typename Modifier>
+         void modify_with( const object& obj, const Modifier& m )
+         {
+            const size_t first_dynamic = DirectBits > 0 ? 1 : 0;
+            save_undo( obj );
+            if( DirectBits > 0 )
+               _direct_by_id->direct_index< object_type, DirectBits >::about_to_modify( obj );
+            for( size_t i = first_dynamic; i < _sindex.size(); ++i )
+               _sindex[i]->about_to_modify( obj );
+            DerivedIndex::modify_with( obj, m );
+            if( DirectBits > 0 )
+               _direct_by_id->direct_index< object_type, DirectBits >::object_modified( obj );
+            for( size_t i = first_dynamic; i < _sindex.size(); ++i )
+               _sindex[i]->object_modified( obj );
+            if( !_observers.empty() )
+               on_modify( obj );
+         }
+
+         const object& load_object( object_type&& obj )
+         {
+            const auto& result = DerivedIndex::insert( std::move( obj ) );
+            for( const auto& item : _sindex )
+               item->object_inserted( result );
+            return result;
+         }
+
+         void open_checkpoint( const path& db, const char* data, size_t size )
+         {
+            fc::datastream<const char*> ds( data, size );
+            uint64_t magic;
+            uint32_t format;
+            fc::sha256 open_ver;
+            uint64_t count;
+            fc::raw::unpack( ds, magic );
+            fc::raw::unpack( ds, format );
+            FC_ASSERT( format == detail::checkpoint_format_version, "Unsupported checkpoint format ${f} in ${db}",
+                       ("f",format)("db",db) );
+            fc::raw::unpack( ds, _next_id );
+            fc::raw::unpack( ds, open_ver );
+            FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
+            fc::raw::unpack( ds, count );
+
+            FC_ASSERT( ds.remaining() >= sizeof(fc::sha256), "Truncated checkpoint ${db}", ("db",db) );
+            const char* payload = data + ( size - ds.remaining() );
+            const size_t payload_size = ds.remaining() - sizeof(fc::sha256);
+            fc::sha256 checksum;
+            memcpy( checksum.data(), payload + payload_size, sizeof(fc::sha256) );
+            FC_ASSERT( detail::checkpoint_checksum( payload, payload_size ) == checksum,
+                       "Checksum mismatch in checkpoint ${db}", ("db",db) );
+
+            fc::datastream<const char*> objects( payload, payload_size );
+            for( uint64_t i = 0; i < count; ++i )
+            {
+               object_type obj;
+               fc::raw::unpack( objects, obj );
+               load_object( std::move( obj ) );
+            }
+            FC_ASSERT( objects.remaining() == 0, "Trailing data in checkpoint ${db}", ("db",db) );
+         }
+
+         /// Format used before checkpoints, every object is packed into a vector which is packed again
+         void open_legacy( const char* data, size_t size )
+         {
+            fc::datastream<const char*> ds( data, size );
+            fc::sha256 open_ver;
+
+            fc::raw::unpack(ds, _next_id);
+            fc::raw::unpack(ds, open_ver);
+            FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
+            vector<char> tmp;
+            while( ds.remaining() > 0 )
+            {
+               fc::raw::unpack( ds, tmp );
+               load( tmp );
+            }
+         }
+
          object_id_type                                 _next_id;
-         const direct_index< object_type, DirectBits >* _direct_by_id = nullptr;
+         direct_index< object_type, DirectBits >*       _direct_by_id = nullptr;
    };
 
 } } // graphene::db
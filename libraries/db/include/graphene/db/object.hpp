@@ -73,6 +73,8 @@ namespace graphene { namespace db {
          virtual void               move_from( object& obj ) = 0;
          virtual variant            to_variant()const  = 0;
          virtual vector<char>       pack()const = 0;
+         /// replaces the content of this object with data produced by pack()
+         virtual void               unpack_from( const vector<char>& data ) = 0;
    };
 
    /**
@@ -97,6 +99,10 @@ namespace graphene { namespace db {
          }
          virtual variant to_variant()const { return variant( static_cast<const DerivedClass&>(*this), MAX_NESTING ); }
          virtual vector<char> pack()const  { return fc::raw::pack( static_cast<const DerivedClass&>(*this) ); }
+         virtual void    unpack_from( const vector<char>& data )
+         {
+            static_cast<DerivedClass&>(*this) = fc::raw::unpack<DerivedClass>( data );
+         }
    };
 
    typedef flat_map<uint8_t, object_id_type> annotation_map;
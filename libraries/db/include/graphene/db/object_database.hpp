@@ -42,12 +42,13 @@ namespace graphene { namespace db {
          object_database();
          ~object_database();
 
-         void reset_indexes() { _index.clear(); _index.resize(255); }
+         void reset_indexes() { _index.clear(); _index.resize(255); _typed_index.clear(); _typed_index.resize(255); }
 
          void open(const fc::path& data_dir );
 
          /**
-          * Saves the complete state of the object_database to disk, this could take a while
+          * Saves the complete state of the object_database to disk. Only indexes which have changed since they were
+          * last opened or saved are rewritten, the others are carried over from the previous checkpoint.
           */
          void flush();
          void wipe(const fc::path& data_dir); // remove from disk
@@ -75,6 +76,8 @@ namespace graphene { namespace db {
          const index&  get_index()const { return get_index(T::space_id,T::type_id); }
          const index&  get_index(uint8_t space_id, uint8_t type_id)const;
          const index&  get_index(object_id_type id)const { return get_index(id.space(),id.type()); }
+         /** Calls inspector for every index which has been added */
+         void          inspect_all_indexes( const std::function<void(const index&)>& inspector )const;
          /// @}
 
          const object& get_object( object_id_type id )const;
@@ -88,7 +91,7 @@ namespace graphene { namespace db {
          void          remove( const object& obj ) { get_mutable_index(obj.id).remove( obj ); }
          template<typename T, typename Lambda>
          void modify( const T& obj, const Lambda& m ) {
-            get_mutable_index(obj.id).modify(obj,m);
+            modify_dispatch( obj, m, std::integral_constant< bool, !std::is_same<T, object>::value >() );
          }
 
          ///@}
@@ -140,7 +143,9 @@ namespace graphene { namespace db {
             assert(!_index[ObjectType::space_id][ObjectType::type_id]);
             unique_ptr<index> indexptr( std::make_unique<IndexType>(*this) );
             _index[ObjectType::space_id][ObjectType::type_id] = std::move(indexptr);
-            return static_cast<IndexType*>(_index[ObjectType::space_id][ObjectType::type_id].get());
+            IndexType* result = static_cast<IndexType*>(_index[ObjectType::space_id][ObjectType::type_id].get());
+            set_typed_index<ObjectType>( result, std::is_base_of< typed_index<ObjectType>, IndexType >() );
+            return result;
          }
 
          template<typename IndexType, typename SecondaryIndexType, typename... Args>
@@ -167,6 +172,32 @@ namespace graphene { namespace db {
          index& get_mutable_index(uint8_t space_id, uint8_t type_id);
 
      private:
+         template<typename T, typename Lambda>
+         void modify_dispatch( const T& obj, const Lambda& m, std::true_type )
+         {
+            assert( obj.id.space() == T::space_id && obj.id.type() == T::type_id );
+            typed_index_base* typed = _typed_index[T::space_id].size() > T::type_id
+                                      ? _typed_index[T::space_id][T::type_id] : nullptr;
+            if( typed != nullptr )
+               static_cast< typed_index<T>* >( typed )->modify_object( obj, m );
+            else
+               get_mutable_index(obj.id).modify(obj,m);
+         }
+         template<typename T, typename Lambda>
+         void modify_dispatch( const T& obj, const Lambda& m, std::false_type )
+         {
+            get_mutable_index(obj.id).modify(obj,m);
+         }
+
+         template<typename ObjectType, typename IndexType>
+         void set_typed_index( IndexType* idx, std::true_type )
+         {
+            if( _typed_index[ObjectType::space_id].size() <= ObjectType::type_id )
+               _typed_index[ObjectType::space_id].resize( 255 );
+            _typed_index[ObjectType::space_id][ObjectType::type_id] = static_cast< typed_index<ObjectType>* >( idx );
+         }
+         template<typename ObjectType, typename IndexType>
+         void set_typed_index( IndexType* idx, std::false_type ) {}
 
          friend class base_primary_index;
          friend class undo_database;
@@ -176,6 +207,10 @@ namespace graphene { namespace db {
 
          fc::path                                                  _data_dir;
          vector< vector< unique_ptr<index> > >                     _index;
+         /// The same indexes as _index, for those which accept modifiers of their object type directly
+         vector< vector< typed_index_base* > >                     _typed_index;
+         /// Set until the on-disk state is known to match all clean indexes
+         bool                                                      _full_flush_needed = true;
    };
 
 } } // graphene::db
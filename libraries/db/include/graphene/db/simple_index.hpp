@@ -54,9 +54,15 @@ namespace graphene { namespace db {
          }
 
          virtual void modify( const object& obj, const std::function<void(object&)>& modify_callback ) override
+         {
+            modify_with( obj, modify_callback );
+         }
+
+         template<typename Modifier>
+         void modify_with( const object& obj, const Modifier& modify_callback )
          {
             assert( obj.id.instance() < _objects.size() );
-            modify_callback( *_objects[obj.id.instance()] );
+            modify_callback( static_cast<T&>( *_objects[obj.id.instance()] ) );
          }
 
          virtual const object& insert( object&& obj )override
@@ -24,6 +24,8 @@
 #pragma once
 #include <graphene/db/object.hpp>
 #include <deque>
+#include <unordered_map>
+#include <unordered_set>
 #include <fc/exception/exception.hpp>
 
 namespace graphene { namespace db {
@@ -32,12 +34,115 @@ namespace graphene { namespace db {
    using fc::flat_set;
    class object_database;
 
+   /**
+    * @brief Recycles the small, fixed size nodes of the undo state containers
+    *
+    * Undo states are created and discarded for every transaction and every block, and nearly all of their
+    * allocations are hash nodes of a handful of sizes. Freed nodes go to per-size free lists, new ones are
+    * carved from large blocks, so in steady state the undo database does not hit the general allocator.
+    * Not thread safe, like the undo database itself.
+    */
+   class undo_memory_pool
+   {
+      public:
+         undo_memory_pool() = default;
+         undo_memory_pool( const undo_memory_pool& ) = delete;
+         undo_memory_pool& operator=( const undo_memory_pool& ) = delete;
+
+         void*  allocate( size_t size );
+         void   deallocate( void* p, size_t size );
+
+         /// bytes handed out and not yet returned, including large allocations which bypass the pool
+         size_t used_bytes()const     { return _used; }
+         /// bytes held in pool blocks
+         size_t reserved_bytes()const { return _blocks.size() * block_size; }
+
+      private:
+         static const size_t block_size    = 64 * 1024;
+         static const size_t granularity   = 16;
+         static const size_t max_node_size = 256;
+
+         struct free_node { free_node* next; };
+
+         free_node*                          _free[ max_node_size / granularity ] = {};
+         std::vector< std::unique_ptr<char[]> > _blocks;
+         size_t                              _block_used = block_size;
+         size_t                              _used = 0;
+   };
+
+   /** Allocator for the undo state containers, all of which share the pool of their undo database */
+   template<typename T>
+   class undo_allocator
+   {
+      public:
+         typedef T value_type;
+
+         explicit undo_allocator( undo_memory_pool& pool ) : _pool(&pool) {}
+         template<typename U>
+         undo_allocator( const undo_allocator<U>& other ) : _pool(other._pool) {}
+
+         T*   allocate( size_t n )           { return static_cast<T*>( _pool->allocate( n * sizeof(T) ) ); }
+         void deallocate( T* p, size_t n )   { _pool->deallocate( p, n * sizeof(T) ); }
+
+         template<typename U>
+         bool operator==( const undo_allocator<U>& other )const { return _pool == other._pool; }
+         template<typename U>
+         bool operator!=( const undo_allocator<U>& other )const { return _pool != other._pool; }
+
+      private:
+         template<typename U> friend class undo_allocator;
+         undo_memory_pool* _pool;
+   };
+
+   /// The value of an object before it was modified, either as a full copy or in packed form
+   struct undo_value
+   {
+      unique_ptr<object> copy;
+      vector<char>       packed;
+   };
+
    struct undo_state
    {
-      unordered_map<object_id_type, unique_ptr<object> > old_values;
-      unordered_map<object_id_type, object_id_type>      old_index_next_ids;
-      std::unordered_set<object_id_type>                 new_ids;
-      unordered_map<object_id_type, unique_ptr<object> > removed;
+      template<typename K, typename V>
+      using map_type = unordered_map< K, V, std::hash<K>, std::equal_to<K>, undo_allocator< std::pair<const K, V> > >;
+      using set_type = std::unordered_set< object_id_type, std::hash<object_id_type>, std::equal_to<object_id_type>,
+                                           undo_allocator<object_id_type> >;
+
+      explicit undo_state( undo_memory_pool& pool )
+      : old_values( undo_allocator< std::pair<const object_id_type, undo_value> >( pool ) ),
+        old_index_next_ids( undo_allocator< std::pair<const object_id_type, object_id_type> >( pool ) ),
+        new_ids( undo_allocator<object_id_type>( pool ) ),
+        removed( undo_allocator< std::pair<const object_id_type, unique_ptr<object>> >( pool ) )
+      {}
+
+      /// Empties the state but keeps its hash tables allocated for reuse
+      void clear()
+      {
+         old_values.clear();
+         old_index_next_ids.clear();
+         new_ids.clear();
+         removed.clear();
+         packed_bytes = 0;
+      }
+
+      map_type<object_id_type, undo_value>          old_values;
+      map_type<object_id_type, object_id_type>      old_index_next_ids;
+      set_type                                      new_ids;
+      map_type<object_id_type, unique_ptr<object>>  removed;
+      /// total size of the packed values in old_values
+      size_t                                        packed_bytes = 0;
+   };
+
+   /// Memory usage counters of the undo database
+   struct undo_stats
+   {
+      uint64_t states = 0;
+      uint64_t old_values = 0;
+      uint64_t new_ids = 0;
+      uint64_t removed = 0;
+      uint64_t packed_bytes = 0;
+      uint64_t pool_used_bytes = 0;
+      uint64_t pool_reserved_bytes = 0;
    };
 
 
@@ -121,18 +226,44 @@ namespace graphene { namespace db {
          size_t max_size()const { return _max_size; }
          uint32_t active_sessions()const { return _active_sessions; }
 
+         /**
+          * Whether to keep the old values of modified objects packed instead of as full copies. Packed values
+          * take much less memory for objects with large containers, at the cost of unpacking them on undo.
+          */
+         void set_packed_values( bool packed ) { _packed_values = packed; }
+         bool packed_values()const { return _packed_values; }
+
          const undo_state& head()const;
 
+         /// Counters for the head state only
+         undo_stats head_stats()const;
+         /// Counters summed over all states
+         undo_stats stats()const;
+
       private:
          void undo();
          void merge();
          void commit();
 
+         void push_state();
+         void pop_state_front();
+         void pop_state_back();
+         void restore_state( undo_state& state );
+
+         /// maximum number of emptied states kept around for reuse
+         static const size_t max_spare_states = 16;
+
          uint32_t                _active_sessions = 0;
          bool                    _disabled = true;
+         bool                    _packed_values = false;
+         undo_memory_pool        _pool;
          std::deque<undo_state>  _stack;
+         std::vector<undo_state> _spare_states;
          object_database&        _db;
          size_t                  _max_size = 256;
    };
 
 } } // graphene::db
+
+FC_REFLECT( graphene::db::undo_stats,
+            (states)(old_values)(new_ids)(removed)(packed_bytes)(pool_used_bytes)(pool_reserved_bytes) )
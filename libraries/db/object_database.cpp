@@ -27,12 +27,15 @@
 #include <fc/container/flat.hpp>
 #include <fc/thread/parallel.hpp>
 
+#include <boost/filesystem.hpp>
+
 namespace graphene { namespace db {
 
 object_database::object_database()
 :_undo_db(*this)
 {
    _index.resize(255);
+   _typed_index.resize(255);
    _undo_db.enable();
 }
 
@@ -59,6 +62,14 @@ const index& object_database::get_index(uint8_t space_id, uint8_t type_id)const
    FC_ASSERT( tmp );
    return *tmp;
 }
+void object_database::inspect_all_indexes( const std::function<void(const index&)>& inspector )const
+{
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            inspector( *idx );
+}
+
 index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
 {
    FC_ASSERT( _index.size() > space_id, "", ("space_id",space_id)("type_id",type_id)("index.size",_index.size()) );
@@ -71,26 +82,52 @@ index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
 void object_database::flush()
 {
 //   ilog("Save object_database in ${d}", ("d", _data_dir));
-   fc::create_directories( _data_dir / "object_database.tmp" / "lock" );
+   const fc::path current_dir = _data_dir / "object_database";
+   const fc::path tmp_dir = _data_dir / "object_database.tmp";
+   // leftovers of an interrupted flush would get in the way of the hard links below
+   fc::remove_all( tmp_dir );
+   fc::create_directories( tmp_dir / "lock" );
    std::vector<fc::future<void>> tasks;
    tasks.reserve(200);
+   std::vector<index*> saved;
+   saved.reserve(200);
+   uint32_t reused = 0;
    for( uint32_t space = 0; space < _index.size(); ++space )
    {
-      fc::create_directories( _data_dir / "object_database.tmp" / fc::to_string(space) );
+      fc::create_directories( tmp_dir / fc::to_string(space) );
       const auto types = _index[space].size();
       for( uint32_t type = 0; type  <  types; ++type )
          if( _index[space][type] )
-            tasks.push_back( fc::do_parallel( [this,space,type] () {
-               _index[space][type]->save( _data_dir / "object_database.tmp" / fc::to_string(space)/fc::to_string(type) );
+         {
+            const fc::path file = fc::path( fc::to_string(space) ) / fc::to_string(type);
+            // Unchanged indexes are carried over from the previous checkpoint without rewriting them
+            if( !_full_flush_needed && !_index[space][type]->is_dirty() && fc::exists( current_dir / file ) )
+            {
+               boost::system::error_code ec;
+               boost::filesystem::create_hard_link( current_dir / file, tmp_dir / file, ec );
+               if( ec )
+                  fc::copy( current_dir / file, tmp_dir / file );
+               ++reused;
+               continue;
+            }
+            saved.push_back( _index[space][type].get() );
+            tasks.push_back( fc::do_parallel( [this,space,type,&tmp_dir,file] () {
+               _index[space][type]->save( tmp_dir / file );
             } ) );
+         }
    }
    for( auto& task : tasks )
       task.wait();
-   fc::remove_all( _data_dir / "object_database.tmp" / "lock" );
-   if( fc::exists( _data_dir / "object_database" ) )
-      fc::rename( _data_dir / "object_database", _data_dir / "object_database.old" );
-   fc::rename( _data_dir / "object_database.tmp", _data_dir / "object_database" );
+   fc::remove_all( tmp_dir / "lock" );
+   if( fc::exists( current_dir ) )
+      fc::rename( current_dir, _data_dir / "object_database.old" );
+   fc::rename( tmp_dir, current_dir );
    fc::remove_all( _data_dir / "object_database.old" );
+
+   for( auto idx : saved )
+      idx->clear_dirty();
+   _full_flush_needed = false;
+   dlog( "Flushed object database: wrote ${w} indexes, kept ${k} unchanged", ("w",saved.size())("k",reused) );
 }
 
 void object_database::wipe(const fc::path& data_dir)
@@ -98,6 +135,7 @@ void object_database::wipe(const fc::path& data_dir)
    close();
    ilog("Wiping object database...");
    fc::remove_all(data_dir / "object_database");
+   _full_flush_needed = true;
    ilog("Done wiping object database.");
 }
 
@@ -120,6 +158,7 @@ void object_database::open(const fc::path& data_dir)
             } ) );
    for( auto& task : tasks )
       task.wait();
+   _full_flush_needed = false;
    ilog( "Done opening object database." );
 
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
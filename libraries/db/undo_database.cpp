@@ -28,6 +28,45 @@
 
 namespace graphene { namespace db {
 
+void* undo_memory_pool::allocate( size_t size )
+{
+   _used += size;
+   if( size > max_node_size )
+      return ::operator new( size );
+
+   size_t slot = ( size + granularity - 1 ) / granularity - 1;
+   if( _free[slot] != nullptr )
+   {
+      free_node* node = _free[slot];
+      _free[slot] = node->next;
+      return node;
+   }
+
+   size_t node_size = ( slot + 1 ) * granularity;
+   if( _block_used + node_size > block_size )
+   {
+      _blocks.emplace_back( new char[block_size] );
+      _block_used = 0;
+   }
+   void* result = _blocks.back().get() + _block_used;
+   _block_used += node_size;
+   return result;
+}
+
+void undo_memory_pool::deallocate( void* p, size_t size )
+{
+   _used -= size;
+   if( size > max_node_size )
+   {
+      ::operator delete( p );
+      return;
+   }
+   size_t slot = ( size + granularity - 1 ) / granularity - 1;
+   free_node* node = static_cast<free_node*>( p );
+   node->next = _free[slot];
+   _free[slot] = node;
+}
+
 void undo_database::enable()  { _disabled = false; }
 void undo_database::disable() { _disabled = true; }
 
@@ -44,6 +83,33 @@ undo_database::session::~session()
    if( _disable_on_exit ) _db.disable();
 }
 
+void undo_database::push_state()
+{
+   if( _spare_states.empty() )
+      _stack.emplace_back( _pool );
+   else
+   {
+      _stack.emplace_back( std::move( _spare_states.back() ) );
+      _spare_states.pop_back();
+   }
+}
+
+void undo_database::pop_state_front()
+{
+   _stack.front().clear();
+   if( _spare_states.size() < max_spare_states )
+      _spare_states.emplace_back( std::move( _stack.front() ) );
+   _stack.pop_front();
+}
+
+void undo_database::pop_state_back()
+{
+   _stack.back().clear();
+   if( _spare_states.size() < max_spare_states )
+      _spare_states.emplace_back( std::move( _stack.back() ) );
+   _stack.pop_back();
+}
+
 undo_database::session undo_database::start_undo_session( bool force_enable )
 {
    if( _disabled && !force_enable ) return session(*this);
@@ -52,9 +118,9 @@ undo_database::session undo_database::start_undo_session( bool force_enable )
       _disabled = false;
 
    while( size() > max_size() )
-      _stack.pop_front();
+      pop_state_front();
 
-   _stack.emplace_back();
+   push_state();
    ++_active_sessions;
    return session(*this, disable_on_exit );
 }
@@ -63,7 +129,7 @@ void undo_database::on_create( const object& obj )
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    auto& state = _stack.back();
    auto index_id = object_id_type( obj.id.space(), obj.id.type(), 0 );
    auto itr = state.old_index_next_ids.find( index_id );
@@ -76,46 +142,64 @@ void undo_database::on_modify( const object& obj )
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    auto& state = _stack.back();
    if( state.new_ids.find(obj.id) != state.new_ids.end() )
       return;
    auto itr =  state.old_values.find(obj.id);
    if( itr != state.old_values.end() ) return;
-   state.old_values[obj.id] = obj.clone();
+   undo_value& value = state.old_values[obj.id];
+   if( _packed_values )
+   {
+      value.packed = obj.pack();
+      state.packed_bytes += value.packed.size();
+   }
+   else
+      value.copy = obj.clone();
 }
 void undo_database::on_remove( const object& obj )
 {
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    undo_state& state = _stack.back();
    if( state.new_ids.count(obj.id) > 0 )
    {
       state.new_ids.erase(obj.id);
       return;
    }
-   if( state.old_values.count(obj.id) > 0 )
+   auto itr = state.old_values.find(obj.id);
+   if( itr != state.old_values.end() )
    {
-      state.removed[obj.id] = std::move(state.old_values[obj.id]);
-      state.old_values.erase(obj.id);
+      undo_value& value = itr->second;
+      if( value.copy )
+         state.removed[obj.id] = std::move(value.copy);
+      else
+      {
+         // the removed object is still intact, turn it back into the value it had before the modification
+         unique_ptr<object> old = obj.clone();
+         old->unpack_from( value.packed );
+         state.packed_bytes -= value.packed.size();
+         state.removed[obj.id] = std::move(old);
+      }
+      state.old_values.erase(itr);
       return;
    }
    if( state.removed.count(obj.id) > 0 ) return;
    state.removed[obj.id] = obj.clone();
 }
 
-void undo_database::undo()
-{ try {
-   FC_ASSERT( !_disabled );
-   FC_ASSERT( _active_sessions > 0 );
-   disable();
-
-   auto& state = _stack.back();
+void undo_database::restore_state( undo_state& state )
+{
    for( auto& item : state.old_values )
    {
-      _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
+      _db.modify( _db.get_object( item.first ), [&]( object& obj ){
+         if( item.second.copy )
+            obj.move_from( *item.second.copy );
+         else
+            obj.unpack_from( item.second.packed );
+      } );
    }
 
    for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
@@ -130,8 +214,17 @@ void undo_database::undo()
 
    for( auto& item : state.removed )
       _db.insert( std::move(*item.second) );
+}
 
-   _stack.pop_back();
+void undo_database::undo()
+{ try {
+   FC_ASSERT( !_disabled );
+   FC_ASSERT( _active_sessions > 0 );
+   disable();
+
+   restore_state( _stack.back() );
+
+   pop_state_back();
    enable();
    --_active_sessions;
 } FC_CAPTURE_AND_RETHROW() }
@@ -141,7 +234,7 @@ void undo_database::merge()
    FC_ASSERT( _active_sessions > 0 );
    if( _active_sessions == 1 && _stack.size() == 1 )
    {
-      _stack.pop_back();
+      pop_state_back();
       --_active_sessions;
       return;
    }
@@ -194,20 +287,21 @@ void undo_database::merge()
    // *+upd
    for( auto& obj : state.old_values )
    {
-      if( prev_state.new_ids.find(obj.second->id) != prev_state.new_ids.end() )
+      if( prev_state.new_ids.find(obj.first) != prev_state.new_ids.end() )
       {
          // new+upd -> new, type A
          continue;
       }
-      if( prev_state.old_values.find(obj.second->id) != prev_state.old_values.end() )
+      if( prev_state.old_values.find(obj.first) != prev_state.old_values.end() )
       {
          // upd(was=X) + upd(was=Y) -> upd(was=X), type A
          continue;
       }
       // del+upd -> N/A
-      assert( prev_state.removed.find(obj.second->id) == prev_state.removed.end() );
+      assert( prev_state.removed.find(obj.first) == prev_state.removed.end() );
       // nop+upd(was=Y) -> upd(was=Y), type B
-      prev_state.old_values[obj.second->id] = std::move(obj.second);
+      prev_state.packed_bytes += obj.second.packed.size();
+      prev_state.old_values[obj.first] = std::move(obj.second);
    }
 
    // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
@@ -234,26 +328,35 @@ void undo_database::merge()
    // *+del
    for( auto& obj : state.removed )
    {
-      if( prev_state.new_ids.find(obj.second->id) != prev_state.new_ids.end() )
+      if( prev_state.new_ids.find(obj.first) != prev_state.new_ids.end() )
       {
          // new + del -> nop (type C)
-         prev_state.new_ids.erase(obj.second->id);
+         prev_state.new_ids.erase(obj.first);
          continue;
       }
-      auto it = prev_state.old_values.find(obj.second->id);
+      auto it = prev_state.old_values.find(obj.first);
       if( it != prev_state.old_values.end() )
       {
          // upd(was=X) + del(was=Y) -> del(was=X)
-         prev_state.removed[obj.second->id] = std::move(it->second);
-         prev_state.old_values.erase(obj.second->id);
+         undo_value& value = it->second;
+         if( value.copy )
+            prev_state.removed[obj.first] = std::move(value.copy);
+         else
+         {
+            // Y is a full object of the right type, X is packed: reuse Y as storage for X
+            obj.second->unpack_from( value.packed );
+            prev_state.packed_bytes -= value.packed.size();
+            prev_state.removed[obj.first] = std::move(obj.second);
+         }
+         prev_state.old_values.erase(it);
          continue;
       }
       // del + del -> N/A
-      assert( prev_state.removed.find( obj.second->id ) == prev_state.removed.end() );
+      assert( prev_state.removed.find( obj.first ) == prev_state.removed.end() );
       // nop + del(was=Y) -> del(was=Y)
-      prev_state.removed[obj.second->id] = std::move(obj.second);
+      prev_state.removed[obj.first] = std::move(obj.second);
    }
-   _stack.pop_back();
+   pop_state_back();
    --_active_sessions;
 }
 void undo_database::commit()
@@ -269,27 +372,9 @@ void undo_database::pop_commit()
 
    disable();
    try {
-      auto& state = _stack.back();
-
-      for( auto& item : state.old_values )
-      {
-         _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
-      }
+      restore_state( _stack.back() );
 
-      for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
-      {
-         _db.remove( _db.get_object(*ritr) );
-      }
-
-      for( auto& item : state.old_index_next_ids )
-      {
-         _db.get_mutable_index( item.first.space(), item.first.type() ).set_next_id( item.second );
-      }
-
-      for( auto& item : state.removed )
-         _db.insert( std::move(*item.second) );
-
-      _stack.pop_back();
+      pop_state_back();
    }
    catch ( const fc::exception& e )
    {
@@ -305,4 +390,37 @@ const undo_state& undo_database::head()const
    return _stack.back();
 }
 
+undo_stats undo_database::head_stats()const
+{
+   undo_stats result;
+   if( !_stack.empty() )
+   {
+      const undo_state& state = _stack.back();
+      result.states = 1;
+      result.old_values = state.old_values.size();
+      result.new_ids = state.new_ids.size();
+      result.removed = state.removed.size();
+      result.packed_bytes = state.packed_bytes;
+   }
+   result.pool_used_bytes = _pool.used_bytes();
+   result.pool_reserved_bytes = _pool.reserved_bytes();
+   return result;
+}
+
+undo_stats undo_database::stats()const
+{
+   undo_stats result;
+   result.states = _stack.size();
+   for( const undo_state& state : _stack )
+   {
+      result.old_values += state.old_values.size();
+      result.new_ids += state.new_ids.size();
+      result.removed += state.removed.size();
+      result.packed_bytes += state.packed_bytes;
+   }
+   result.pool_used_bytes = _pool.used_bytes();
+   result.pool_reserved_bytes = _pool.reserved_bytes();
+   return result;
+}
+
 } } // graphene::db
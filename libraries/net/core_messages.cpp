@@ -25,6 +25,8 @@
 
 #include <fc/io/raw.hpp>
 
+#include <numeric>
+
 namespace graphene { namespace net {
 
   const core_message_type_enum trx_message::type                             = core_message_type_enum::trx_message_type;
@@ -46,6 +48,66 @@ namespace graphene { namespace net {
   const core_message_type_enum check_firewall_reply_message::type            = core_message_type_enum::check_firewall_reply_message_type;
   const core_message_type_enum get_current_connections_request_message::type = core_message_type_enum::get_current_connections_request_message_type;
   const core_message_type_enum get_current_connections_reply_message::type   = core_message_type_enum::get_current_connections_reply_message_type;
+  const core_message_type_enum compact_block_message::type                   = core_message_type_enum::compact_block_message_type;
+  const core_message_type_enum fetch_block_transactions_message::type        = core_message_type_enum::fetch_block_transactions_message_type;
+  const core_message_type_enum block_transactions_message::type              = core_message_type_enum::block_transactions_message_type;
+
+  compact_block_message::compact_block_message(const signed_block& block) :
+    header(block),
+    block_id(block.id())
+  {
+    transactions.reserve(block.transactions.size());
+    for (const graphene::protocol::processed_transaction& trx : block.transactions)
+      transactions.push_back(compact_block_transaction{ compact_transaction_id(trx.id()), trx.operation_results });
+  }
+
+  graphene::protocol::signed_block rebuild_compact_block(
+        const compact_block_message& compact,
+        const std::function<fc::optional<graphene::protocol::signed_transaction>(uint64_t)>& find_transaction,
+        std::vector<uint32_t>& missing_indexes )
+  {
+    graphene::protocol::signed_block block;
+    static_cast<graphene::protocol::signed_block_header&>(block) = compact.header;
+    block.transactions.reserve(compact.transactions.size());
+    missing_indexes.clear();
+    for (const compact_block_transaction& compact_trx : compact.transactions)
+    {
+      fc::optional<graphene::protocol::signed_transaction> known_trx = find_transaction(compact_trx.short_id);
+      if (known_trx)
+        block.transactions.emplace_back(*known_trx);
+      else
+      {
+        missing_indexes.push_back(static_cast<uint32_t>(block.transactions.size()));
+        block.transactions.emplace_back();
+      }
+      block.transactions.back().operation_results = compact_trx.operation_results;
+    }
+    return block;
+  }
+
+  bool fill_compact_block( graphene::protocol::signed_block& block, const std::vector<uint32_t>& missing_indexes,
+                           const std::vector<graphene::protocol::processed_transaction>& transactions )
+  {
+    if (transactions.size() != missing_indexes.size())
+      return false;
+    for (uint32_t index : missing_indexes)
+      if (index >= block.transactions.size())
+        return false;
+    for (size_t i = 0; i < missing_indexes.size(); ++i)
+      block.transactions[missing_indexes[i]] = transactions[i];
+    return true;
+  }
+
+  std::vector<uint32_t> compact_block_transactions_to_refetch( const graphene::protocol::signed_block& block )
+  {
+    std::vector<uint32_t> indexes;
+    if (block.calculate_merkle_root() != block.transaction_merkle_root)
+    {
+      indexes.resize(block.transactions.size());
+      std::iota(indexes.begin(), indexes.end(), 0u);
+    }
+    return indexes;
+  }
 
 } } // graphene::net
 
@@ -128,6 +190,14 @@ FC_REFLECT_DERIVED_NO_TYPENAME(graphene::net::get_current_connections_reply_mess
                                                             (upload_rate_one_hour)
                                                             (download_rate_one_hour)
                                                             (current_connections))
+FC_REFLECT_DERIVED_NO_TYPENAME(graphene::net::compact_block_transaction, BOOST_PP_SEQ_NIL,
+                                (short_id)(operation_results))
+FC_REFLECT_DERIVED_NO_TYPENAME(graphene::net::compact_block_message, BOOST_PP_SEQ_NIL,
+                                (header)(block_id)(transactions))
+FC_REFLECT_DERIVED_NO_TYPENAME(graphene::net::fetch_block_transactions_message, BOOST_PP_SEQ_NIL,
+                                (block_id)(indexes))
+FC_REFLECT_DERIVED_NO_TYPENAME(graphene::net::block_transactions_message, BOOST_PP_SEQ_NIL,
+                                (block_id)(transactions))
 
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::trx_message )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::block_message )
@@ -151,3 +221,7 @@ GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::check_firewall_reply_m
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::get_current_connections_request_message )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::current_connection_data )
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::get_current_connections_reply_message )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::compact_block_transaction )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::compact_block_message )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::fetch_block_transactions_message )
+GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::block_transactions_message )
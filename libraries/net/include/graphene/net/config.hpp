@@ -25,7 +25,7 @@
 
 #include <stddef.h>
 
-#define GRAPHENE_NET_PROTOCOL_VERSION                        106
+#define GRAPHENE_NET_PROTOCOL_VERSION                        107
 
 /**
  * Define this to enable debugging code in the p2p network interface.
@@ -61,6 +61,11 @@
 #define GRAPHENE_NET_DEFAULT_MAX_CONNECTIONS                 200
 
 #define GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES        (1024 * 1024)
+/**
+ * A connection keeps the buffers it sends and receives messages with for the
+ * next message, unless they grew larger than this, e.g. for a large block
+ */
+#define GRAPHENE_NET_MAX_POOLED_BUFFER_SIZE                  (64 * 1024)
 
 /**
  * When we receive a message from the network, we advertise it to
@@ -86,6 +91,17 @@
 
 #define GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING      200
 
+/**
+ * During sync, the number of blocks we keep requested from a peer (its sync window)
+ * follows the rate at which the peer delivers them, so that a window takes about
+ * this long to arrive.  Fast peers get larger stripes of the chain and slow peers
+ * hold up fewer blocks the chain is waiting for.  The window stays between
+ * GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING and the maximum above, and it is
+ * refilled when half of it has arrived.
+ */
+#define GRAPHENE_NET_SYNC_WINDOW_TARGET_SECONDS              2
+#define GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING      10
+
 /**
  * During normal operation, how many items will be fetched from each
  * peer at a time.  This will only come into play when the network
@@ -36,6 +36,8 @@
 
 #include <graphene/protocol/block.hpp>
 
+#include <cstring>
+#include <functional>
 #include <vector>
 
 namespace graphene { namespace net {
@@ -85,6 +87,9 @@ namespace graphene { namespace net {
     check_firewall_reply_message_type            = 5015,
     get_current_connections_request_message_type = 5016,
     get_current_connections_reply_message_type   = 5017,
+    compact_block_message_type                   = 5018,
+    fetch_block_transactions_message_type        = 5019,
+    block_transactions_message_type              = 5020,
     core_message_type_last                       = 5099
   };
 
@@ -399,6 +404,84 @@ namespace graphene { namespace net {
     std::vector<current_connection_data> current_connections;
   };
 
+  /// Identifies a transaction in a compact block: the first 8 bytes of its id
+  inline uint64_t compact_transaction_id( const transaction_id_type& trx_id )
+  {
+    uint64_t short_id;
+    memcpy( &short_id, trx_id.data(), sizeof(short_id) );
+    return short_id;
+  }
+
+  struct compact_block_transaction
+  {
+    uint64_t short_id;
+    /// not part of the transaction, but covered by the merkle root of the block
+    std::vector<graphene::protocol::operation_result> operation_results;
+  };
+
+  /**
+   * Sent instead of a block_message to peers that support it, when the block is requested during
+   * normal operation.  The receiver is expected to have most of the transactions already and
+   * rebuilds the block from them, it fetches the rest with a fetch_block_transactions_message.
+   */
+  struct compact_block_message
+  {
+    static const core_message_type_enum type;
+
+    graphene::protocol::signed_block_header header;
+    block_id_type                           block_id;
+    std::vector<compact_block_transaction>  transactions;
+
+    compact_block_message() {}
+    explicit compact_block_message(const signed_block& block);
+  };
+
+  struct fetch_block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    block_id_type         block_id;
+    std::vector<uint32_t> indexes; ///< positions of the wanted transactions in the block
+
+    fetch_block_transactions_message() {}
+    fetch_block_transactions_message(const block_id_type& block_id, const std::vector<uint32_t>& indexes) :
+      block_id(block_id),
+      indexes(indexes)
+    {}
+  };
+
+  /// The reply to a fetch_block_transactions_message, transactions are in the order of the requested indexes
+  struct block_transactions_message
+  {
+    static const core_message_type_enum type;
+
+    block_id_type                                         block_id;
+    std::vector<graphene::protocol::processed_transaction> transactions;
+  };
+
+  /**
+   * Rebuilds the block of a compact block from the transactions we know.
+   * @param find_transaction returns the known transaction with the given short id, if any
+   * @param missing_indexes receives the positions of the unknown transactions, which are left empty in the block
+   */
+  graphene::protocol::signed_block rebuild_compact_block(
+        const compact_block_message& compact,
+        const std::function<fc::optional<graphene::protocol::signed_transaction>(uint64_t)>& find_transaction,
+        std::vector<uint32_t>& missing_indexes );
+
+  /**
+   * Puts the transactions fetched for a rebuilt compact block into place.
+   * @return false, leaving the block unchanged, if their number doesn't match the missing indexes
+   */
+  bool fill_compact_block( graphene::protocol::signed_block& block, const std::vector<uint32_t>& missing_indexes,
+                           const std::vector<graphene::protocol::processed_transaction>& transactions );
+
+  /**
+   * @return the positions of the transactions of a rebuilt compact block to fetch from the peer again: none if
+   *         the block matches its merkle root, else all of them, because a short id matched a different transaction
+   */
+  std::vector<uint32_t> compact_block_transactions_to_refetch( const graphene::protocol::signed_block& block );
+
 } } // graphene::net
 
 FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
@@ -422,6 +505,9 @@ FC_REFLECT_ENUM( graphene::net::core_message_type_enum,
                  (check_firewall_reply_message_type)
                  (get_current_connections_request_message_type)
                  (get_current_connections_reply_message_type)
+                 (compact_block_message_type)
+                 (fetch_block_transactions_message_type)
+                 (block_transactions_message_type)
                  (core_message_type_last) )
 FC_REFLECT_ENUM(graphene::net::rejection_reason_code, (unspecified)
                                                  (different_chain)
@@ -463,6 +549,10 @@ FC_REFLECT_TYPENAME( graphene::net::check_firewall_reply_message )
 FC_REFLECT_TYPENAME( graphene::net::get_current_connections_request_message )
 FC_REFLECT_TYPENAME( graphene::net::current_connection_data )
 FC_REFLECT_TYPENAME( graphene::net::get_current_connections_reply_message )
+FC_REFLECT_TYPENAME( graphene::net::compact_block_transaction )
+FC_REFLECT_TYPENAME( graphene::net::compact_block_message )
+FC_REFLECT_TYPENAME( graphene::net::fetch_block_transactions_message )
+FC_REFLECT_TYPENAME( graphene::net::block_transactions_message )
 
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::trx_message )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::block_message )
@@ -486,6 +576,10 @@ GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::check_firewall_reply_mes
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::get_current_connections_request_message )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::current_connection_data )
 GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::get_current_connections_reply_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::compact_block_transaction )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::compact_block_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::fetch_block_transactions_message )
+GRAPHENE_DECLARE_EXTERNAL_SERIALIZATION( graphene::net::block_transactions_message )
 
 #include <unordered_map>
 #include <fc/crypto/city.hpp>
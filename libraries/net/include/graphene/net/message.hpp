@@ -32,6 +32,8 @@
 #include <fc/crypto/ripemd160.hpp>
 #include <fc/reflect/typename.hpp>
 
+#include <memory>
+
 namespace graphene { namespace net {
 
   /**
@@ -116,6 +118,12 @@ namespace graphene { namespace net {
      }
   };
 
+  /**
+   *  A message which is not changed any more, shared by everyone who sends it instead of copied, e.g. by the
+   *  send queues of all peers a block is broadcast to.
+   */
+  using message_ptr = std::shared_ptr<const message>;
+
 } } // graphene::net
 
 FC_REFLECT_TYPENAME( graphene::net::message_header )
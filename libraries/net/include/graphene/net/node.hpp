@@ -10,6 +10,8 @@
 
 #include <graphene/protocol/types.hpp>
 
+#include <fc/thread/future.hpp>
+
 namespace graphene { namespace net {
 
   using fc::variant_object;
@@ -57,6 +59,18 @@ namespace graphene { namespace net {
           */
          virtual bool handle_block( const graphene::net::block_message& blk_msg, bool sync_mode, 
                                     std::vector<message_hash_type>& contained_transaction_msg_ids ) = 0;
+
+         /**
+          *  @brief Called during sync when a block arrives ahead of the blocks it builds on, to start its
+          *         expensive checks (ids, digests, signature recovery) while earlier blocks are applied
+          *
+          *  The block will be passed to handle_block() later, which must not rely on this being done.  Unlike the
+          *  other methods, this is called on the p2p thread, it must not touch the chain state.
+          *
+          *  @param blk_msg the block, it must be kept alive until the returned future is ready
+          *  @return a future which is ready when the precomputations are done
+          */
+         virtual fc::future<void> precompute_block( const std::shared_ptr<const graphene::net::block_message>& blk_msg ) = 0;
          
          /**
           *  @brief Called when a new transaction comes in from the network
@@ -299,6 +313,13 @@ namespace graphene { namespace net {
 
    using node_ptr = std::shared_ptr<node>;
 
+   /**
+    * @return the sync window of a peer which delivered @p blocks sync blocks in @p elapsed: the number of blocks
+    *         it would deliver in GRAPHENE_NET_SYNC_WINDOW_TARGET_SECONDS, averaged with @p current_window and kept
+    *         between GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING and @p max_blocks_per_peer
+    */
+   size_t adapt_sync_window(size_t current_window, size_t blocks, fc::microseconds elapsed, size_t max_blocks_per_peer);
+
 } } // graphene::net
 
 FC_REFLECT(graphene::net::message_propagation_data, (received_time)(validated_time)(originating_peer));
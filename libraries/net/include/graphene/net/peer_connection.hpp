@@ -66,7 +66,7 @@ namespace graphene { namespace net
       virtual void on_message(peer_connection* originating_peer,
                               const message& received_message) = 0;
       virtual void on_connection_closed(peer_connection* originating_peer) = 0;
-      virtual message get_message_for_item(const item_id& item) = 0;
+      virtual message_ptr get_message_for_item(const item_id& item) = 0;
     };
 
     using peer_connection_ptr = std::shared_ptr<peer_connection>;
@@ -120,7 +120,7 @@ namespace graphene { namespace net
           enqueue_time(enqueue_time)
         {}
 
-        virtual message get_message(peer_connection_delegate* node) = 0;
+        virtual message_ptr get_message(peer_connection_delegate* node) = 0;
         /** returns roughly the number of bytes of memory the message is consuming while
          * it is sitting on the queue
          */
@@ -128,21 +128,21 @@ namespace graphene { namespace net
         virtual ~queued_message() = default;
       };
 
-      /* when you queue up a 'real_queued_message', a full copy of the message is
-       * stored on the heap until it is sent
+      /* when you queue up a 'real_queued_message', the message is kept on the heap until
+       * it is sent.  The message is shared, so a message going to many peers is only stored once
        */
       struct real_queued_message : queued_message
       {
-        message        message_to_send;
+        message_ptr    message_to_send;
         size_t         message_send_time_field_offset;
 
-        real_queued_message(message message_to_send,
+        real_queued_message(message_ptr message_to_send,
                             size_t message_send_time_field_offset = (size_t)-1) :
           message_to_send(std::move(message_to_send)),
           message_send_time_field_offset(message_send_time_field_offset)
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        message_ptr get_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
@@ -158,7 +158,7 @@ namespace graphene { namespace net
           item_to_send(std::move(the_item_to_send))
         {}
 
-        message get_message(peer_connection_delegate* node) override;
+        message_ptr get_message(peer_connection_delegate* node) override;
         size_t get_size_in_queue() override;
       };
 
@@ -204,6 +204,7 @@ namespace graphene { namespace net
       fc::optional<fc::time_point_sec> fc_git_revision_unix_timestamp;
       fc::optional<std::string> platform;
       fc::optional<uint32_t> bitness;
+      bool             supports_compact_blocks = false; ///< the peer announced in its hello that it takes compact_block_messages
 
       // for inbound connections, these fields record what the peer sent us in
       // its hello message.  For outbound, they record what we sent the peer
@@ -225,6 +226,10 @@ namespace graphene { namespace net
       fc::optional<boost::tuple<std::vector<item_hash_t>, fc::time_point> > item_ids_requested_from_peer; /// we check this to detect a timed-out request and in busy()
       fc::time_point last_sync_item_received_time; /// the time we received the last sync item or the time we sent the last batch of sync item requests to this peer
       std::set<item_hash_t> sync_items_requested_from_peer; /// ids of blocks we've requested from this peer during sync.  fetch from another peer if this peer disconnects
+      size_t sync_window = GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING; /// how many sync blocks we keep requested from this peer, adapted to its throughput
+      fc::time_point sync_throughput_period_start; /// start of the current measurement of the peer's sync throughput
+      uint32_t sync_blocks_in_throughput_period = 0; /// sync blocks received from the peer since sync_throughput_period_start
+      uint32_t sync_blocks_per_second = 0; /// the sync throughput last measured, 0 if none was
       item_hash_t last_block_delegate_has_seen; /// the hash of the last block  this peer has told us about that the peer knows
       fc::time_point_sec last_block_time_delegate_has_seen;
       bool inhibit_fetching_sync_blocks = false;
@@ -251,6 +256,15 @@ namespace graphene { namespace net
       timestamped_items_set_type inventory_advertised_to_peer;
 
       item_to_time_map_type items_requested_from_peer;  /// items we've requested from this peer during normal operation.  fetch from another peer if this peer disconnects
+
+      /// a compact block from this peer which waits for the transactions we asked the peer for
+      struct pending_compact_block
+      {
+        graphene::protocol::signed_block block;
+        std::vector<uint32_t>            missing_indexes;
+      };
+      /// at most one per block requested from this peer, as the peer may send the next one before the transactions
+      std::map<block_id_type, pending_compact_block> compact_blocks_being_completed;
       /// @}
 
       // if they're flooding us with transactions, we set this to avoid fetching for a few seconds to let the
@@ -283,6 +297,7 @@ namespace graphene { namespace net
 
       void send_queueable_message(std::unique_ptr<queued_message>&& message_to_send);
       void send_message(const message& message_to_send, size_t message_send_time_field_offset = (size_t)-1);
+      void send_message(message_ptr message_to_send, size_t message_send_time_field_offset = (size_t)-1);
       void send_item(const item_id& item_to_send);
       void close_connection();
       void destroy_connection();
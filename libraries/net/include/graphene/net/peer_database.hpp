@@ -25,6 +25,7 @@
 #include <boost/iterator/iterator_facade.hpp>
 
 #include <graphene/protocol/types.hpp>
+#include <graphene/net/core_messages.hpp>
 
 #include <fc/network/ip.hpp>
 #include <fc/time.hpp>
@@ -53,6 +54,13 @@ namespace graphene { namespace net {
     uint32_t                          number_of_successful_connection_attempts;
     uint32_t                          number_of_failed_connection_attempts;
     fc::optional<fc::exception>       last_error;
+    /// round trip delay measured during the last connection, 0 if unknown
+    fc::microseconds                  latency;
+    /// rate at which the peer sent us sync blocks during the last connection, 0 if unknown
+    uint32_t                          sync_blocks_per_second = 0;
+    fc::enum_type<uint8_t,firewalled_state> firewalled = firewalled_state::unknown;
+    /// quality of the peer computed by the peer_database from the fields above, higher is better
+    uint32_t                          score = 0;
 
     potential_peer_record() :
       number_of_successful_connection_attempts(0),
@@ -71,6 +79,9 @@ namespace graphene { namespace net {
 
   namespace detail
   {
+    /// Rates a peer by how reliably we can connect to it, its latency and how fast it served sync blocks
+    uint32_t calculate_peer_score(const potential_peer_record& record);
+
     class peer_database_impl;
 
     class peer_database_iterator_impl;
@@ -99,7 +110,10 @@ namespace graphene { namespace net {
     peer_database();
     virtual ~peer_database();
 
+    /// Loads the database, changes are written to the file as they are made
     void open(const fc::path& databaseFilename);
+    /// Adds the records of a peer database in the old JSON format
+    void import_json(const fc::path& json_filename);
     void close();
     void clear();
 
@@ -109,6 +123,7 @@ namespace graphene { namespace net {
     potential_peer_record lookup_or_create_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
     fc::optional<potential_peer_record> lookup_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
 
+    /// iterates from the best scored peer to the worst, peers seen more recently first among equals
     using iterator = detail::peer_database_iterator;
     iterator begin() const;
     iterator end() const;
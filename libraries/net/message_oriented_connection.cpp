@@ -65,6 +65,8 @@ namespace graphene { namespace net {
 
       std::atomic_bool _send_message_in_progress;
       std::atomic_bool _read_loop_in_progress;
+      /// padded copy of the message being sent, reused for the next one unless it grew too large
+      std::vector<char> _send_buffer;
 #ifndef NDEBUG
       fc::thread* _thread;
 #endif
@@ -175,10 +177,14 @@ namespace graphene { namespace net {
 
       try
       {
+        // m.data keeps its memory from one message to the next, and _sock decrypts ahead in large reads,
+        // so reading the header usually doesn't touch the socket
         message m;
         char buffer[BUFFER_SIZE];
         while( true )
         {
+          if( m.data.capacity() > GRAPHENE_NET_MAX_POOLED_BUFFER_SIZE )
+            std::vector<char>().swap( m.data );
           _sock.read(buffer, BUFFER_SIZE);
           _bytes_received += BUFFER_SIZE;
           memcpy((char*)&m, buffer, sizeof(message_header));
@@ -273,15 +279,18 @@ namespace graphene { namespace net {
            elog("Trying to send a message larger than MAX_MESSAGE_SIZE. This probably won't work...");
         //pad the message we send to a multiple of 16 bytes
         size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::vector<char> padded_message( size_with_padding );
+        _send_buffer.resize( size_with_padding );
 
-        memcpy( padded_message.data(), (const char*)&message_to_send, sizeof(message_header) );
-        memcpy( padded_message.data() + sizeof(message_header), message_to_send.data.data(),
+        memcpy( _send_buffer.data(), (const char*)&message_to_send, sizeof(message_header) );
+        memcpy( _send_buffer.data() + sizeof(message_header), message_to_send.data.data(),
                 message_to_send.size.value() );
-        char* padding_space = padded_message.data() + sizeof(message_header) + message_to_send.size.value();
+        char* padding_space = _send_buffer.data() + sizeof(message_header) + message_to_send.size.value();
         memset(padding_space, 0, size_with_padding - size_of_message_and_header);
-        _sock.write( padded_message.data(), size_with_padding );
+        _sock.write( _send_buffer.data(), size_with_padding );
         _sock.flush();
+        // don't keep the memory of an occasional large block for every connection
+        if( _send_buffer.capacity() > GRAPHENE_NET_MAX_POOLED_BUFFER_SIZE )
+          std::vector<char>().swap( _send_buffer );
         _bytes_sent += size_with_padding;
         _last_message_sent_time = fc::time_point::now();
       } FC_RETHROW_EXCEPTIONS( warn, "unable to send message" )
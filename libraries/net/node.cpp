@@ -108,13 +108,13 @@ namespace graphene { namespace net { namespace detail {
                                                       const message_hash_type& message_content_hash )
    {
       _message_cache.insert( message_info(hash_of_message_to_cache,
-                                         message_to_cache,
+                                         std::make_shared<const message>( message_to_cache ),
                                          block_clock,
                                          propagation_data,
                                          message_content_hash ) );
    }
 
-   message blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup ) const
+   message_ptr blockchain_tied_message_cache::get_message( const message_hash_type& hash_of_message_to_lookup ) const
    {
       message_cache_container::index<message_hash_index>::type::const_iterator iter =
          _message_cache.get<message_hash_index>().find(hash_of_message_to_lookup );
@@ -123,6 +123,33 @@ namespace graphene { namespace net { namespace detail {
       FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
    }
 
+   message_ptr blockchain_tied_message_cache::get_message_by_contents(
+            const message_hash_type& hash_of_msg_contents_to_lookup ) const
+   {
+      if( hash_of_msg_contents_to_lookup != message_hash_type() )
+      {
+         const auto& by_contents = _message_cache.get<message_contents_hash_index>();
+         auto iter = by_contents.find( hash_of_msg_contents_to_lookup );
+         if( iter != by_contents.end() )
+            return iter->message_body;
+      }
+      FC_THROW_EXCEPTION(  fc::key_not_found_exception, "Requested message not in cache" );
+   }
+
+   message_ptr blockchain_tied_message_cache::get_transaction_by_short_id( uint64_t short_id ) const
+   {
+      // transaction ids are ordered by their bytes, so those starting with the short id are adjacent
+      message_hash_type lowest_id_with_prefix;
+      memcpy( lowest_id_with_prefix.data(), &short_id, sizeof(short_id) );
+      const auto& by_contents = _message_cache.get<message_contents_hash_index>();
+      for( auto iter = by_contents.lower_bound( lowest_id_with_prefix );
+           iter != by_contents.end() && compact_transaction_id( iter->message_contents_hash ) == short_id;
+           ++iter )
+         if( iter->message_body->msg_type.value() == trx_message_type )
+            return iter->message_body;
+      return message_ptr();
+   }
+
     message_propagation_data blockchain_tied_message_cache::get_message_propagation_data(
              const message_hash_type& hash_of_msg_contents_to_lookup ) const
     {
@@ -176,8 +203,7 @@ namespace graphene { namespace net { namespace detail {
       _node_is_shutting_down = true;
 
       {
-         fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-         for (const peer_connection_ptr& active_peer : _active_connections)
+         for (const peer_connection_ptr& active_peer : _active_connections.get_snapshot())
          {
             fc::optional<fc::ip::endpoint> inbound_endpoint = active_peer->get_endpoint_for_connecting();
             if (inbound_endpoint)
@@ -265,6 +291,7 @@ namespace graphene { namespace net { namespace detail {
             bool initiated_connection_this_pass = false;
             _potential_peer_db_updated = false;
 
+            // the database iterates the best scored peers first
             for (peer_database::iterator iter = _potential_peer_db.begin();
                  iter != _potential_peer_db.end() && is_wanting_new_connections();
                  ++iter)
@@ -375,10 +402,7 @@ namespace graphene { namespace net { namespace detail {
     bool node_impl::have_already_received_sync_item( const item_hash_t& item_hash )
     {
       VERIFY_CORRECT_THREAD();
-      return std::find_if(_received_sync_items.begin(), _received_sync_items.end(),
-                          [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _received_sync_items.end() ||
-             std::find_if(_new_received_sync_items.begin(), _new_received_sync_items.end(),
-                          [&item_hash]( const graphene::net::block_message& message ) { return message.block_id == item_hash; } ) != _new_received_sync_items.end();                          ;
+      return _received_sync_items.find(item_hash) != _received_sync_items.end();
     }
 
     void node_impl::request_sync_item_from_peer( const peer_connection_ptr& peer, const item_hash_t& item_to_request )
@@ -387,6 +411,12 @@ namespace graphene { namespace net { namespace detail {
       dlog( "requesting item ${item_hash} from peer ${endpoint}", ("item_hash", item_to_request )("endpoint", peer->get_remote_endpoint() ) );
       item_id item_id_to_request( graphene::net::block_message_type, item_to_request );
       _active_sync_requests.insert( active_sync_requests_map::value_type(item_to_request, fc::time_point::now() ) );
+      if (peer->sync_items_requested_from_peer.empty())
+      {
+        // the peer's throughput is only measured while it has something to deliver
+        peer->sync_throughput_period_start = fc::time_point::now();
+        peer->sync_blocks_in_throughput_period = 0;
+      }
       peer->last_sync_item_received_time = fc::time_point::now();
       peer->sync_items_requested_from_peer.insert(item_to_request);
       peer->send_message( fetch_items_message(item_id_to_request.item_type, std::vector<item_hash_t>{item_id_to_request.item_hash} ) );
@@ -397,6 +427,12 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "requesting ${item_count} item(s) ${items_to_request} from peer ${endpoint}",
             ("item_count", items_to_request.size())("items_to_request", items_to_request)("endpoint", peer->get_remote_endpoint()) );
+      if (peer->sync_items_requested_from_peer.empty())
+      {
+        // the peer's throughput is only measured while it has something to deliver
+        peer->sync_throughput_period_start = fc::time_point::now();
+        peer->sync_blocks_in_throughput_period = 0;
+      }
       for (const item_hash_t& item_to_request : items_to_request)
       {
         _active_sync_requests.insert( active_sync_requests_map::value_type(item_to_request, fc::time_point::now() ) );
@@ -421,14 +457,17 @@ namespace graphene { namespace net { namespace detail {
           {
             std::set<item_hash_t> sync_items_to_request;
 
-            // for each idle peer that we're syncing with
-            fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-            for( const peer_connection_ptr& peer : _active_connections )
+            // for each peer that we're syncing with and which has room in its sync window.  The window
+            // is refilled when half of it has arrived, so the peer doesn't run dry while we ask for more.
+            // Each peer takes the next blocks nobody was asked for yet, so the chain is striped across
+            // all of them, in stripes as large as their windows
+            for( const peer_connection_ptr& peer : _active_connections.get_snapshot() )
             {
               if( peer->we_need_sync_items_from_peer &&
                   // if we've already scheduled a request for this peer, don't consider scheduling another
                   sync_item_requests_to_send.find(peer) == sync_item_requests_to_send.end() &&
-                  peer->idle() )
+                  peer->items_requested_from_peer.empty() && !peer->item_ids_requested_from_peer &&
+                  peer->sync_items_requested_from_peer.size() <= peer->sync_window / 2 )
               {
                 if (!peer->inhibit_fetching_sync_blocks)
                 {
@@ -447,7 +486,8 @@ namespace graphene { namespace net { namespace detail {
                       // then schedule a request from this peer
                       sync_item_requests_to_send[peer].push_back(item_to_potentially_request);
                       sync_items_to_request.insert( item_to_potentially_request );
-                      if (sync_item_requests_to_send[peer].size() >= _max_sync_blocks_per_peer)
+                      if (sync_item_requests_to_send[peer].size() + peer->sync_items_requested_from_peer.size()
+                            >= std::min(peer->sync_window, _max_sync_blocks_per_peer))
                         break;
                     }
                   }
@@ -486,8 +526,7 @@ namespace graphene { namespace net { namespace detail {
 
     bool node_impl::is_item_in_any_peers_inventory(const item_id& item) const
     {
-      fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-      for( const peer_connection_ptr& peer : _active_connections )
+      for( const peer_connection_ptr& peer : _active_connections.get_snapshot() )
       {
         if (peer->inventory_peer_advertised_to_us.find(item) != peer->inventory_peer_advertised_to_us.end() )
           return true;
@@ -530,8 +569,7 @@ namespace graphene { namespace net { namespace detail {
 
         // initialize the fetch_messages_to_send with an empty set of items for all idle peers
         {
-         fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-         for (const peer_connection_ptr& peer : _active_connections)
+         for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
             if (peer->idle())
                items_by_peer.insert(peer_and_items_to_fetch(peer));
         }
@@ -639,16 +677,14 @@ namespace graphene { namespace net { namespace detail {
       {
         dlog("beginning an iteration of advertise inventory");
         // swap inventory into local variable, clearing the node's copy
-        std::unordered_set<item_id> inventory_to_advertise;
-        _new_inventory.swap( inventory_to_advertise );
+        std::unordered_set<item_id> inventory_to_advertise = _new_inventory.take_all();
 
         // process all inventory to advertise and construct the inventory messages we'll send
         // first, then send them all in a batch (to avoid any fiber interruption points while
         // we're computing the messages)
         std::list<std::pair<peer_connection_ptr, item_ids_inventory_message> > inventory_messages_to_send;
         {
-         fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-         for (const peer_connection_ptr& peer : _active_connections)
+         for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
          {
           // only advertise to peers who are in sync with us
           idump((peer->peer_needs_sync_items_from_us));
@@ -698,7 +734,7 @@ namespace graphene { namespace net { namespace detail {
           }
           peer->clear_old_inventory();
          }
-        } // lock_guard
+        }
 
         for (auto iter = inventory_messages_to_send.begin(); iter != inventory_messages_to_send.end(); ++iter)
           iter->first->send_message(iter->second);
@@ -749,8 +785,7 @@ namespace graphene { namespace net { namespace detail {
       uint32_t handshaking_timeout = _peer_inactivity_timeout;
       fc::time_point handshaking_disconnect_threshold = fc::time_point::now() - fc::seconds(handshaking_timeout);
       {
-         fc::scoped_lock<fc::mutex> lock(_handshaking_connections.get_mutex());
-         for( const peer_connection_ptr& handshaking_peer : _handshaking_connections )
+         for( const peer_connection_ptr& handshaking_peer : _handshaking_connections.get_snapshot() )
          {
             if( handshaking_peer->connection_initiation_time < handshaking_disconnect_threshold &&
                   handshaking_peer->get_last_message_received_time() < handshaking_disconnect_threshold &&
@@ -772,7 +807,7 @@ namespace graphene { namespace net { namespace detail {
                peers_to_disconnect_forcibly.push_back( handshaking_peer );
             } // if
          } // for
-      } // scoped_lock
+      }
       // timeout for any active peers is two block intervals
       uint32_t active_disconnect_timeout = 10 * _recent_block_interval_seconds;
       uint32_t active_send_keepalive_timeout = active_disconnect_timeout / 2;
@@ -791,9 +826,8 @@ namespace graphene { namespace net { namespace detail {
       fc::time_point active_send_keepalive_threshold = fc::time_point::now() - fc::seconds(active_send_keepalive_timeout);
       fc::time_point active_ignored_request_threshold = fc::time_point::now() - active_ignored_request_timeout;
       {
-         fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
 
-         for( const peer_connection_ptr& active_peer : _active_connections )
+         for( const peer_connection_ptr& active_peer : _active_connections.get_snapshot() )
          {
             if( active_peer->connection_initiation_time < active_disconnect_threshold &&
                   active_peer->get_last_message_received_time() < active_disconnect_threshold )
@@ -860,12 +894,11 @@ namespace graphene { namespace net { namespace detail {
                }
             } // else
          } // for
-      } // scoped_lock
+      }
 
       fc::time_point closing_disconnect_threshold = fc::time_point::now() - fc::seconds(GRAPHENE_NET_PEER_DISCONNECT_TIMEOUT);
       {
-         fc::scoped_lock<fc::mutex> lock(_closing_connections.get_mutex());
-         for( const peer_connection_ptr& closing_peer : _closing_connections )
+         for( const peer_connection_ptr& closing_peer : _closing_connections.get_snapshot() )
          {
             if( closing_peer->connection_closed_time < closing_disconnect_threshold )
             {
@@ -876,12 +909,11 @@ namespace graphene { namespace net { namespace detail {
                peers_to_disconnect_forcibly.push_back( closing_peer );
             }
          } // for
-      } // scoped_lock
+      }
       uint32_t failed_terminate_timeout_seconds = 120;
       fc::time_point failed_terminate_threshold = fc::time_point::now() - fc::seconds(failed_terminate_timeout_seconds);
       {
-         fc::scoped_lock<fc::mutex> lock(_terminating_connections.get_mutex());
-         for (const peer_connection_ptr& peer : _terminating_connections )
+         for (const peer_connection_ptr& peer : _terminating_connections.get_snapshot() )
          {
             if (peer->get_connection_terminated_time() != fc::time_point::min() &&
                peer->get_connection_terminated_time() < failed_terminate_threshold)
@@ -890,22 +922,19 @@ namespace graphene { namespace net { namespace detail {
                peers_to_terminate.push_back(peer);
             }
          }
-      } // scoped_lock
+      }
       // That's the end of the sorting step; now all peers that require further processing are now in one of the
       // lists peers_to_disconnect_gently,  peers_to_disconnect_forcibly, peers_to_send_keep_alive, or peers_to_terminate
 
       // if we've decided to delete any peers, do it now; in its current implementation this doesn't yield,
       // and once we start yielding, we may find that we've moved that peer to another list (closed or active)
       // and that triggers assertions, maybe even errors
+      for (const peer_connection_ptr& peer : peers_to_terminate )
       {
-         fc::scoped_lock<fc::mutex> lock(_terminating_connections.get_mutex());
-         for (const peer_connection_ptr& peer : peers_to_terminate )
-         {
-            assert(_terminating_connections.find(peer) != _terminating_connections.end());
-            _terminating_connections.erase(peer);
-            schedule_peer_for_deletion(peer);
-         }
-      } // scoped_lock
+         assert(_terminating_connections.contains(peer));
+         _terminating_connections.erase(peer);
+         schedule_peer_for_deletion(peer);
+      }
       peers_to_terminate.clear();
 
       // if we're going to abruptly disconnect anyone, do it here 
@@ -923,13 +952,12 @@ namespace graphene { namespace net { namespace detail {
       for( const peer_connection_ptr& peer : peers_to_disconnect_gently )
       {
          {
-            fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
             fc::exception detailed_error( FC_LOG_MESSAGE(warn, "Disconnecting due to inactivity",
                   ( "last_message_received_seconds_ago", (peer->get_last_message_received_time() 
                   - fc::time_point::now() ).count() / fc::seconds(1 ).count() )
                   ( "last_message_sent_seconds_ago", (peer->get_last_message_sent_time() 
                   - fc::time_point::now() ).count() / fc::seconds(1 ).count() )
-                  ( "inactivity_timeout", _active_connections.find(peer ) != _active_connections.end() 
+                  ( "inactivity_timeout", _active_connections.contains(peer) 
                   ? _peer_inactivity_timeout * 10 : _peer_inactivity_timeout ) ) );
             disconnect_from_peer( peer.get(), "Disconnecting due to inactivity", false, detailed_error );
          }
@@ -963,10 +991,7 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       
       {
-         fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-         // JMJ 2018-10-22 Unsure why we're making a copy here, but this is probably unnecessary
-         std::list<peer_connection_ptr> original_active_peers(_active_connections.begin(), _active_connections.end());
-         for( const peer_connection_ptr& active_peer : original_active_peers )
+         for( const peer_connection_ptr& active_peer : _active_connections.get_snapshot() )
          {
             try
             {
@@ -1086,10 +1111,10 @@ namespace graphene { namespace net { namespace detail {
     {
       VERIFY_CORRECT_THREAD();
 
-      assert(_handshaking_connections.find(peer_to_delete) == _handshaking_connections.end());
-      assert(_active_connections.find(peer_to_delete) == _active_connections.end());
-      assert(_closing_connections.find(peer_to_delete) == _closing_connections.end());
-      assert(_terminating_connections.find(peer_to_delete) == _terminating_connections.end());
+      assert(!_handshaking_connections.contains(peer_to_delete));
+      assert(!_active_connections.contains(peer_to_delete));
+      assert(!_closing_connections.contains(peer_to_delete));
+      assert(!_terminating_connections.contains(peer_to_delete));
 
 #ifdef USE_PEERS_TO_DELETE_MUTEX
       dlog("scheduling peer for deletion: ${peer} (may block on a mutex here)",
@@ -1155,14 +1180,12 @@ namespace graphene { namespace net { namespace detail {
     peer_connection_ptr node_impl::get_peer_by_node_id(const node_id_t& node_id)
     {
       {
-         fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-         for (const peer_connection_ptr& active_peer : _active_connections)
+         for (const peer_connection_ptr& active_peer : _active_connections.get_snapshot())
             if (node_id == active_peer->node_id)
                return active_peer;
       }
       {
-         fc::scoped_lock<fc::mutex> lock(_handshaking_connections.get_mutex());
-         for (const peer_connection_ptr& handshaking_peer : _handshaking_connections)
+         for (const peer_connection_ptr& handshaking_peer : _handshaking_connections.get_snapshot())
             if (node_id == handshaking_peer->node_id)
                return handshaking_peer;
       }
@@ -1178,8 +1201,7 @@ namespace graphene { namespace net { namespace detail {
         return true;
       }
       {
-         fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-         for (const peer_connection_ptr& active_peer : _active_connections)
+         for (const peer_connection_ptr& active_peer : _active_connections.get_snapshot())
          {
             if (node_id == active_peer->node_id)
             {
@@ -1189,8 +1211,7 @@ namespace graphene { namespace net { namespace detail {
          }
       }
       {
-         fc::scoped_lock<fc::mutex> lock(_handshaking_connections.get_mutex());
-         for (const peer_connection_ptr& handshaking_peer : _handshaking_connections)
+         for (const peer_connection_ptr& handshaking_peer : _handshaking_connections.get_snapshot())
             if (node_id == handshaking_peer->node_id)
             {
                dlog("is_already_connected_to_id returning true because the peer is already in our handshaking list");
@@ -1229,8 +1250,7 @@ namespace graphene { namespace net { namespace detail {
       dlog("   my id is ${id}", ("id", _node_id));
 
       {
-         fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-         for (const peer_connection_ptr& active_connection : _active_connections)
+         for (const peer_connection_ptr& active_connection : _active_connections.get_snapshot())
          {
             dlog("        active: ${endpoint} with ${id}   [${direction}]",
                   ("endpoint", active_connection->get_remote_endpoint())
@@ -1239,8 +1259,7 @@ namespace graphene { namespace net { namespace detail {
          }
       }
       {
-         fc::scoped_lock<fc::mutex> lock(_handshaking_connections.get_mutex());
-         for (const peer_connection_ptr& handshaking_connection : _handshaking_connections)
+         for (const peer_connection_ptr& handshaking_connection : _handshaking_connections.get_snapshot())
          {
             dlog("   handshaking: ${endpoint} with ${id}  [${direction}]",
                   ("endpoint", handshaking_connection->get_remote_endpoint())
@@ -1314,6 +1333,15 @@ namespace graphene { namespace net { namespace detail {
         break;
       case core_message_type_enum::get_current_connections_reply_message_type:
         break;
+      case core_message_type_enum::compact_block_message_type:
+        on_compact_block_message(originating_peer, received_message.as<compact_block_message>());
+        break;
+      case core_message_type_enum::fetch_block_transactions_message_type:
+        on_fetch_block_transactions_message(originating_peer, received_message.as<fetch_block_transactions_message>());
+        break;
+      case core_message_type_enum::block_transactions_message_type:
+        on_block_transactions_message(originating_peer, received_message.as<block_transactions_message>());
+        break;
 
       default:
         // ignore any message in between core_message_type_first and _last that we don't handle above
@@ -1359,6 +1387,8 @@ namespace graphene { namespace net { namespace detail {
       if (!_hard_fork_block_numbers.empty())
         user_data["last_known_fork_block_number"] = _hard_fork_block_numbers.back();
 
+      user_data["compact_blocks"] = true;
+
       return user_data;
     }
     void node_impl::parse_hello_user_data_for_peer(peer_connection* originating_peer, const fc::variant_object& user_data)
@@ -1383,6 +1413,9 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->node_id = user_data["node_id"].as<node_id_t>(1);
       if (user_data.contains("last_known_fork_block_number"))
         originating_peer->last_known_fork_block_number = user_data["last_known_fork_block_number"].as<uint32_t>(1);
+      originating_peer->supports_compact_blocks = originating_peer->core_protocol_version >= 107 &&
+                                                  user_data.contains("compact_blocks") &&
+                                                  user_data["compact_blocks"].as_bool();
     }
 
     void node_impl::on_hello_message( peer_connection* originating_peer, const hello_message& hello_message_received )
@@ -1551,6 +1584,7 @@ namespace graphene { namespace net { namespace detail {
               // peer is not firewalled, add it to our database
               fc::ip::endpoint peers_inbound_endpoint(originating_peer->inbound_address, originating_peer->inbound_port);
               potential_peer_record updated_peer_record = _potential_peer_db.lookup_or_create_entry_for_endpoint(peers_inbound_endpoint);
+              updated_peer_record.firewalled = firewalled_state::not_firewalled;
               _potential_peer_db.update_entry(updated_peer_record);
               originating_peer->is_firewalled = firewalled_state::not_firewalled;
             }
@@ -1561,6 +1595,14 @@ namespace graphene { namespace net { namespace detail {
                  ("reported_endpoint", fc::ip::endpoint(originating_peer->inbound_address, originating_peer->outbound_port))
                  ("actual_endpoint", peers_actual_outbound_endpoint));
             originating_peer->is_firewalled = firewalled_state::firewalled;
+            // don't prefer the endpoint it claims to listen on when we look for peers to connect to
+            fc::optional<potential_peer_record> updated_peer_record = _potential_peer_db.lookup_entry_for_endpoint(
+                  fc::ip::endpoint(originating_peer->inbound_address, originating_peer->inbound_port));
+            if (updated_peer_record && updated_peer_record->firewalled != firewalled_state::firewalled)
+            {
+              updated_peer_record->firewalled = firewalled_state::firewalled;
+              _potential_peer_db.update_entry(*updated_peer_record);
+            }
           }
 
           if (!is_accepting_new_connections())
@@ -1670,8 +1712,7 @@ namespace graphene { namespace net { namespace detail {
       if (!_peer_advertising_disabled)
       {
         reply.addresses.reserve(_active_connections.size());
-        fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-        for (const peer_connection_ptr& active_peer : _active_connections)
+        for (const peer_connection_ptr& active_peer : _active_connections.get_snapshot())
         {
           fc::optional<potential_peer_record> updated_peer_record = _potential_peer_db.lookup_entry_for_endpoint(*active_peer->get_remote_endpoint());
           if (updated_peer_record)
@@ -1708,7 +1749,7 @@ namespace graphene { namespace net { namespace detail {
       if (new_information_received)
         trigger_p2p_network_connect_loop();
 
-      if (_handshaking_connections.find(originating_peer->shared_from_this()) != _handshaking_connections.end())
+      if (_handshaking_connections.contains(originating_peer->shared_from_this()))
       {
         // if we were handshaking, we need to continue with the next step in handshaking (which is either
         // ending handshaking and starting synchronization or disconnecting)
@@ -1837,7 +1878,7 @@ namespace graphene { namespace net { namespace detail {
         }
 
       if (originating_peer->direction == peer_connection_direction::inbound &&
-          _handshaking_connections.find(originating_peer->shared_from_this()) != _handshaking_connections.end())
+          _handshaking_connections.contains(originating_peer->shared_from_this()))
       {
         // handshaking is done, move the connection to fully active status and start synchronizing
         dlog("peer ${endpoint} which was handshaking with us has started synchronizing with us, start syncing with it",
@@ -1861,8 +1902,7 @@ namespace graphene { namespace net { namespace detail {
     {
       VERIFY_CORRECT_THREAD();
       uint32_t max_number_of_unfetched_items = 0;
-      fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-      for( const peer_connection_ptr& peer : _active_connections )
+      for( const peer_connection_ptr& peer : _active_connections.get_snapshot() )
       {
         uint32_t this_peer_unfetched_items_count = (uint32_t)peer->ids_of_items_to_get.size()
                                                  + peer->number_of_unfetched_item_ids;
@@ -2088,8 +2128,7 @@ namespace graphene { namespace net { namespace detail {
           {
             bool is_first_item_for_other_peer = false;
             {
-               fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-               for (const peer_connection_ptr& peer : _active_connections)
+               for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
                {
                   if (peer != originating_peer->shared_from_this() &&
                         !peer->ids_of_items_to_get.empty() &&
@@ -2256,7 +2295,7 @@ namespace graphene { namespace net { namespace detail {
       }
     }
 
-    message node_impl::get_message_for_item(const item_id& item)
+    message_ptr node_impl::get_message_for_item(const item_id& item)
     {
       try
       {
@@ -2264,13 +2303,23 @@ namespace graphene { namespace net { namespace detail {
       }
       catch (fc::key_not_found_exception&)
       {}
+      if (item.item_type == block_message_type)
+      {
+        // blocks are requested by block id, a block we broadcast is sent to all peers from the same cached message
+        try
+        {
+          return _message_cache.get_message_by_contents(item.item_hash);
+        }
+        catch (fc::key_not_found_exception&)
+        {}
+      }
       try
       {
-        return _delegate->get_item(item);
+        return std::make_shared<const message>(_delegate->get_item(item));
       }
       catch (fc::key_not_found_exception&)
       {}
-      return item_not_available_message(item);
+      return std::make_shared<const message>(item_not_available_message(item));
     }
 
     void node_impl::on_fetch_items_message(peer_connection* originating_peer,
@@ -2282,20 +2331,28 @@ namespace graphene { namespace net { namespace detail {
            ("type", fetch_items_message_received.item_type)
            ("endpoint", originating_peer->get_remote_endpoint()));
 
-      fc::optional<message> last_block_message_sent;
+      message_ptr last_block_message_sent;
 
-      std::list<message> reply_messages;
+      std::list<message_ptr> reply_messages;
       for (const item_hash_t& item_hash : fetch_items_message_received.items_to_fetch)
       {
         try
         {
-          message requested_message = _message_cache.get_message(item_hash);
+          message_ptr requested_message = _message_cache.get_message(item_hash);
           dlog("received item request for item ${id} from peer ${endpoint}, returning the item from my message cache",
                ("endpoint", originating_peer->get_remote_endpoint())
-               ("id", requested_message.id()));
-          reply_messages.push_back(requested_message);
+               ("id", requested_message->id()));
           if (fetch_items_message_received.item_type == block_message_type)
+          {
             last_block_message_sent = requested_message;
+            // a block in the cache is a recent one, the peer very likely has its transactions already
+            if (originating_peer->supports_compact_blocks)
+            {
+              reply_messages.push_back(get_compact_block_message(requested_message));
+              continue;
+            }
+          }
+          reply_messages.push_back(requested_message);
           continue;
         }
         catch (fc::key_not_found_exception&)
@@ -2306,10 +2363,10 @@ namespace graphene { namespace net { namespace detail {
         item_id item_to_fetch(fetch_items_message_received.item_type, item_hash);
         try
         {
-          message requested_message = _delegate->get_item(item_to_fetch);
+          message_ptr requested_message = std::make_shared<const message>(_delegate->get_item(item_to_fetch));
           dlog("received item request from peer ${endpoint}, returning the item from delegate with id ${id} size ${size}",
-               ("id", requested_message.id())
-               ("size", requested_message.size)
+               ("id", requested_message->id())
+               ("size", requested_message->size)
                ("endpoint", originating_peer->get_remote_endpoint()));
           reply_messages.push_back(requested_message);
           if (fetch_items_message_received.item_type == block_message_type)
@@ -2318,7 +2375,7 @@ namespace graphene { namespace net { namespace detail {
         }
         catch (fc::key_not_found_exception&)
         {
-          reply_messages.push_back(item_not_available_message(item_to_fetch));
+          reply_messages.push_back(std::make_shared<const message>(item_not_available_message(item_to_fetch)));
           dlog("received item request from peer ${endpoint} but we don't have it",
                ("endpoint", originating_peer->get_remote_endpoint()));
         }
@@ -2332,15 +2389,30 @@ namespace graphene { namespace net { namespace detail {
         originating_peer->last_block_time_delegate_has_seen = _delegate->get_block_time(block.block_id);
       }
 
-      for (const message& reply : reply_messages)
+      for (const message_ptr& reply : reply_messages)
       {
-        if (reply.msg_type.value() == block_message_type)
-          originating_peer->send_item(item_id(block_message_type, reply.as<graphene::net::block_message>().block_id));
+        if (reply->msg_type.value() == block_message_type)
+          originating_peer->send_item(item_id(block_message_type, reply->as<graphene::net::block_message>().block_id));
         else
           originating_peer->send_message(reply);
       }
     }
 
+    message_ptr node_impl::get_compact_block_message( const message_ptr& full_block_message ) const
+    {
+      VERIFY_CORRECT_THREAD();
+      graphene::net::block_message block = full_block_message->as<graphene::net::block_message>();
+      for (const auto& id_and_message : _recent_compact_blocks)
+        if (id_and_message.first == block.block_id)
+          return id_and_message.second;
+
+      message_ptr compact = std::make_shared<const message>(compact_block_message(block.block));
+      _recent_compact_blocks.emplace_back(block.block_id, compact);
+      if (_recent_compact_blocks.size() > GRAPHENE_NET_MESSAGE_CACHE_DURATION_IN_BLOCKS)
+        _recent_compact_blocks.pop_front();
+      return compact;
+    }
+
     void node_impl::on_item_not_available_message( peer_connection* originating_peer, const item_not_available_message& item_not_available_message_received )
     {
       VERIFY_CORRECT_THREAD();
@@ -2397,8 +2469,7 @@ namespace graphene { namespace net { namespace detail {
         bool we_advertised_this_item_to_a_peer = false;
         bool we_requested_this_item_from_a_peer = false;
         {
-           fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-            for (const peer_connection_ptr& peer : _active_connections)
+            for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
             {
                if (peer->inventory_advertised_to_peer.find(advertised_item_id) != peer->inventory_advertised_to_peer.end())
                {
@@ -2510,7 +2581,7 @@ namespace graphene { namespace net { namespace detail {
       _closing_connections.erase(originating_peer_ptr);
       _handshaking_connections.erase(originating_peer_ptr);
       _terminating_connections.erase(originating_peer_ptr);
-      if (_active_connections.find(originating_peer_ptr) != _active_connections.end())
+      if (_active_connections.contains(originating_peer_ptr))
       {
         _active_connections.erase(originating_peer_ptr);
 
@@ -2521,6 +2592,11 @@ namespace graphene { namespace net { namespace detail {
           if (updated_peer_record)
           {
             updated_peer_record->last_seen_time = fc::time_point::now();
+            // remember how the peer performed, it rates the peer when we look for peers to connect to
+            if (originating_peer_ptr->round_trip_delay > fc::microseconds())
+              updated_peer_record->latency = originating_peer_ptr->round_trip_delay;
+            if (originating_peer_ptr->sync_blocks_per_second > 0)
+              updated_peer_record->sync_blocks_per_second = originating_peer_ptr->sync_blocks_per_second;
             _potential_peer_db.update_entry(*updated_peer_record);
           }
         }
@@ -2645,9 +2721,8 @@ namespace graphene { namespace net { namespace detail {
                ("count", _total_num_of_unfetched_items));
          bool is_fork_block = is_hard_fork_block(block_message_to_send.block.block_num());
          {
-            fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
 
-            for (const peer_connection_ptr& peer : _active_connections)
+            for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
             {
                bool disconnecting_this_peer = false;
                if (is_fork_block)
@@ -2715,13 +2790,12 @@ namespace graphene { namespace net { namespace detail {
                   }
                }
             } // for
-         } // lock_guard
+         }
       }
       else
       {
         // invalid message received
-        fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-        for (const peer_connection_ptr& peer : _active_connections)
+        for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
         {
           if (peer->ids_of_items_being_processed.find(block_message_to_send.block_id)
                  != peer->ids_of_items_being_processed.end())
@@ -2811,87 +2885,100 @@ namespace graphene { namespace net { namespace detail {
 
       do
       {
-        std::copy(std::make_move_iterator(_new_received_sync_items.begin()),
-                  std::make_move_iterator(_new_received_sync_items.end()),
-                  std::front_inserter(_received_sync_items));
-        _new_received_sync_items.clear();
         dlog("currently ${count} sync items to consider", ("count", _received_sync_items.size()));
 
         block_processed_this_iteration = false;
-        for (auto received_block_iter = _received_sync_items.begin();
-             received_block_iter != _received_sync_items.end();
-             ++received_block_iter)
+
+        // find out if we have the next block on the active chain or one of the forks, i.e. the first block
+        // any peer still has to give us
+        auto received_block_iter = _received_sync_items.end();
+        for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
         {
+          if (!peer->ids_of_items_to_get.empty())
+          {
+            received_block_iter = _received_sync_items.find(peer->ids_of_items_to_get.front());
+            if (received_block_iter != _received_sync_items.end())
+              break;
+          }
+        }
 
-          // find out if this block is the next block on the active chain or one of the forks
-          bool potential_first_block = false;
+        // if it is, process it, remove it from all sync peers lists
+        if (received_block_iter != _received_sync_items.end())
+        {
+          const graphene::net::block_id_type block_id = received_block_iter->first;
+          for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
           {
-            fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-            for (const peer_connection_ptr& peer : _active_connections)
+            if (!peer->ids_of_items_to_get.empty() &&
+                peer->ids_of_items_to_get.front() == block_id)
             {
-               if (!peer->ids_of_items_to_get.empty() &&
-                     peer->ids_of_items_to_get.front() == received_block_iter->block_id)
-               {
-                  potential_first_block = true;
-                  peer->ids_of_items_to_get.pop_front();
-                  peer->ids_of_items_being_processed.insert(received_block_iter->block_id);
-               }
+              peer->ids_of_items_to_get.pop_front();
+              peer->ids_of_items_being_processed.insert(block_id);
             }
           }
 
-          // if it is, process it, remove it from all sync peers lists
-          if (potential_first_block)
+          // we can get into an interesting situation near the end of synchronization.  We can be in
+          // sync with one peer who is sending us the last block on the chain via a regular inventory
+          // message, while at the same time still be synchronizing with a peer who is sending us the
+          // block through the sync mechanism.  Further, we must request both blocks because
+          // we don't know they're the same (for the peer in normal operation, it has only told us the
+          // message id, for the peer in the sync case we only known the block_id).
+          if (std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
+                        block_id) == _most_recent_blocks_accepted.end())
           {
-            // we can get into an interesting situation near the end of synchronization.  We can be in
-            // sync with one peer who is sending us the last block on the chain via a regular inventory
-            // message, while at the same time still be synchronizing with a peer who is sending us the
-            // block through the sync mechanism.  Further, we must request both blocks because
-            // we don't know they're the same (for the peer in normal operation, it has only told us the
-            // message id, for the peer in the sync case we only known the block_id).
-            if (std::find(_most_recent_blocks_accepted.begin(), _most_recent_blocks_accepted.end(),
-                          received_block_iter->block_id) == _most_recent_blocks_accepted.end())
-            {
-              graphene::net::block_message block_message_to_process = *received_block_iter;
-              _received_sync_items.erase(received_block_iter);
-              _handle_message_calls_in_progress.emplace_back(fc::async([this, block_message_to_process](){
-                send_sync_block_to_node_delegate(block_message_to_process);
-              }, "send_sync_block_to_node_delegate"));
-              ++blocks_processed;
-              block_processed_this_iteration = true;
-            }
-            else
+            received_sync_block block_to_process = std::move(received_block_iter->second);
+            _received_sync_items.erase(received_block_iter);
+            _handle_message_calls_in_progress.emplace_back(fc::async([this, block_to_process]() mutable {
+              if (block_to_process.precomputed.valid())
+              {
+                try
+                {
+                  block_to_process.precomputed.wait();
+                }
+                catch (const fc::canceled_exception&)
+                {
+                  throw;
+                }
+                catch (...)
+                {
+                  // handle_block() checks the block again and reports the problem
+                }
+              }
+              send_sync_block_to_node_delegate(*block_to_process.block);
+            }, "send_sync_block_to_node_delegate"));
+            ++blocks_processed;
+            block_processed_this_iteration = true;
+          }
+          else
+          {
+            dlog("Already received and accepted this block (presumably through normal inventory mechanism), treating it as accepted");
+            _received_sync_items.erase(received_block_iter);
+            std::vector< peer_connection_ptr > peers_needing_next_batch;
+            for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
             {
-              dlog("Already received and accepted this block (presumably through normal inventory mechanism), treating it as accepted");
-              std::vector< peer_connection_ptr > peers_needing_next_batch;
-              fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-              for (const peer_connection_ptr& peer : _active_connections)
+              auto items_being_processed_iter = peer->ids_of_items_being_processed.find(block_id);
+              if (items_being_processed_iter != peer->ids_of_items_being_processed.end())
               {
-                auto items_being_processed_iter = peer->ids_of_items_being_processed.find(received_block_iter->block_id);
-                if (items_being_processed_iter != peer->ids_of_items_being_processed.end())
+                peer->ids_of_items_being_processed.erase(items_being_processed_iter);
+                dlog("Removed item from ${endpoint}'s list of items being processed, still processing ${len} blocks",
+                     ("endpoint", peer->get_remote_endpoint())("len", peer->ids_of_items_being_processed.size()));
+
+                // if we just processed the last item in our list from this peer, we will want to
+                // send another request to find out if we are now in sync (this is normally handled in
+                // send_sync_block_to_node_delegate)
+                if (peer->ids_of_items_to_get.empty() &&
+                    peer->number_of_unfetched_item_ids == 0 &&
+                    peer->ids_of_items_being_processed.empty())
                 {
-                  peer->ids_of_items_being_processed.erase(items_being_processed_iter);
-                  dlog("Removed item from ${endpoint}'s list of items being processed, still processing ${len} blocks",
-                       ("endpoint", peer->get_remote_endpoint())("len", peer->ids_of_items_being_processed.size()));
-
-                  // if we just processed the last item in our list from this peer, we will want to
-                  // send another request to find out if we are now in sync (this is normally handled in
-                  // send_sync_block_to_node_delegate)
-                  if (peer->ids_of_items_to_get.empty() &&
-                      peer->number_of_unfetched_item_ids == 0 &&
-                      peer->ids_of_items_being_processed.empty())
-                  {
-                    dlog("We received last item in our list for peer ${endpoint}, setup to do a sync check", ("endpoint", peer->get_remote_endpoint()));
-                    peers_needing_next_batch.push_back( peer );
-                  }
+                  dlog("We received last item in our list for peer ${endpoint}, setup to do a sync check", ("endpoint", peer->get_remote_endpoint()));
+                  peers_needing_next_batch.push_back( peer );
                 }
               }
-              for( const peer_connection_ptr& peer : peers_needing_next_batch )
-                fetch_next_batch_of_item_ids_from_peer(peer.get());
             }
-
-            break; // start iterating _received_sync_items from the beginning
-          } // end if potential_first_block
-        } // end for each block in _received_sync_items
+            for( const peer_connection_ptr& peer : peers_needing_next_batch )
+              fetch_next_batch_of_item_ids_from_peer(peer.get());
+            block_processed_this_iteration = true;
+          }
+        } // end if we have the next block
 
         if (_handle_message_calls_in_progress.size() >= _max_blocks_to_handle_at_once)
         {
@@ -2919,6 +3006,28 @@ namespace graphene { namespace net { namespace detail {
                                                           "process_backlog_of_sync_blocks" );
     }
 
+    void node_impl::update_sync_window(peer_connection* peer)
+    {
+      VERIFY_CORRECT_THREAD();
+      ++peer->sync_blocks_in_throughput_period;
+      const fc::microseconds elapsed = fc::time_point::now() - peer->sync_throughput_period_start;
+      // measure over half a window at least, so single blocks arriving in bursts don't make it jump around
+      if (peer->sync_blocks_in_throughput_period < std::max<size_t>(peer->sync_window / 2, 1) ||
+          elapsed <= fc::microseconds())
+        return;
+
+      peer->sync_window = adapt_sync_window(peer->sync_window, peer->sync_blocks_in_throughput_period, elapsed,
+                                            _max_sync_blocks_per_peer);
+      peer->sync_blocks_per_second = (uint32_t)(uint64_t(peer->sync_blocks_in_throughput_period)
+                                                * fc::seconds(1).count() / elapsed.count());
+      dlog("sync window of peer ${endpoint} is now ${window} blocks, it delivered ${count} blocks in ${elapsed}us",
+           ("endpoint", peer->get_remote_endpoint())("window", peer->sync_window)
+           ("count", peer->sync_blocks_in_throughput_period)("elapsed", elapsed.count()));
+
+      peer->sync_throughput_period_start = fc::time_point::now();
+      peer->sync_blocks_in_throughput_period = 0;
+    }
+
     void node_impl::process_block_during_syncing( peer_connection* originating_peer,
                                                const graphene::net::block_message& block_message_to_process,
                                                const message_hash_type& )
@@ -2926,9 +3035,21 @@ namespace graphene { namespace net { namespace detail {
       VERIFY_CORRECT_THREAD();
       dlog( "received a sync block from peer ${endpoint}", ("endpoint", originating_peer->get_remote_endpoint() ) );
 
-      // add it to the front of _received_sync_items, then process _received_sync_items to try to
-      // pass as many messages as possible to the client.
-      _new_received_sync_items.push_front( block_message_to_process );
+      // add it to _received_sync_items and start its precomputations, they run on other threads while the
+      // blocks before it are applied.  Then process _received_sync_items to try to pass as many messages as
+      // possible to the client.
+      received_sync_block received;
+      received.block = std::make_shared<const graphene::net::block_message>( block_message_to_process );
+      try
+      {
+        received.precomputed = _delegate->precompute_block( received.block );
+      }
+      catch (const fc::exception& e)
+      {
+        // handle_block() will do the work and report the problem
+        dlog( "unable to precompute sync block ${id}: ${e}", ("id", block_message_to_process.block_id)("e", e) );
+      }
+      _received_sync_items.emplace( block_message_to_process.block_id, std::move(received) );
       trigger_process_backlog_of_sync_blocks();
     }
 
@@ -2992,8 +3113,7 @@ namespace graphene { namespace net { namespace detail {
         uint32_t block_number = block_message_to_process.block.block_num();
         fc::time_point_sec block_time = block_message_to_process.block.timestamp;
         {
-         fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-         for (const peer_connection_ptr& peer : _active_connections)
+         for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
          {
             auto iter = peer->inventory_peer_advertised_to_us.find(block_message_item_id);
             if (iter != peer->inventory_peer_advertised_to_us.end())
@@ -3017,8 +3137,7 @@ namespace graphene { namespace net { namespace detail {
         {
           // we just pushed a hard fork block.  Find out if any of our peers are running clients
           // that will be unable to process future blocks
-          fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-          for (const peer_connection_ptr& peer : _active_connections)
+          for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
           {
             if (peer->last_known_fork_block_number != 0)
             {
@@ -3072,8 +3191,7 @@ namespace graphene { namespace net { namespace detail {
         disconnect_reason = "You offered me a block that I have deemed to be invalid";
 
         peers_to_disconnect.insert( originating_peer->shared_from_this() );
-        fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-        for (const peer_connection_ptr& peer : _active_connections)
+        for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
           if (!peer->ids_of_items_to_get.empty() && peer->ids_of_items_to_get.front() == block_message_to_process.block_id)
             peers_to_disconnect.insert(peer);
       }
@@ -3128,6 +3246,7 @@ namespace graphene { namespace net { namespace detail {
           {
             originating_peer->last_sync_item_received_time = fc::time_point::now();
             _active_sync_requests.erase(block_message_to_process.block_id);
+            update_sync_window(originating_peer);
             process_block_during_syncing(originating_peer, block_message_to_process, message_hash);
             if (originating_peer->idle())
             {
@@ -3139,6 +3258,8 @@ namespace graphene { namespace net { namespace detail {
               else
                 trigger_fetch_sync_items_loop();
             }
+            else if (originating_peer->sync_items_requested_from_peer.size() <= originating_peer->sync_window / 2)
+              trigger_fetch_sync_items_loop(); // half of the window arrived, refill it
             return;
           }
           catch (const fc::canceled_exception& e)
@@ -3175,6 +3296,164 @@ namespace graphene { namespace net { namespace detail {
       disconnect_from_peer(originating_peer, "You sent me a block that I didn't ask for", true, detailed_error);
     }
 
+    void node_impl::on_compact_block_message(peer_connection* originating_peer,
+                                             const compact_block_message& compact_block_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      // compact blocks only come in reply to the blocks we request during normal operation
+      bool block_requested = false;
+      for (const peer_connection::item_to_time_map_type::value_type& item_and_time : originating_peer->items_requested_from_peer)
+        if (item_and_time.first.item_type == block_message_type)
+        {
+          block_requested = true;
+          break;
+        }
+      if (!originating_peer->supports_compact_blocks || !block_requested)
+      {
+        wlog("received a compact block ${block_id} I didn't ask for from peer ${endpoint}, disconnecting from peer",
+             ("endpoint", originating_peer->get_remote_endpoint())
+             ("block_id", compact_block_message_received.block_id));
+        fc::exception detailed_error(FC_LOG_MESSAGE(error, "You sent me a compact block that I didn't ask for, block_id: ${block_id}",
+                                                    ("block_id", compact_block_message_received.block_id)));
+        disconnect_from_peer(originating_peer, "You sent me a compact block that I didn't ask for", true, detailed_error);
+        return;
+      }
+
+      std::vector<uint32_t> missing_indexes;
+      graphene::protocol::signed_block block = rebuild_compact_block(compact_block_message_received,
+            [this](uint64_t short_id) -> fc::optional<graphene::protocol::signed_transaction> {
+              message_ptr cached_trx_message = _message_cache.get_transaction_by_short_id(short_id);
+              if (!cached_trx_message)
+                return fc::optional<graphene::protocol::signed_transaction>();
+              return graphene::protocol::signed_transaction(cached_trx_message->as<trx_message>().trx);
+            },
+            missing_indexes);
+
+      if (missing_indexes.empty())
+      {
+        process_completed_compact_block(originating_peer, std::move(block), compact_block_message_received.block_id, false);
+        return;
+      }
+
+      dlog("missing ${count} of ${total} transactions of compact block ${block_id} from peer ${endpoint}, fetching them",
+           ("count", missing_indexes.size())
+           ("total", block.transactions.size())
+           ("block_id", compact_block_message_received.block_id)
+           ("endpoint", originating_peer->get_remote_endpoint()));
+      originating_peer->send_message(fetch_block_transactions_message(compact_block_message_received.block_id,
+                                                                      missing_indexes));
+      originating_peer->compact_blocks_being_completed[compact_block_message_received.block_id] =
+            peer_connection::pending_compact_block{ std::move(block), std::move(missing_indexes) };
+    }
+
+    void node_impl::on_fetch_block_transactions_message(peer_connection* originating_peer,
+                                                        const fetch_block_transactions_message& fetch_block_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      block_transactions_message reply;
+      reply.block_id = fetch_block_transactions_message_received.block_id;
+
+      fc::optional<graphene::net::block_message> requested_block;
+      try
+      {
+        requested_block = _message_cache.get_message_by_contents(reply.block_id)->as<graphene::net::block_message>();
+      }
+      catch (fc::key_not_found_exception&)
+      {
+        try
+        {
+          requested_block = _delegate->get_item(item_id(block_message_type, reply.block_id)).as<graphene::net::block_message>();
+        }
+        catch (fc::key_not_found_exception&)
+        {
+        }
+      }
+
+      // an empty reply tells the peer we can't complete the block
+      if (requested_block)
+      {
+        const std::vector<graphene::protocol::processed_transaction>& transactions = requested_block->block.transactions;
+        reply.transactions.reserve(fetch_block_transactions_message_received.indexes.size());
+        for (uint32_t index : fetch_block_transactions_message_received.indexes)
+        {
+          if (index >= transactions.size())
+          {
+            reply.transactions.clear();
+            break;
+          }
+          reply.transactions.push_back(transactions[index]);
+        }
+      }
+      else
+        dlog("peer ${endpoint} asked for transactions of block ${block_id}, which I don't have",
+             ("endpoint", originating_peer->get_remote_endpoint())("block_id", reply.block_id));
+      originating_peer->send_message(reply);
+    }
+
+    void node_impl::on_block_transactions_message(peer_connection* originating_peer,
+                                                  const block_transactions_message& block_transactions_message_received)
+    {
+      VERIFY_CORRECT_THREAD();
+      const block_id_type& block_id = block_transactions_message_received.block_id;
+      auto pending_iter = originating_peer->compact_blocks_being_completed.find(block_id);
+      if (pending_iter == originating_peer->compact_blocks_being_completed.end())
+      {
+        dlog("ignoring transactions of block ${block_id} from peer ${endpoint}, I'm not waiting for them",
+             ("block_id", block_id)("endpoint", originating_peer->get_remote_endpoint()));
+        return;
+      }
+      peer_connection::pending_compact_block pending = std::move(pending_iter->second);
+      originating_peer->compact_blocks_being_completed.erase(pending_iter);
+
+      if (!fill_compact_block(pending.block, pending.missing_indexes, block_transactions_message_received.transactions))
+      {
+        // the peer doesn't have the block any more, fetch it from another peer right away instead of waiting for
+        // the request to time out, which would disconnect this peer
+        wlog("peer ${endpoint} couldn't complete compact block ${block_id}, fetching the block from another peer",
+             ("endpoint", originating_peer->get_remote_endpoint())("block_id", block_id));
+        const item_id requested_item(graphene::net::block_message_type, block_id);
+        originating_peer->items_requested_from_peer.erase(requested_item);
+        originating_peer->inventory_peer_advertised_to_us.erase(requested_item);
+        if (is_item_in_any_peers_inventory(requested_item))
+        {
+          _items_to_fetch.insert(prioritized_item_id(requested_item, _items_to_fetch_seq_counter));
+          ++_items_to_fetch_seq_counter;
+        }
+        trigger_fetch_items_loop();
+        return;
+      }
+
+      bool all_transactions_from_peer = pending.missing_indexes.size() == pending.block.transactions.size();
+      process_completed_compact_block(originating_peer, std::move(pending.block), block_id,
+                                      all_transactions_from_peer);
+    }
+
+    void node_impl::process_completed_compact_block(peer_connection* originating_peer,
+                                                    graphene::protocol::signed_block&& block,
+                                                    const block_id_type& block_id,
+                                                    bool all_transactions_from_peer)
+    {
+      VERIFY_CORRECT_THREAD();
+      std::vector<uint32_t> all_indexes;
+      if (!all_transactions_from_peer)
+        all_indexes = compact_block_transactions_to_refetch(block);
+      if (!all_indexes.empty())
+      {
+        // a short id matched a different transaction of ours, take them all from the peer instead
+        dlog("compact block ${block_id} from peer ${endpoint} doesn't match its merkle root, fetching all of its transactions",
+             ("block_id", block_id)("endpoint", originating_peer->get_remote_endpoint()));
+        originating_peer->send_message(fetch_block_transactions_message(block_id, all_indexes));
+        originating_peer->compact_blocks_being_completed[block_id] =
+              peer_connection::pending_compact_block{ std::move(block), std::move(all_indexes) };
+        return;
+      }
+
+      // if the peer sent a block that doesn't match, its message hash won't match our request either
+      // and process_block_message() disconnects it
+      message block_message_to_process{graphene::net::block_message(block)};
+      process_block_message(originating_peer, block_message_to_process, block_message_to_process.id());
+    }
+
     void node_impl::on_current_time_request_message(peer_connection* originating_peer,
                                                     const current_time_request_message& current_time_request_message_received)
     {
@@ -3204,8 +3483,7 @@ namespace graphene { namespace net { namespace detail {
     void node_impl::forward_firewall_check_to_next_available_peer(firewall_check_state_data* firewall_check_state)
     {
       {
-         fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-         for (const peer_connection_ptr& peer : _active_connections)
+         for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
          {
             if (firewall_check_state->expected_node_id != peer->node_id && // it's not the node who is asking us to test
                   !peer->firewall_check_state && // the peer isn't already performing a check for another node
@@ -3224,7 +3502,7 @@ namespace graphene { namespace net { namespace detail {
                return;
             }
          }
-      } // lock_guard
+      }
       wlog("Unable to forward firewall check for node ${to_check} to any other peers, returning 'unable'",
            ("to_check", firewall_check_state->endpoint_to_test));
 
@@ -3330,6 +3608,7 @@ namespace graphene { namespace net { namespace detail {
                 {
                   potential_peer_record updated_peer_record = _potential_peer_db.lookup_or_create_entry_for_endpoint(*inbound_endpoint);
                   updated_peer_record.last_seen_time = fc::time_point::now();
+                  updated_peer_record.firewalled = firewalled_state::not_firewalled;
                   _potential_peer_db.update_entry(updated_peer_record);
                 }
               }
@@ -3473,8 +3752,7 @@ namespace graphene { namespace net { namespace detail {
 
     void node_impl::start_synchronizing()
     {
-      fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-      for( const peer_connection_ptr& peer : _active_connections )
+      for( const peer_connection_ptr& peer : _active_connections.get_snapshot() )
         start_synchronizing_with_peer( peer );
     }
 
@@ -3577,6 +3855,21 @@ namespace graphene { namespace net { namespace detail {
         wlog( "Exception thrown while terminating Process backlog of sync items task, ignoring" );
       }
 
+      // the precomputations of the sync blocks we were holding may still be running on other threads
+      for (auto& received : _received_sync_items)
+      {
+        try
+        {
+          if (received.second.precomputed.valid())
+            received.second.precomputed.wait();
+        }
+        catch (...)
+        {
+          // only its completion matters here
+        }
+      }
+      _received_sync_items.clear();
+
       size_t handle_message_call_count = 0;
       while( true )
       {
@@ -3679,17 +3972,10 @@ namespace graphene { namespace net { namespace detail {
       // operate off copies of the lists in case they change during iteration
       std::list<peer_connection_ptr> all_peers;
       auto p_back = [&all_peers](const peer_connection_ptr& conn) { all_peers.push_back(conn); };
+      for (const auto* peers : { &_active_connections, &_handshaking_connections, &_closing_connections })
       {
-         fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-         std::for_each(_active_connections.begin(), _active_connections.end(), p_back);
-      }
-      {
-         fc::scoped_lock<fc::mutex> lock(_handshaking_connections.get_mutex());
-         std::for_each(_handshaking_connections.begin(), _handshaking_connections.end(), p_back);
-      }
-      {
-         fc::scoped_lock<fc::mutex> lock(_closing_connections.get_mutex());
-         std::for_each(_closing_connections.begin(), _closing_connections.end(), p_back);
+         const auto snapshot = peers->get_snapshot();
+         std::for_each(snapshot.begin(), snapshot.end(), p_back);
       }
 
       for (const peer_connection_ptr& peer : all_peers)
@@ -3928,6 +4214,7 @@ namespace graphene { namespace net { namespace detail {
         updated_peer_record.last_connection_disposition = last_connection_handshaking_failed;
         updated_peer_record.number_of_successful_connection_attempts++;
         updated_peer_record.last_seen_time = fc::time_point::now();
+        updated_peer_record.firewalled = firewalled_state::not_firewalled;
         _potential_peer_db.update_entry(updated_peer_record);
       }
       catch (const fc::exception& except)
@@ -3977,9 +4264,9 @@ namespace graphene { namespace net { namespace detail {
         // whether the peer is firewalled, we want to disconnect now.
         _handshaking_connections.erase(new_peer);
         _terminating_connections.erase(new_peer);
-        assert(_active_connections.find(new_peer) == _active_connections.end());
+        assert(!_active_connections.contains(new_peer));
         _active_connections.erase(new_peer);
-        assert(_closing_connections.find(new_peer) == _closing_connections.end());
+        assert(!_closing_connections.contains(new_peer));
         _closing_connections.erase(new_peer);
 
         display_current_connections();
@@ -4068,6 +4355,9 @@ namespace graphene { namespace net { namespace detail {
       try
       {
         _potential_peer_db.open(potential_peer_database_file_name);
+        fc::path legacy_potential_peer_database_file_name(_node_configuration_directory / LEGACY_POTENTIAL_PEER_DATABASE_FILENAME);
+        if (_potential_peer_db.size() == 0 && fc::exists(legacy_potential_peer_database_file_name))
+          _potential_peer_db.import_json(legacy_potential_peer_database_file_name);
 
         // push back the time on all peers loaded from the database so we will be able to retry them immediately
         for (peer_database::iterator itr = _potential_peer_db.begin(); itr != _potential_peer_db.end(); ++itr)
@@ -4297,8 +4587,7 @@ namespace graphene { namespace net { namespace detail {
     {
       VERIFY_CORRECT_THREAD();
       {
-         fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-         for( const peer_connection_ptr& active_peer : _active_connections )
+         for( const peer_connection_ptr& active_peer : _active_connections.get_snapshot() )
          {
             fc::optional<fc::ip::endpoint> endpoint_for_this_peer( active_peer->get_remote_endpoint() );
             if( endpoint_for_this_peer && *endpoint_for_this_peer == remote_endpoint )
@@ -4306,8 +4595,7 @@ namespace graphene { namespace net { namespace detail {
          }
       }
       {
-         fc::scoped_lock<fc::mutex> lock(_handshaking_connections.get_mutex());
-         for( const peer_connection_ptr& handshaking_peer : _handshaking_connections )
+         for( const peer_connection_ptr& handshaking_peer : _handshaking_connections.get_snapshot() )
          {
             fc::optional<fc::ip::endpoint> endpoint_for_this_peer( handshaking_peer->get_remote_endpoint() );
             if( endpoint_for_this_peer && *endpoint_for_this_peer == remote_endpoint )
@@ -4358,8 +4646,7 @@ namespace graphene { namespace net { namespace detail {
            ( "active", _active_connections.size() )("handshaking", _handshaking_connections.size() )("closing",_closing_connections.size() )
            ( "desired", _desired_number_of_connections )("maximum", _maximum_number_of_connections ) );
       {
-         fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-         for( const peer_connection_ptr& peer : _active_connections )
+         for( const peer_connection_ptr& peer : _active_connections.get_snapshot() )
          {
             ilog( "       active peer ${endpoint} peer_is_in_sync_with_us:${in_sync_with_us} we_are_in_sync_with_peer:${in_sync_with_them}",
                   ( "endpoint", peer->get_remote_endpoint() )
@@ -4372,8 +4659,7 @@ namespace graphene { namespace net { namespace detail {
          }
       }
       {
-         fc::scoped_lock<fc::mutex> lock(_handshaking_connections.get_mutex());
-         for( const peer_connection_ptr& peer : _handshaking_connections )
+         for( const peer_connection_ptr& peer : _handshaking_connections.get_snapshot() )
          {
             ilog( "  handshaking peer ${endpoint} in state ours(${our_state}) theirs(${their_state})",
                   ( "endpoint", peer->get_remote_endpoint() )("our_state", peer->our_state )("their_state", peer->their_state ) );
@@ -4382,12 +4668,10 @@ namespace graphene { namespace net { namespace detail {
       ilog( "--------- MEMORY USAGE ------------" );
       ilog( "node._active_sync_requests size: ${size}", ("size", _active_sync_requests.size() ) );
       ilog( "node._received_sync_items size: ${size}", ("size", _received_sync_items.size() ) );
-      ilog( "node._new_received_sync_items size: ${size}", ("size", _new_received_sync_items.size() ) );
       ilog( "node._items_to_fetch size: ${size}", ("size", _items_to_fetch.size() ) );
       ilog( "node._new_inventory size: ${size}", ("size", _new_inventory.size() ) );
       ilog( "node._message_cache size: ${size}", ("size", _message_cache.size() ) );
-      fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-      for( const peer_connection_ptr& peer : _active_connections )
+      for( const peer_connection_ptr& peer : _active_connections.get_snapshot() )
       {
         ilog( "  peer ${endpoint}", ("endpoint", peer->get_remote_endpoint() ) );
         ilog( "    peer.ids_of_items_to_get size: ${size}", ("size", peer->ids_of_items_to_get.size() ) );
@@ -4484,8 +4768,7 @@ namespace graphene { namespace net { namespace detail {
     {
       VERIFY_CORRECT_THREAD();
       std::vector<peer_status> statuses;
-      fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-      for (const peer_connection_ptr& peer : _active_connections)
+      for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
       {
         peer_status this_peer_status;
         this_peer_status.version = 0;
@@ -4634,7 +4917,7 @@ namespace graphene { namespace net { namespace detail {
       _desired_number_of_connections = std::min(_desired_number_of_connections, _maximum_number_of_connections);
 
       while (_active_connections.size() > _maximum_number_of_connections)
-        disconnect_from_peer(_active_connections.begin()->get(),
+        disconnect_from_peer(_active_connections.get_snapshot().begin()->get(),
                              "I have too many connections open");
       trigger_p2p_network_connect_loop();
     }
@@ -4678,8 +4961,7 @@ namespace graphene { namespace net { namespace detail {
       std::list<peer_connection_ptr> peers_to_disconnect;
       if (!_allowed_peers.empty())
       {
-         fc::scoped_lock<fc::mutex> lock(_active_connections.get_mutex());
-         for (const peer_connection_ptr& peer : _active_connections)
+         for (const peer_connection_ptr& peer : _active_connections.get_snapshot())
             if (_allowed_peers.find(peer->node_id) == _allowed_peers.end())
                peers_to_disconnect.push_back(peer);
       }
@@ -5056,6 +5338,13 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_AND_COLLECT_STATISTICS(handle_block, block_message, sync_mode, contained_transaction_msg_ids);
     }
 
+    fc::future<void> statistics_gathering_node_delegate_wrapper::precompute_block(
+             const std::shared_ptr<const graphene::net::block_message>& blk_msg )
+    {
+      // this only starts the work and is meant to be called on the p2p thread, so don't hop to the delegate thread
+      return _node_delegate->precompute_block( blk_msg );
+    }
+
     void statistics_gathering_node_delegate_wrapper::handle_transaction( const graphene::net::trx_message& transaction_message )
     {
       INVOKE_AND_COLLECT_STATISTICS(handle_transaction, transaction_message);
@@ -5177,4 +5466,21 @@ namespace graphene { namespace net { namespace detail {
       INVOKE_IN_IMPL(add_seed_node, in);
    }
 
+   size_t adapt_sync_window(size_t current_window, size_t blocks, fc::microseconds elapsed, size_t max_blocks_per_peer)
+   {
+      if (elapsed <= fc::microseconds())
+         return current_window;
+      // the window which would take GRAPHENE_NET_SYNC_WINDOW_TARGET_SECONDS at the measured rate,
+      // averaged with the current one to smooth it
+      const uint64_t blocks_per_target = uint64_t(blocks) * fc::seconds(GRAPHENE_NET_SYNC_WINDOW_TARGET_SECONDS).count()
+                                         / elapsed.count();
+      const size_t max_window = std::max<size_t>(max_blocks_per_peer, GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING);
+      const size_t new_window = (size_t)std::min<uint64_t>(std::max<uint64_t>(blocks_per_target,
+                                                                               GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING),
+                                                            max_window);
+      return std::min<size_t>(std::max<size_t>((current_window + new_window + 1) / 2,
+                                               GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING),
+                              max_window);
+   }
+
 } } // end namespace graphene::net
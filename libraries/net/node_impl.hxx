@@ -16,8 +16,11 @@
 #define testnetlog(...) do {} while (0)
 #endif
 
+#include <array>
+#include <deque>
 #include <memory>
 #include <mutex>
+#include <unordered_set>
 #include <fc/thread/thread.hpp>
 #include <fc/log/logger.hpp>
 #include <fc/network/tcp_socket.hpp>
@@ -32,121 +35,179 @@ namespace graphene { namespace net { namespace detail {
 namespace bmi = boost::multi_index;
 
 /*******
- * A class to wrap std::unordered_set for multithreading
+ * A set which is copied on every change, so that readers never lock it for longer than it takes to copy a
+ * pointer.  Iterating over a snapshot is safe even if the set changes meanwhile, also across fiber switches,
+ * and every snapshot keeps its elements alive.
+ *
+ * Meant for small sets which are read much more often than they are changed, like the peer sets
+ * of the node, which change when a peer connects or disconnects and are iterated in all loops of the node.
  */
 template <class Key, class Hash = std::hash<Key>, class Pred = std::equal_to<Key> >
-class concurrent_unordered_set : private std::unordered_set<Key, Hash, Pred>
+class copy_on_write_set
 {
-private:
-   mutable fc::mutex mux;
-
 public:
-   /// Iterations require a lock. This exposes the mutex. Use with care (i.e. lock_guard)
-   fc::mutex& get_mutex()const { return mux; }
+   using set_type = std::unordered_set<Key, Hash, Pred>;
 
-   /// Insertion
-   /// @{
-   std::pair< typename std::unordered_set<Key, Hash, Pred>::iterator, bool> emplace( Key key)
+   /// An immutable state of the set
+   class snapshot
    {
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::emplace( key );
-   }
-   std::pair< typename std::unordered_set<Key, Hash, Pred>::iterator, bool> insert (const Key& val)
+   public:
+      explicit snapshot( std::shared_ptr<const set_type> s ) : _set( std::move(s) ) {}
+
+      typename set_type::const_iterator begin() const { return _set->begin(); }
+      typename set_type::const_iterator end() const   { return _set->end(); }
+      size_t size() const { return _set->size(); }
+      bool empty() const  { return _set->empty(); }
+      bool contains( const Key& key ) const { return _set->find( key ) != _set->end(); }
+
+   private:
+      std::shared_ptr<const set_type> _set;
+   };
+
+   copy_on_write_set() : _set( std::make_shared<const set_type>() ) {}
+
+   snapshot get_snapshot() const
    {
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::insert( val ); 
+      std::lock_guard<std::mutex> lock( _mutex );
+      return snapshot( _set );
    }
-   /// @}
-   /// Size
+
+   /// Shortcuts for a single lookup, for several lookups which must agree use a snapshot
    /// @{
-   size_t size() const 
-   { 
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::size(); 
-   }
-   bool empty() const noexcept
-   {
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::empty();
-   }
+   size_t size() const { return get_snapshot().size(); }
+   bool empty() const  { return get_snapshot().empty(); }
+   bool contains( const Key& key ) const { return get_snapshot().contains( key ); }
    /// @}
-   /// Removal
-   /// @{
-   void clear() noexcept
+
+   /// @return true if the key was not in the set
+   bool insert( const Key& key )
    {
-      fc::scoped_lock<fc::mutex> lock(mux);
-      std::unordered_set<Key, Hash, Pred>::clear();
-   }
-   typename std::unordered_set<Key, Hash, Pred>::iterator erase( 
-         typename std::unordered_set<Key, Hash, Pred>::const_iterator itr)
-   { 
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::erase( itr); 
+      return update( [&key]( set_type& s ) { return s.insert( key ).second; } );
    }
-   size_t erase( const Key& key)
+
+   /// @return true if the key was in the set
+   bool erase( const Key& key )
    {
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::erase( key ); 
+      return update( [&key]( set_type& s ) { return s.erase( key ) > 0; } );
    }
-   /// @}
-   /// Swap
-   /// @{
-   void swap( typename std::unordered_set<Key, Hash, Pred>& other ) noexcept
+
+   void clear()
    {
-      fc::scoped_lock<fc::mutex> lock(mux);
-      std::unordered_set<Key, Hash, Pred>::swap( other );
-   }
-   /// @}
-   /// Iteration
-   /// @{
-   typename std::unordered_set<Key, Hash, Pred>::iterator begin() noexcept 
-   { 
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::begin(); 
+      std::lock_guard<std::mutex> lock( _writer_mutex );
+      publish( std::make_shared<const set_type>() );
    }
-   typename std::unordered_set<Key, Hash, Pred>::const_iterator begin() const noexcept 
-   { 
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::begin(); 
+
+private:
+   /// Copies the set, applies the change, and publishes the copy if something changed
+   template<typename Change>
+   bool update( const Change& change )
+   {
+      std::lock_guard<std::mutex> lock( _writer_mutex );
+      set_type changed( *get_snapshot_set() );
+      if( !change( changed ) )
+         return false;
+      publish( std::make_shared<const set_type>( std::move(changed) ) );
+      return true;
    }
-   typename std::unordered_set<Key, Hash, Pred>::local_iterator begin(size_t n) 
-   { 
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::begin(n); 
+
+   std::shared_ptr<const set_type> get_snapshot_set() const
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      return _set;
    }
-   typename std::unordered_set<Key, Hash, Pred>::const_local_iterator begin(size_t n) const 
-   { 
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::begin(n); 
+
+   void publish( std::shared_ptr<const set_type> s )
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _set.swap( s );
+      // the old set is released outside of this function, after the lock
    }
-   typename std::unordered_set<Key, Hash, Pred>::iterator end() noexcept 
-   { 
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::end(); 
+
+   /// Serializes writers, held while the copy is made
+   std::mutex _writer_mutex;
+   /// Only protects the pointer, never held for more than copying it
+   mutable std::mutex _mutex;
+   std::shared_ptr<const set_type> _set;
+};
+
+/*******
+ * A set split into shards with a lock each, so that threads which insert different keys rarely wait for
+ * each other, and none of them waits for the whole set to be collected.
+ */
+template <class Key, class Hash = std::hash<Key>, class Pred = std::equal_to<Key>, size_t Shards = 16>
+class sharded_unordered_set
+{
+public:
+   using set_type = std::unordered_set<Key, Hash, Pred>;
+
+   bool insert( const Key& key )
+   {
+      shard& sh = shard_of( key );
+      std::lock_guard<std::mutex> lock( sh.mutex );
+      return sh.set.insert( key ).second;
    }
-   typename std::unordered_set<Key, Hash, Pred>::const_iterator end() const noexcept 
-   { 
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::end(); 
+
+   size_t size() const
+   {
+      size_t result = 0;
+      for( const shard& sh : _shards )
+      {
+         std::lock_guard<std::mutex> lock( sh.mutex );
+         result += sh.set.size();
+      }
+      return result;
    }
-   typename std::unordered_set<Key, Hash, Pred>::local_iterator end(size_t n) 
-   { 
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::end(n); 
+
+   bool empty() const
+   {
+      for( const shard& sh : _shards )
+      {
+         std::lock_guard<std::mutex> lock( sh.mutex );
+         if( !sh.set.empty() )
+            return false;
+      }
+      return true;
    }
-   typename std::unordered_set<Key, Hash, Pred>::const_local_iterator end(size_t n) const 
-   { 
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::end(n); 
+
+   /// Removes all keys and returns them, one shard at a time, so inserts go on meanwhile
+   set_type take_all()
+   {
+      set_type result;
+      for( shard& sh : _shards )
+      {
+         set_type taken;
+         {
+            std::lock_guard<std::mutex> lock( sh.mutex );
+            taken.swap( sh.set );
+         }
+         if( result.empty() )
+            result.swap( taken );
+         else
+            result.insert( taken.begin(), taken.end() );
+      }
+      return result;
    }
-   /// @}
-   /// Search
-   typename std::unordered_set<Key, Hash, Pred>::const_iterator find(Key key)
+
+   void clear()
    {
-      fc::scoped_lock<fc::mutex> lock(mux);
-      return std::unordered_set<Key, Hash, Pred>::find(key); 
+      for( shard& sh : _shards )
+      {
+         std::lock_guard<std::mutex> lock( sh.mutex );
+         sh.set.clear();
+      }
    }
-};   
+
+private:
+   struct shard
+   {
+      mutable std::mutex mutex;
+      set_type           set;
+   };
+
+   shard& shard_of( const Key& key ) { return _shards[ Hash()( key ) % Shards ]; }
+
+   std::array<shard, Shards> _shards;
+};
 
 class blockchain_tied_message_cache
 {
@@ -159,7 +220,7 @@ private:
    struct message_info
    {
       message_hash_type message_hash;
-      message           message_body;
+      message_ptr       message_body;
       uint32_t          block_clock_when_received;
 
       /// for network performance stats
@@ -169,12 +230,12 @@ private:
       message_hash_type message_contents_hash;
 
       message_info( const message_hash_type& message_hash,
-                    const message&           message_body,
+                    message_ptr              message_body,
                     uint32_t                 block_clock_when_received,
                     const message_propagation_data& propagation_data,
                     message_hash_type        message_contents_hash ) :
             message_hash( message_hash ),
-            message_body( message_body ),
+            message_body( std::move(message_body) ),
             block_clock_when_received( block_clock_when_received ),
             propagation_data( propagation_data ),
             message_contents_hash( message_contents_hash )
@@ -200,7 +261,12 @@ public:
                        const message_hash_type& hash_of_message_to_cache,
                        const message_propagation_data& propagation_data,
                        const message_hash_type& message_content_hash );
-   message get_message( const message_hash_type& hash_of_message_to_lookup ) const;
+   /// the cached message is shared, not copied, by every peer it is sent to
+   message_ptr get_message( const message_hash_type& hash_of_message_to_lookup ) const;
+   /// looks a message up by the hash of what it contains, i.e. a block message by its block id
+   message_ptr get_message_by_contents( const message_hash_type& hash_of_msg_contents_to_lookup ) const;
+   /// looks a transaction message up by the short id used in compact blocks, @return nullptr if there is none
+   message_ptr get_transaction_by_short_id( uint64_t short_id ) const;
    message_propagation_data get_message_propagation_data(
          const message_hash_type& hash_of_msg_contents_to_lookup ) const;
    size_t size() const { return _message_cache.size(); }
@@ -343,6 +409,7 @@ class statistics_gathering_node_delegate_wrapper : public node_delegate
       void handle_message( const message& ) override;
       bool handle_block( const graphene::net::block_message& block_message, bool sync_mode,
                          std::vector<message_hash_type>& contained_transaction_msg_ids ) override;
+      fc::future<void> precompute_block( const std::shared_ptr<const graphene::net::block_message>& blk_msg ) override;
       void handle_transaction( const graphene::net::trx_message& transaction_message ) override;
       std::vector<item_hash_t> get_block_ids(const std::vector<item_hash_t>& blockchain_synopsis,
                                              uint32_t& remaining_item_count,
@@ -387,7 +454,8 @@ class node_impl : public peer_connection_delegate, public std::enable_shared_fro
       fc::sha256           _chain_id;
 
 #define NODE_CONFIGURATION_FILENAME      "node_config.json"
-#define POTENTIAL_PEER_DATABASE_FILENAME "peers.json"
+#define POTENTIAL_PEER_DATABASE_FILENAME "peers.dat"
+#define LEGACY_POTENTIAL_PEER_DATABASE_FILENAME "peers.json"
       fc::path             _node_configuration_directory;
       node_configuration   _node_configuration;
 
@@ -424,11 +492,15 @@ class node_impl : public peer_connection_delegate, public std::enable_shared_fro
 
       /// List of sync blocks we've asked for from peers but have not yet received
       active_sync_requests_map              _active_sync_requests;
-      /// List of sync blocks we've just received but haven't yet tried to process
-      std::list<graphene::net::block_message> _new_received_sync_items;
-      /// List of sync blocks we've received, but can't yet process because we are still missing blocks
-      /// that come earlier in the chain
-      std::list<graphene::net::block_message> _received_sync_items;
+      /// A sync block waiting for its turn, its precomputations run meanwhile
+      struct received_sync_block
+      {
+        std::shared_ptr<const graphene::net::block_message> block;
+        fc::future<void>                                    precomputed;
+      };
+      /// Sync blocks we've received, but can't yet process because we are still missing blocks
+      /// that come earlier in the chain, by block id
+      std::unordered_map<graphene::net::block_id_type, received_sync_block> _received_sync_items;
       /// @}
 
       fc::future<void> _process_backlog_of_sync_blocks_done;
@@ -464,7 +536,7 @@ class node_impl : public peer_connection_delegate, public std::enable_shared_fro
       fc::promise<void>::ptr        _retrigger_advertise_inventory_loop_promise;
       fc::future<void>              _advertise_inventory_loop_done;
       /// List of items we have received but not yet advertised to our peers
-      concurrent_unordered_set<item_id>   _new_inventory;
+      sharded_unordered_set<item_id>      _new_inventory;
       /// @}
 
       fc::future<void>     _kill_inactive_conns_loop_done;
@@ -502,15 +574,15 @@ class node_impl : public peer_connection_delegate, public std::enable_shared_fro
 
       /// Stores all connections which have not yet finished key exchange or are still sending
       /// initial handshaking messages back and forth (not yet ready to initiate syncing)
-      concurrent_unordered_set<graphene::net::peer_connection_ptr>               _handshaking_connections;
+      copy_on_write_set<graphene::net::peer_connection_ptr>                      _handshaking_connections;
       /** Stores fully established connections we're either syncing with or in normal operation with */
-      concurrent_unordered_set<graphene::net::peer_connection_ptr>               _active_connections;
+      copy_on_write_set<graphene::net::peer_connection_ptr>                      _active_connections;
       /// Stores connections we've closed (sent closing message, not actually closed),
       /// but are still waiting for the remote end to close before we delete them
-      concurrent_unordered_set<graphene::net::peer_connection_ptr>               _closing_connections;
+      copy_on_write_set<graphene::net::peer_connection_ptr>                      _closing_connections;
       /// Stores connections we've closed, but are still waiting for the OS to notify us that the socket
       /// is really closed
-      concurrent_unordered_set<graphene::net::peer_connection_ptr>               _terminating_connections;
+      copy_on_write_set<graphene::net::peer_connection_ptr>                      _terminating_connections;
 
       /// The /n/ most recent blocks we've accepted (currently tuned to the max number of connections)
       boost::circular_buffer<item_hash_t> _most_recent_blocks_accepted { _maximum_number_of_connections };
@@ -523,6 +595,8 @@ class node_impl : public peer_connection_delegate, public std::enable_shared_fro
 
       /// Cache message we have received and might be required to provide to other peers via inventory requests
       blockchain_tied_message_cache _message_cache;
+      /// Compact versions of the most recent blocks we sent, shared by all peers that take them
+      mutable std::deque<std::pair<block_id_type, message_ptr>> _recent_compact_blocks;
 
       fc::rate_limiting_group _rate_limiter { 0, 0 };
 
@@ -666,6 +740,9 @@ class node_impl : public peer_connection_delegate, public std::enable_shared_fro
       void on_fetch_items_message( peer_connection* originating_peer,
                                    const fetch_items_message& fetch_items_message_received ) const;
 
+      /// @return the compact version of a cached block message
+      message_ptr get_compact_block_message( const message_ptr& full_block_message ) const;
+
       void on_item_not_available_message( peer_connection* originating_peer,
                                           const item_not_available_message& item_not_available_message_received );
 
@@ -689,9 +766,27 @@ class node_impl : public peer_connection_delegate, public std::enable_shared_fro
       void on_check_firewall_reply_message(peer_connection* originating_peer,
                                            const check_firewall_reply_message& check_firewall_reply_message_received);
 
+      void on_compact_block_message(peer_connection* originating_peer,
+                                    const compact_block_message& compact_block_message_received);
+
+      void on_fetch_block_transactions_message(peer_connection* originating_peer,
+                                               const fetch_block_transactions_message& fetch_block_transactions_message_received);
+
+      void on_block_transactions_message(peer_connection* originating_peer,
+                                         const block_transactions_message& block_transactions_message_received);
+
+      /// Hands a block rebuilt from a compact block to process_block_message(), or fetches all of its
+      /// transactions from the peer if it doesn't match its merkle root
+      void process_completed_compact_block(peer_connection* originating_peer,
+                                           graphene::protocol::signed_block&& block,
+                                           const block_id_type& block_id,
+                                           bool all_transactions_from_peer);
+
       void on_connection_closed(peer_connection* originating_peer) override;
 
       void send_sync_block_to_node_delegate(const graphene::net::block_message& block_message_to_send);
+      /// Adapts the sync window of the peer to the rate at which it delivers sync blocks
+      void update_sync_window(peer_connection* peer);
       void process_backlog_of_sync_blocks();
       void trigger_process_backlog_of_sync_blocks();
       void process_block_during_syncing(
@@ -777,7 +872,7 @@ class node_impl : public peer_connection_delegate, public std::enable_shared_fro
       void                       set_total_bandwidth_limit( uint32_t upload_bytes_per_second, uint32_t download_bytes_per_second );
       void                       disable_peer_advertising();
       fc::variant_object         get_call_statistics() const;
-      message                    get_message_for_item(const item_id& item) override;
+      message_ptr                get_message_for_item(const item_id& item) override;
 
       fc::variant_object         network_get_info() const;
       fc::variant_object         network_get_usage_stats() const;
@@ -45,24 +45,27 @@
 
 namespace graphene { namespace net
   {
-    message peer_connection::real_queued_message::get_message(peer_connection_delegate*)
+    message_ptr peer_connection::real_queued_message::get_message(peer_connection_delegate*)
     {
       if (message_send_time_field_offset != (size_t)-1)
       {
         // patch the current time into the message.  Since this operates on the packed version of the structure,
-        // it won't work for anything after a variable-length field
+        // it won't work for anything after a variable-length field.  The message may be shared, so the
+        // time goes into a copy (these are only the small time request and reply messages)
         std::vector<char> packed_current_time = fc::raw::pack(fc::time_point::now());
-        assert(message_send_time_field_offset + packed_current_time.size() <= message_to_send.data.size());
-        memcpy(message_to_send.data.data() + message_send_time_field_offset,
+        assert(message_send_time_field_offset + packed_current_time.size() <= message_to_send->data.size());
+        auto stamped_message = std::make_shared<message>(*message_to_send);
+        memcpy(stamped_message->data.data() + message_send_time_field_offset,
                packed_current_time.data(), packed_current_time.size());
+        return stamped_message;
       }
       return message_to_send;
     }
     size_t peer_connection::real_queued_message::get_size_in_queue()
     {
-      return message_to_send.data.size();
+      return message_to_send->data.size();
     }
-    message peer_connection::virtual_queued_message::get_message(peer_connection_delegate* node)
+    message_ptr peer_connection::virtual_queued_message::get_message(peer_connection_delegate* node)
     {
       return node->get_message_for_item(item_to_send);
     }
@@ -302,13 +305,13 @@ namespace graphene { namespace net
       while (!_queued_messages.empty())
       {
         _queued_messages.front()->transmission_start_time = fc::time_point::now();
-        message message_to_send = _queued_messages.front()->get_message(_node);
+        message_ptr message_to_send = _queued_messages.front()->get_message(_node);
         try
         {
           //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
           //     "to send message of type ${type} for peer ${endpoint}",
-          //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
-          _message_connection.send_message(message_to_send);
+          //     ("type", message_to_send->msg_type)("endpoint", get_remote_endpoint()));
+          _message_connection.send_message(*message_to_send);
           //dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_message() completed normally for peer ${endpoint}",
           //     ("endpoint", get_remote_endpoint()));
         }
@@ -378,12 +381,17 @@ namespace graphene { namespace net
     }
 
     void peer_connection::send_message(const message& message_to_send, size_t message_send_time_field_offset)
+    {
+      send_message(std::make_shared<const message>(message_to_send), message_send_time_field_offset);
+    }
+
+    void peer_connection::send_message(message_ptr message_to_send, size_t message_send_time_field_offset)
     {
       VERIFY_CORRECT_THREAD();
       //dlog("peer_connection::send_message() enqueueing message of type ${type} for peer ${endpoint}",
-      //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint())); // for debug
+      //     ("type", message_to_send->msg_type)("endpoint", get_remote_endpoint())); // for debug
       auto message_to_enqueue = std::make_unique<real_queued_message>(
-                                      message_to_send, message_send_time_field_offset );
+                                      std::move(message_to_send), message_send_time_field_offset );
       send_queueable_message(std::move(message_to_enqueue));
     }
 
@@ -28,43 +28,101 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/mem_fun.hpp>
 #include <boost/multi_index/tag.hpp>
+#include <boost/multi_index/composite_key.hpp>
 
 #include <fc/io/raw.hpp>
 #include <fc/io/raw_variant.hpp>
+#include <fc/io/fstream.hpp>
 #include <fc/log/logger.hpp>
 #include <fc/io/json.hpp>
 
 #include <graphene/net/peer_database.hpp>
 #include <graphene/net/config.hpp>
 
+#include <algorithm>
+#include <fstream>
+
 namespace graphene { namespace net {
   namespace detail
   {
     using namespace boost::multi_index;
 
+    /**
+     * The database file starts with a header, followed by entries which each either store a record or erase the
+     * record of an endpoint.  Changes are appended as they are made, the file is rewritten with one entry per
+     * record when it is opened, closed, or when most of its entries are outdated.
+     */
+    constexpr uint32_t peer_database_magic = 0x42445047; // "GPDB"
+    constexpr uint32_t peer_database_format_version = 1;
+    enum peer_database_entry_type : uint8_t
+    {
+      record_stored = 0,
+      record_erased = 1
+    };
+
+    uint32_t calculate_peer_score(const potential_peer_record& record)
+    {
+      constexpr double max_score = 1000000;
+      constexpr double reference_latency_ms = 250; // latency which halves the score, also assumed for unknown latency
+      constexpr double reference_sync_blocks_per_second = 500; // rate which doubles the score, at most
+
+      // successful and failed attempts with one of each assumed, so peers we don't know yet are rated in the middle
+      const double reliability = (record.number_of_successful_connection_attempts + 1.0)
+                                 / (record.number_of_successful_connection_attempts
+                                    + record.number_of_failed_connection_attempts + 2.0);
+      const double latency_ms = record.latency.count() > 0 ? record.latency.count() / 1000.0 : reference_latency_ms;
+      const double latency_factor = 1.0 / (1.0 + latency_ms / reference_latency_ms);
+      const double throughput_factor = 1.0 + std::min<double>(record.sync_blocks_per_second,
+                                                              reference_sync_blocks_per_second)
+                                             / reference_sync_blocks_per_second;
+      double firewall_factor = 0.75;
+      if (record.firewalled == firewalled_state::not_firewalled)
+        firewall_factor = 1.0;
+      else if (record.firewalled == firewalled_state::firewalled)
+        firewall_factor = 0.25;
+      // the factors are at most 1, 1, 2 and 1
+      return static_cast<uint32_t>(max_score / 2 * reliability * latency_factor * throughput_factor * firewall_factor);
+    }
+
     class peer_database_impl
     {
     public:
-      struct last_seen_time_index {};
+      struct score_index {};
       struct endpoint_index {};
-      typedef boost::multi_index_container<potential_peer_record, 
-                                           indexed_by<ordered_non_unique<tag<last_seen_time_index>, 
-                                                                         member<potential_peer_record, 
-                                                                                fc::time_point_sec, 
-                                                                                &potential_peer_record::last_seen_time>,
-                                                                         std::greater<fc::time_point_sec> >,
-                                                      hashed_unique<tag<endpoint_index>, 
-                                                                    member<potential_peer_record, 
-                                                                           fc::ip::endpoint, 
-                                                                           &potential_peer_record::endpoint>, 
+      typedef boost::multi_index_container<potential_peer_record,
+                                           indexed_by<ordered_non_unique<tag<score_index>,
+                                                                         composite_key<potential_peer_record,
+                                                                                       member<potential_peer_record,
+                                                                                              uint32_t,
+                                                                                              &potential_peer_record::score>,
+                                                                                       member<potential_peer_record,
+                                                                                              fc::time_point_sec,
+                                                                                              &potential_peer_record::last_seen_time> >,
+                                                                         composite_key_compare<std::greater<uint32_t>,
+                                                                                               std::greater<fc::time_point_sec> > >,
+                                                      hashed_unique<tag<endpoint_index>,
+                                                                    member<potential_peer_record,
+                                                                           fc::ip::endpoint,
+                                                                           &potential_peer_record::endpoint>,
                                                                     std::hash<fc::ip::endpoint> > > > potential_peer_set;
 
     private:
       potential_peer_set     _potential_peer_set;
       fc::path _peer_database_filename;
+      std::ofstream _database_file;
+      size_t _entries_in_file = 0;
+
+      void store_record(potential_peer_record record);
+      bool erase_record(const fc::ip::endpoint& endpoint);
+      void prune();
+      void load();
+      void rewrite_file();
+      /// appends to the open database file
+      void append_entry(peer_database_entry_type type, const std::vector<char>& data);
 
     public:
       void open(const fc::path& databaseFilename);
+      void import_json(const fc::path& json_filename);
       void close();
       void clear();
       void erase(const fc::ip::endpoint& endpointToErase);
@@ -80,57 +138,182 @@ namespace graphene { namespace net {
     class peer_database_iterator_impl
     {
     public:
-      typedef peer_database_impl::potential_peer_set::index<peer_database_impl::last_seen_time_index>::type::iterator last_seen_time_index_iterator;
-      last_seen_time_index_iterator _iterator;
-      explicit peer_database_iterator_impl(const last_seen_time_index_iterator& iterator) :
+      typedef peer_database_impl::potential_peer_set::index<peer_database_impl::score_index>::type::iterator score_index_iterator;
+      score_index_iterator _iterator;
+      explicit peer_database_iterator_impl(const score_index_iterator& iterator) :
         _iterator(iterator)
       {}
     };
     peer_database_iterator::peer_database_iterator( const peer_database_iterator& c ) :
       boost::iterator_facade<peer_database_iterator, const potential_peer_record, boost::forward_traversal_tag>(c){}
 
-    void peer_database_impl::open(const fc::path& peer_database_filename)
+    void peer_database_impl::store_record(potential_peer_record record)
     {
-      _peer_database_filename = peer_database_filename;
-      if (fc::exists(_peer_database_filename))
+      record.score = calculate_peer_score(record);
+      auto iter = _potential_peer_set.get<endpoint_index>().find(record.endpoint);
+      if (iter != _potential_peer_set.get<endpoint_index>().end())
+        _potential_peer_set.get<endpoint_index>().modify(iter, [&record](potential_peer_record& stored) { stored = record; });
+      else
+        _potential_peer_set.get<endpoint_index>().insert(record);
+    }
+
+    bool peer_database_impl::erase_record(const fc::ip::endpoint& endpoint)
+    {
+      auto iter = _potential_peer_set.get<endpoint_index>().find(endpoint);
+      if (iter == _potential_peer_set.get<endpoint_index>().end())
+        return false;
+      _potential_peer_set.get<endpoint_index>().erase(iter);
+      return true;
+    }
+
+    void peer_database_impl::prune()
+    {
+      // prune database to a reasonable size, dropping the worst peers
+      if (_potential_peer_set.size() > MAXIMUM_PEERDB_SIZE)
       {
+        auto iter = _potential_peer_set.begin();
+        std::advance(iter, MAXIMUM_PEERDB_SIZE);
+        _potential_peer_set.erase(iter, _potential_peer_set.end());
+      }
+    }
+
+    void peer_database_impl::load()
+    {
+      std::string contents;
+      fc::read_file_contents(_peer_database_filename, contents);
+      fc::datastream<const char*> ds(contents.data(), contents.size());
+      uint32_t magic = 0;
+      uint32_t format_version = 0;
+      fc::raw::unpack(ds, magic);
+      fc::raw::unpack(ds, format_version);
+      FC_ASSERT(magic == peer_database_magic, "Not a peer database");
+      FC_ASSERT(format_version == peer_database_format_version,
+                "Unsupported peer database format version ${v}", ("v", format_version));
+
+      while (ds.remaining() > 0)
+      {
+        uint8_t type = 0;
+        uint32_t size = 0;
+        // an entry cut short, the node must have stopped while writing it
+        if (ds.remaining() < sizeof(type) + sizeof(size))
+          break;
+        fc::raw::unpack(ds, type);
+        fc::raw::unpack(ds, size);
+        if (ds.remaining() < size)
+          break;
+        const char* entry = contents.data() + (contents.size() - ds.remaining());
+        ds.skip(size);
         try
         {
-          std::vector<potential_peer_record> peer_records = fc::json::from_file(_peer_database_filename).as<std::vector<potential_peer_record> >( GRAPHENE_NET_MAX_NESTED_OBJECTS );
-          std::copy(peer_records.begin(), peer_records.end(), std::inserter(_potential_peer_set, _potential_peer_set.end()));
-          if (_potential_peer_set.size() > MAXIMUM_PEERDB_SIZE)
-          {
-            // prune database to a reasonable size
-            auto iter = _potential_peer_set.begin();
-            std::advance(iter, MAXIMUM_PEERDB_SIZE);
-            _potential_peer_set.erase(iter, _potential_peer_set.end());
-          }
+          if (type == record_stored)
+            store_record(fc::raw::unpack<potential_peer_record>(entry, size, GRAPHENE_NET_MAX_NESTED_OBJECTS));
+          else if (type == record_erased)
+            erase_record(fc::raw::unpack<fc::ip::endpoint>(entry, size));
         }
         catch (const fc::exception& e)
         {
-          elog("error opening peer database file ${peer_database_filename}, starting with a clean database", 
-               ("peer_database_filename", _peer_database_filename));
+          wlog("skipping unreadable entry in peer database file ${peer_database_filename}: ${e}",
+               ("peer_database_filename", _peer_database_filename)("e", e));
         }
       }
     }
 
-    void peer_database_impl::close()
+    void write_peer_database_entry(std::ostream& out, peer_database_entry_type type, const std::vector<char>& data)
     {
-      std::vector<potential_peer_record> peer_records;
-      peer_records.reserve(_potential_peer_set.size());
-      std::copy(_potential_peer_set.begin(), _potential_peer_set.end(), std::back_inserter(peer_records));
+      std::vector<char> entry_header = fc::raw::pack(static_cast<uint8_t>(type));
+      std::vector<char> size = fc::raw::pack(static_cast<uint32_t>(data.size()));
+      entry_header.insert(entry_header.end(), size.begin(), size.end());
+      out.write(entry_header.data(), entry_header.size());
+      out.write(data.data(), data.size());
+    }
 
+    void peer_database_impl::rewrite_file()
+    {
+      if (_database_file.is_open())
+        _database_file.close();
       try
       {
         fc::path peer_database_filename_dir = _peer_database_filename.parent_path();
         if (!fc::exists(peer_database_filename_dir))
           fc::create_directories(peer_database_filename_dir);
-        fc::json::save_to_file( peer_records, _peer_database_filename, GRAPHENE_NET_MAX_NESTED_OBJECTS );
+
+        // write a new file next to the old one and replace it, so an interruption doesn't lose the database
+        fc::path new_database_filename = _peer_database_filename.generic_string() + ".tmp";
+        {
+          std::ofstream new_database_file(new_database_filename.generic_string(),
+                                          std::ios::out | std::ios::binary | std::ios::trunc);
+          std::vector<char> header = fc::raw::pack(peer_database_magic);
+          std::vector<char> format_version = fc::raw::pack(peer_database_format_version);
+          header.insert(header.end(), format_version.begin(), format_version.end());
+          new_database_file.write(header.data(), header.size());
+          for (const potential_peer_record& record : _potential_peer_set)
+            write_peer_database_entry(new_database_file, record_stored, fc::raw::pack(record));
+          new_database_file.flush();
+          FC_ASSERT(new_database_file.good(), "Error writing ${f}", ("f", new_database_filename));
+        }
+        fc::rename(new_database_filename, _peer_database_filename);
+
+        _database_file.open(_peer_database_filename.generic_string(), std::ios::out | std::ios::binary | std::ios::app);
+        _entries_in_file = _potential_peer_set.size();
+      }
+      catch (const fc::exception& e)
+      {
+        elog("error writing peer database file ${peer_database_filename}, changes won't be saved: ${e}",
+             ("peer_database_filename", _peer_database_filename)("e", e));
+      }
+    }
+
+    void peer_database_impl::append_entry(peer_database_entry_type type, const std::vector<char>& data)
+    {
+      write_peer_database_entry(_database_file, type, data);
+      _database_file.flush();
+      ++_entries_in_file;
+    }
+
+    void peer_database_impl::open(const fc::path& peer_database_filename)
+    {
+      _peer_database_filename = peer_database_filename;
+      if (fc::exists(_peer_database_filename))
+      {
+        try
+        {
+          load();
+          prune();
+        }
+        catch (const fc::exception& e)
+        {
+          elog("error opening peer database file ${peer_database_filename}, starting with a clean database",
+               ("peer_database_filename", _peer_database_filename));
+          _potential_peer_set.clear();
+        }
+      }
+      rewrite_file();
+    }
+
+    void peer_database_impl::import_json(const fc::path& json_filename)
+    {
+      try
+      {
+        std::vector<potential_peer_record> peer_records = fc::json::from_file(json_filename).as<std::vector<potential_peer_record> >( GRAPHENE_NET_MAX_NESTED_OBJECTS );
+        for (const potential_peer_record& record : peer_records)
+          store_record(record);
+        prune();
+        if (_database_file.is_open())
+          rewrite_file();
       }
       catch (const fc::exception& e)
       {
-        elog("error saving peer database to file ${peer_database_filename}", 
-             ("peer_database_filename", _peer_database_filename));
+        elog("error importing peer database file ${json_filename}",
+             ("json_filename", json_filename));
+      }
+    }
+
+    void peer_database_impl::close()
+    {
+      if (_database_file.is_open())
+      {
+        rewrite_file();
+        _database_file.close();
       }
       _potential_peer_set.clear();
     }
@@ -138,22 +321,26 @@ namespace graphene { namespace net {
     void peer_database_impl::clear()
     {
       _potential_peer_set.clear();
+      if (_database_file.is_open())
+        rewrite_file();
     }
 
     void peer_database_impl::erase(const fc::ip::endpoint& endpointToErase)
     {
-      auto iter = _potential_peer_set.get<endpoint_index>().find(endpointToErase);
-      if (iter != _potential_peer_set.get<endpoint_index>().end())
-        _potential_peer_set.get<endpoint_index>().erase(iter);
+      if (erase_record(endpointToErase) && _database_file.is_open())
+        append_entry(record_erased, fc::raw::pack(endpointToErase));
     }
 
     void peer_database_impl::update_entry(const potential_peer_record& updatedRecord)
     {
-      auto iter = _potential_peer_set.get<endpoint_index>().find(updatedRecord.endpoint);
-      if (iter != _potential_peer_set.get<endpoint_index>().end())
-        _potential_peer_set.get<endpoint_index>().modify(iter, [&updatedRecord](potential_peer_record& record) { record = updatedRecord; });
+      store_record(updatedRecord);
+      if (!_database_file.is_open())
+        return;
+      // rewrite the file once most of its entries are outdated
+      if (_entries_in_file >= 2 * _potential_peer_set.size() + MAXIMUM_PEERDB_SIZE)
+        rewrite_file();
       else
-        _potential_peer_set.get<endpoint_index>().insert(updatedRecord);
+        append_entry(record_stored, fc::raw::pack(updatedRecord));
     }
 
     potential_peer_record peer_database_impl::lookup_or_create_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup)
@@ -175,13 +362,13 @@ namespace graphene { namespace net {
     peer_database::iterator peer_database_impl::begin() const
     {
       return peer_database::iterator( std::make_unique<peer_database_iterator_impl>(
-                   _potential_peer_set.get<last_seen_time_index>().begin() ) );
+                   _potential_peer_set.get<score_index>().begin() ) );
     }
 
     peer_database::iterator peer_database_impl::end() const
     {
       return peer_database::iterator( std::make_unique<peer_database_iterator_impl>(
-                   _potential_peer_set.get<last_seen_time_index>().end() ) );
+                   _potential_peer_set.get<score_index>().end() ) );
     }
 
     size_t peer_database_impl::size() const
@@ -232,6 +419,11 @@ namespace graphene { namespace net {
     my->open(databaseFilename);
   }
 
+  void peer_database::import_json(const fc::path& json_filename)
+  {
+    my->import_json(json_filename);
+  }
+
   void peer_database::close()
   {
     my->close();
@@ -286,6 +478,7 @@ FC_REFLECT_ENUM( graphene::net::potential_peer_last_connection_disposition,
 FC_REFLECT_DERIVED_NO_TYPENAME( graphene::net::potential_peer_record, BOOST_PP_SEQ_NIL,
                                 (endpoint)(last_seen_time)(last_connection_disposition)
                                 (last_connection_attempt_time)(number_of_successful_connection_attempts)
-                                (number_of_failed_connection_attempts)(last_error) )
+                                (number_of_failed_connection_attempts)(last_error)
+                                (latency)(sync_blocks_per_second)(firewalled)(score) )
 
 GRAPHENE_IMPLEMENT_EXTERNAL_SERIALIZATION( graphene::net::potential_peer_record)
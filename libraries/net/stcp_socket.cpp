@@ -24,6 +24,7 @@
 #include <assert.h>
 
 #include <algorithm>
+#include <cstring>
 
 #include <fc/crypto/hex.hpp>
 #include <fc/crypto/aes.hpp>
@@ -84,6 +85,11 @@ void stcp_socket::bind( const fc::ip::endpoint& local_endpoint )
  *   This method must read at least 16 bytes at a time from
  *   the underlying TCP socket so that it can decrypt them. It
  *   will buffer any left-over.
+ *
+ *   It reads as much as the socket has available, up to the size
+ *   of its buffer, even if less was asked for, so that small reads
+ *   like message headers are served from memory instead of costing
+ *   a socket read each.
  */
 size_t stcp_socket::readsome( char* buffer, size_t len )
 { try {
@@ -100,20 +106,39 @@ size_t stcp_socket::readsome( char* buffer, size_t len )
     } buffer_in_use_checker(_read_buffer_in_use);
 #endif
 
-    const size_t read_buffer_length = 4096;
+    if( _plaintext_begin < _plaintext_end )
+    {
+      // both are multiples of 16, so is the rest
+      size_t s = std::min<size_t>( _plaintext_end - _plaintext_begin, len );
+      memcpy( buffer, _plaintext_buffer.get() + _plaintext_begin, s );
+      _plaintext_begin += s;
+      return s;
+    }
+
+    const size_t read_buffer_length = 32 * 1024;
+    static_assert( read_buffer_length % 16 == 0, "the buffer must hold whole cipher blocks" );
     if (!_read_buffer)
       _read_buffer.reset(new char[read_buffer_length], [](char* p){ delete[] p; });
 
-    len = std::min<size_t>(read_buffer_length, len);
-
-    size_t s = _sock.readsome( _read_buffer, len, 0 );
+    size_t s = _sock.readsome( _read_buffer, read_buffer_length, 0 );
     if( s % 16 ) 
     {
       _sock.read(_read_buffer, 16 - (s%16), s);
       s += 16-(s%16);
     }
-    _recv_aes.decode( _read_buffer.get(), s, buffer );
-    return s;
+    if( s <= len )
+    {
+      _recv_aes.decode( _read_buffer.get(), s, buffer );
+      return s;
+    }
+
+    if (!_plaintext_buffer)
+      _plaintext_buffer.reset(new char[read_buffer_length], [](char* p){ delete[] p; });
+    _recv_aes.decode( _read_buffer.get(), s, _plaintext_buffer.get() );
+    memcpy( buffer, _plaintext_buffer.get(), len );
+    _plaintext_begin = len;
+    _plaintext_end = s;
+    return len;
 } FC_RETHROW_EXCEPTIONS( warn, "", ("len",len) ) }
 
 size_t stcp_socket::readsome( const std::shared_ptr<char>& buf, size_t len, size_t offset ) 
@@ -123,7 +148,7 @@ size_t stcp_socket::readsome( const std::shared_ptr<char>& buf, size_t len, size
 
 bool stcp_socket::eof()const
 {
-  return _sock.eof();
+  return _plaintext_begin == _plaintext_end && _sock.eof();
 }
 
 size_t stcp_socket::writesome( const char* buffer, size_t len )
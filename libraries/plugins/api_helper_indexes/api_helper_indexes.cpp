@@ -23,8 +23,10 @@
  */
 
 #include <graphene/api_helper_indexes/api_helper_indexes.hpp>
+#include <graphene/chain/account_object.hpp>
 #include <graphene/chain/market_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
+#include <graphene/chain/tnt/object.hpp>
 
 namespace graphene { namespace api_helper_indexes {
 
@@ -92,6 +94,50 @@ share_type amount_in_collateral_index::get_backing_collateral( const asset_id_ty
    return itr->second;
 } FC_CAPTURE_AND_RETHROW( (asst) ) }
 
+void asset_holders_index::object_inserted( const object& objct )
+{ try {
+   const account_balance_object& o = static_cast<const account_balance_object&>( objct );
+   if( o.balance != 0 )
+      ++holders_count[o.asset_type];
+} FC_CAPTURE_AND_RETHROW( (objct) ) }
+
+void asset_holders_index::object_removed( const object& objct )
+{ try {
+   const account_balance_object& o = static_cast<const account_balance_object&>( objct );
+   if( o.balance != 0 )
+   {
+      auto itr = holders_count.find( o.asset_type );
+      if( itr != holders_count.end() ) // should always be true
+         --itr->second;
+   }
+} FC_CAPTURE_AND_RETHROW( (objct) ) }
+
+void asset_holders_index::about_to_modify( const object& objct )
+{ try {
+   before_held = ( static_cast<const account_balance_object&>( objct ).balance != 0 );
+} FC_CAPTURE_AND_RETHROW( (objct) ) }
+
+void asset_holders_index::object_modified( const object& objct )
+{ try {
+   const account_balance_object& o = static_cast<const account_balance_object&>( objct );
+   const bool held = ( o.balance != 0 );
+   if( held && !before_held )
+      ++holders_count[o.asset_type];
+   else if( !held && before_held )
+   {
+      auto itr = holders_count.find( o.asset_type );
+      if( itr != holders_count.end() ) // should always be true
+         --itr->second;
+   }
+} FC_CAPTURE_AND_RETHROW( (objct) ) }
+
+uint64_t asset_holders_index::get_holders_count( const asset_id_type& asst )const
+{ try {
+   auto itr = holders_count.find( asst );
+   if( itr == holders_count.end() ) return 0;
+   return itr->second;
+} FC_CAPTURE_AND_RETHROW( (asst) ) }
+
 namespace detail
 {
 
@@ -150,6 +196,10 @@ void api_helper_indexes::plugin_startup()
    for( const auto& call : database().get_index_type<call_order_index>().indices() )
       amount_in_collateral_idx->object_inserted( call );
 
+   asset_holders_idx = database().add_secondary_index< primary_index<account_balance_index>, asset_holders_index >();
+   for( const auto& balance : database().get_index_type<account_balance_index>().indices() )
+      asset_holders_idx->object_inserted( balance );
+
    auto& account_members = *database().add_secondary_index< primary_index<account_index>, account_member_index >();
    for( const auto& account : database().get_index_type< account_index >().indices() )
       account_members.object_inserted( account );
@@ -157,6 +207,10 @@ void api_helper_indexes::plugin_startup()
    auto& approvals = *database().add_secondary_index< primary_index<proposal_index>, required_approval_index >();
    for( const auto& proposal : database().get_index_type< proposal_index >().indices() )
       approvals.object_inserted( proposal );
+
+   auto& tank_connections = *database().add_secondary_index< primary_index<tank_index>, tank_connection_index >();
+   for( const auto& tank : database().get_index_type< tank_index >().indices() )
+      tank_connections.object_inserted( tank );
 }
 
 } }
@@ -51,6 +51,25 @@ class amount_in_collateral_index : public secondary_index
       flat_map<asset_id_type, share_type> backing_collateral;
 };
 
+/**
+ *  @brief This secondary index counts the accounts which hold a non-zero balance of each asset.
+ *  @note This is implemented with \c flat_map, new entries are only added when an asset gets its first holder.
+ */
+class asset_holders_index : public secondary_index
+{
+   public:
+      void object_inserted( const object& obj ) override;
+      void object_removed( const object& obj ) override;
+      void about_to_modify( const object& before ) override;
+      void object_modified( const object& after ) override;
+
+      uint64_t get_holders_count( const asset_id_type& asset )const;
+
+   private:
+      flat_map<asset_id_type, uint64_t> holders_count;
+      bool before_held = false;
+};
+
 namespace detail
 {
     class api_helper_indexes_impl;
@@ -75,6 +94,7 @@ class api_helper_indexes : public graphene::app::plugin
    private:
       std::unique_ptr<detail::api_helper_indexes_impl> my;
       amount_in_collateral_index* amount_in_collateral_idx = nullptr;
+      asset_holders_index* asset_holders_idx = nullptr;
 };
 
 } } //graphene::template
@@ -7,7 +7,9 @@
 #include <graphene/chain/impacted.hpp>
 #include <graphene/chain/account_evaluator.hpp>
 #include <graphene/chain/hardfork.hpp>
+#include <graphene/utilities/elasticsearch_exporter.hpp>
 #include <curl/curl.h>
+#include <boost/filesystem/path.hpp>
 
 namespace graphene { namespace elasticsearch {
 
@@ -45,11 +47,12 @@ class elasticsearch_plugin_impl
       uint32_t _elasticsearch_start_es_after_block = 0;
       bool _elasticsearch_operation_string = false;
       mode _elasticsearch_mode = mode::only_save;
+      graphene::utilities::es_exporter_options _exporter_options;
+      std::unique_ptr<graphene::utilities::es_exporter> _exporter;
       CURL *curl; // curl handler
       vector <string> bulk_lines; //  vector of op lines
       vector<std::string> prepare;
 
-      graphene::utilities::ES es;
       uint32_t limit_documents;
       int16_t op_type;
       operation_history_struct os;
@@ -74,7 +77,7 @@ class elasticsearch_plugin_impl
       void cleanObjects(const account_transaction_history_id_type& ath, const account_id_type& account_id);
       void createBulkLine(const account_transaction_history_object& ath);
       void prepareBulk(const account_transaction_history_id_type& ath_id);
-      void populateESstruct();
+      void sendBulk(uint32_t block_number);
 };
 
 elasticsearch_plugin_impl::~elasticsearch_plugin_impl()
@@ -172,27 +175,8 @@ bool elasticsearch_plugin_impl::update_account_histories( const signed_block& b
       }
    }
    // we send bulk at end of block when we are in sync for better real time client experience
-   if(is_sync)
-   {
-      populateESstruct();
-      if(es.bulk_lines.size() > 0)
-      {
-         prepare.clear();
-         if(!graphene::utilities::SendBulk(std::move(es)))
-         {
-            // Note: although called with `std::move()`, `es` is not updated in `SendBulk()`
-            elog( "Error sending ${n} lines of bulk data to Elastic Search, the first lines are:",
-                  ("n",es.bulk_lines.size()) );
-            for( size_t i = 0; i < es.bulk_lines.size() && i < 10; ++i )
-            {
-               edump( (es.bulk_lines[i]) );
-            }
-            return false;
-         }
-         else
-            bulk_lines.clear();
-      }
-   }
+   if(is_sync && bulk_lines.size() > 0)
+      sendBulk(b.block_num());
 
    if(bulk_lines.size() != limit_documents)
       bulk_lines.reserve(limit_documents);
@@ -300,23 +284,8 @@ bool elasticsearch_plugin_impl::add_elasticsearch( const account_id_type account
    }
    cleanObjects(ath.id, account_id);
 
-   if (curl && bulk_lines.size() >= limit_documents) { // we are in bulk time, ready to add data to elasticsearech
-      prepare.clear();
-      populateESstruct();
-      if(!graphene::utilities::SendBulk(std::move(es)))
-      {
-         // Note: although called with `std::move()`, `es` is not updated in `SendBulk()`
-         elog( "Error sending ${n} lines of bulk data to Elastic Search, the first lines are:",
-               ("n",es.bulk_lines.size()) );
-         for( size_t i = 0; i < es.bulk_lines.size() && i < 10; ++i )
-         {
-            edump( (es.bulk_lines[i]) );
-         }
-         return false;
-      }
-      else
-         bulk_lines.clear();
-   }
+   if (_exporter && bulk_lines.size() >= limit_documents) // we are in bulk time, ready to add data to elasticsearech
+      sendBulk(block_number);
 
    return true;
 }
@@ -409,15 +378,13 @@ void elasticsearch_plugin_impl::cleanObjects(const account_transaction_history_i
    }
 }
 
-void elasticsearch_plugin_impl::populateESstruct()
+void elasticsearch_plugin_impl::sendBulk(uint32_t block_number)
 {
-   es.curl = curl;
-   es.bulk_lines = std::move(bulk_lines);
-   es.elasticsearch_url = _elasticsearch_node_url;
-   es.auth = _elasticsearch_basic_auth;
-   es.index_prefix = _elasticsearch_index_prefix;
-   es.endpoint = "";
-   es.query = "";
+   // hands the lines over to the exporter threads, this never waits for Elastic Search unless there is no
+   // spill journal and the queue is full
+   prepare.clear();
+   _exporter->submit(block_number, std::move(bulk_lines));
+   bulk_lines.clear();
 }
 
 } // end namespace detail
@@ -466,6 +433,15 @@ void elasticsearch_plugin::plugin_set_program_options(
                "Save operation as string. Needed to serve history api calls(false)")
          ("elasticsearch-mode", boost::program_options::value<uint16_t>(),
                "Mode of operation: only_save(0), only_query(1), all(2) - Default: 0")
+         ("elasticsearch-exporter-connections", boost::program_options::value<uint16_t>(),
+               "Number of bulk requests sent to Elastic Search in parallel(2)")
+         ("elasticsearch-exporter-queue-size", boost::program_options::value<uint32_t>(),
+               "Number of bulk batches held in memory while Elastic Search is slow or down(64). They are not on "
+               "disk: if the node crashes, the queued batches and the ones being sent are lost and have to be "
+               "exported again by replaying these blocks")
+         ("elasticsearch-exporter-spill-dir", boost::program_options::value<boost::filesystem::path>(),
+               "Directory for bulk batches that do not fit the queue, relative to the data dir "
+               "(elasticsearch-spill). Set it to an empty string to wait for Elastic Search instead")
          ;
    cfg.add(cli);
 }
@@ -514,6 +490,21 @@ void elasticsearch_plugin::plugin_initialize(const boost::program_options::varia
          FC_THROW_EXCEPTION(graphene::chain::plugin_exception,
                "If elasticsearch-mode is set to all then elasticsearch-operation-string need to be true");
 
+      auto& exporter_options = my->_exporter_options;
+      exporter_options.elasticsearch_url = my->_elasticsearch_node_url;
+      exporter_options.auth = my->_elasticsearch_basic_auth;
+      if (options.count("elasticsearch-exporter-connections") > 0)
+         exporter_options.connections = options["elasticsearch-exporter-connections"].as<uint16_t>();
+      if (options.count("elasticsearch-exporter-queue-size") > 0)
+         exporter_options.max_queued_batches = options["elasticsearch-exporter-queue-size"].as<uint32_t>();
+      boost::filesystem::path spill_dir = "elasticsearch-spill";
+      if (options.count("elasticsearch-exporter-spill-dir") > 0)
+         spill_dir = options["elasticsearch-exporter-spill-dir"].as<boost::filesystem::path>();
+      if (!spill_dir.empty() && spill_dir.is_relative() && options.count("data-dir") > 0)
+         spill_dir = options["data-dir"].as<boost::filesystem::path>() / spill_dir;
+      exporter_options.spill_dir = spill_dir;
+      my->_exporter = std::make_unique<graphene::utilities::es_exporter>(exporter_options);
+
       database().applied_block.connect([this](const signed_block &b) {
          if (!my->update_account_histories(b))
             FC_THROW_EXCEPTION(graphene::chain::plugin_exception,
@@ -534,6 +525,22 @@ void elasticsearch_plugin::plugin_startup()
    ilog("elasticsearch ACCOUNT HISTORY: plugin_startup() begin");
 }
 
+void elasticsearch_plugin::plugin_shutdown()
+{
+   if(my->_exporter)
+   {
+      const auto stats = my->_exporter->get_stats();
+      ilog("elasticsearch ACCOUNT HISTORY: stopping the exporter, ${s}", ("s", stats));
+      my->_exporter.reset();
+   }
+}
+
+graphene::utilities::es_exporter_stats elasticsearch_plugin::get_exporter_stats()const
+{
+   FC_ASSERT(my->_exporter, "The elasticsearch plugin does not export in this mode");
+   return my->_exporter->get_stats();
+}
+
 operation_history_object elasticsearch_plugin::get_operation_by_id(operation_history_id_type id)
 {
    const string operation_id_string = std::string(object_id_type(id));
@@ -27,6 +27,7 @@
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/operation_history_object.hpp>
 #include <graphene/utilities/elasticsearch.hpp>
+#include <graphene/utilities/elasticsearch_exporter.hpp>
 
 namespace graphene { namespace elasticsearch {
    using namespace chain;
@@ -65,6 +66,10 @@ class elasticsearch_plugin : public graphene::app::plugin
          boost::program_options::options_description& cfg) override;
       void plugin_initialize(const boost::program_options::variables_map& options) override;
       void plugin_startup() override;
+      void plugin_shutdown() override;
+
+      /// Queue depth and lag of the data not sent to Elastic Search yet
+      graphene::utilities::es_exporter_stats get_exporter_stats()const;
 
       operation_history_object get_operation_by_id(operation_history_id_type id);
       vector<operation_history_object> get_account_history(const account_id_type account_id,
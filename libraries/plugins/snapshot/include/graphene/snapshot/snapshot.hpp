@@ -26,8 +26,12 @@
 #include <graphene/app/plugin.hpp>
 #include <graphene/chain/database.hpp>
 
+#include <fc/thread/future.hpp>
+#include <fc/thread/thread.hpp>
 #include <fc/time.hpp>
 
+#include <memory>
+
 namespace graphene { namespace snapshot_plugin {
 
 class snapshot_plugin : public graphene::app::plugin {
@@ -43,13 +47,19 @@ class snapshot_plugin : public graphene::app::plugin {
       ) override;
 
       void plugin_initialize( const boost::program_options::variables_map& options ) override;
+      void plugin_shutdown() override;
 
    private:
        void check_snapshot( const graphene::chain::signed_block& b);
+       void create_binary_snapshot( const graphene::chain::signed_block& b );
 
        uint32_t           snapshot_block = -1, last_block = 0;
        fc::time_point_sec snapshot_time = fc::time_point_sec::maximum(), last_time = fc::time_point_sec(1);
        fc::path           dest;
+       bool               binary_format = false;
+
+       std::unique_ptr<fc::thread> writer_thread;
+       fc::future<void>            pending_write;
 };
 
 } } //graphene::snapshot_plugin
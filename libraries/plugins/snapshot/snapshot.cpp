@@ -24,6 +24,7 @@
 #include <graphene/snapshot/snapshot.hpp>
 
 #include <graphene/chain/database.hpp>
+#include <graphene/chain/snapshot.hpp>
 
 #include <fc/io/fstream.hpp>
 
@@ -36,6 +37,7 @@ namespace bpo = boost::program_options;
 static const char* OPT_BLOCK_NUM  = "snapshot-at-block";
 static const char* OPT_BLOCK_TIME = "snapshot-at-time";
 static const char* OPT_DEST       = "snapshot-to";
+static const char* OPT_FORMAT     = "snapshot-format";
 
 void snapshot_plugin::plugin_set_program_options(
    boost::program_options::options_description& command_line_options,
@@ -44,7 +46,10 @@ void snapshot_plugin::plugin_set_program_options(
    command_line_options.add_options()
          (OPT_BLOCK_NUM, bpo::value<uint32_t>(), "Block number after which to do a snapshot")
          (OPT_BLOCK_TIME, bpo::value<string>(), "Block time (ISO format) after which to do a snapshot")
-         (OPT_DEST, bpo::value<string>(), "Pathname of JSON file where to store the snapshot")
+         (OPT_DEST, bpo::value<string>(), "Pathname of JSON file or binary snapshot directory where to store the snapshot")
+         (OPT_FORMAT, bpo::value<string>()->default_value("json"),
+          "Snapshot format: \"json\" for one JSON object per line, or \"binary\" for compressed chunks "
+          "written in the background, which can be loaded with --restore-from-snapshot")
          ;
    config_file_options.add(command_line_options);
 }
@@ -72,6 +77,9 @@ void snapshot_plugin::plugin_initialize(const boost::program_options::variables_
          snapshot_block = options[OPT_BLOCK_NUM].as<uint32_t>();
       if( options.count(OPT_BLOCK_TIME) > 0 )
          snapshot_time = fc::time_point_sec::from_iso_string( options[OPT_BLOCK_TIME].as<std::string>() );
+      const std::string format = options[OPT_FORMAT].as<std::string>();
+      FC_ASSERT( format == "json" || format == "binary", "Unknown snapshot format ${f}", ("f",format) );
+      binary_format = ( format == "binary" );
       database().applied_block.connect( [&]( const graphene::chain::signed_block& b ) {
          check_snapshot( b );
       });
@@ -82,6 +90,14 @@ void snapshot_plugin::plugin_initialize(const boost::program_options::variables_
    ilog("snapshot plugin: plugin_initialize() end");
 } FC_LOG_AND_RETHROW() }
 
+void snapshot_plugin::plugin_shutdown()
+{
+   if( pending_write.valid() )
+      pending_write.wait();
+   if( writer_thread )
+      writer_thread->quit();
+}
+
 static void create_snapshot( const graphene::chain::database& db, const fc::path& dest )
 {
    ilog("snapshot plugin: creating snapshot");
@@ -95,32 +111,55 @@ static void create_snapshot( const graphene::chain::database& db, const fc::path
       wlog( "Failed to open snapshot destination: ${ex}", ("ex",e) );
       return;
    }
-   for( uint32_t space_id = 0; space_id < 256; space_id++ )
-      for( uint32_t type_id = 0; type_id < 256; type_id++ )
-      {
-         try
-         {
-            db.get_index( (uint8_t)space_id, (uint8_t)type_id );
-         }
-         catch (fc::assert_exception& e)
-         {
-            continue;
-         }
-         auto& index = db.get_index( (uint8_t)space_id, (uint8_t)type_id );
-         index.inspect_all_objects( [&out]( const graphene::db::object& o ) {
-            out << fc::json::to_string( o.to_variant() ) << '\n';
-         });
-      }
+   db.inspect_all_indexes( [&out]( const graphene::db::index& index ) {
+      index.inspect_all_objects( [&out]( const graphene::db::object& o ) {
+         out << fc::json::to_string( o.to_variant() ) << '\n';
+      });
+   });
    out.close();
    ilog("snapshot plugin: created snapshot");
 }
 
+void snapshot_plugin::create_binary_snapshot( const graphene::chain::signed_block& b )
+{
+   if( pending_write.valid() && !pending_write.ready() )
+   {
+      wlog( "snapshot plugin: previous snapshot is still being written, waiting for it" );
+      pending_write.wait();
+   }
+
+   ilog( "snapshot plugin: capturing binary snapshot at block ${n}", ("n",b.block_num()) );
+   auto snapshot = std::make_shared<graphene::chain::binary_snapshot>(
+                      graphene::chain::binary_snapshot::capture( database(), b ) );
+   ilog( "snapshot plugin: captured ${n} indexes, writing in the background", ("n",snapshot->manifest().chunks.size()) );
+
+   if( !writer_thread )
+      writer_thread = std::make_unique<fc::thread>( "snapshot" );
+   const fc::path target = dest;
+   pending_write = writer_thread->async( [snapshot,target] () {
+      try
+      {
+         snapshot->write( target );
+         ilog( "snapshot plugin: wrote binary snapshot to ${d}", ("d",target) );
+      }
+      catch( const fc::exception& e )
+      {
+         elog( "snapshot plugin: failed to write snapshot to ${d}: ${e}", ("d",target)("e",e.to_detail_string()) );
+      }
+   }, "snapshot writer" );
+}
+
 void snapshot_plugin::check_snapshot( const graphene::chain::signed_block& b )
 { try {
     uint32_t current_block = b.block_num();
     if( (last_block < snapshot_block && snapshot_block <= current_block)
            || (last_time < snapshot_time && snapshot_time <= b.timestamp) )
-       create_snapshot( database(), dest );
+    {
+       if( binary_format )
+          create_binary_snapshot( b );
+       else
+          create_snapshot( database(), dest );
+    }
     last_block = current_block;
     last_time = b.timestamp;
 } FC_LOG_AND_RETHROW() }
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2020-2023 Revolution Populi Limited, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/protocol/types.hpp>
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+namespace graphene { namespace protocol {
+
+   struct signature_cache_stats
+   {
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      /// Number of recovered keys held
+      uint64_t size = 0;
+      /// Maximum number of recovered keys held
+      uint64_t capacity = 0;
+   };
+
+   /**
+    * @brief Keeps the public keys recovered from recent signatures, for the whole process
+    *
+    * The same transaction is usually checked several times: when it arrives from a peer, again when it is
+    * included in a block, when a block is generated and in API calls. Since signed_transaction::get_signature_keys
+    * looks up every (digest, signature) pair here before recovering it, only the first check pays for ECDSA
+    * recovery.
+    *
+    * The cache is sharded by key, each shard under its own mutex, so it can be used from the threads which
+    * precompute blocks in parallel. Each shard holds two generations of keys: when the current one is full, it
+    * replaces the previous one, which is dropped, and keys found in the previous one move to the current one.
+    */
+   class signature_cache
+   {
+      public:
+         static signature_cache& instance();
+
+         /// Recover the key of the signature, or take it from the cache
+         public_key_type recover( const digest_type& digest, const signature_type& signature );
+
+         /// Set the maximum number of keys held, 0 disables the cache; this drops the keys held so far
+         void set_capacity( uint64_t capacity );
+
+         void clear();
+
+         signature_cache_stats get_stats()const;
+
+      private:
+         signature_cache();
+
+         struct key_type
+         {
+            digest_type    digest;
+            signature_type signature;
+
+            friend bool operator==( const key_type& a, const key_type& b )
+            {
+               return a.digest == b.digest && a.signature == b.signature;
+            }
+         };
+         struct key_hash
+         {
+            size_t operator()( const key_type& k )const;
+         };
+         typedef std::unordered_map<key_type, public_key_type, key_hash> generation_type;
+
+         struct shard
+         {
+            mutable std::mutex _mutex;
+            generation_type    _current;
+            generation_type    _previous;
+         };
+
+         static const size_t shard_count = 16;
+
+         std::array<shard, shard_count> _shards;
+         std::atomic<uint64_t>          _generation_size;
+         std::atomic<uint64_t>          _hits{ 0 };
+         std::atomic<uint64_t>          _misses{ 0 };
+   };
+
+} } // graphene::protocol
+
+FC_REFLECT( graphene::protocol::signature_cache_stats, (hits)(misses)(size)(capacity) )
@@ -276,6 +276,13 @@ struct periodic_flow_limit {
    uint32_t period_num_at_time(const time_point_sec& creation_date, const time_point_sec& time) const {
       return uint32_t((time - creation_date).to_seconds() / period_duration_sec);
    }
+   /// The time the period ends and the next one begins
+   time_point_sec period_end_time(const time_point_sec& creation_date, uint32_t period_num) const {
+      uint64_t end = creation_date.sec_since_epoch() + (uint64_t(period_num) + 1) * period_duration_sec;
+      if (end >= time_point_sec::maximum().sec_since_epoch())
+         return time_point_sec::maximum();
+      return time_point_sec(uint32_t(end));
+   }
 
    periodic_flow_limit(share_type limit = 0, uint32_t period_duration_sec = 0)
       : period_duration_sec(period_duration_sec), limit(limit) {}
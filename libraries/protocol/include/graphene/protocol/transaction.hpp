@@ -125,7 +125,7 @@ namespace graphene { namespace protocol {
 
    protected:
       // Calculate the digest used for signature validation
-      digest_type sig_digest( const chain_id_type& chain_id )const;
+      virtual digest_type sig_digest( const chain_id_type& chain_id )const;
       mutable transaction_id_type _tx_id_buffer;
    };
 
@@ -211,6 +211,7 @@ namespace graphene { namespace protocol {
        *       @ref _signees field, then @ref _signees will be returned;
        *       otherwise, the @p chain_id parameter will be ignored, and
        *       @ref _signees will be returned directly.
+       * @note Keys are taken from @ref signature_cache if they were recovered before.
        */
       virtual const flat_set<public_key_type>& get_signature_keys( const chain_id_type& chain_id )const;
 
@@ -243,8 +244,15 @@ namespace graphene { namespace protocol {
       virtual const flat_set<public_key_type>& get_signature_keys( const chain_id_type& chain_id )const override;
       virtual uint64_t                         get_packed_size()const override;
    protected:
+      virtual digest_type sig_digest( const chain_id_type& chain_id )const override;
+      /// The transaction packed without signatures, which the ID, the signature digest, the packed size and the
+      /// merkle digest are all calculated from, so it is packed only once
+      const vector<char>& get_packed_transaction()const;
+
       mutable bool _validated = false;
-      mutable uint64_t _packed_size = 0;
+      mutable vector<char> _packed_transaction;
+      mutable digest_type _sig_digest;
+      mutable chain_id_type _sig_digest_chain_id;
    };
 
    /**
@@ -294,6 +302,9 @@ namespace graphene { namespace protocol {
    {
       processed_transaction( const signed_transaction& trx = signed_transaction() )
          : precomputable_transaction(trx){}
+      /// Keeps the cached results of @p trx
+      processed_transaction( const precomputable_transaction& trx )
+         : precomputable_transaction(trx){}
       virtual ~processed_transaction() = default;
 
       vector<operation_result> operation_results;
@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2020-2023 Revolution Populi Limited, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/protocol/signature_cache.hpp>
+
+#include <cstring>
+
+namespace graphene { namespace protocol {
+
+static const uint64_t default_signature_cache_capacity = 100000;
+
+signature_cache& signature_cache::instance()
+{
+   static signature_cache cache;
+   return cache;
+}
+
+signature_cache::signature_cache()
+   : _generation_size( default_signature_cache_capacity / shard_count / 2 ) {}
+
+size_t signature_cache::key_hash::operator()( const key_type& k )const
+{
+   // Both the digest and the signature are random enough to be used as hashes themselves
+   uint64_t sig_bits;
+   std::memcpy( &sig_bits, k.signature.begin() + 1, sizeof(sig_bits) );
+   return size_t( k.digest._hash[0] ^ sig_bits );
+}
+
+public_key_type signature_cache::recover( const digest_type& digest, const signature_type& signature )
+{
+   const uint64_t generation_size = _generation_size.load();
+   if( generation_size == 0 )
+   {
+      ++_misses;
+      return fc::ecc::public_key( signature, digest );
+   }
+
+   key_type key{ digest, signature };
+   const size_t hash = key_hash()( key );
+   shard& s = _shards[ ( hash >> 56 ) % shard_count ];
+   {
+      std::lock_guard<std::mutex> guard( s._mutex );
+      auto itr = s._current.find( key );
+      if( itr != s._current.end() )
+      {
+         ++_hits;
+         return itr->second;
+      }
+      itr = s._previous.find( key );
+      if( itr != s._previous.end() )
+      {
+         ++_hits;
+         public_key_type result = itr->second;
+         s._previous.erase( itr );
+         s._current.emplace( std::move(key), result );
+         return result;
+      }
+   }
+
+   ++_misses;
+   // Recover without holding the lock, other threads may need the shard meanwhile
+   public_key_type result = fc::ecc::public_key( signature, digest );
+
+   std::lock_guard<std::mutex> guard( s._mutex );
+   if( s._current.size() >= generation_size )
+   {
+      s._previous = std::move( s._current );
+      s._current = generation_type();
+   }
+   s._current.emplace( std::move(key), result );
+   return result;
+}
+
+void signature_cache::set_capacity( uint64_t capacity )
+{
+   _generation_size.store( capacity == 0 ? 0 : std::max<uint64_t>( capacity / shard_count / 2, 1 ) );
+   clear();
+}
+
+void signature_cache::clear()
+{
+   for( shard& s : _shards )
+   {
+      std::lock_guard<std::mutex> guard( s._mutex );
+      s._current.clear();
+      s._previous.clear();
+   }
+}
+
+signature_cache_stats signature_cache::get_stats()const
+{
+   signature_cache_stats result;
+   result.hits = _hits.load();
+   result.misses = _misses.load();
+   result.capacity = _generation_size.load() * shard_count * 2;
+   for( const shard& s : _shards )
+   {
+      std::lock_guard<std::mutex> guard( s._mutex );
+      result.size += s._current.size() + s._previous.size();
+   }
+   return result;
+}
+
+} } // graphene::protocol
@@ -29,6 +29,7 @@
 #include <graphene/protocol/fee_schedule.hpp>
 #include <graphene/protocol/pts_address.hpp>
 #include <graphene/protocol/restriction_predicate.hpp>
+#include <graphene/protocol/signature_cache.hpp>
 
 #include <fc/io/raw.hpp>
 
@@ -36,8 +37,12 @@ namespace graphene { namespace protocol {
 
 digest_type processed_transaction::merkle_digest()const
 {
+   // Same as packing the whole processed transaction, the transaction fields come first
    digest_type::encoder enc;
-   fc::raw::pack( enc, *this );
+   const vector<char>& packed = get_packed_transaction();
+   enc.write( packed.data(), packed.size() );
+   fc::raw::pack( enc, signatures );
+   fc::raw::pack( enc, operation_results );
    return enc.result();
 }
 
@@ -355,7 +360,7 @@ const flat_set<public_key_type>& signed_transaction::get_signature_keys( const c
    for( const auto&  sig : signatures )
    {
       GRAPHENE_ASSERT(
-         result.insert( fc::ecc::public_key(sig,d) ).second,
+         result.insert( signature_cache::instance().recover( d, sig ) ).second,
             tx_duplicate_sig,
             "Duplicate Signature detected" );
    }
@@ -435,7 +440,11 @@ set<public_key_type> signed_transaction::minimize_required_signatures(
 const transaction_id_type& precomputable_transaction::id()const
 {
    if( !_tx_id_buffer._hash[0].value() )
-      transaction::id();
+   {
+      const vector<char>& packed = get_packed_transaction();
+      auto h = digest_type::hash( packed.data(), packed.size() );
+      memcpy(_tx_id_buffer._hash, h._hash, std::min(sizeof(_tx_id_buffer), sizeof(h)));
+   }
    return _tx_id_buffer;
 }
 
@@ -448,9 +457,28 @@ void precomputable_transaction::validate() const
 
 uint64_t precomputable_transaction::get_packed_size()const
 {
-   if( _packed_size == 0 )
-      _packed_size = transaction::get_packed_size();
-   return _packed_size;
+   return get_packed_transaction().size();
+}
+
+const vector<char>& precomputable_transaction::get_packed_transaction()const
+{
+   if( _packed_transaction.empty() )
+      _packed_transaction = fc::raw::pack( static_cast<const transaction&>( *this ) );
+   return _packed_transaction;
+}
+
+digest_type precomputable_transaction::sig_digest( const chain_id_type& chain_id )const
+{
+   if( _sig_digest == digest_type() || _sig_digest_chain_id != chain_id )
+   {
+      digest_type::encoder enc;
+      fc::raw::pack( enc, chain_id );
+      const vector<char>& packed = get_packed_transaction();
+      enc.write( packed.data(), packed.size() );
+      _sig_digest = enc.result();
+      _sig_digest_chain_id = chain_id;
+   }
+   return _sig_digest;
 }
 
 const flat_set<public_key_type>& precomputable_transaction::get_signature_keys( const chain_id_type& chain_id )const
@@ -185,6 +185,7 @@ const std::string doCurl(CurlRequest& curl)
    if(!curl.auth.empty())
       curl_easy_setopt(curl.handler, CURLOPT_USERPWD, curl.auth.c_str());
    curl_easy_perform(curl.handler);
+   curl_slist_free_all(headers);
 
    return CurlReadBuffer;
 }
@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2020-2023 Revolution Populi Limited, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/utilities/elasticsearch_exporter.hpp>
+#include <graphene/utilities/elasticsearch.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <chrono>
+
+namespace graphene { namespace utilities {
+
+namespace {
+   /// Precedes every batch in the spill journal
+   struct journal_record_header
+   {
+      uint32_t block_num;
+      uint32_t lines;
+      int64_t  queued;  // microseconds since epoch
+      uint64_t size;
+   };
+}
+
+es_exporter::es_exporter( const es_exporter_options& options )
+   : _options( options )
+{
+   FC_ASSERT( _options.connections > 0, "The exporter needs at least one connection" );
+   FC_ASSERT( _options.max_queued_batches > 0, "The exporter needs room for at least one batch" );
+   if( !_options.spill_dir.string().empty() )
+      open_journal();
+   _workers.reserve( _options.connections );
+   for( uint16_t i = 0; i < _options.connections; ++i )
+      _workers.emplace_back( [this] () { run(); } );
+}
+
+es_exporter::~es_exporter()
+{
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _stopping = true;
+   }
+   _work_available.notify_all();
+   _space_available.notify_all();
+   for( auto& worker : _workers )
+      worker.join();
+
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( !_queue.empty() && !_journal.is_open() )
+      elog( "Dropping ${n} bulk batches which were not sent to Elastic Search, up to block ${b}",
+            ("n",_queue.size())("b",_stats.last_submitted_block) );
+   for( const auto& b : _queue )
+      if( _journal.is_open() )
+         spill( b );
+   _queue.clear();
+}
+
+void es_exporter::submit( uint32_t block_num, std::vector<std::string>&& bulk_lines )
+{
+   if( bulk_lines.empty() )
+      return;
+
+   batch b;
+   b.block_num = block_num;
+   b.lines = uint32_t( bulk_lines.size() );
+   b.queued = fc::time_point::now();
+   b.body = joinBulkLines( bulk_lines );
+   bulk_lines.clear();
+
+   std::unique_lock<std::mutex> lock( _mutex );
+   _stats.last_submitted_block = std::max( _stats.last_submitted_block, block_num );
+   if( _queue.size() >= _options.max_queued_batches )
+   {
+      if( _journal.is_open() )
+      {
+         spill( b );
+         _work_available.notify_one();
+         return;
+      }
+      _space_available.wait( lock, [this] () {
+         return _queue.size() < _options.max_queued_batches || _stopping;
+      });
+   }
+   _queue.push_back( std::move(b) );
+   _work_available.notify_one();
+}
+
+es_exporter_stats es_exporter::get_stats()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   es_exporter_stats result = _stats;
+   result.queued_batches = uint32_t( _queue.size() );
+   result.spilled_batches = _journal_batches;
+
+   fc::time_point oldest = fc::time_point::maximum();
+   if( !_queue.empty() )
+      oldest = _queue.front().queued;
+   if( _journal_batches > 0 )
+      oldest = std::min( oldest, _journal_oldest );
+   if( oldest != fc::time_point::maximum() )
+      result.export_lag = fc::time_point::now() - oldest;
+   return result;
+}
+
+bool es_exporter::wait_idle( const fc::microseconds& timeout )const
+{
+   std::unique_lock<std::mutex> lock( _mutex );
+   return _idle.wait_for( lock, std::chrono::microseconds( timeout.count() ), [this] () {
+      return _queue.empty() && _journal_batches == 0 && _in_flight == 0;
+   });
+}
+
+void es_exporter::run()
+{
+   CURL* curl = curl_easy_init();
+   curl_easy_setopt( curl, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1_2 );
+   curl_easy_setopt( curl, CURLOPT_TIMEOUT_MS, long( _options.request_timeout.count() / 1000 ) );
+   curl_easy_setopt( curl, CURLOPT_NOSIGNAL, 1L );
+
+   std::unique_lock<std::mutex> lock( _mutex );
+   while( !_stopping )
+   {
+      const fc::time_point now = fc::time_point::now();
+      if( now < _retry_at )
+      {
+         _work_available.wait_for( lock, std::chrono::microseconds( (_retry_at - now).count() ) );
+         continue;
+      }
+
+      batch b;
+      // spilled batches are older than the queued ones
+      bool found = _journal_batches > 0 && unspill( b );
+      if( !found && !_queue.empty() )
+      {
+         b = std::move( _queue.front() );
+         _queue.pop_front();
+         _space_available.notify_one();
+         found = true;
+      }
+      if( !found )
+      {
+         _work_available.wait( lock );
+         continue;
+      }
+
+      ++_in_flight;
+      lock.unlock();
+      const bool sent = send( curl, b );
+      lock.lock();
+      --_in_flight;
+
+      if( sent )
+      {
+         if( _retry_at != fc::time_point() )
+         {
+            ilog( "Elastic Search is reachable again, ${q} batches queued, ${s} spilled",
+                  ("q",_queue.size())("s",_journal_batches) );
+            _retry_at = fc::time_point();
+            _work_available.notify_all();
+         }
+         ++_stats.exported_batches;
+         _stats.exported_lines += b.lines;
+         _stats.last_exported_block = std::max( _stats.last_exported_block, b.block_num );
+      }
+      else
+      {
+         ++_stats.failed_requests;
+         _retry_at = fc::time_point::now() + _options.retry_interval;
+         wlog( "Sending ${n} lines of bulk data of block ${b} to Elastic Search failed, retrying in ${s} seconds",
+               ("n",b.lines)("b",b.block_num)("s",_options.retry_interval.to_seconds()) );
+         if( _journal.is_open() )
+            spill( b );
+         else
+            _queue.push_front( std::move(b) );
+      }
+
+      if( _queue.empty() && _journal_batches == 0 && _in_flight == 0 )
+         _idle.notify_all();
+   }
+   lock.unlock();
+
+   curl_easy_cleanup( curl );
+}
+
+bool es_exporter::send( void* curl, const batch& b )const
+{
+   CurlRequest request;
+   request.handler = static_cast<CURL*>( curl );
+   request.url = _options.elasticsearch_url + "_bulk";
+   request.auth = _options.auth;
+   request.type = "POST";
+   request.query = b.body;
+
+   try {
+      const std::string response = doCurl( request );
+      return handleBulkResponse( getResponseCode( request.handler ), response );
+   } catch( const fc::exception& e ) {
+      elog( "Unexpected response from Elastic Search: ${e}", ("e",e.to_detail_string()) );
+   }
+   return false;
+}
+
+void es_exporter::open_journal()
+{
+   fc::create_directories( _options.spill_dir );
+   _journal_path = _options.spill_dir / "bulk.journal";
+   if( !fc::exists( _journal_path ) )
+      std::ofstream( _journal_path.string(), std::ios::binary );
+   _journal.open( _journal_path.string(), std::ios::in | std::ios::out | std::ios::binary );
+   FC_ASSERT( _journal.is_open(), "Unable to open the spill journal ${p}", ("p",_journal_path) );
+
+   // count the batches left from an earlier run, a torn record at the end is cut off
+   journal_record_header header;
+   uint64_t pos = 0;
+   _journal.seekg( 0, std::ios::end );
+   const uint64_t end = uint64_t( _journal.tellg() );
+   _journal.seekg( 0 );
+   while( pos + sizeof(header) <= end && _journal.read( (char*)&header, sizeof(header) )
+          && pos + sizeof(header) + header.size <= end )
+   {
+      if( _journal_batches == 0 )
+         _journal_oldest = fc::time_point( fc::microseconds( header.queued ) );
+      ++_journal_batches;
+      pos += sizeof(header) + header.size;
+      _journal.seekg( pos );
+   }
+   _journal.clear();
+   if( pos < end )
+   {
+      wlog( "Discarding ${n} bytes of an incomplete batch at the end of ${p}", ("n",end-pos)("p",_journal_path) );
+      fc::resize_file( _journal_path, pos );
+   }
+   if( _journal_batches > 0 )
+      ilog( "Found ${n} bulk batches not sent to Elastic Search yet in ${p}", ("n",_journal_batches)("p",_journal_path) );
+}
+
+void es_exporter::spill( const batch& b )
+{
+   journal_record_header header;
+   header.block_num = b.block_num;
+   header.lines = b.lines;
+   header.queued = b.queued.time_since_epoch().count();
+   header.size = b.body.size();
+
+   _journal.clear();
+   _journal.seekp( 0, std::ios::end );
+   _journal.write( (const char*)&header, sizeof(header) );
+   _journal.write( b.body.data(), b.body.size() );
+   _journal.flush();
+   if( !_journal )
+   {
+      elog( "Unable to write to ${p}, dropping ${n} lines of bulk data of block ${b}",
+            ("p",_journal_path)("n",b.lines)("b",b.block_num) );
+      _journal.clear();
+      return;
+   }
+   if( _journal_batches == 0 )
+      _journal_oldest = b.queued;
+   ++_journal_batches;
+}
+
+bool es_exporter::unspill( batch& b )
+{
+   journal_record_header header;
+   bool found = false;
+   _journal.clear();
+   _journal.seekg( _journal_read_pos );
+   if( _journal.read( (char*)&header, sizeof(header) ) )
+   {
+      b.block_num = header.block_num;
+      b.lines = header.lines;
+      b.queued = fc::time_point( fc::microseconds( header.queued ) );
+      b.body.resize( header.size );
+      found = bool( _journal.read( &b.body[0], header.size ) );
+   }
+
+   if( found )
+   {
+      _journal_read_pos += sizeof(header) + header.size;
+      --_journal_batches;
+   }
+   else
+   {
+      elog( "Unable to read from ${p}, dropping ${n} spilled batches", ("p",_journal_path)("n",_journal_batches) );
+      _journal_batches = 0;
+   }
+
+   if( _journal_batches == 0 )
+   {
+      // everything was taken out, start over
+      _journal.close();
+      _journal.open( _journal_path.string(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc );
+      _journal_read_pos = 0;
+   }
+   else if( _journal.read( (char*)&header, sizeof(header) ) )
+      _journal_oldest = fc::time_point( fc::microseconds( header.queued ) );
+   return found;
+}
+
+} } // end namespace graphene::utilities
@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2020-2023 Revolution Populi Limited, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/filesystem.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/time.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace graphene { namespace utilities {
+
+   struct es_exporter_options
+   {
+      std::string      elasticsearch_url;
+      std::string      auth;
+      /// Number of bulk requests sent in parallel, each with its own connection
+      uint16_t         connections = 2;
+      /// Number of bulk batches held in memory before they go to the spill journal, or before submit() waits
+      /// for the exporter if there is no journal
+      uint32_t         max_queued_batches = 64;
+      /// Directory of the spill journal, empty for none
+      fc::path         spill_dir;
+      /// Time to wait after a failed request before trying again
+      fc::microseconds retry_interval = fc::seconds(5);
+      /// Time limit for a single bulk request
+      fc::microseconds request_timeout = fc::seconds(30);
+   };
+
+   struct es_exporter_stats
+   {
+      /// Batches waiting in memory
+      uint32_t         queued_batches = 0;
+      /// Batches waiting in the spill journal
+      uint32_t         spilled_batches = 0;
+      uint64_t         exported_batches = 0;
+      uint64_t         exported_lines = 0;
+      uint64_t         failed_requests = 0;
+      uint32_t         last_submitted_block = 0;
+      uint32_t         last_exported_block = 0;
+      /// Age of the oldest batch which was not exported yet
+      fc::microseconds export_lag;
+   };
+
+   /**
+    * @brief Sends bulk lines to Elasticsearch from its own threads
+    *
+    * submit() only hands the lines over and returns. Batches are sent in parallel over a pool of connections,
+    * so their order in Elasticsearch is not guaranteed; bulk lines must therefore be idempotent, e.g. index
+    * documents with explicit IDs.
+    *
+    * When Elasticsearch is slow or down, batches pile up in memory up to max_queued_batches, then go to the
+    * spill journal, from where they are sent once requests succeed again. The journal survives restarts: a
+    * new exporter on the same directory picks it up. Batches of a partly sent journal may be sent twice.
+    * Without a journal, submit() waits for the exporter when the queue is full.
+    *
+    * Only batches which overflow the queue, fail or are still queued on a clean shutdown are journaled. If the node
+    * crashes, the queued batches and those in flight are lost, i.e. up to max_queued_batches plus the number of
+    * connections. As bulk lines are idempotent, they can be recovered by replaying the blocks since then.
+    */
+   class es_exporter
+   {
+      public:
+         explicit es_exporter( const es_exporter_options& options );
+         /// Waits for the requests in flight and spills the batches still queued, they are lost without a journal
+         ~es_exporter();
+
+         es_exporter( const es_exporter& ) = delete;
+         es_exporter& operator=( const es_exporter& ) = delete;
+
+         void submit( uint32_t block_num, std::vector<std::string>&& bulk_lines );
+
+         es_exporter_stats get_stats()const;
+
+         /// Waits until all submitted batches are exported, @return false on timeout
+         bool wait_idle( const fc::microseconds& timeout )const;
+
+      private:
+         struct batch
+         {
+            uint32_t         block_num = 0;
+            uint32_t         lines = 0;
+            fc::time_point   queued;
+            std::string      body;
+         };
+
+         void run();
+         bool send( void* curl, const batch& b )const;
+
+         /// The journal methods need _mutex to be held
+         void spill( const batch& b );
+         bool unspill( batch& b );
+         void open_journal();
+
+         const es_exporter_options    _options;
+
+         mutable std::mutex              _mutex;
+         std::condition_variable         _work_available;
+         std::condition_variable         _space_available;
+         mutable std::condition_variable _idle;
+         std::deque<batch>               _queue;
+         uint32_t                        _in_flight = 0;
+         bool                            _stopping = false;
+         /// Requests are not sent before this time after a failure
+         fc::time_point                  _retry_at;
+
+         std::fstream                    _journal;
+         fc::path                        _journal_path;
+         uint64_t                        _journal_read_pos = 0;
+         uint32_t                        _journal_batches = 0;
+         fc::time_point                  _journal_oldest;
+
+         es_exporter_stats               _stats;
+         std::vector<std::thread>        _workers;
+   };
+
+} } // end namespace graphene::utilities
+
+FC_REFLECT( graphene::utilities::es_exporter_stats,
+            (queued_batches)(spilled_batches)(exported_batches)(exported_lines)(failed_requests)
+            (last_submitted_block)(last_exported_block)(export_lag) )
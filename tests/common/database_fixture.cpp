@@ -312,6 +312,8 @@ std::shared_ptr<boost::program_options::variables_map> database_fixture_base::in
       fc::set_option( options, "elasticsearch-operation-object", true );
       fc::set_option( options, "elasticsearch-operation-string", true );
       fc::set_option( options, "elasticsearch-mode", uint16_t(2) );
+      fc::set_option( options, "elasticsearch-exporter-spill-dir",
+                      boost::filesystem::path(fixture.data_dir.path() / "elasticsearch-spill") );
 
       fixture.es_index_prefix = string("acloudbank-") + fc::to_string(uint64_t(rand())) + "-";
       BOOST_TEST_MESSAGE( string("ES index prefix is ") + fixture.es_index_prefix );
@@ -344,10 +346,12 @@ std::shared_ptr<boost::program_options::variables_map> database_fixture_base::in
    }
 
    if( fixture.current_test_name == "asset_in_collateral"
+            || fixture.current_test_name == "asset_holders_count_and_pages"
             || fixture.current_test_name == "htlc_database_api"
             || fixture.current_suite_name == "database_api_tests"
             || fixture.current_suite_name == "api_limit_tests"
-            || fixture.current_suite_name == "electoral_threshold_tests" )
+            || fixture.current_suite_name == "electoral_threshold_tests"
+            || fixture.current_suite_name == "tnt_tests" )
    {
       fixture.app.register_plugin<graphene::api_helper_indexes::api_helper_indexes>(true);
    }
@@ -488,7 +492,7 @@ void database_fixture_base::verify_asset_supplies( const database& db )
    const asset_dynamic_data_object& core_asset_data = db.get_core_asset().dynamic_asset_data_id(db);
    BOOST_CHECK(core_asset_data.fee_pool == 0);
 
-   const auto& statistics_index = db.get_index_type<account_stats_index>().indices();
+   const auto& statistics_index = db.get_index_type<account_stats_index>();
    const auto& acct_balance_index = db.get_index_type<account_balance_index>().indices();
    const auto& settle_index = db.get_index_type<force_settlement_index>().indices();
    map<asset_id_type,share_type> total_balances;
@@ -8,6 +8,7 @@
 #include <fc/crypto/digest.hpp>
 
 #include <graphene/utilities/elasticsearch.hpp>
+#include <graphene/utilities/elasticsearch_exporter.hpp>
 #include <graphene/elasticsearch/elasticsearch_plugin.hpp>
 
 #include "../common/init_unit_test_suite.hpp"
@@ -16,6 +17,17 @@
 
 #include "../common/utils.hpp"
 
+#include <boost/algorithm/string/case_conv.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <set>
+#include <thread>
+
 #define ES_WAIT_TIME (fc::milliseconds(10000))
 
 using namespace graphene::chain;
@@ -209,3 +221,194 @@ BOOST_AUTO_TEST_CASE(elasticsearch_suite) {
 }
 
 BOOST_AUTO_TEST_SUITE_END()
+
+namespace {
+
+/// Answers bulk requests on a local port like Elastic Search would, or with errors while it is "down"
+class fake_elasticsearch
+{
+   public:
+      fake_elasticsearch()
+      {
+         _socket = ::socket( AF_INET, SOCK_STREAM, 0 );
+         FC_ASSERT( _socket >= 0 );
+         sockaddr_in addr = {};
+         addr.sin_family = AF_INET;
+         addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+         addr.sin_port = 0;
+         FC_ASSERT( ::bind( _socket, (sockaddr*)&addr, sizeof(addr) ) == 0 );
+         FC_ASSERT( ::listen( _socket, 16 ) == 0 );
+         socklen_t len = sizeof(addr);
+         ::getsockname( _socket, (sockaddr*)&addr, &len );
+         _port = ntohs( addr.sin_port );
+         _server = std::thread( [this] () { serve(); } );
+      }
+
+      ~fake_elasticsearch()
+      {
+         _stopping = true;
+         ::shutdown( _socket, SHUT_RDWR );
+         ::close( _socket );
+         _server.join();
+      }
+
+      std::string url()const { return "http://127.0.0.1:" + fc::to_string( uint64_t(_port) ) + "/"; }
+
+      std::atomic<bool> up{ true };
+
+      std::set<std::string> received()
+      {
+         std::lock_guard<std::mutex> lock( _mutex );
+         return _received;
+      }
+
+   private:
+      void serve()
+      {
+         while( !_stopping )
+         {
+            const int client = ::accept( _socket, nullptr, nullptr );
+            if( client < 0 )
+               continue;
+            handle( client );
+            ::close( client );
+         }
+      }
+
+      void handle( int client )
+      {
+         std::string request;
+         char buffer[4096];
+         size_t header_end = std::string::npos;
+         while( header_end == std::string::npos )
+         {
+            const ssize_t n = ::recv( client, buffer, sizeof(buffer), 0 );
+            if( n <= 0 )
+               return;
+            request.append( buffer, size_t(n) );
+            header_end = request.find( "\r\n\r\n" );
+         }
+         const std::string headers = boost::algorithm::to_lower_copy( request.substr( 0, header_end ) );
+         size_t content_length = 0;
+         const size_t cl = headers.find( "content-length:" );
+         if( cl != std::string::npos )
+            content_length = std::stoul( headers.substr( cl + 15 ) );
+         if( headers.find( "expect: 100-continue" ) != std::string::npos )
+            send_all( client, "HTTP/1.1 100 Continue\r\n\r\n" );
+         std::string body = request.substr( header_end + 4 );
+         while( body.size() < content_length )
+         {
+            const ssize_t n = ::recv( client, buffer, sizeof(buffer), 0 );
+            if( n <= 0 )
+               return;
+            body.append( buffer, size_t(n) );
+         }
+
+         std::string response_body = "{\"errors\":false,\"items\":[]}";
+         std::string status = "200 OK";
+         if( !up )
+         {
+            response_body = "{\"error\":\"unavailable\"}";
+            status = "503 Service Unavailable";
+         }
+         else
+         {
+            std::lock_guard<std::mutex> lock( _mutex );
+            _received.insert( body );
+         }
+         send_all( client, "HTTP/1.1 " + status + "\r\nContent-Type: application/json\r\nContent-Length: "
+                           + fc::to_string( uint64_t(response_body.size()) ) + "\r\nConnection: close\r\n\r\n"
+                           + response_body );
+      }
+
+      static void send_all( int client, const std::string& data )
+      {
+         size_t sent = 0;
+         while( sent < data.size() )
+         {
+            const ssize_t n = ::send( client, data.data() + sent, data.size() - sent, MSG_NOSIGNAL );
+            if( n <= 0 )
+               return;
+            sent += size_t(n);
+         }
+      }
+
+      int                   _socket = -1;
+      uint16_t              _port = 0;
+      std::atomic<bool>     _stopping{ false };
+      std::thread           _server;
+      std::mutex            _mutex;
+      std::set<std::string> _received;
+};
+
+std::vector<std::string> bulk_for_block( uint32_t block_num )
+{
+   return { "{\"index\":{\"_index\":\"test\",\"_id\":\"" + fc::to_string( uint64_t(block_num) ) + "\"}}",
+            "{\"block\":" + fc::to_string( uint64_t(block_num) ) + "}" };
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(elasticsearch_exporter_spill_and_resume) {
+   try {
+      fake_elasticsearch server;
+      fc::temp_directory spill_dir( graphene::utilities::temp_directory_path() );
+
+      graphene::utilities::es_exporter_options options;
+      options.elasticsearch_url = server.url();
+      options.connections = 2;
+      options.max_queued_batches = 2;
+      options.spill_dir = spill_dir.path();
+      options.retry_interval = fc::milliseconds(100);
+      options.request_timeout = fc::seconds(5);
+
+      const uint32_t batches = 10;
+      server.up = false;
+      {
+         graphene::utilities::es_exporter exporter( options );
+         // submitting never waits, whatever does not fit in memory goes to the journal
+         for( uint32_t i = 1; i <= batches; ++i )
+            exporter.submit( i, bulk_for_block( i ) );
+
+         BOOST_CHECK( !exporter.wait_idle( fc::milliseconds(300) ) );
+         auto stats = exporter.get_stats();
+         BOOST_CHECK_GT( stats.failed_requests, 0u );
+         BOOST_CHECK_EQUAL( stats.exported_batches, 0u );
+         BOOST_CHECK_GT( stats.spilled_batches, 0u );
+         BOOST_CHECK_EQUAL( stats.last_submitted_block, batches );
+         BOOST_CHECK_GT( stats.export_lag.count(), 0 );
+
+         server.up = true;
+         BOOST_REQUIRE( exporter.wait_idle( fc::seconds(10) ) );
+         stats = exporter.get_stats();
+         BOOST_CHECK_EQUAL( stats.exported_batches, batches );
+         BOOST_CHECK_EQUAL( stats.exported_lines, 2 * batches );
+         BOOST_CHECK_EQUAL( stats.last_exported_block, batches );
+         BOOST_CHECK_EQUAL( stats.queued_batches, 0u );
+         BOOST_CHECK_EQUAL( stats.spilled_batches, 0u );
+         BOOST_CHECK_EQUAL( stats.export_lag.count(), 0 );
+      }
+      BOOST_CHECK_EQUAL( server.received().size(), batches );
+
+      // batches not sent before shutdown are sent by the next exporter on the same journal
+      server.up = false;
+      {
+         graphene::utilities::es_exporter exporter( options );
+         for( uint32_t i = batches + 1; i <= batches + 3; ++i )
+            exporter.submit( i, bulk_for_block( i ) );
+      }
+      server.up = true;
+      {
+         graphene::utilities::es_exporter exporter( options );
+         BOOST_REQUIRE( exporter.wait_idle( fc::seconds(10) ) );
+      }
+      const auto received = server.received();
+      BOOST_CHECK_EQUAL( received.size(), batches + 3 );
+      for( uint32_t i = 1; i <= batches + 3; ++i )
+         BOOST_CHECK( received.count( graphene::utilities::joinBulkLines( bulk_for_block( i ) ) ) == 1 );
+   }
+   catch (fc::exception &e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
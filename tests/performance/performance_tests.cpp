@@ -37,6 +37,28 @@ BOOST_AUTO_TEST_CASE( sigcheck_benchmark )
    wlog( "Benchmark: verify ${sps} signatures/s", ("sps",(cycles*1000000)/elapsed.count()) );
 }
 
+BOOST_AUTO_TEST_CASE( modify_benchmark )
+{ try {
+   db._undo_db.disable();
+   const account_statistics_object& stats = account_id_type()(db).statistics(db);
+   const asset_dynamic_data_object& core_dyn = asset_id_type()(db).dynamic_data(db);
+   const uint64_t cycles = 1000000;
+
+   auto start = fc::time_point::now();
+   for( uint32_t i = 0; i < cycles; ++i )
+      db.modify( stats, [i]( account_statistics_object& s ) { s.total_ops = i; } );
+   auto elapsed = fc::time_point::now() - start;
+   wlog( "Benchmark: ${mps} account statistics modifications/s", ("mps",(cycles*1000000)/elapsed.count()) );
+
+   start = fc::time_point::now();
+   for( uint32_t i = 0; i < cycles; ++i )
+      db.modify( core_dyn, [i]( asset_dynamic_data_object& d ) { d.accumulated_fees = i; } );
+   elapsed = fc::time_point::now() - start;
+   wlog( "Benchmark: ${mps} asset dynamic data modifications/s", ("mps",(cycles*1000000)/elapsed.count()) );
+
+   db._undo_db.enable();
+} FC_LOG_AND_RETHROW() }
+
 // See https://bitshares.org/blog/2015/06/08/measuring-performance/
 // (note this is not the original test mentioned in the above post, but was
 //  recreated later according to the description)
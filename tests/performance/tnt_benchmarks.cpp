@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2020-2023 Revolution Populi Limited, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/global_property_object.hpp>
+#include <graphene/chain/tnt/object.hpp>
+#include <graphene/chain/tnt/query_evaluator.hpp>
+#include <graphene/chain/tnt/tap_flow_evaluator.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+namespace {
+// Unqualified, tnt would be ambiguous here between the chain and protocol namespaces
+namespace tnt = graphene::chain::tnt;
+
+/// Times tap openings the way the tap_open evaluator performs them, on tanks created directly in the database, so the
+/// results show which TNT parameter limits (max_taps_to_open, max_connection_chain_length) the hardware can support
+struct tnt_benchmark_fixture : database_fixture {
+   static constexpr uint16_t max_limit = 1000;
+
+   tnt_benchmark_fixture() {
+      db.modify(db.get_global_properties(), [](global_property_object& gpo) {
+         ptnt::parameters_type tnt_parameters;
+         tnt_parameters.max_connection_chain_length = max_limit;
+         tnt_parameters.max_taps_to_open = max_limit;
+         gpo.parameters.extensions.value.updatable_tnt_options = tnt_parameters;
+      });
+   }
+
+   tank_id_type create_tank() {
+      return db.create<tank_object>([now = db.head_block_time()](tank_object& tank) {
+         tank.schematic.asset_type = asset_id_type();
+         tank.schematic.remote_sources = ptnt::all_sources();
+         tank.balance = GRAPHENE_MAX_SHARE_SUPPLY;
+         tank.creation_date = now;
+      }).get_id();
+   }
+
+   /// Create a chain of tanks where the tap of each tank releases into a tap opener on the next one, which opens that
+   /// tank's tap in turn; the tap of the last tank releases to an account. Every tap has the supplied requirements,
+   /// and every tank has a flow meter with some metered asset as attachment 1 for exchange requirements.
+   ptnt::tap_id_type create_tap_chain(uint16_t length, const vector<ptnt::tap_requirement>& requirements) {
+      vector<tank_id_type> tanks;
+      for (uint16_t i = 0; i < length; ++i)
+         tanks.push_back(create_tank());
+
+      for (uint16_t i = 0; i < length; ++i)
+         db.modify(tanks[i](db), [&](tank_object& tank) {
+            ptnt::tap tap;
+            if (i + 1 < length)
+               tap.connected_connection = ptnt::connection(ptnt::attachment_id_type{tanks[i + 1], 0});
+            else
+               tap.connected_connection = ptnt::connection(account_id_type());
+            tap.requirements = requirements;
+            tap.destructor_tap = false;
+            tank.schematic.taps[0] = tap;
+            tank.schematic.tap_counter = 1;
+
+            ptnt::tap_opener opener(0, share_type(1), ptnt::same_tank(), asset_id_type());
+            opener.remote_sources = ptnt::all_sources();
+            tank.schematic.attachments[0] = opener;
+            tank.schematic.attachments[1] = ptnt::asset_flow_meter(asset_id_type(), account_id_type());
+            tank.schematic.attachment_counter = 2;
+            tank.get_or_create_state(ptnt::tank_accessory_address<ptnt::asset_flow_meter>{1}).metered_amount =
+                  GRAPHENE_MAX_SHARE_SUPPLY;
+         });
+
+      return ptnt::tap_id_type{tanks.front(), 0};
+   }
+
+   /// Create a tank whose tap releases through a chain of flow meters on the tank before reaching an account
+   ptnt::tap_id_type create_meter_chain(uint16_t length) {
+      tank_id_type tank_id = create_tank();
+      db.modify(tank_id(db), [length](tank_object& tank) {
+         ptnt::tap tap;
+         tap.connected_connection = ptnt::connection(ptnt::attachment_id_type{{}, 0});
+         tap.destructor_tap = false;
+         tank.schematic.taps[0] = tap;
+         tank.schematic.tap_counter = 1;
+         for (uint16_t i = 0; i < length; ++i) {
+            ptnt::connection destination = account_id_type();
+            if (i + 1 < length)
+               destination = ptnt::attachment_id_type{{}, ptnt::index_type(i + 1)};
+            tank.schematic.attachments[i] = ptnt::asset_flow_meter(asset_id_type(), destination);
+         }
+         tank.schematic.attachment_counter = length;
+      });
+      return ptnt::tap_id_type{tank_id, 0};
+   }
+
+   /// Open the tap without committing the changes, so every run starts from the same state; returns the number of
+   /// taps opened
+   size_t open_tap(const ptnt::tap_id_type& tap) {
+      cow_db_wrapper wrapper(db);
+      tnt::query_evaluator queries;
+      queries.set_query_tank((*tap.tank_id)(db));
+      auto flows = tnt::evaluate_tap_flow(wrapper, queries, account_id_type(), tap, share_type(1), max_limit,
+                                          [](account_id_type, asset, vector<ptnt::connection>) {});
+      return flows.size();
+   }
+
+   void benchmark_tap(const string& name, const ptnt::tap_id_type& tap, uint32_t cycles) {
+      size_t taps_opened = 0;
+      auto start = fc::time_point::now();
+      for (uint32_t i = 0; i < cycles; ++i)
+         taps_opened += open_tap(tap);
+      auto elapsed = fc::time_point::now() - start;
+      wlog("Benchmark: ${name}: ${ops} tap_open operations/s, ${tps} taps opened/s, ${us} us per operation",
+           ("name", name)("ops", (cycles * 1000000) / elapsed.count())
+           ("tps", (taps_opened * 1000000) / elapsed.count())("us", elapsed.count() / cycles));
+   }
+
+   void benchmark_chains(const string& name, const vector<ptnt::tap_requirement>& requirements) {
+      for (uint16_t length : {10, 100, 1000})
+         benchmark_tap(name + " x" + std::to_string(length), create_tap_chain(length, requirements),
+                       100000 / length);
+   }
+};
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE( tnt_benchmarks, tnt_benchmark_fixture )
+
+BOOST_AUTO_TEST_CASE( tap_chain_benchmark )
+{ try {
+   benchmark_chains("tap chain", {});
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( connection_chain_benchmark )
+{ try {
+   for (uint16_t length : {10, 100, 1000})
+      benchmark_tap("meter chain x" + std::to_string(length), create_meter_chain(length), 100000 / length);
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( time_lock_benchmark )
+{ try {
+   vector<time_point_sec> times;
+   for (uint32_t i = 1; i <= 100; ++i)
+      times.push_back(db.head_block_time() + i * 3600);
+   benchmark_chains("time locked tap chain", {ptnt::time_lock(times)});
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( periodic_limit_benchmark )
+{ try {
+   benchmark_chains("flow limited tap chain",
+                    {ptnt::periodic_flow_limit(GRAPHENE_MAX_SHARE_SUPPLY, 86400),
+                     ptnt::cumulative_flow_limit(GRAPHENE_MAX_SHARE_SUPPLY),
+                     ptnt::immediate_flow_limit(GRAPHENE_MAX_SHARE_SUPPLY)});
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( exchange_requirement_benchmark )
+{ try {
+   benchmark_chains("exchange limited tap chain",
+                    {ptnt::exchange_requirement(ptnt::attachment_id_type{{}, 1}, 1, 1)});
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
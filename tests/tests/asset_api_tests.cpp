@@ -64,4 +64,50 @@ BOOST_AUTO_TEST_CASE( api_limit_get_asset_holders )
    BOOST_REQUIRE_EQUAL( holders.size(), 4u );
 }
 
+BOOST_AUTO_TEST_CASE( asset_holders_count_and_pages )
+{ try {
+   graphene::app::asset_api asset_api(app);
+   const std::string core = std::string( static_cast<object_id_type>(asset_id_type()) );
+
+   auto dan = create_account("dan");
+   auto bob = create_account("bob");
+   auto alice = create_account("alice");
+   transfer(account_id_type()(db), dan, asset(100));
+   transfer(account_id_type()(db), alice, asset(200));
+   transfer(account_id_type()(db), bob, asset(300));
+
+   vector<account_asset_balance> all = asset_api.get_asset_holders( core, 0, 100 );
+   BOOST_CHECK_EQUAL( asset_api.get_asset_holders_count( core ), static_cast<int>( all.size() ) );
+
+   BOOST_TEST_MESSAGE( "Pages of two holders, each starting from the last holder of the previous page" );
+   vector<account_asset_balance> paged = asset_api.list_asset_holders( core, {}, {}, 2 );
+   while( true )
+   {
+      auto page = asset_api.list_asset_holders( core, paged.back().amount, paged.back().account_id, 2 );
+      BOOST_REQUIRE( !page.empty() );
+      BOOST_CHECK( page.front().account_id == paged.back().account_id );
+      if( page.size() == 1 )
+         break;
+      paged.push_back( page.back() );
+   }
+   BOOST_REQUIRE_EQUAL( paged.size(), all.size() );
+   for( size_t i = 0; i < all.size(); ++i )
+      BOOST_CHECK( paged[i].account_id == all[i].account_id );
+
+   BOOST_TEST_MESSAGE( "Emptied balances are not counted" );
+   db.adjust_balance( dan.id, -asset(100) );
+   BOOST_CHECK_EQUAL( asset_api.get_asset_holders_count( core ), static_cast<int>( all.size() ) - 1 );
+   BOOST_CHECK_EQUAL( asset_api.get_asset_holders( core, 0, 100 ).size(), all.size() - 1 );
+   db.adjust_balance( dan.id, asset(50) );
+   BOOST_CHECK_EQUAL( asset_api.get_asset_holders_count( core ), static_cast<int>( all.size() ) );
+
+   BOOST_TEST_MESSAGE( "Starting from a balance skips larger holders" );
+   auto from_bob = asset_api.list_asset_holders( core, share_type(300), {}, 100 );
+   BOOST_REQUIRE( !from_bob.empty() );
+   BOOST_CHECK( from_bob.front().account_id == bob.id );
+
+   BOOST_TEST_MESSAGE( "A start account needs a start balance" );
+   GRAPHENE_CHECK_THROW( asset_api.list_asset_holders( core, {}, account_id_type( bob.id ), 100 ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
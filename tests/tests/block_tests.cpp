@@ -16,12 +16,19 @@
 #include <graphene/chain/hardfork.hpp>
 #include <graphene/chain/witness_schedule_object.hpp>
 #include <graphene/chain/witness_object.hpp>
+#include <graphene/chain/snapshot.hpp>
+
+#include <graphene/protocol/signature_cache.hpp>
 
 #include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
 #include <fc/io/fstream.hpp>
 
+#include <atomic>
+#include <fstream>
+#include <thread>
+
 #include "../common/database_fixture.hpp"
 
 using namespace graphene::chain;
@@ -114,6 +121,171 @@ BOOST_AUTO_TEST_CASE( block_database_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( block_database_concurrent_read_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+      bdb.set_sync_interval( 7 );
+
+      const uint32_t num_blocks = 200;
+      vector<block_id_type> ids;
+      ids.reserve( num_blocks ); // the readers index the first half while the second half is appended
+      clearable_block b;
+      for( uint32_t i = 0; i < num_blocks / 2; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+      }
+
+      // readers race with the writer appending the second half
+      std::atomic<uint32_t> failures(0);
+      std::vector<std::thread> readers;
+      for( int t = 0; t < 4; ++t )
+         readers.emplace_back( [&bdb,&ids,&failures,num_blocks]() {
+            for( uint32_t i = 1; i <= num_blocks / 2; ++i )
+            {
+               auto blk = bdb.fetch_by_number( i );
+               if( !blk.valid() || blk->witness != witness_id_type(i) )
+                  ++failures;
+               if( !bdb.contains( ids[i-1] ) || !bdb.fetch_optional( ids[i-1] ).valid() )
+                  ++failures;
+            }
+         } );
+      for( uint32_t i = num_blocks / 2; i < num_blocks; ++i )
+      {
+         b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+      }
+      for( auto& t : readers )
+         t.join();
+      BOOST_CHECK_EQUAL( failures.load(), 0u );
+
+      BOOST_CHECK( !bdb.fetch_by_number( num_blocks + 1 ).valid() );
+      BOOST_CHECK_THROW( bdb.fetch_block_id( num_blocks + 1 ), fc::key_not_found_exception );
+
+      bdb.remove( ids.back() );
+      BOOST_CHECK( !bdb.contains( ids.back() ) );
+      bdb.flush();
+      bdb.close();
+
+      bdb.open( data_dir.path() );
+      auto last = bdb.last();
+      BOOST_REQUIRE( last.valid() );
+      BOOST_CHECK( last->id() == ids[num_blocks - 2] );
+      for( uint32_t i = 1; i < num_blocks; ++i )
+         BOOST_CHECK( bdb.fetch_block_id( i ) == ids[i-1] );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_raw_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.set_cache_size( 3 );
+      bdb.open( data_dir.path() );
+
+      vector<signed_block> blocks;
+      clearable_block b;
+      for( uint32_t i = 0; i < 10; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         b.clear();
+         bdb.store( b.id(), b );
+         blocks.push_back( b );
+      }
+
+      // served from the cache and from the log alike
+      for( const auto& blk : blocks )
+      {
+         raw_block_ptr raw = bdb.fetch_raw( blk.id() );
+         BOOST_REQUIRE( raw );
+         BOOST_CHECK( *raw == fc::raw::pack( blk ) );
+         raw = bdb.fetch_raw_by_number( blk.block_num() );
+         BOOST_REQUIRE( raw );
+         BOOST_CHECK( *raw == fc::raw::pack( blk ) );
+         BOOST_CHECK( fc::raw::unpack<signed_block>( *raw ).id() == blk.id() );
+      }
+      // the same data is shared while it is cached
+      BOOST_CHECK( bdb.fetch_raw( blocks.back().id() ) == bdb.fetch_raw_by_number( blocks.back().block_num() ) );
+
+      BOOST_CHECK( !bdb.fetch_raw_by_number( 11 ) );
+      BOOST_CHECK( !bdb.fetch_raw( block_id_type() ) );
+
+      bdb.remove( blocks.back().id() );
+      BOOST_CHECK( !bdb.fetch_raw( blocks.back().id() ) );
+      BOOST_CHECK( !bdb.fetch_raw_by_number( blocks.back().block_num() ) );
+
+      bdb.set_cache_size( 0 );
+      raw_block_ptr raw = bdb.fetch_raw( blocks.front().id() );
+      BOOST_REQUIRE( raw );
+      BOOST_CHECK( *raw == fc::raw::pack( blocks.front() ) );
+      BOOST_CHECK( raw != bdb.fetch_raw( blocks.front().id() ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_replaced_and_corrupted_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      {
+         block_database bdb;
+         bdb.open( data_dir.path() );
+
+         signed_block b;
+         b.transactions.emplace_back();
+         b.transactions.back().ref_block_num = 1;
+         b.transaction_merkle_root = b.calculate_merkle_root();
+         bdb.store( b.id(), b );
+         BOOST_REQUIRE( bdb.fetch_raw( b.id() ) );
+
+         // a block of another fork under the same number is not served from the cache
+         signed_block other = b;
+         other.witness = witness_id_type(1);
+         bdb.store( other.id(), other );
+         BOOST_CHECK( !bdb.fetch_raw( b.id() ) );
+         BOOST_CHECK( !bdb.fetch_optional( b.id() ).valid() );
+         BOOST_REQUIRE( bdb.fetch_raw( other.id() ) );
+         BOOST_CHECK( *bdb.fetch_raw( other.id() ) == fc::raw::pack( other ) );
+         bdb.close();
+
+         // flip the reference block number of the transaction, which leaves the block ID alone
+         const size_t other_pos = fc::raw::pack_size( b );
+         const size_t tx_pos = other_pos + fc::raw::pack_size( static_cast<const signed_block_header&>( other ) ) + 1;
+         std::fstream blocks( ( data_dir.path() / "blocks" ).string(),
+                              std::ios::in | std::ios::out | std::ios::binary );
+         blocks.seekp( tx_pos );
+         blocks.put( 2 );
+      }
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+      BOOST_CHECK( !bdb.fetch_raw_by_number( 1 ) );
+      BOOST_CHECK( !bdb.fetch_by_number( 1 ).valid() );
+      BOOST_CHECK( bdb.contains( bdb.fetch_block_id( 1 ) ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( generate_empty_blocks )
 {
    try {
@@ -1003,6 +1175,60 @@ BOOST_FIXTURE_TEST_CASE( change_block_interval, database_fixture )
    BOOST_CHECK_EQUAL(db.head_block_time().sec_since_epoch() - past_time, 2u);
 } FC_LOG_AND_RETHROW() }
 
+BOOST_FIXTURE_TEST_CASE( binary_snapshot_restore, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      transfer( committee_account, alice_id, asset(1000) );
+      const signed_block head = generate_block();
+
+      fc::temp_directory snapshot_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory restore_dir( graphene::utilities::temp_directory_path() );
+      const auto snapshot = binary_snapshot::capture( db, head );
+      snapshot.write( snapshot_dir.path() );
+
+      // A snapshot of another chain is rejected before anything is written
+      const chain_id_type other_chain_id = fc::sha256::hash( "BOGUS" );
+      fc::temp_directory other_dir( graphene::utilities::temp_directory_path() );
+      BOOST_CHECK_THROW( binary_snapshot::read_manifest( snapshot_dir.path(), other_chain_id ), fc::exception );
+      BOOST_CHECK_THROW( binary_snapshot::restore( snapshot_dir.path(), other_dir.path(), other_chain_id ),
+                         fc::exception );
+      BOOST_CHECK( !fc::exists( other_dir.path() / "object_database" ) );
+
+      const auto manifest = binary_snapshot::restore( snapshot_dir.path(), restore_dir.path(), db.get_chain_id() );
+      BOOST_CHECK( manifest.head_block_id == head.id() );
+      BOOST_CHECK_EQUAL( manifest.chunks.size(), snapshot.manifest().chunks.size() );
+
+      database restored;
+      restored.open( restore_dir.path(), [](){ return genesis_state_type(); }, GRAPHENE_CURRENT_DB_VERSION );
+      BOOST_CHECK( restored.head_block_id() == db.head_block_id() );
+      BOOST_CHECK( restored.get_chain_id() == db.get_chain_id() );
+      BOOST_CHECK( restored.find( bob_id ) != nullptr );
+      BOOST_CHECK_EQUAL( restored.get_balance( alice_id, asset_id_type() ).amount.value, 1000 );
+      BOOST_CHECK( restored.fetch_block_by_id( head.id() ).valid() );
+
+      BOOST_TEST_MESSAGE( "The restored node has no blocks before the snapshot" );
+      BOOST_REQUIRE( restored.find_block_id_for_num( head.block_num() ).valid() );
+      BOOST_CHECK( *restored.find_block_id_for_num( head.block_num() ) == head.id() );
+      BOOST_CHECK( !restored.find_block_id_for_num( head.block_num() - 1 ).valid() );
+      BOOST_CHECK( !restored.fetch_block_by_number( head.block_num() - 1 ).valid() );
+
+      BOOST_TEST_MESSAGE( "The restored node syncs from its head block, and switches forks right after it" );
+      const signed_block own_block = restored.generate_block( restored.get_slot_time(2),
+                                                              restored.get_scheduled_witness(2),
+                                                              init_account_priv_key, database::skip_nothing );
+      generate_blocks( 5 );
+      for( uint32_t num = head.block_num() + 1; num <= db.head_block_num(); ++num )
+         PUSH_BLOCK( restored, *db.fetch_block_by_number( num ) );
+      BOOST_CHECK( restored.head_block_id() == db.head_block_id() );
+      BOOST_CHECK( *restored.find_block_id_for_num( own_block.block_num() ) != own_block.id() );
+      BOOST_CHECK_EQUAL( restored.get_balance( alice_id, asset_id_type() ).amount.value, 1000 );
+      restored.close( false );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_FIXTURE_TEST_CASE( pop_block_twice, database_fixture )
 {
    try
@@ -1328,6 +1554,87 @@ BOOST_FIXTURE_TEST_CASE( transaction_invalidated_in_cache, database_fixture )
    }
 }
 
+BOOST_FIXTURE_TEST_CASE( precheck_pending_authorities, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      // tx's created by ACTORS() have bogus authority
+      generate_block( database::skip_transaction_signatures );
+      transfer( account_id_type(), alice_id, asset( 10000 ) );
+      transfer( account_id_type(),   bob_id, asset( 10000 ) );
+      generate_block( database::skip_transaction_signatures );
+
+      const fc::ecc::private_key alice_new_key = generate_private_key( "alice_new" );
+
+      auto make_xfer = [&]( account_id_type from, account_id_type to, share_type amount,
+                            const fc::ecc::private_key& key ) -> processed_transaction
+      {
+         signed_transaction tx;
+         transfer_operation xfer_op;
+         xfer_op.from = from;
+         xfer_op.to = to;
+         xfer_op.amount = asset( amount );
+         tx.operations.push_back( xfer_op );
+         set_expiration( db, tx );
+         sign( tx, key );
+         return processed_transaction( tx );
+      };
+
+      vector<processed_transaction> pending;
+      pending.push_back( make_xfer( alice_id, bob_id, 100, alice_private_key ) );
+      {
+         signed_transaction tx;
+         account_update_operation op;
+         op.account = alice_id;
+         op.active = authority( 1, public_key_type( alice_new_key.get_public_key() ), 1 );
+         tx.operations.push_back( op );
+         set_expiration( db, tx );
+         sign( tx, alice_private_key );
+         pending.push_back( processed_transaction( tx ) );
+      }
+      pending.push_back( make_xfer( alice_id, bob_id, 200, alice_new_key ) );
+      pending.push_back( make_xfer( bob_id, alice_id, 300, bob_private_key ) );
+      pending.push_back( make_xfer( alice_id, bob_id, 400, alice_private_key ) );
+      pending.push_back( make_xfer( alice_id, bob_id, 500, bob_private_key ) );
+
+      authority_precheck checks = db.precheck_authorities( pending );
+      BOOST_REQUIRE_EQUAL( checks.results.size(), pending.size() );
+      BOOST_CHECK( checks.results[0].passed );
+      BOOST_CHECK( checks.results[0].accounts.find( alice_id ) != checks.results[0].accounts.end() );
+      BOOST_CHECK( checks.results[1].passed );
+      BOOST_CHECK( !checks.results[2].passed ); // signed with the key alice does not have yet
+      BOOST_CHECK( checks.results[3].passed );
+      BOOST_CHECK( checks.results[4].passed );
+      BOOST_CHECK( !checks.results[5].passed ); // signed by bob
+
+      BOOST_CHECK( checks.still_valid( 0 ) );
+      checks.applied( pending[0] );
+      BOOST_CHECK( checks.still_valid( 1 ) );
+      checks.applied( pending[1] );
+      // alice's authority changed, her transactions are verified again, bob's check is still fine
+      BOOST_CHECK( !checks.still_valid( 2 ) );
+      BOOST_CHECK( checks.still_valid( 3 ) );
+      BOOST_CHECK( !checks.still_valid( 4 ) );
+      BOOST_CHECK( !checks.still_valid( 5 ) );
+
+      // the same through the pending pool, the transfer signed with the old key must not get into the block
+      for( size_t i = 0; i < 4; ++i )
+         PUSH_TX( db, pending[i], database::skip_nothing );
+      GRAPHENE_REQUIRE_THROW( PUSH_TX( db, pending[4], database::skip_nothing ), fc::exception );
+      signed_block b = db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                                          database::skip_nothing );
+      BOOST_CHECK_EQUAL( b.transactions.size(), 4u );
+      BOOST_CHECK_EQUAL( get_balance( alice_id, asset_id_type() ), 10000 - 100 - 200 + 300 );
+      BOOST_CHECK_EQUAL( get_balance( bob_id, asset_id_type() ), 10000 + 100 + 200 - 300 );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( genesis_reserve_ids )
 {
    try
@@ -1853,4 +2160,60 @@ BOOST_FIXTURE_TEST_CASE( block_size_test, database_fixture )
    }
 }
 
+BOOST_FIXTURE_TEST_CASE( signature_cache_test, database_fixture )
+{
+   try
+   {
+      ACTORS((alice)(bob));
+      transfer(committee_account, alice_id, asset(10000000));
+      generate_block();
+
+      signature_cache& cache = signature_cache::instance();
+
+      signed_transaction trx;
+      transfer_operation xfer_op;
+      xfer_op.from = alice_id;
+      xfer_op.to = bob_id;
+      xfer_op.amount = asset(1000);
+      trx.operations.push_back( xfer_op );
+      set_expiration( db, trx );
+      sign( trx, alice_private_key );
+
+      BOOST_TEST_MESSAGE( "The first check of a transaction recovers its key" );
+      auto before = cache.get_stats();
+      precomputable_transaction first( trx );
+      BOOST_CHECK( first.get_signature_keys( db.get_chain_id() ) == flat_set<public_key_type>{ alice_public_key } );
+      auto after = cache.get_stats();
+      BOOST_CHECK_EQUAL( after.misses, before.misses + 1 );
+      BOOST_CHECK_EQUAL( after.hits, before.hits );
+
+      BOOST_TEST_MESSAGE( "Further checks of copies of the transaction find the key in the cache" );
+      before = after;
+      precomputable_transaction second( trx );
+      BOOST_CHECK( second.get_signature_keys( db.get_chain_id() ) == flat_set<public_key_type>{ alice_public_key } );
+      PUSH_TX( db, trx );
+      generate_block();
+      after = cache.get_stats();
+      BOOST_CHECK_EQUAL( after.misses, before.misses );
+      BOOST_CHECK_GE( after.hits, before.hits + 2 );
+
+      BOOST_TEST_MESSAGE( "A disabled cache recovers every time" );
+      cache.set_capacity( 0 );
+      before = cache.get_stats();
+      BOOST_CHECK_EQUAL( before.size, 0u );
+      precomputable_transaction third( trx );
+      BOOST_CHECK( third.get_signature_keys( db.get_chain_id() ) == flat_set<public_key_type>{ alice_public_key } );
+      after = cache.get_stats();
+      BOOST_CHECK_EQUAL( after.misses, before.misses + 1 );
+      BOOST_CHECK_EQUAL( after.size, 0u );
+      cache.set_capacity( 100000 );
+   }
+   catch( fc::exception& e )
+   {
+      signature_cache::instance().set_capacity( 100000 );
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/net/core_messages.hpp>
+
+#include <map>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+using graphene::net::compact_block_message;
+
+namespace {
+
+/// Produces a block holding a transfer to each of the given accounts
+signed_block generate_block_with_transfers( database_fixture& fixture, const account_object& from,
+                                            const fc::ecc::private_key& from_key,
+                                            const std::vector<account_id_type>& to )
+{
+   for( size_t i = 0; i < to.size(); ++i )
+   {
+      signed_transaction trx;
+      transfer_operation op;
+      op.from = from.id;
+      op.to = to[i];
+      op.amount = asset( 100 + i );
+      trx.operations.push_back( op );
+      set_expiration( fixture.db, trx );
+      fixture.sign( trx, from_key );
+      PUSH_TX( fixture.db, trx, ~0 );
+   }
+   return fixture.generate_block();
+}
+
+/// Looks transactions up by short id the way the node's message cache does
+struct transaction_lookup
+{
+   std::map<uint64_t, signed_transaction> known;
+
+   void add( const signed_transaction& trx )
+   {
+      known[graphene::net::compact_transaction_id( trx.id() )] = trx;
+   }
+
+   fc::optional<signed_transaction> operator()( uint64_t short_id )const
+   {
+      auto itr = known.find( short_id );
+      if( itr == known.end() )
+         return fc::optional<signed_transaction>();
+      return itr->second;
+   }
+};
+
+}
+
+BOOST_FIXTURE_TEST_SUITE( compact_block_tests, database_fixture )
+
+BOOST_AUTO_TEST_CASE( rebuild_from_known_transactions )
+{ try {
+   ACTORS( (nathan)(alice)(bob)(carol) );
+   fund( nathan_id(db) );
+
+   signed_block block = generate_block_with_transfers( *this, nathan_id(db), nathan_private_key,
+                                                       { alice_id, bob_id, carol_id } );
+   BOOST_REQUIRE_EQUAL( block.transactions.size(), 3u );
+
+   compact_block_message compact( block );
+   BOOST_CHECK( compact.block_id == block.id() );
+   BOOST_REQUIRE_EQUAL( compact.transactions.size(), 3u );
+
+   transaction_lookup lookup;
+   for( const processed_transaction& trx : block.transactions )
+      lookup.add( trx );
+
+   std::vector<uint32_t> missing_indexes;
+   signed_block rebuilt = graphene::net::rebuild_compact_block( compact, std::cref( lookup ), missing_indexes );
+   BOOST_CHECK( missing_indexes.empty() );
+   BOOST_CHECK( graphene::net::compact_block_transactions_to_refetch( rebuilt ).empty() );
+   BOOST_CHECK( rebuilt.id() == block.id() );
+   BOOST_CHECK( fc::raw::pack( rebuilt ) == fc::raw::pack( block ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( fetch_missing_transactions )
+{ try {
+   ACTORS( (nathan)(alice)(bob)(carol) );
+   fund( nathan_id(db) );
+
+   signed_block block = generate_block_with_transfers( *this, nathan_id(db), nathan_private_key,
+                                                       { alice_id, bob_id, carol_id } );
+   compact_block_message compact( block );
+
+   // only the middle transaction is known
+   transaction_lookup lookup;
+   lookup.add( block.transactions[1] );
+
+   std::vector<uint32_t> missing_indexes;
+   signed_block rebuilt = graphene::net::rebuild_compact_block( compact, std::cref( lookup ), missing_indexes );
+   BOOST_CHECK( missing_indexes == std::vector<uint32_t>({ 0, 2 }) );
+   BOOST_REQUIRE_EQUAL( rebuilt.transactions.size(), 3u );
+   BOOST_CHECK( rebuilt.transactions[1].id() == block.transactions[1].id() );
+
+   // a reply with the wrong number of transactions leaves the block alone
+   std::vector<processed_transaction> too_few{ block.transactions[0] };
+   BOOST_CHECK( !graphene::net::fill_compact_block( rebuilt, missing_indexes, too_few ) );
+   BOOST_CHECK( rebuilt.transactions[0].operations.empty() );
+
+   // so does a missing index beyond the end of the block
+   std::vector<processed_transaction> two{ block.transactions[0], block.transactions[2] };
+   BOOST_CHECK( !graphene::net::fill_compact_block( rebuilt, { 0, 3 }, two ) );
+   BOOST_CHECK( rebuilt.transactions[0].operations.empty() );
+
+   BOOST_REQUIRE( graphene::net::fill_compact_block( rebuilt, missing_indexes, two ) );
+   BOOST_CHECK( graphene::net::compact_block_transactions_to_refetch( rebuilt ).empty() );
+   BOOST_CHECK( rebuilt.id() == block.id() );
+   BOOST_CHECK( fc::raw::pack( rebuilt ) == fc::raw::pack( block ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( short_id_collision_fetches_all_transactions )
+{ try {
+   ACTORS( (nathan)(alice)(bob)(carol)(dan) );
+   fund( nathan_id(db) );
+
+   signed_block block = generate_block_with_transfers( *this, nathan_id(db), nathan_private_key,
+                                                       { alice_id, bob_id, carol_id } );
+   signed_block other_block = generate_block_with_transfers( *this, nathan_id(db), nathan_private_key,
+                                                             { dan_id } );
+   compact_block_message compact( block );
+
+   // the short id of the second transaction matches a different transaction we have
+   transaction_lookup lookup;
+   for( const processed_transaction& trx : block.transactions )
+      lookup.add( trx );
+   lookup.known[compact.transactions[1].short_id] = other_block.transactions[0];
+
+   std::vector<uint32_t> missing_indexes;
+   signed_block rebuilt = graphene::net::rebuild_compact_block( compact, std::cref( lookup ), missing_indexes );
+   BOOST_CHECK( missing_indexes.empty() );
+   BOOST_CHECK( rebuilt.transactions[1].id() != block.transactions[1].id() );
+
+   std::vector<uint32_t> refetch = graphene::net::compact_block_transactions_to_refetch( rebuilt );
+   BOOST_CHECK( refetch == std::vector<uint32_t>({ 0, 1, 2 }) );
+
+   // the peer sends all of them, which restores the original block
+   std::vector<processed_transaction> from_peer( block.transactions.begin(), block.transactions.end() );
+   BOOST_REQUIRE( graphene::net::fill_compact_block( rebuilt, refetch, from_peer ) );
+   BOOST_CHECK( graphene::net::compact_block_transactions_to_refetch( rebuilt ).empty() );
+   BOOST_CHECK( rebuilt.id() == block.id() );
+   BOOST_CHECK( fc::raw::pack( rebuilt ) == fc::raw::pack( block ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
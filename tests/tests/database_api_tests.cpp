@@ -13,7 +13,11 @@
 
 #include "../common/database_fixture.hpp"
 
+#include <atomic>
+#include <chrono>
+#include <future>
 #include <random>
+#include <thread>
 
 using namespace graphene::chain;
 using namespace graphene::chain::test;
@@ -61,6 +65,48 @@ BOOST_AUTO_TEST_CASE(is_registered)
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( key_and_account_references_follow_authority_changes )
+{
+   try {
+      ACTORS( (alice)(bob) );
+      public_key_type new_key = generate_private_key( "new_key" ).get_public_key();
+
+      graphene::app::application_options opt = app.get_options();
+      opt.has_api_helper_indexes_plugin = true;
+      graphene::app::database_api db_api( db, &opt );
+
+      auto key_refs = [&]( const public_key_type& key ) { return db_api.get_key_references( { key } ).front(); };
+      const flat_set<account_id_type> just_alice{ alice_id };
+
+      BOOST_TEST_MESSAGE( "Adding members to an authority adds references" );
+      db.modify( alice_id(db), [&]( account_object& a ) {
+         a.active.key_auths[new_key] = 1;
+         a.active.account_auths[bob_id] = 1;
+      });
+      BOOST_CHECK( key_refs( new_key ) == just_alice );
+      BOOST_CHECK( db_api.get_account_references( "bob" ) == vector<account_id_type>{ alice_id } );
+
+      BOOST_TEST_MESSAGE( "Modifications which leave the authorities alone keep the references" );
+      db.modify( alice_id(db), []( account_object& a ) {
+         a.options.num_witness = 1;
+      });
+      BOOST_CHECK( key_refs( new_key ) == just_alice );
+      BOOST_CHECK( key_refs( alice_public_key ) == just_alice );
+      BOOST_CHECK( db_api.get_account_references( "bob" ) == vector<account_id_type>{ alice_id } );
+
+      BOOST_TEST_MESSAGE( "Removing members removes only their references" );
+      db.modify( alice_id(db), [&]( account_object& a ) {
+         a.active.key_auths.erase( new_key );
+         a.active.account_auths.erase( bob_id );
+      });
+      BOOST_CHECK( key_refs( new_key ).empty() );
+      BOOST_CHECK( db_api.get_account_references( "bob" ).empty() );
+      BOOST_CHECK( key_refs( alice_public_key ) == just_alice );
+      BOOST_CHECK( key_refs( bob_public_key ) == flat_set<account_id_type>{ bob_id } );
+
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_CASE( get_potential_signatures_owner_and_active )
 {
    try {
@@ -1306,4 +1352,93 @@ BOOST_AUTO_TEST_CASE( verify_authority_multiple_accounts )
    }
 }
 
+BOOST_AUTO_TEST_CASE( read_view_on_reader_threads )
+{ try {
+   ACTORS( (alice) );
+   fund( alice, asset(1000) );
+   generate_block();
+
+   db.set_reader_threads( 2 );
+   graphene::app::database_api db_api( db, &( app.get_options() ) );
+
+   // queries run on the reader threads while this thread keeps producing blocks
+   for( int i = 0; i < 10; ++i )
+   {
+      const uint64_t version = db.get_state_lock().version();
+      auto accounts = db_api.get_full_accounts( { "alice" }, false );
+      BOOST_REQUIRE_EQUAL( accounts.size(), 1u );
+      BOOST_CHECK( accounts["alice"].account.id == alice_id );
+      BOOST_CHECK_EQUAL( accounts["alice"].balances.size(), 1u );
+      BOOST_CHECK_EQUAL( db_api.list_assets( "", 10 ).size(), db.get_index_type<asset_index>().indices().size() );
+
+      transfer( account_id_type(), alice_id, asset(1) );
+      generate_block();
+      BOOST_CHECK( db.get_state_lock().version() > version );
+   }
+   BOOST_CHECK_EQUAL( db_api.get_full_accounts( { "alice" }, false )["alice"].balances[0].balance.value, 1010 );
+
+   // validating a transaction applies and undoes it in a write section, unseen by readers
+   {
+      transfer_operation op;
+      op.from = alice_id;
+      op.to = account_id_type();
+      op.amount = asset(10);
+      signed_transaction tx;
+      tx.operations.push_back( op );
+      set_expiration( db, tx );
+      sign( tx, alice_private_key );
+      const uint64_t version = db.get_state_lock().version();
+      db_api.validate_transaction( tx );
+      BOOST_CHECK_EQUAL( db.get_state_lock().version(), version + 1 );
+      BOOST_CHECK_EQUAL( db_api.get_full_accounts( { "alice" }, false )["alice"].balances[0].balance.value, 1010 );
+   }
+
+   // a read view running on the writing thread does not deadlock
+   state_lock::write_guard guard( db.get_state_lock() );
+   db.set_reader_threads( 0 );
+   BOOST_CHECK_EQUAL( db_api.lookup_accounts( "alice", 1, false ).size(), 1u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( state_lock_prefers_writers )
+{ try {
+   state_lock lock;
+   std::atomic<bool> stop{ false };
+   std::atomic<uint32_t> reads{ 0 };
+
+   // staggered readers keep the read side held at all times, which would starve a writer of a read-preferring lock
+   std::vector<std::thread> readers;
+   for( int i = 0; i < 4; ++i )
+      readers.emplace_back( [&lock, &stop, &reads, i] () {
+         std::this_thread::sleep_for( std::chrono::microseconds( 250 * i ) );
+         while( !stop.load() )
+         {
+            state_lock::read_guard guard( lock );
+            ++reads;
+            std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+         }
+      } );
+   while( reads.load() < 20 )
+      std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+
+   auto writer = std::async( std::launch::async, [&lock] () {
+      state_lock::write_guard guard( lock );
+   } );
+   const bool acquired = ( writer.wait_for( std::chrono::seconds(5) ) == std::future_status::ready );
+
+   // readers get back in once the writer is done
+   const uint32_t reads_after_write = reads.load();
+   for( int i = 0; i < 5000 && reads.load() == reads_after_write; ++i )
+      std::this_thread::sleep_for( std::chrono::milliseconds(1) );
+   const bool read_again = ( reads.load() > reads_after_write );
+
+   stop = true;
+   writer.wait();
+   for( auto& reader : readers )
+      reader.join();
+
+   BOOST_CHECK( acquired );
+   BOOST_CHECK( read_again );
+   BOOST_CHECK_EQUAL( lock.version(), 1u );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
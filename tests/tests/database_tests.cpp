@@ -30,6 +30,8 @@
 #include <graphene/chain/account_object.hpp>
 #include <graphene/chain/proposal_object.hpp>
 
+#include <graphene/utilities/tempdir.hpp>
+
 #include <fc/crypto/digest.hpp>
 
 #include "../common/database_fixture.hpp"
@@ -64,6 +66,45 @@ BOOST_AUTO_TEST_CASE( undo_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( incremental_flush_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      account_balance_id_type bal_id;
+      {
+         database db;
+         db.object_database::open( data_dir.path() );
+         const auto& bal = db.create<account_balance_object>( [&]( account_balance_object& obj ){
+            obj.balance = 100;
+         });
+         bal_id = bal.id;
+         BOOST_CHECK( db.get_index<account_balance_object>().is_dirty() );
+         db.flush();
+         BOOST_CHECK( !db.get_index<account_balance_object>().is_dirty() );
+         BOOST_CHECK( !db.get_index<asset_object>().is_dirty() );
+
+         db.modify( bal, [&]( account_balance_object& obj ){
+            obj.balance = 200;
+         });
+         BOOST_CHECK( db.get_index<account_balance_object>().is_dirty() );
+         BOOST_CHECK( !db.get_index<asset_object>().is_dirty() );
+         // only the balance index is rewritten, the others are carried over
+         db.flush();
+         BOOST_CHECK( !db.get_index<account_balance_object>().is_dirty() );
+      }
+      {
+         database db;
+         db.object_database::open( data_dir.path() );
+         BOOST_CHECK_EQUAL( db.get( bal_id ).balance.value, 200 );
+         BOOST_CHECK( db.get_index<account_balance_object>().get_next_id() == object_id_type( bal_id ) + 1 );
+      }
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
 /**
  * Check that database modify() functors that throw do not get caught by boost, which will remove the object
  */
@@ -109,6 +150,55 @@ BOOST_AUTO_TEST_CASE( merge_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( packed_undo_test )
+{
+   try {
+      database db;
+      db._undo_db.set_packed_values( true );
+      const auto& bal1 = db.create<account_balance_object>( [&]( account_balance_object& obj ){
+          obj.balance = 10;
+      });
+      const auto& bal2 = db.create<account_balance_object>( [&]( account_balance_object& obj ){
+          obj.balance = 20;
+      });
+      account_balance_id_type id1 = bal1.id;
+      account_balance_id_type id2 = bal2.id;
+      db._undo_db.enable();
+
+      // modify, then undo
+      {
+         auto ses = db._undo_db.start_undo_session();
+         db.modify( bal1, [&]( account_balance_object& obj ){ obj.balance = 11; } );
+         BOOST_CHECK( db._undo_db.head().old_values.at( id1 ).packed.size() > 0 );
+         BOOST_CHECK( db._undo_db.head_stats().packed_bytes > 0 );
+      }
+      BOOST_CHECK_EQUAL( db.get( id1 ).balance.value, 10 );
+
+      // modify in one session, remove in a nested one, merge and undo: the original value comes back
+      {
+         auto outer = db._undo_db.start_undo_session();
+         db.modify( db.get( id2 ), [&]( account_balance_object& obj ){ obj.balance = 21; } );
+         {
+            auto inner = db._undo_db.start_undo_session();
+            db.modify( db.get( id1 ), [&]( account_balance_object& obj ){ obj.balance = 12; } );
+            db.remove( db.get( id2 ) );
+            inner.merge();
+         }
+         BOOST_CHECK( db.find( id2 ) == nullptr );
+         BOOST_CHECK_EQUAL( db.get( id1 ).balance.value, 12 );
+         BOOST_CHECK_EQUAL( db._undo_db.head().removed.at( id2 )->id, object_id_type( id2 ) );
+         BOOST_CHECK_EQUAL( db._undo_db.head_stats().removed, 1u );
+      }
+      BOOST_CHECK_EQUAL( db.get( id1 ).balance.value, 10 );
+      BOOST_CHECK_EQUAL( db.get( id2 ).balance.value, 20 );
+      BOOST_CHECK_EQUAL( db._undo_db.stats().states, 0u );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( direct_index_test )
 { try {
    try {
@@ -194,6 +284,58 @@ BOOST_AUTO_TEST_CASE( direct_index_test )
    // but the secondary has not updated its representation
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( flat_index_test )
+{ try {
+   graphene::db::primary_index< account_stats_index > my_stats( db );
+   BOOST_CHECK_EQUAL( 0u, my_stats.size() );
+   BOOST_CHECK( nullptr == my_stats.find( account_statistics_id_type( 1 ) ) );
+
+   account_statistics_object test_stats;
+   test_stats.id = account_statistics_id_type(1);
+   test_stats.name = "account1";
+   my_stats.load( fc::raw::pack( test_stats ) );
+
+   // an instance in a chunk far behind the first one
+   test_stats.id = account_statistics_id_type(5000);
+   test_stats.name = "account5000";
+   my_stats.load( fc::raw::pack( test_stats ) );
+   GRAPHENE_REQUIRE_THROW( my_stats.load( fc::raw::pack( test_stats ) ), fc::assert_exception );
+
+   const auto& created = my_stats.create( [] ( object& o ) {
+       account_statistics_object& stats = dynamic_cast< account_statistics_object& >( o );
+       BOOST_CHECK_EQUAL( 0u, stats.id.instance() );
+       stats.name = "account0";
+   } );
+   const object* first = my_stats.find( account_statistics_id_type(1) );
+   BOOST_REQUIRE( nullptr != first );
+   BOOST_CHECK_EQUAL( 3u, my_stats.size() );
+
+   // iteration is in id order
+   vector<uint64_t> instances;
+   for( const account_statistics_object& s : my_stats )
+      instances.push_back( s.id.instance() );
+   BOOST_CHECK( instances == vector<uint64_t>({ 0, 1, 5000 }) );
+
+   // the ordered index follows modifications
+   const auto& by_seq = my_stats.indices().get<by_maintenance_seq>();
+   BOOST_CHECK( by_seq.lower_bound( true ) == by_seq.end() );
+   my_stats.modify( *first, [] ( object& o ) {
+      dynamic_cast< account_statistics_object& >( o ).pending_fees = 10;
+   });
+   BOOST_REQUIRE( by_seq.lower_bound( true ) != by_seq.end() );
+   BOOST_CHECK_EQUAL( "account1", (*by_seq.lower_bound( true ))->name );
+
+   // addresses are stable
+   BOOST_CHECK( first == my_stats.find( account_statistics_id_type(1) ) );
+   BOOST_CHECK( &created == my_stats.find( account_statistics_id_type(0) ) );
+
+   my_stats.remove( *first );
+   BOOST_CHECK( nullptr == my_stats.find( account_statistics_id_type(1) ) );
+   BOOST_CHECK( by_seq.lower_bound( true ) == by_seq.end() );
+   BOOST_CHECK_EQUAL( 2u, my_stats.size() );
+   BOOST_CHECK_EQUAL( 2u, by_seq.size() );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( required_approval_index_test ) // see https://github.com/bitshares/bitshares-core/issues/1719
 { try {
    ACTORS( (alice)(bob)(charlie)(agnetha)(benny)(carlos) );
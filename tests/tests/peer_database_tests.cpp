@@ -0,0 +1,316 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/peer_database.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/filesystem.hpp>
+#include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+
+#include <fstream>
+
+using namespace graphene::net;
+
+namespace {
+
+/// Counts the stored and erased entries of a peer database file after checking its header
+std::pair<size_t, size_t> count_peer_database_entries( const fc::path& filename )
+{
+   std::string contents;
+   fc::read_file_contents( filename, contents );
+   fc::datastream<const char*> ds( contents.data(), contents.size() );
+   uint32_t magic = 0;
+   uint32_t format_version = 0;
+   fc::raw::unpack( ds, magic );
+   fc::raw::unpack( ds, format_version );
+   BOOST_CHECK_EQUAL( magic, 0x42445047u ); // "GPDB"
+   BOOST_CHECK_EQUAL( format_version, 1u );
+
+   std::pair<size_t, size_t> stored_and_erased;
+   while( ds.remaining() > 0 )
+   {
+      uint8_t type = 0;
+      uint32_t size = 0;
+      fc::raw::unpack( ds, type );
+      fc::raw::unpack( ds, size );
+      BOOST_REQUIRE_LE( size, ds.remaining() );
+      ds.skip( size );
+      if( type == 0 )
+         ++stored_and_erased.first;
+      else
+      {
+         BOOST_CHECK_EQUAL( type, 1 );
+         ++stored_and_erased.second;
+      }
+   }
+   return stored_and_erased;
+}
+
+potential_peer_record make_peer_record( const std::string& endpoint, uint32_t seconds_seen )
+{
+   potential_peer_record record( fc::ip::endpoint::from_string( endpoint ), fc::time_point_sec( seconds_seen ),
+                                 last_connection_succeeded );
+   record.number_of_successful_connection_attempts = 1;
+   return record;
+}
+
+std::vector<fc::ip::endpoint> endpoints_in_order( const peer_database& db )
+{
+   std::vector<fc::ip::endpoint> endpoints;
+   for( const potential_peer_record& record : db )
+      endpoints.push_back( record.endpoint );
+   return endpoints;
+}
+
+}
+
+BOOST_AUTO_TEST_SUITE( peer_database_tests )
+
+BOOST_AUTO_TEST_CASE( journal_round_trip )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path filename = data_dir.path() / "peers.dat";
+   const fc::path copy_filename = data_dir.path() / "peers_copy.dat";
+
+   peer_database db;
+   db.open( filename );
+   BOOST_CHECK( fc::exists( filename ) );
+   BOOST_CHECK( !fc::exists( filename.generic_string() + ".tmp" ) );
+   BOOST_CHECK( count_peer_database_entries( filename ) == std::make_pair( size_t(0), size_t(0) ) );
+
+   potential_peer_record updated = make_peer_record( "10.0.0.1:1776", 100 );
+   db.update_entry( updated );
+   db.update_entry( make_peer_record( "10.0.0.2:1776", 200 ) );
+   db.update_entry( make_peer_record( "10.0.0.3:1776", 300 ) );
+   updated.number_of_failed_connection_attempts = 3;
+   updated.latency = fc::milliseconds( 80 );
+   db.update_entry( updated );
+   db.erase( fc::ip::endpoint::from_string( "10.0.0.2:1776" ) );
+   // erasing an unknown peer writes nothing
+   db.erase( fc::ip::endpoint::from_string( "10.0.0.9:1776" ) );
+   BOOST_CHECK_EQUAL( db.size(), 2u );
+
+   // every change was appended to the file
+   BOOST_CHECK( count_peer_database_entries( filename ) == std::make_pair( size_t(4), size_t(1) ) );
+
+   // replaying the journal restores the records
+   fc::copy( filename, copy_filename );
+   {
+      peer_database copy;
+      copy.open( copy_filename );
+      BOOST_CHECK_EQUAL( copy.size(), 2u );
+      BOOST_CHECK( !copy.lookup_entry_for_endpoint( fc::ip::endpoint::from_string( "10.0.0.2:1776" ) ) );
+      fc::optional<potential_peer_record> loaded
+            = copy.lookup_entry_for_endpoint( fc::ip::endpoint::from_string( "10.0.0.1:1776" ) );
+      BOOST_REQUIRE( loaded );
+      BOOST_CHECK_EQUAL( loaded->number_of_failed_connection_attempts, 3u );
+      BOOST_CHECK( loaded->latency == fc::milliseconds( 80 ) );
+      BOOST_CHECK_EQUAL( loaded->score, detail::calculate_peer_score( updated ) );
+      BOOST_CHECK( endpoints_in_order( copy ) == endpoints_in_order( db ) );
+      // opening compacted the file to one entry per record, through a temporary file
+      BOOST_CHECK( count_peer_database_entries( copy_filename ) == std::make_pair( size_t(2), size_t(0) ) );
+      BOOST_CHECK( !fc::exists( copy_filename.generic_string() + ".tmp" ) );
+   }
+
+   // closing compacts the file too
+   db.close();
+   BOOST_CHECK_EQUAL( db.size(), 0u );
+   BOOST_CHECK( count_peer_database_entries( filename ) == std::make_pair( size_t(2), size_t(0) ) );
+   BOOST_CHECK( !fc::exists( filename.generic_string() + ".tmp" ) );
+
+   db.open( filename );
+   BOOST_CHECK_EQUAL( db.size(), 2u );
+   db.clear();
+   BOOST_CHECK_EQUAL( db.size(), 0u );
+   BOOST_CHECK( count_peer_database_entries( filename ) == std::make_pair( size_t(0), size_t(0) ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( truncated_tail_recovery )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path filename = data_dir.path() / "peers.dat";
+   const fc::path truncated_filename = data_dir.path() / "peers_truncated.dat";
+
+   peer_database db;
+   db.open( filename );
+   db.update_entry( make_peer_record( "10.0.0.1:1776", 100 ) );
+   db.update_entry( make_peer_record( "10.0.0.2:1776", 200 ) );
+   db.erase( fc::ip::endpoint::from_string( "10.0.0.1:1776" ) );
+   db.update_entry( make_peer_record( "10.0.0.3:1776", 300 ) );
+
+   std::string contents;
+   fc::read_file_contents( filename, contents );
+
+   // the node stopped while writing the last record
+   {
+      std::ofstream truncated( truncated_filename.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc );
+      truncated.write( contents.data(), contents.size() - 5 );
+   }
+   {
+      peer_database recovered;
+      recovered.open( truncated_filename );
+      BOOST_CHECK_EQUAL( recovered.size(), 1u );
+      BOOST_CHECK( !recovered.lookup_entry_for_endpoint( fc::ip::endpoint::from_string( "10.0.0.1:1776" ) ) );
+      BOOST_CHECK( recovered.lookup_entry_for_endpoint( fc::ip::endpoint::from_string( "10.0.0.2:1776" ) ) );
+      BOOST_CHECK( !recovered.lookup_entry_for_endpoint( fc::ip::endpoint::from_string( "10.0.0.3:1776" ) ) );
+      // the cut entry is gone from the rewritten file, new entries are readable again
+      BOOST_CHECK( count_peer_database_entries( truncated_filename ) == std::make_pair( size_t(1), size_t(0) ) );
+      recovered.update_entry( make_peer_record( "10.0.0.4:1776", 400 ) );
+   }
+   {
+      peer_database reopened;
+      reopened.open( truncated_filename );
+      BOOST_CHECK_EQUAL( reopened.size(), 2u );
+      BOOST_CHECK( reopened.lookup_entry_for_endpoint( fc::ip::endpoint::from_string( "10.0.0.4:1776" ) ) );
+   }
+
+   // even an entry header cut short is dropped
+   {
+      std::ofstream truncated( truncated_filename.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc );
+      // the header, the first stored record and two bytes of the next entry's header
+      const size_t first_entry_size = 8 + 1 + 4 + fc::raw::pack( make_peer_record( "10.0.0.1:1776", 100 ) ).size();
+      BOOST_REQUIRE_LT( first_entry_size + 2, contents.size() );
+      truncated.write( contents.data(), first_entry_size + 2 );
+   }
+   {
+      peer_database recovered;
+      recovered.open( truncated_filename );
+      BOOST_CHECK_EQUAL( recovered.size(), 1u );
+      BOOST_CHECK( recovered.lookup_entry_for_endpoint( fc::ip::endpoint::from_string( "10.0.0.1:1776" ) ) );
+   }
+
+   // a file which isn't a peer database is replaced by an empty one
+   {
+      std::ofstream garbage( truncated_filename.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc );
+      garbage << "[{\"endpoint\":\"10.0.0.1:1776\"}]";
+   }
+   {
+      peer_database recovered;
+      recovered.open( truncated_filename );
+      BOOST_CHECK_EQUAL( recovered.size(), 0u );
+      BOOST_CHECK( count_peer_database_entries( truncated_filename ) == std::make_pair( size_t(0), size_t(0) ) );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( legacy_json_import )
+{ try {
+   fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+   const fc::path filename = data_dir.path() / "peers.dat";
+   const fc::path json_filename = data_dir.path() / "peers.json";
+
+   std::vector<potential_peer_record> legacy_records;
+   legacy_records.push_back( make_peer_record( "10.0.0.1:1776", 100 ) );
+   legacy_records.push_back( make_peer_record( "10.0.0.2:1776", 200 ) );
+   legacy_records.back().number_of_failed_connection_attempts = 5;
+   fc::json::save_to_file( legacy_records, json_filename );
+
+   peer_database db;
+   db.open( filename );
+   db.import_json( json_filename );
+   BOOST_CHECK_EQUAL( db.size(), 2u );
+   fc::optional<potential_peer_record> imported
+         = db.lookup_entry_for_endpoint( fc::ip::endpoint::from_string( "10.0.0.2:1776" ) );
+   BOOST_REQUIRE( imported );
+   BOOST_CHECK_EQUAL( imported->number_of_failed_connection_attempts, 5u );
+   BOOST_CHECK_EQUAL( imported->score, detail::calculate_peer_score( legacy_records.back() ) );
+   BOOST_CHECK( count_peer_database_entries( filename ) == std::make_pair( size_t(2), size_t(0) ) );
+   db.close();
+
+   db.open( filename );
+   BOOST_CHECK_EQUAL( db.size(), 2u );
+   BOOST_CHECK( db.lookup_entry_for_endpoint( fc::ip::endpoint::from_string( "10.0.0.1:1776" ) ) );
+
+   // a missing or unreadable file changes nothing
+   db.import_json( data_dir.path() / "missing.json" );
+   {
+      std::ofstream garbage( json_filename.generic_string(), std::ios::out | std::ios::trunc );
+      garbage << "not json";
+   }
+   db.import_json( json_filename );
+   BOOST_CHECK_EQUAL( db.size(), 2u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE( peers_ordered_by_score )
+{ try {
+   const potential_peer_record unknown( fc::ip::endpoint::from_string( "10.0.0.1:1776" ) );
+
+   potential_peer_record reliable = unknown;
+   reliable.number_of_successful_connection_attempts = 10;
+   potential_peer_record unreliable = unknown;
+   unreliable.number_of_failed_connection_attempts = 10;
+   BOOST_CHECK_GT( detail::calculate_peer_score( reliable ), detail::calculate_peer_score( unknown ) );
+   BOOST_CHECK_LT( detail::calculate_peer_score( unreliable ), detail::calculate_peer_score( unknown ) );
+
+   potential_peer_record close_by = unknown;
+   close_by.latency = fc::milliseconds( 20 );
+   potential_peer_record far_away = unknown;
+   far_away.latency = fc::milliseconds( 1000 );
+   BOOST_CHECK_GT( detail::calculate_peer_score( close_by ), detail::calculate_peer_score( unknown ) );
+   BOOST_CHECK_LT( detail::calculate_peer_score( far_away ), detail::calculate_peer_score( unknown ) );
+
+   potential_peer_record fast = unknown;
+   fast.sync_blocks_per_second = 500;
+   potential_peer_record faster = unknown;
+   faster.sync_blocks_per_second = 5000;
+   BOOST_CHECK_GT( detail::calculate_peer_score( fast ), detail::calculate_peer_score( unknown ) );
+   // the throughput bonus is capped
+   BOOST_CHECK_EQUAL( detail::calculate_peer_score( faster ), detail::calculate_peer_score( fast ) );
+
+   potential_peer_record reachable = unknown;
+   reachable.firewalled = firewalled_state::not_firewalled;
+   potential_peer_record firewalled = unknown;
+   firewalled.firewalled = firewalled_state::firewalled;
+   BOOST_CHECK_GT( detail::calculate_peer_score( reachable ), detail::calculate_peer_score( unknown ) );
+   BOOST_CHECK_LT( detail::calculate_peer_score( firewalled ), detail::calculate_peer_score( unknown ) );
+
+   // the database iterates from the best peer down, the most recently seen first among equals
+   peer_database db;
+   potential_peer_record best = make_peer_record( "10.0.0.1:1776", 100 );
+   best.latency = fc::milliseconds( 20 );
+   best.firewalled = firewalled_state::not_firewalled;
+   potential_peer_record seen_earlier = make_peer_record( "10.0.0.2:1776", 100 );
+   potential_peer_record seen_later = make_peer_record( "10.0.0.3:1776", 200 );
+   potential_peer_record worst = make_peer_record( "10.0.0.4:1776", 300 );
+   worst.number_of_failed_connection_attempts = 20;
+   db.update_entry( worst );
+   db.update_entry( seen_earlier );
+   db.update_entry( best );
+   db.update_entry( seen_later );
+   BOOST_CHECK( endpoints_in_order( db ) == std::vector<fc::ip::endpoint>( { best.endpoint, seen_later.endpoint,
+                                                                             seen_earlier.endpoint, worst.endpoint } ) );
+
+   // an update moves the peer to its new place
+   worst.number_of_failed_connection_attempts = 0;
+   worst.number_of_successful_connection_attempts = 20;
+   worst.latency = fc::milliseconds( 10 );
+   worst.firewalled = firewalled_state::not_firewalled;
+   db.update_entry( worst );
+   BOOST_CHECK( endpoints_in_order( db ).front() == worst.endpoint );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
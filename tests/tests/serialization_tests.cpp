@@ -74,6 +74,33 @@ BOOST_AUTO_TEST_CASE( serialization_json_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( precomputed_digests_test )
+{
+   try {
+      make_account();
+      transfer_operation op;
+      op.from = account_id_type(1);
+      op.to = account_id_type(2);
+      op.amount = asset(100);
+      trx.operations.push_back( op );
+      set_expiration( db, trx );
+      sign( trx, init_account_priv_key );
+
+      // The digests of a precomputable transaction come from its packed bytes, they must match packing it again
+      processed_transaction ptx( trx );
+      ptx.operation_results.push_back( void_result() );
+      BOOST_CHECK( ptx.id() == trx.id() );
+      BOOST_CHECK_EQUAL( ptx.get_packed_size(), fc::raw::pack_size( static_cast<const transaction&>( trx ) ) );
+      auto packed = fc::raw::pack( ptx );
+      BOOST_CHECK( ptx.merkle_digest() == digest_type::hash( packed.data(), packed.size() ) );
+      BOOST_CHECK( ptx.get_signature_keys( db.get_chain_id() )
+                   == flat_set<public_key_type>{ init_account_priv_key.get_public_key() } );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( json_tests )
 {
    try {
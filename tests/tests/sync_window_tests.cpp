@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/net/config.hpp>
+#include <graphene/net/node.hpp>
+
+using graphene::net::adapt_sync_window;
+
+BOOST_AUTO_TEST_SUITE( sync_window_tests )
+
+BOOST_AUTO_TEST_CASE( window_follows_peer_throughput )
+{
+   const size_t min_window = GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING;
+   const size_t max_window = 1000;
+   const fc::microseconds target = fc::seconds( GRAPHENE_NET_SYNC_WINDOW_TARGET_SECONDS );
+
+   // a peer delivering 200 blocks per target period moves the window halfway from 100 towards 200
+   BOOST_CHECK_EQUAL( adapt_sync_window( 100, 200, target, max_window ), 150u );
+   // and halfway down again when it slows to 50
+   BOOST_CHECK_EQUAL( adapt_sync_window( 150, 50, target, max_window ), 100u );
+
+   // repeated measurements converge on the peer's rate
+   size_t window = min_window;
+   for( int i = 0; i < 20; ++i )
+      window = adapt_sync_window( window, 400, target, max_window );
+   BOOST_CHECK_EQUAL( window, 400u );
+
+   // nothing measured yet leaves the window alone
+   BOOST_CHECK_EQUAL( adapt_sync_window( 123, 10, fc::microseconds(), max_window ), 123u );
+}
+
+BOOST_AUTO_TEST_CASE( window_stays_within_bounds )
+{
+   const size_t min_window = GRAPHENE_NET_MIN_BLOCKS_PER_PEER_DURING_SYNCING;
+   const fc::microseconds target = fc::seconds( GRAPHENE_NET_SYNC_WINDOW_TARGET_SECONDS );
+
+   // a stalled peer's window shrinks to the minimum but not below it
+   size_t window = 500;
+   for( int i = 0; i < 20; ++i )
+      window = adapt_sync_window( window, 1, fc::seconds( 60 ), 1000 );
+   BOOST_CHECK_LE( window, min_window + 1 );
+   BOOST_CHECK_EQUAL( adapt_sync_window( min_window, 1, fc::seconds( 60 ), 1000 ), min_window );
+
+   // a fast peer is capped at the maximum
+   window = min_window;
+   for( int i = 0; i < 20; ++i )
+      window = adapt_sync_window( window, 100000, target, 1000 );
+   BOOST_CHECK_EQUAL( window, 1000u );
+
+   // lowering the maximum below the current window takes effect at once
+   BOOST_CHECK_EQUAL( adapt_sync_window( 1000, 100000, target, 200 ), 200u );
+
+   // a maximum below the minimum is raised to it
+   BOOST_CHECK_EQUAL( adapt_sync_window( min_window, 100000, target, 1 ), min_window );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,695 @@
+/*
+ * Copyright (c) 2020-2023 Revolution Populi Limited, and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "../common/database_fixture.hpp"
+
+#include <graphene/app/database_api.hpp>
+#include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/global_property_object.hpp>
+#include <graphene/chain/tnt/object.hpp>
+#include <graphene/chain/tnt/tap_open_helper.hpp>
+
+#include <graphene/protocol/tnt/validation.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+using namespace graphene::chain;
+using namespace graphene::chain::test;
+
+namespace {
+// Unqualified, tnt would be ambiguous here between the chain and protocol namespaces
+namespace tnt = graphene::chain::tnt;
+
+struct tnt_fixture : database_fixture {
+   tnt_fixture() {
+      generate_blocks(HARDFORK_BSIP_72_TIME);
+      generate_block();
+      db.modify(db.get_global_properties(), [](global_property_object& gpo) {
+         gpo.parameters.extensions.value.updatable_tnt_options = ptnt::parameters_type();
+      });
+   }
+
+   processed_transaction push_operation(operation op) {
+      signed_transaction tx;
+      tx.operations.emplace_back(std::move(op));
+      set_expiration(db, tx);
+      return PUSH_TX(db, tx, ~0);
+   }
+
+   /// Make a tank_create_operation for a tank with only an emergency tap, which the owner opens and connects, and
+   /// which releases to the owner
+   tank_create_operation make_tank(account_id_type owner, asset_id_type asset_type = {}) {
+      tank_create_operation op;
+      op.payer = owner;
+      op.contained_asset = asset_type;
+      op.authorized_sources = ptnt::all_sources();
+      ptnt::tap emergency_tap;
+      emergency_tap.connected_connection = ptnt::connection(owner);
+      emergency_tap.open_authority = authority(1, owner, 1);
+      emergency_tap.connect_authority = authority(1, owner, 1);
+      emergency_tap.destructor_tap = true;
+      op.taps.emplace_back(std::move(emergency_tap));
+      return op;
+   }
+
+   /// Make a tap anyone can open, releasing to the supplied connection
+   static ptnt::tap make_tap(ptnt::connection destination) {
+      ptnt::tap tap;
+      tap.connected_connection = std::move(destination);
+      tap.destructor_tap = false;
+      return tap;
+   }
+
+   tank_id_type create_tank(tank_create_operation op) {
+      op.fee = asset(1);
+      op.deposit_amount =
+            ptnt::tank_validator::calculate_deposit(ptnt::tank_schematic::from_create_operation(op), db);
+      return tank_id_type(push_operation(std::move(op)).operation_results[0].get<object_id_type>());
+   }
+
+   /// Update a tank, paying or claiming whatever deposit change the update calls for
+   void update_tank(tank_update_operation op) {
+      const tank_object& tank = op.tank_to_update(db);
+      ptnt::tank_schematic updated = tank.schematic;
+      updated.update_from_operation(op);
+      op.fee = asset(1);
+      op.update_authority = *tank.schematic.taps.at(0).open_authority;
+      op.deposit_delta = tank.deposit - ptnt::tank_validator::calculate_deposit(updated, db);
+      push_operation(std::move(op));
+   }
+
+   void delete_tank(account_id_type payer, tank_id_type tank_id) {
+      const tank_object& tank = tank_id(db);
+      tank_delete_operation op;
+      op.fee = asset(1);
+      op.payer = payer;
+      op.delete_authority = *tank.schematic.taps.at(0).open_authority;
+      op.tank_to_delete = tank_id;
+      op.deposit_claimed = tank.deposit;
+      push_operation(std::move(op));
+   }
+
+   void fund_tank(account_id_type funder, tank_id_type tank, asset amount) {
+      account_fund_connection_operation op;
+      op.fee = asset(1);
+      op.funding_account = funder;
+      op.funding_destination = tank;
+      op.funding_amount = amount;
+      push_operation(std::move(op));
+   }
+
+   /// Make a tap anyone can open, releasing to the recipient at most 100 per period
+   static ptnt::tap make_periodic_limit_tap(account_id_type recipient, uint32_t period_sec) {
+      ptnt::tap tap = make_tap(recipient);
+      tap.requirements.emplace_back(ptnt::periodic_flow_limit(100, period_sec));
+      return tap;
+   }
+
+   void open_tap(account_id_type payer, ptnt::tap_id_type tap, ptnt::asset_flow_limit amount) {
+      tap_open_operation op;
+      op.fee = asset(1);
+      op.payer = payer;
+      op.tap_to_open = tap;
+      op.release_amount = amount;
+      tnt::set_tap_open_count_and_authorities(db, op);
+      push_operation(std::move(op));
+   }
+
+   /// Evaluate a tap flow without applying it, returning the reported flows and the deposit path of each account
+   /// paid
+   vector<tnt::tap_flow> evaluate_tap(account_id_type payer, ptnt::tap_id_type tap, share_type amount,
+                                      map<account_id_type, vector<ptnt::connection>>& deposit_paths) {
+      cow_db_wrapper wrapper(db);
+      tnt::query_evaluator queries;
+      queries.set_query_tank((*tap.tank_id)(db));
+      return tnt::evaluate_tap_flow(wrapper, queries, payer, tap, amount, 10,
+                                    [&deposit_paths](account_id_type account, asset, vector<ptnt::connection> path) {
+         deposit_paths[account] = std::move(path);
+      });
+   }
+};
+
+vector<tank_id_type> tank_ids(const vector<tank_object>& tanks) {
+   vector<tank_id_type> ids;
+   for (const auto& tank : tanks)
+      ids.push_back(tank.get_id());
+   return ids;
+}
+
+// Connections cannot be compared for equality (same_tank has no equality operator), so compare their JSON
+string to_json(const vector<ptnt::connection>& path) {
+   return fc::json::to_string(path);
+}
+
+} // namespace
+
+BOOST_FIXTURE_TEST_SUITE( tnt_tests, tnt_fixture )
+
+/// Before HARDFORK_TNT_FLOW_FIX_TIME, taps released the core asset whatever their tank held; after it, they release
+/// the tank's asset
+BOOST_AUTO_TEST_CASE( non_core_tank_pays_account )
+{ try {
+   ACTORS((alice)(bob));
+   fund(alice, asset(1000 * GRAPHENE_BLOCKCHAIN_PRECISION));
+   const asset_id_type usd_id = create_user_issued_asset("TNTUSD", alice, 0).id;
+   issue_uia(alice, asset(1000, usd_id));
+
+   auto create_op = make_tank(alice_id, usd_id);
+   create_op.taps.emplace_back(make_tap(bob_id));
+   tank_id_type tank_id = create_tank(create_op);
+   fund_tank(alice_id, tank_id, asset(100, usd_id));
+   BOOST_CHECK_EQUAL(tank_id(db).balance.value, 100);
+
+   BOOST_TEST_MESSAGE("Opening the tap before the hardfork pays the core asset");
+   open_tap(alice_id, ptnt::tap_id_type{tank_id, 1}, share_type(10));
+   BOOST_CHECK_EQUAL(tank_id(db).balance.value, 90);
+   BOOST_CHECK_EQUAL(get_balance(bob_id, asset_id_type()), 10);
+   BOOST_CHECK_EQUAL(get_balance(bob_id, usd_id), 0);
+   generate_block();
+
+   generate_blocks(HARDFORK_TNT_FLOW_FIX_TIME);
+
+   BOOST_TEST_MESSAGE("Opening the tap after the hardfork pays the tank's asset");
+   open_tap(alice_id, ptnt::tap_id_type{tank_id, 1}, share_type(10));
+   BOOST_CHECK_EQUAL(tank_id(db).balance.value, 80);
+   BOOST_CHECK_EQUAL(get_balance(bob_id, asset_id_type()), 10);
+   BOOST_CHECK_EQUAL(get_balance(bob_id, usd_id), 10);
+} FC_LOG_AND_RETHROW() }
+
+/// Before HARDFORK_TNT_FLOW_FIX_TIME, a flow reaching a tank through an attachment was not checked against the
+/// destination tank's remote sources; after it, the destination must authorize the attachment
+BOOST_AUTO_TEST_CASE( tank_to_tank_remote_sources )
+{ try {
+   ACTORS((alice));
+   fund(alice, asset(1000 * GRAPHENE_BLOCKCHAIN_PRECISION));
+
+   // Tank B accepts deposits from no remote sources
+   auto create_op = make_tank(alice_id);
+   create_op.authorized_sources = flat_set<ptnt::remote_connection>();
+   tank_id_type b_id = create_tank(create_op);
+
+   // Tank A releases to tank B through a flow meter on tap 1, and directly on tap 2
+   create_op = make_tank(alice_id);
+   create_op.taps.emplace_back(make_tap(ptnt::attachment_id_type{{}, 0}));
+   create_op.taps.emplace_back(make_tap(b_id));
+   create_op.attachments.emplace_back(ptnt::asset_flow_meter(asset_id_type(), b_id));
+   tank_id_type a_id = create_tank(create_op);
+   fund_tank(alice_id, a_id, asset(100));
+
+   BOOST_TEST_MESSAGE("Before the hardfork, only the direct flow is checked against tank B's sources");
+   GRAPHENE_REQUIRE_THROW(open_tap(alice_id, ptnt::tap_id_type{a_id, 2}, share_type(10)), fc::exception);
+   open_tap(alice_id, ptnt::tap_id_type{a_id, 1}, share_type(10));
+   BOOST_CHECK_EQUAL(a_id(db).balance.value, 90);
+   BOOST_CHECK_EQUAL(b_id(db).balance.value, 10);
+   generate_block();
+
+   generate_blocks(HARDFORK_TNT_FLOW_FIX_TIME);
+
+   BOOST_TEST_MESSAGE("After the hardfork, tank B must authorize the flow meter");
+   GRAPHENE_REQUIRE_THROW(open_tap(alice_id, ptnt::tap_id_type{a_id, 1}, share_type(10)), fc::exception);
+   GRAPHENE_REQUIRE_THROW(open_tap(alice_id, ptnt::tap_id_type{a_id, 2}, share_type(10)), fc::exception);
+
+   tank_update_operation update_op;
+   update_op.payer = alice_id;
+   update_op.tank_to_update = b_id;
+   update_op.new_authorized_sources =
+         flat_set<ptnt::remote_connection>{ptnt::attachment_id_type{a_id, 0}};
+   update_tank(update_op);
+
+   open_tap(alice_id, ptnt::tap_id_type{a_id, 1}, share_type(10));
+   BOOST_CHECK_EQUAL(a_id(db).balance.value, 80);
+   BOOST_CHECK_EQUAL(b_id(db).balance.value, 20);
+   // Authorizing the meter does not authorize the tank it is on
+   GRAPHENE_REQUIRE_THROW(open_tap(alice_id, ptnt::tap_id_type{a_id, 2}, share_type(10)), fc::exception);
+} FC_LOG_AND_RETHROW() }
+
+/// Before HARDFORK_TNT_FLOW_FIX_TIME, flows were reported as released by the tap the operation opened, along the
+/// connections the attachments released to, and accounts were paid along a path padded with default connections
+BOOST_AUTO_TEST_CASE( reported_tap_flows )
+{ try {
+   ACTORS((alice)(bob));
+   fund(alice, asset(1000 * GRAPHENE_BLOCKCHAIN_PRECISION));
+
+   // Tap 1 releases through a flow meter to alice; tap 2 releases through a tap opener, which opens tap 1, to bob
+   auto create_op = make_tank(alice_id);
+   create_op.taps.emplace_back(make_tap(ptnt::attachment_id_type{{}, 0}));
+   create_op.taps.emplace_back(make_tap(ptnt::attachment_id_type{{}, 1}));
+   create_op.attachments.emplace_back(ptnt::asset_flow_meter(asset_id_type(), alice_id));
+   create_op.attachments.emplace_back(ptnt::tap_opener(1, share_type(5), bob_id, asset_id_type()));
+   tank_id_type tank_id = create_tank(create_op);
+   fund_tank(alice_id, tank_id, asset(100));
+   const ptnt::tap_id_type tap_1{tank_id, 1};
+   const ptnt::tap_id_type tap_2{tank_id, 2};
+
+   BOOST_TEST_MESSAGE("Checking the flows reported before the hardfork");
+   map<account_id_type, vector<ptnt::connection>> deposit_paths;
+   auto flows = evaluate_tap(alice_id, tap_2, share_type(20), deposit_paths);
+   BOOST_REQUIRE_EQUAL(flows.size(), 2u);
+   BOOST_CHECK(flows[0].amount_released == asset(20));
+   BOOST_CHECK(flows[0].source_tap == tap_2);
+   BOOST_CHECK_EQUAL(to_json(flows[0].connection_path), to_json({bob_id, bob_id}));
+   BOOST_CHECK(flows[1].amount_released == asset(5));
+   BOOST_CHECK(flows[1].source_tap == tap_2);
+   BOOST_CHECK_EQUAL(to_json(flows[1].connection_path), to_json({alice_id, alice_id}));
+   BOOST_CHECK_EQUAL(to_json(deposit_paths[bob_id]),
+                     to_json({ptnt::same_tank(), ptnt::same_tank(), ptnt::same_tank(), tank_id, bob_id, bob_id}));
+   BOOST_CHECK_EQUAL(to_json(deposit_paths[alice_id]),
+                     to_json({ptnt::same_tank(), ptnt::same_tank(), ptnt::same_tank(), tank_id, alice_id,
+                              alice_id}));
+
+   generate_blocks(HARDFORK_TNT_FLOW_FIX_TIME);
+
+   BOOST_TEST_MESSAGE("Checking the flows reported after the hardfork");
+   deposit_paths.clear();
+   flows = evaluate_tap(alice_id, tap_2, share_type(20), deposit_paths);
+   BOOST_REQUIRE_EQUAL(flows.size(), 2u);
+   BOOST_CHECK(flows[0].amount_released == asset(20));
+   BOOST_CHECK(flows[0].source_tap == tap_2);
+   BOOST_CHECK_EQUAL(to_json(flows[0].connection_path), to_json({ptnt::attachment_id_type{tank_id, 1}, bob_id}));
+   BOOST_CHECK(flows[1].amount_released == asset(5));
+   BOOST_CHECK(flows[1].source_tap == tap_1);
+   BOOST_CHECK_EQUAL(to_json(flows[1].connection_path),
+                     to_json({ptnt::attachment_id_type{tank_id, 0}, alice_id}));
+   BOOST_CHECK_EQUAL(to_json(deposit_paths[bob_id]),
+                     to_json({tank_id, ptnt::attachment_id_type{tank_id, 1}, bob_id}));
+   BOOST_CHECK_EQUAL(to_json(deposit_paths[alice_id]),
+                     to_json({tank_id, ptnt::attachment_id_type{tank_id, 0}, alice_id}));
+
+   BOOST_TEST_MESSAGE("Checking the flows are applied by tap_open");
+   open_tap(alice_id, tap_2, share_type(20));
+   BOOST_CHECK_EQUAL(tank_id(db).balance.value, 75);
+   const auto* meter_state =
+         tank_id(db).get_state(ptnt::tank_accessory_address<ptnt::asset_flow_meter>{0});
+   BOOST_REQUIRE(meter_state != nullptr);
+   BOOST_CHECK_EQUAL(meter_state->metered_amount.value, 5);
+} FC_LOG_AND_RETHROW() }
+
+/// Reading the whole object from a copy-on-write wrapper after writing some of its fields shows the writes, and
+/// leaves the references to the written fields valid
+BOOST_AUTO_TEST_CASE( cow_db_wrapper_const_view )
+{ try {
+   ACTORS((alice));
+   fund(alice, asset(1000 * GRAPHENE_BLOCKCHAIN_PRECISION));
+   auto create_op = make_tank(alice_id);
+   create_op.attachments.emplace_back(ptnt::asset_flow_meter(asset_id_type(), alice_id));
+   tank_id_type tank_id = create_tank(create_op);
+   fund_tank(alice_id, tank_id, asset(100));
+   const ptnt::tank_accessory_address<ptnt::asset_flow_meter> meter_address{0};
+
+   cow_db_wrapper wrapper(db);
+   auto tank = wrapper.get(tank_id);
+   const auto& const_tank = tank;
+
+   // Nothing written yet: the view is the database object
+   const tank_object& original_view = const_tank;
+   BOOST_CHECK(&original_view == &tank_id(db));
+
+   share_type& balance = tank.balance.set();
+   auto& states = tank.accessory_states.set();
+   balance += 10;
+   tank_object::get_or_create_state(states, meter_address).metered_amount = 7;
+
+   const tank_object& view = const_tank;
+   BOOST_CHECK(&view != &tank_id(db));
+   BOOST_CHECK_EQUAL(view.balance.value, 110);
+   BOOST_REQUIRE(view.get_state(meter_address) != nullptr);
+   BOOST_CHECK_EQUAL(view.get_state(meter_address)->metered_amount.value, 7);
+   BOOST_CHECK(view.schematic.attachments.size() == 1);
+
+   // The field references are still valid, and a new view shows the writes made through them
+   balance += 5;
+   tank_object::get_or_create_state(states, meter_address).metered_amount += 1;
+   BOOST_CHECK_EQUAL(tank.balance().value, 115);
+   const tank_object& second_view = const_tank;
+   BOOST_CHECK_EQUAL(second_view.balance.value, 115);
+   BOOST_CHECK_EQUAL(second_view.get_state(meter_address)->metered_amount.value, 8);
+
+   // The database is not written until the commit
+   BOOST_CHECK_EQUAL(tank_id(db).balance.value, 100);
+   BOOST_CHECK(tank_id(db).get_state(meter_address) == nullptr);
+   wrapper.commit(db);
+   BOOST_CHECK_EQUAL(tank_id(db).balance.value, 115);
+   BOOST_REQUIRE(tank_id(db).get_state(meter_address) != nullptr);
+   BOOST_CHECK_EQUAL(tank_id(db).get_state(meter_address)->metered_amount.value, 8);
+   BOOST_CHECK(tank_id(db).schematic.attachments.size() == 1);
+} FC_LOG_AND_RETHROW() }
+
+/// Opening a tap whose flow passes through a chain of attachments, on the tank and to another tank, commits every
+/// balance and accessory state the flow changed
+BOOST_AUTO_TEST_CASE( tap_open_through_chained_attachments )
+{ try {
+   // Before HARDFORK_TNT_FLOW_FIX_TIME, an attachment releasing into another attachment on the same tank was taken
+   // for a remote source
+   generate_blocks(HARDFORK_TNT_FLOW_FIX_TIME);
+   ACTORS((alice)(bob));
+   fund(alice, asset(1000 * GRAPHENE_BLOCKCHAIN_PRECISION));
+
+   auto create_op = make_tank(alice_id);
+   tank_id_type other_id = create_tank(create_op);
+
+   // Tap 1 releases through a flow meter into a tap opener, which releases to bob and opens tap 2; tap 2 releases
+   // through another flow meter into the other tank
+   create_op = make_tank(alice_id);
+   create_op.taps.emplace_back(make_tap(ptnt::attachment_id_type{{}, 0}));
+   create_op.taps.emplace_back(make_tap(ptnt::attachment_id_type{{}, 2}));
+   create_op.attachments.emplace_back(ptnt::asset_flow_meter(asset_id_type(), ptnt::attachment_id_type{{}, 1}));
+   create_op.attachments.emplace_back(ptnt::tap_opener(2, share_type(5), bob_id, asset_id_type()));
+   create_op.attachments.emplace_back(ptnt::asset_flow_meter(asset_id_type(), other_id));
+   tank_id_type tank_id = create_tank(create_op);
+   fund_tank(alice_id, tank_id, asset(100));
+   const ptnt::tank_accessory_address<ptnt::asset_flow_meter> first_meter{0};
+   const ptnt::tank_accessory_address<ptnt::asset_flow_meter> second_meter{2};
+   const ptnt::tank_schematic schematic = tank_id(db).schematic;
+   const auto bob_balance = get_balance(bob_id, asset_id_type());
+
+   auto check_tank = [&](share_type balance, share_type first_metered, share_type second_metered,
+                         share_type other_balance) {
+      const tank_object& tank = tank_id(db);
+      BOOST_CHECK_EQUAL(tank.balance.value, balance.value);
+      BOOST_REQUIRE(tank.get_state(first_meter) != nullptr);
+      BOOST_CHECK_EQUAL(tank.get_state(first_meter)->metered_amount.value, first_metered.value);
+      BOOST_REQUIRE(tank.get_state(second_meter) != nullptr);
+      BOOST_CHECK_EQUAL(tank.get_state(second_meter)->metered_amount.value, second_metered.value);
+      BOOST_CHECK_EQUAL(tank.accessory_states.size(), 2u);
+      BOOST_CHECK(fc::raw::pack(tank.schematic) == fc::raw::pack(schematic));
+      BOOST_CHECK_EQUAL(other_id(db).balance.value, other_balance.value);
+   };
+
+   open_tap(alice_id, ptnt::tap_id_type{tank_id, 1}, share_type(20));
+   check_tank(75, 20, 5, 5);
+   BOOST_CHECK_EQUAL(get_balance(bob_id, asset_id_type()), bob_balance + 20);
+
+   open_tap(alice_id, ptnt::tap_id_type{tank_id, 1}, share_type(10));
+   check_tank(60, 30, 10, 10);
+   BOOST_CHECK_EQUAL(get_balance(bob_id, asset_id_type()), bob_balance + 30);
+
+   generate_block();
+   check_tank(60, 30, 10, 10);
+} FC_LOG_AND_RETHROW() }
+
+/// A periodic flow limit's state is deleted once its period has passed
+BOOST_AUTO_TEST_CASE( periodic_limit_state_expires )
+{ try {
+   ACTORS((alice)(bob));
+   fund(alice, asset(1000 * GRAPHENE_BLOCKCHAIN_PRECISION));
+   auto create_op = make_tank(alice_id);
+   create_op.taps.emplace_back(make_periodic_limit_tap(bob_id, 3600));
+   tank_id_type tank_id = create_tank(create_op);
+   fund_tank(alice_id, tank_id, asset(100));
+   const ptnt::tank_accessory_address<ptnt::periodic_flow_limit> address{1, 0};
+   BOOST_CHECK(tank_id(db).next_state_update == time_point_sec::maximum());
+
+   open_tap(alice_id, ptnt::tap_id_type{tank_id, 1}, share_type(10));
+   generate_block();
+   const auto* state = tank_id(db).get_state(address);
+   BOOST_REQUIRE(state != nullptr);
+   BOOST_CHECK_EQUAL(state->amount_released.value, 10);
+   auto period_end = ptnt::periodic_flow_limit(100, 3600).period_end_time(tank_id(db).creation_date,
+                                                                           state->period_num);
+   BOOST_CHECK(tank_id(db).next_state_update == period_end);
+
+   generate_blocks(period_end);
+   BOOST_CHECK(tank_id(db).get_state(address) == nullptr);
+   BOOST_CHECK(tank_id(db).next_state_update == time_point_sec::maximum());
+} FC_LOG_AND_RETHROW() }
+
+/// A periodic flow limit's state is kept, and keeps counting, within its period
+BOOST_AUTO_TEST_CASE( periodic_limit_state_kept_within_period )
+{ try {
+   ACTORS((alice)(bob));
+   fund(alice, asset(1000 * GRAPHENE_BLOCKCHAIN_PRECISION));
+   auto create_op = make_tank(alice_id);
+   create_op.taps.emplace_back(make_periodic_limit_tap(bob_id, 3600));
+   tank_id_type tank_id = create_tank(create_op);
+   fund_tank(alice_id, tank_id, asset(100));
+   const ptnt::tank_accessory_address<ptnt::periodic_flow_limit> address{1, 0};
+
+   open_tap(alice_id, ptnt::tap_id_type{tank_id, 1}, share_type(10));
+   generate_block();
+   BOOST_REQUIRE(tank_id(db).get_state(address) != nullptr);
+   const uint32_t period_num = tank_id(db).get_state(address)->period_num;
+   const time_point_sec period_end = tank_id(db).next_state_update;
+   BOOST_CHECK(period_end == ptnt::periodic_flow_limit(100, 3600).period_end_time(tank_id(db).creation_date,
+                                                                                    period_num));
+
+   generate_blocks(period_end - 60);
+   BOOST_REQUIRE(db.head_block_time() < period_end);
+   open_tap(alice_id, ptnt::tap_id_type{tank_id, 1}, share_type(5));
+   generate_block();
+   BOOST_REQUIRE(db.head_block_time() < period_end);
+   const auto* state = tank_id(db).get_state(address);
+   BOOST_REQUIRE(state != nullptr);
+   BOOST_CHECK_EQUAL(state->period_num, period_num);
+   BOOST_CHECK_EQUAL(state->amount_released.value, 15);
+   BOOST_CHECK(tank_id(db).next_state_update == period_end);
+} FC_LOG_AND_RETHROW() }
+
+/// Removing a tap deletes the states of its requirements, and reschedules the tank's state updates
+BOOST_AUTO_TEST_CASE( removed_requirement_state_pruned )
+{ try {
+   ACTORS((alice)(bob));
+   fund(alice, asset(1000 * GRAPHENE_BLOCKCHAIN_PRECISION));
+   auto create_op = make_tank(alice_id);
+   create_op.taps.emplace_back(make_periodic_limit_tap(bob_id, 3600));
+   create_op.taps.emplace_back(make_periodic_limit_tap(bob_id, 7200));
+   tank_id_type tank_id = create_tank(create_op);
+   fund_tank(alice_id, tank_id, asset(100));
+   const ptnt::tank_accessory_address<ptnt::periodic_flow_limit> first_address{1, 0};
+   const ptnt::tank_accessory_address<ptnt::periodic_flow_limit> second_address{2, 0};
+
+   open_tap(alice_id, ptnt::tap_id_type{tank_id, 1}, share_type(10));
+   open_tap(alice_id, ptnt::tap_id_type{tank_id, 2}, share_type(10));
+   generate_block();
+   BOOST_REQUIRE(tank_id(db).get_state(first_address) != nullptr);
+   BOOST_REQUIRE(tank_id(db).get_state(second_address) != nullptr);
+   const auto& creation_date = tank_id(db).creation_date;
+   const auto second_period_end = ptnt::periodic_flow_limit(100, 7200).period_end_time(
+            creation_date, tank_id(db).get_state(second_address)->period_num);
+   BOOST_CHECK(tank_id(db).next_state_update == ptnt::periodic_flow_limit(100, 3600).period_end_time(
+            creation_date, tank_id(db).get_state(first_address)->period_num));
+
+   tank_update_operation update_op;
+   update_op.payer = alice_id;
+   update_op.tank_to_update = tank_id;
+   update_op.taps_to_remove = {1};
+   update_tank(update_op);
+   BOOST_CHECK(tank_id(db).get_state(first_address) == nullptr);
+   BOOST_CHECK(tank_id(db).get_state(second_address) != nullptr);
+   BOOST_CHECK(tank_id(db).next_state_update == second_period_end);
+
+   update_op.taps_to_remove = {2};
+   update_tank(update_op);
+   BOOST_CHECK(tank_id(db).accessory_states.empty());
+   BOOST_CHECK(tank_id(db).next_state_update == time_point_sec::maximum());
+} FC_LOG_AND_RETHROW() }
+
+/// Shortening a periodic flow limit's period schedules the state update for the end of the shorter period
+BOOST_AUTO_TEST_CASE( shortened_period_rescheduled )
+{ try {
+   ACTORS((alice)(bob));
+   fund(alice, asset(1000 * GRAPHENE_BLOCKCHAIN_PRECISION));
+   auto create_op = make_tank(alice_id);
+   create_op.taps.emplace_back(make_periodic_limit_tap(bob_id, 86400));
+   tank_id_type tank_id = create_tank(create_op);
+   fund_tank(alice_id, tank_id, asset(100));
+   const ptnt::tank_accessory_address<ptnt::periodic_flow_limit> address{1, 0};
+
+   open_tap(alice_id, ptnt::tap_id_type{tank_id, 1}, share_type(10));
+   generate_block();
+   BOOST_REQUIRE(tank_id(db).get_state(address) != nullptr);
+
+   tank_update_operation update_op;
+   update_op.payer = alice_id;
+   update_op.tank_to_update = tank_id;
+   update_op.taps_to_replace[1] = make_periodic_limit_tap(bob_id, 600);
+   update_tank(update_op);
+   generate_block();
+   BOOST_CHECK(tank_id(db).get_state(address) == nullptr);
+   BOOST_CHECK(tank_id(db).next_state_update == time_point_sec::maximum());
+
+   open_tap(alice_id, ptnt::tap_id_type{tank_id, 1}, share_type(10));
+   generate_block();
+   const auto* state = tank_id(db).get_state(address);
+   BOOST_REQUIRE(state != nullptr);
+   auto period_end = ptnt::periodic_flow_limit(100, 600).period_end_time(tank_id(db).creation_date,
+                                                                         state->period_num);
+   BOOST_CHECK(tank_id(db).next_state_update == period_end);
+
+   generate_blocks(period_end);
+   BOOST_CHECK(tank_id(db).get_state(address) == nullptr);
+   BOOST_CHECK(tank_id(db).next_state_update == time_point_sec::maximum());
+} FC_LOG_AND_RETHROW() }
+
+/// The tank lookups of the database API follow tanks as they are created, updated and deleted
+BOOST_AUTO_TEST_CASE( tank_lookups_follow_tank_changes )
+{ try {
+   ACTORS((alice)(bob)(carol));
+   fund(alice, asset(1000 * GRAPHENE_BLOCKCHAIN_PRECISION));
+   graphene::app::application_options opt = app.get_options();
+   opt.has_api_helper_indexes_plugin = true;
+   graphene::app::database_api db_api(db, &opt);
+   const string core_id = std::string(object_id_type(asset_id_type()));
+   using tanks = vector<tank_id_type>;
+
+   // The other tank accepts deposits from bob
+   auto create_op = make_tank(alice_id);
+   create_op.authorized_sources = flat_set<ptnt::remote_connection>{bob_id};
+   tank_id_type other_id = create_tank(create_op);
+
+   // The tank has a tap bob can open, which releases through a flow meter to the other tank
+   create_op = make_tank(alice_id);
+   ptnt::tap bob_tap = make_tap(ptnt::attachment_id_type{{}, 0});
+   bob_tap.open_authority = authority(1, bob_id, 1);
+   create_op.taps.emplace_back(std::move(bob_tap));
+   create_op.attachments.emplace_back(ptnt::asset_flow_meter(asset_id_type(), other_id));
+   tank_id_type tank_id = create_tank(create_op);
+
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_asset(core_id, {}, 100)) == (tanks{other_id, tank_id}));
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_connection(other_id, {}, 100)) == tanks{tank_id});
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_connection(alice_id, {}, 100)) == (tanks{other_id, tank_id}));
+   BOOST_CHECK(db_api.get_tanks_by_connection(carol_id, {}, 100).empty());
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_source(bob_id, {}, 100)) == tanks{other_id});
+   BOOST_CHECK(db_api.get_tanks_by_source(carol_id, {}, 100).empty());
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_tap_opener("bob", {}, 100)) == tanks{tank_id});
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_tap_opener("alice", {}, 100)) == (tanks{other_id, tank_id}));
+
+   BOOST_TEST_MESSAGE("Updating the tank to release to carol, who can open it");
+   tank_update_operation update_op;
+   update_op.payer = alice_id;
+   update_op.tank_to_update = tank_id;
+   ptnt::tap carol_tap = make_tap(carol_id);
+   carol_tap.open_authority = authority(1, carol_id, 1);
+   update_op.taps_to_replace[1] = std::move(carol_tap);
+   update_op.attachments_to_remove = {0};
+   update_tank(update_op);
+
+   BOOST_CHECK(db_api.get_tanks_by_connection(other_id, {}, 100).empty());
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_connection(carol_id, {}, 100)) == tanks{tank_id});
+   BOOST_CHECK(db_api.get_tanks_by_tap_opener("bob", {}, 100).empty());
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_tap_opener("carol", {}, 100)) == tanks{tank_id});
+
+   BOOST_TEST_MESSAGE("Updating the other tank to accept deposits from carol instead of bob");
+   update_op = tank_update_operation();
+   update_op.payer = alice_id;
+   update_op.tank_to_update = other_id;
+   update_op.new_authorized_sources = flat_set<ptnt::remote_connection>{carol_id};
+   update_tank(update_op);
+
+   BOOST_CHECK(db_api.get_tanks_by_source(bob_id, {}, 100).empty());
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_source(carol_id, {}, 100)) == tanks{other_id});
+
+   BOOST_TEST_MESSAGE("Deleting the tank");
+   delete_tank(alice_id, tank_id);
+   BOOST_CHECK(db.find(tank_id) == nullptr);
+
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_asset(core_id, {}, 100)) == tanks{other_id});
+   BOOST_CHECK(db_api.get_tanks_by_connection(carol_id, {}, 100).empty());
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_connection(alice_id, {}, 100)) == tanks{other_id});
+   BOOST_CHECK(db_api.get_tanks_by_tap_opener("carol", {}, 100).empty());
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_tap_opener("alice", {}, 100)) == tanks{other_id});
+
+   BOOST_TEST_MESSAGE("Checking the lookups survive a block");
+   generate_block();
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_source(carol_id, {}, 100)) == tanks{other_id});
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_tap_opener("alice", {}, 100)) == tanks{other_id});
+   BOOST_CHECK(db_api.get_tanks_by_tap_opener("carol", {}, 100).empty());
+} FC_LOG_AND_RETHROW() }
+
+/// The flow path of a tap lists every connection the released asset passes, with absolute tank references
+BOOST_AUTO_TEST_CASE( tank_flow_path )
+{ try {
+   ACTORS((alice));
+   fund(alice, asset(1000 * GRAPHENE_BLOCKCHAIN_PRECISION));
+   graphene::app::application_options opt = app.get_options();
+   graphene::app::database_api db_api(db, &opt);
+
+   tank_id_type other_id = create_tank(make_tank(alice_id));
+   auto create_op = make_tank(alice_id);
+   create_op.taps.emplace_back(make_tap(ptnt::attachment_id_type{{}, 0}));
+   create_op.attachments.emplace_back(ptnt::asset_flow_meter(asset_id_type(), ptnt::attachment_id_type{{}, 1}));
+   create_op.attachments.emplace_back(ptnt::tap_opener(0, share_type(1), other_id, asset_id_type()));
+   tank_id_type tank_id = create_tank(create_op);
+
+   BOOST_CHECK_EQUAL(to_json(db_api.get_tank_flow_path(ptnt::tap_id_type{tank_id, 0})), to_json({alice_id}));
+   BOOST_CHECK_EQUAL(to_json(db_api.get_tank_flow_path(ptnt::tap_id_type{tank_id, 1})),
+                     to_json({ptnt::attachment_id_type{tank_id, 0}, ptnt::attachment_id_type{tank_id, 1},
+                              other_id}));
+
+   GRAPHENE_CHECK_THROW(db_api.get_tank_flow_path(ptnt::tap_id_type{{}, 1}), fc::exception);
+   GRAPHENE_CHECK_THROW(db_api.get_tank_flow_path(ptnt::tap_id_type{tank_id, 2}), fc::exception);
+   GRAPHENE_CHECK_THROW(db_api.get_tank_flow_path(ptnt::tap_id_type{tank_id_type(other_id.instance.value + 10), 0}),
+                        fc::exception);
+} FC_LOG_AND_RETHROW() }
+
+/// The tank lookups return at most api-limit-get-tanks tanks, and page from the start tank
+BOOST_AUTO_TEST_CASE( api_limit_get_tanks )
+{ try {
+   ACTORS((alice)(bob));
+   fund(alice, asset(1000 * GRAPHENE_BLOCKCHAIN_PRECISION));
+   graphene::app::application_options opt = app.get_options();
+   opt.has_api_helper_indexes_plugin = true;
+   opt.api_limit_get_tanks = 2;
+   graphene::app::database_api db_api(db, &opt);
+   const string core_id = std::string(object_id_type(asset_id_type()));
+   using tanks = vector<tank_id_type>;
+
+   auto create_op = make_tank(alice_id);
+   create_op.authorized_sources = flat_set<ptnt::remote_connection>{bob_id};
+   tanks all_tanks;
+   for (int i = 0; i < 3; ++i) {
+      all_tanks.push_back(create_tank(create_op));
+      // Identical transactions must go in different blocks
+      generate_block();
+   }
+   const tanks first_page(all_tanks.begin(), all_tanks.begin() + 2);
+   const tanks last_page{all_tanks.back()};
+
+   GRAPHENE_CHECK_THROW(db_api.get_tanks_by_asset(core_id, {}, 3), fc::exception);
+   GRAPHENE_CHECK_THROW(db_api.get_tanks_by_connection(alice_id, {}, 3), fc::exception);
+   GRAPHENE_CHECK_THROW(db_api.get_tanks_by_source(bob_id, {}, 3), fc::exception);
+   GRAPHENE_CHECK_THROW(db_api.get_tanks_by_tap_opener("alice", {}, 3), fc::exception);
+
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_asset(core_id, {}, 2)) == first_page);
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_connection(alice_id, {}, 2)) == first_page);
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_source(bob_id, {}, 2)) == first_page);
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_tap_opener("alice", {}, 2)) == first_page);
+
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_asset(core_id, all_tanks.back(), 2)) == last_page);
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_connection(alice_id, all_tanks.back(), 2)) == last_page);
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_source(bob_id, all_tanks.back(), 2)) == last_page);
+   BOOST_CHECK(tank_ids(db_api.get_tanks_by_tap_opener("alice", all_tanks.back(), 2)) == last_page);
+
+   // The lookups by reference need the api_helper_indexes plugin
+   opt.has_api_helper_indexes_plugin = false;
+   graphene::app::database_api db_api_without_helpers(db, &opt);
+   BOOST_CHECK(tank_ids(db_api_without_helpers.get_tanks_by_asset(core_id, {}, 2)) == first_page);
+   GRAPHENE_CHECK_THROW(db_api_without_helpers.get_tanks_by_connection(alice_id, {}, 2), fc::exception);
+   GRAPHENE_CHECK_THROW(db_api_without_helpers.get_tanks_by_source(bob_id, {}, 2), fc::exception);
+   GRAPHENE_CHECK_THROW(db_api_without_helpers.get_tanks_by_tap_opener("alice", {}, 2), fc::exception);
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -951,4 +951,97 @@ BOOST_AUTO_TEST_CASE( committee_votes_calculation )
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE( parallel_vote_tally_matches_serial_tally )
+{ try {
+   vote_for_committee_and_witnesses(INITIAL_COMMITTEE_MEMBER_COUNT, INITIAL_WITNESS_COUNT);
+   generate_blocks(db.get_dynamic_global_properties().next_maintenance_time);
+   set_expiration( db, trx );
+
+   ACTOR(nathan);
+   upgrade_to_lifetime_member(nathan_id);
+   const vote_id_type worker_vote = create_worker( nathan_id ).vote_for;
+
+   // Committee members vote for the worker, so the order of its supporters is checked too
+   for( const auto& cm : db.get_global_properties().active_committee_members )
+   {
+      account_update_operation op;
+      op.account = cm(db).committee_member_account;
+      op.new_options = op.account(db).options;
+      op.new_options->votes.insert( worker_vote );
+      trx.operations.push_back( op );
+      PUSH_TX( db, trx, ~0 );
+      trx.clear();
+   }
+
+   vector<vote_id_type> candidates;
+   for( const witness_object& wit : db.get_index_type<witness_index>().indices() )
+      candidates.push_back( wit.vote_id );
+   for( const committee_member_object& cm : db.get_index_type<committee_member_index>().indices() )
+      candidates.push_back( cm.vote_id );
+
+   // Voters with various stakes, opinions and proxies
+   const uint32_t num_voters = 60;
+   vector<account_id_type> voters;
+   for( uint32_t i = 0; i < num_voters; ++i )
+   {
+      const account_object& voter = create_account( "voter" + fc::to_string(i) );
+      voters.push_back( voter.id );
+      fund( voter, asset( 1000 + i * 37 ) );
+
+      account_update_operation op;
+      op.account = voter.id;
+      op.new_options = voter.options;
+      if( i % 7 == 3 )
+         op.new_options->voting_account = voters[i / 2];
+      else
+      {
+         for( size_t c = i % 3; c < candidates.size(); c += 1 + i % 4 )
+            op.new_options->votes.insert( candidates[c] );
+         uint16_t num_witness = 0;
+         uint16_t num_committee = 0;
+         for( vote_id_type id : op.new_options->votes )
+         {
+            if( id.type() == vote_id_type::witness )
+               ++num_witness;
+            else if( id.type() == vote_id_type::committee )
+               ++num_committee;
+         }
+         op.new_options->num_witness = ( i % 2 == 0 ? num_witness : num_witness / 2 );
+         op.new_options->num_committee = ( i % 3 == 0 ? num_committee : num_committee / 2 );
+         if( i % 2 == 0 )
+            op.new_options->votes.insert( worker_vote );
+      }
+      trx.operations.push_back( op );
+      PUSH_TX( db, trx, ~0 );
+      trx.clear();
+   }
+   generate_block();
+
+   vector<vote_tally_buffers> tallies;
+   boost::signals2::scoped_connection connection = db.votes_tallied.connect(
+         [&tallies]( const vote_tally_buffers& tally ) { tallies.push_back( tally ); } );
+
+   // Tally on one thread, then apply the same maintenance block again with a tally over many threads
+   db.set_vote_tally_chunk_size( std::numeric_limits<size_t>::max() );
+   generate_blocks( db.get_dynamic_global_properties().next_maintenance_time );
+   BOOST_REQUIRE_EQUAL( tallies.size(), 1u );
+   const signed_block maintenance_block = *db.fetch_block_by_number( db.head_block_num() );
+
+   db.pop_block();
+   db.set_vote_tally_chunk_size( 1 );
+   PUSH_BLOCK( db, maintenance_block );
+   BOOST_REQUIRE_EQUAL( tallies.size(), 2u );
+
+   const vote_tally_buffers& serial = tallies[0];
+   const vote_tally_buffers& parallel = tallies[1];
+   BOOST_CHECK_GT( serial.cm_support_worker[worker_vote.instance()].size(), 1u );
+   BOOST_CHECK( serial.vote_tally == parallel.vote_tally );
+   BOOST_CHECK( serial.cm_vote_for_worker == parallel.cm_vote_for_worker );
+   BOOST_CHECK( serial.cm_support_worker == parallel.cm_support_worker );
+   BOOST_CHECK( serial.witness_count_histogram == parallel.witness_count_histogram );
+   BOOST_CHECK( serial.committee_count_histogram == parallel.committee_count_histogram );
+   BOOST_CHECK_EQUAL( serial.total_voting_stake[0], parallel.total_voting_stake[0] );
+   BOOST_CHECK_EQUAL( serial.total_voting_stake[1], parallel.total_voting_stake[1] );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()